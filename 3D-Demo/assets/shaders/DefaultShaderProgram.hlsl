@@ -9,7 +9,8 @@ PixelInput VS_main(VertexInput input, uint instanceID : SV_InstanceID)
 
 	InstanceData instance = InstanceBuffer[instanceID];
 
-	float4 position = float4(input.Position, 1.0f);
+	// Exactly as in DepthPrepassShaderProgram.hlsl, the depth must match for the equal test
+	precise float4 position = float4(input.Position, 1.0f);
 	position = mul(position, instance.WorldMatrix);
 	output.Position = position;
 	position = mul(position, Camera.ViewMatrix);
@@ -21,6 +22,7 @@ PixelInput VS_main(VertexInput input, uint instanceID : SV_InstanceID)
 	output.Normal = normalize(normal.xyz);
 
 	output.Texcoord = input.Texcoord;
+	output.MaterialIndex = input.MaterialIndex;
 
 	return output;
 }
@@ -28,42 +30,28 @@ PixelInput VS_main(VertexInput input, uint instanceID : SV_InstanceID)
 PixelOutput PS_main(PixelInput input)
 {
 	PixelOutput output;
-	//output.Color = float4(1.0f, 1.0f, 1.0f, 1.0f);
-	//return output;
 
-	struct LightGeneral
-	{
-		float3 Ambient;
-	} lightGeneral;
-	lightGeneral.Ambient = float3(0.1f, 0.1f, 0.1f);
-
-	struct LightSpecific
-	{
-		float3 Diffuse;
-		float3 Specular;
-	} lightSpecific;
-	lightSpecific.Diffuse = float3(0.6f, 0.6f, 0.6f);
-	lightSpecific.Specular = float3(0.8f, 0.8f, 0.8f);
-
-	float3 lightDir = normalize(Light.Position - input.Position);
-	float3 lightReflect = normalize(reflect(lightDir * -1.0f, input.Normal));
 	float3 eyeDir = normalize(Camera.Position - input.Position);
 
-	float3 diffuse = Material.Diffuse;
+	MaterialData material = MaterialTable[input.MaterialIndex];
 
-	if (Material.DiffuseMapIndex != -1)
-	{
-		diffuse = MaterialDiffuseMap.Sample(defaultSampler, input.Texcoord).xyz;
-	}
+	float2 dx = ddx(input.Texcoord);
+	float2 dy = ddy(input.Texcoord);
+
+	float3 diffuse = GetMaterialDiffuse(material, input.Texcoord, dx, dy);
+	float3 specular = GetMaterialSpecular(material, input.Texcoord, dx, dy);
+	float3 normal = GetMaterialNormal(material, input.Normal, input.Position, input.Texcoord, dx, dy);
 
-	float3 ambientComponent = Material.Ambient * lightGeneral.Ambient;
-	float3 diffuseComponent = diffuse * max(0.0f, dot(lightDir, input.Normal)) * lightSpecific.Diffuse;
-	float3 specularComponent = Material.Specular * pow(max(0.0f, dot(lightReflect, eyeDir)), Material.SpecularExponent) * lightSpecific.Specular;
+	float3 final = material.Ambient * AMBIENT_LIGHT;
+	final += ShadeSun(input.Position, normal, input.NDC.w, eyeDir, diffuse, specular, material.SpecularExponent);
 
-	float3 final = float3(0.0f, 0.0f, 0.0f);
-	final += ambientComponent;
-	final += diffuseComponent;
-	final += specularComponent;
+	// Only the lights binned into this pixel's cluster
+	uint2 cluster = GetLightCluster(input.NDC);
+	for (uint i = 0; i < cluster.y; i++)
+	{
+		PointLightData light = PointLights[GetClusterLightIndex(cluster, i)];
+		final += ShadePointLight(light, input.Position, normal, eyeDir, diffuse, specular, material.SpecularExponent);
+	}
 
 	output.Color = float4(final, 1.0f);
 
@@ -0,0 +1,25 @@
+//#define ENTRY_VERTEX VS_main
+
+#include "ShaderLib.hlsli"
+
+/**
+* -----------------------------------------------------------------------------
+*								DEPTH PREPASS
+*
+* - Depth only, no pixel shader, reads the mesh position stream
+* - The color passes after it test depth equal, positions are transformed
+*	step for step as in their vertex shaders
+* -----------------------------------------------------------------------------
+*/
+
+float4 VS_main(PositionInput input, uint instanceID : SV_InstanceID) : SV_POSITION
+{
+	InstanceData instance = InstanceBuffer[instanceID];
+
+	precise float4 position = float4(input.Position, 1.0f);
+	position = mul(position, instance.WorldMatrix);
+	position = mul(position, Camera.ViewMatrix);
+	position = mul(position, Camera.ProjectionMatrix);
+
+	return position;
+}
@@ -0,0 +1,70 @@
+//#define ENTRY_VERTEX VS_main
+//#define ENTRY_PIXEL PS_main
+
+#include "ShaderLib.hlsli"
+
+/**
+* -----------------------------------------------------------------------------
+*								G-BUFFER LAYOUT
+*
+* - See Graphics::Renderer, lit by TiledDeferredLighting.hlsl
+* - Color		RGB = diffuse, A = specular intensity
+* - Normal		RGB = world normal * 0.5 + 0.5
+* - Emissive	RGB = ambient color, A = intensity
+* - Roughness	R = sqrt(2 / (specular exponent + 2))
+* -----------------------------------------------------------------------------
+*/
+
+struct GBufferOutput
+{
+	float4 Color : SV_TARGET0;
+	float4 Normal : SV_TARGET1;
+	float4 Emissive : SV_TARGET2;
+	float Roughness : SV_TARGET3;
+};
+
+PixelInput VS_main(VertexInput input, uint instanceID : SV_InstanceID)
+{
+	PixelInput output;
+
+	InstanceData instance = InstanceBuffer[instanceID];
+
+	// Exactly as in DepthPrepassShaderProgram.hlsl, the depth must match for the equal test
+	precise float4 position = float4(input.Position, 1.0f);
+	position = mul(position, instance.WorldMatrix);
+	output.Position = position;
+	position = mul(position, Camera.ViewMatrix);
+	position = mul(position, Camera.ProjectionMatrix);
+	output.NDC = position;
+
+	float4 normal = float4(input.Normal, 0.0f);
+	normal = mul(normal, instance.WorldMatrix);
+	output.Normal = normalize(normal.xyz);
+
+	output.Texcoord = input.Texcoord;
+	output.MaterialIndex = input.MaterialIndex;
+
+	return output;
+}
+
+GBufferOutput PS_main(PixelInput input)
+{
+	GBufferOutput output;
+
+	MaterialData material = MaterialTable[input.MaterialIndex];
+
+	float2 dx = ddx(input.Texcoord);
+	float2 dy = ddy(input.Texcoord);
+
+	float3 diffuse = GetMaterialDiffuse(material, input.Texcoord, dx, dy);
+	float3 specular = GetMaterialSpecular(material, input.Texcoord, dx, dy);
+	float3 normal = GetMaterialNormal(material, input.Normal, input.Position, input.Texcoord, dx, dy);
+
+	// Specular is kept as a single intensity, colored highlights turn grey
+	output.Color = float4(diffuse, dot(specular, float3(1.0f, 1.0f, 1.0f) / 3.0f));
+	output.Normal = float4(normal * 0.5f + 0.5f, 0.0f);
+	output.Emissive = float4(material.Ambient, AMBIENT_LIGHT.x);
+	output.Roughness = sqrt(2.0f / (max(material.SpecularExponent, 0.0f) + 2.0f));
+
+	return output;
+}
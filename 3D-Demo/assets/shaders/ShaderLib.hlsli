@@ -9,6 +9,13 @@ struct VertexInput
 	float3 Position : POSITION;
 	float3 Normal : NORMAL;
 	float2 Texcoord : TEXCOORD;
+	uint MaterialIndex : MATERIAL;
+};
+
+// Mesh position stream, the input layout only has what the shader reads
+struct PositionInput
+{
+	float3 Position : POSITION;
 };
 
 struct PixelInput
@@ -17,6 +24,7 @@ struct PixelInput
 	float3 Position : POSITION;
 	float3 Normal : NORMAL;
 	float2 Texcoord : TEXCOORD;
+	nointerpolation uint MaterialIndex : MATERIAL;
 };
 
 // ----------
@@ -49,21 +57,6 @@ cbuffer ObjectBuffer : register (b0)
 	//} BoundingSphere;
 }
 
-cbuffer MaterialBuffer : register (b1)
-{
-	struct
-	{
-		float3 Diffuse;
-		int DiffuseMapIndex;
-		float3 Specular;
-		int SpecularMapIndex;
-		float3 Ambient;
-		int AmbientMapIndex;
-		float SpecularExponent;
-		float3 Padding;
-	} Material;
-}
-
 // -----------
 
 cbuffer CameraBuffer : register (b2)
@@ -77,15 +70,36 @@ cbuffer CameraBuffer : register (b2)
 	} Camera;
 }
 
-cbuffer LightBuffer : register (b3)
+// Graphics::LightClusters, slice = log(depth) * DepthScale + DepthBias
+cbuffer ClusterBuffer : register (b3)
 {
 	struct
 	{
-		float3 Position;
-		float Radius;
-		float3 Color;
+		float2 ScreenOffset;
+		float2 ScreenScale;
+		float DepthScale;
+		float DepthBias;
+		uint GridX;
+		uint GridY;
+		uint GridZ;
+		uint LightCount;
+		float2 Padding;
+	} Clusters;
+}
+
+// Graphics::ShadowCascades, CascadeCount is 0 without a sun
+cbuffer ShadowBuffer : register (b5)
+{
+	struct
+	{
+		float4x4 Cascades[4];
+		float4 SplitDepths;
+		float4 TexelSizes;
+		float3 Direction;
 		float Padding;
-	} Light;
+		float3 Color;
+		uint CascadeCount;
+	} Shadow;
 }
 
 /**
@@ -100,7 +114,60 @@ struct InstanceData
 };
 StructuredBuffer<InstanceData> InstanceBuffer : register (t0); // Vertex
 
+// Map indices are slices of the array in the MapArray slot, maps that are
+// not in an array have the slot -1 and are bound on their own
+struct MaterialData
+{
+	float3 Diffuse;
+	int DiffuseMapIndex;
+	float3 Specular;
+	int SpecularMapIndex;
+	float3 Ambient;
+	int AmbientMapIndex;
+	float SpecularExponent;
+	int DiffuseMapArray;
+	int SpecularMapArray;
+	int NormalMapArray;
+	int NormalMapIndex;
+	uint Features;
+	float2 Padding;
+};
+StructuredBuffer<MaterialData> MaterialTable : register (t1); // Pixel
+
+struct PointLightData
+{
+	float3 Position;
+	float Radius;
+	float3 Color;
+	float Padding;
+};
+StructuredBuffer<PointLightData> PointLights : register (t11); // Pixel, compute
+
+// x = offset into LightIndexList, y = light count
+StructuredBuffer<uint4> LightClusters : register (t12); // Pixel
+
+// Four light indices per element
+StructuredBuffer<uint4> LightIndexList : register (t13); // Pixel
+
+// Sun shadow maps, one per cascade
+Texture2D<float> ShadowCascade0 : register (t19); // Pixel, compute
+Texture2D<float> ShadowCascade1 : register (t20); // Pixel, compute
+Texture2D<float> ShadowCascade2 : register (t21); // Pixel, compute
+Texture2D<float> ShadowCascade3 : register (t22); // Pixel, compute
+
 Texture2D<float4> MaterialDiffuseMap : register (t0); // Pixel
+Texture2D<float4> MaterialSpecularMap : register (t10); // Pixel
+Texture2D<float4> MaterialNormalMap : register (t23); // Pixel
+
+// One array per format and size, MAX_MATERIAL_TEXTURE_ARRAYS in Material.h
+Texture2DArray<float4> MaterialTextureArray0 : register (t2); // Pixel
+Texture2DArray<float4> MaterialTextureArray1 : register (t3); // Pixel
+Texture2DArray<float4> MaterialTextureArray2 : register (t4); // Pixel
+Texture2DArray<float4> MaterialTextureArray3 : register (t5); // Pixel
+Texture2DArray<float4> MaterialTextureArray4 : register (t6); // Pixel
+Texture2DArray<float4> MaterialTextureArray5 : register (t7); // Pixel
+Texture2DArray<float4> MaterialTextureArray6 : register (t8); // Pixel
+Texture2DArray<float4> MaterialTextureArray7 : register (t9); // Pixel
 
 /**
 * -----------------------------------------------------------------------------
@@ -108,4 +175,222 @@ Texture2D<float4> MaterialDiffuseMap : register (t0); // Pixel
 * -----------------------------------------------------------------------------
 */
 
-SamplerState defaultSampler : register (s0);
\ No newline at end of file
+SamplerState defaultSampler : register (s0);
+SamplerComparisonState shadowSampler : register (s1); // Pixel, compute
+
+/**
+* -----------------------------------------------------------------------------
+*							MATERIAL TEXTURE SAMPLING
+* 
+* - Gradients are passed in since the array and slice vary per pixel
+* - The material shaders are compiled once per set of material features,
+*	MATERIAL_FEATURE_DEFINES in Material.h, so the maps a material does not
+*	have are never branched on
+* -----------------------------------------------------------------------------
+*/
+
+float4 SampleMaterialTextureArray(int array, int slice, float2 texcoord, float2 dx, float2 dy)
+{
+	float3 location = float3(texcoord, slice);
+
+	switch (array)
+	{
+	case 0: return MaterialTextureArray0.SampleGrad(defaultSampler, location, dx, dy);
+	case 1: return MaterialTextureArray1.SampleGrad(defaultSampler, location, dx, dy);
+	case 2: return MaterialTextureArray2.SampleGrad(defaultSampler, location, dx, dy);
+	case 3: return MaterialTextureArray3.SampleGrad(defaultSampler, location, dx, dy);
+	case 4: return MaterialTextureArray4.SampleGrad(defaultSampler, location, dx, dy);
+	case 5: return MaterialTextureArray5.SampleGrad(defaultSampler, location, dx, dy);
+	case 6: return MaterialTextureArray6.SampleGrad(defaultSampler, location, dx, dy);
+	default: return MaterialTextureArray7.SampleGrad(defaultSampler, location, dx, dy);
+	}
+}
+
+// A map in a texture array, or bound on its own when array is -1
+float4 SampleMaterialMap(int array, int slice, Texture2D<float4> map, float2 texcoord, float2 dx, float2 dy)
+{
+	return (array != -1)
+		? SampleMaterialTextureArray(array, slice, texcoord, dx, dy)
+		: map.SampleGrad(defaultSampler, texcoord, dx, dy);
+}
+
+// Diffuse and specular colors of a material, from its maps when it has them
+float3 GetMaterialDiffuse(MaterialData material, float2 texcoord, float2 dx, float2 dy)
+{
+#ifdef MATERIAL_DIFFUSE_MAP
+	float4 diffuse = SampleMaterialMap(material.DiffuseMapArray, material.DiffuseMapIndex, MaterialDiffuseMap, texcoord, dx, dy);
+#ifdef MATERIAL_ALPHA_TEST
+	clip(diffuse.a - 0.5f);
+#endif
+	return diffuse.xyz;
+#else
+	return material.Diffuse;
+#endif
+}
+
+float3 GetMaterialSpecular(MaterialData material, float2 texcoord, float2 dx, float2 dy)
+{
+#ifdef MATERIAL_SPECULAR_MAP
+	return SampleMaterialMap(material.SpecularMapArray, material.SpecularMapIndex, MaterialSpecularMap, texcoord, dx, dy).xyz;
+#else
+	return material.Specular;
+#endif
+}
+
+// Meshes have no tangents, the tangent frame comes from the screen space
+// derivatives of the position and texcoord. Normal maps are BC5, z is rebuilt.
+float3 GetMaterialNormal(MaterialData material, float3 normal, float3 position, float2 texcoord, float2 dx, float2 dy)
+{
+	normal = normalize(normal);
+#ifdef MATERIAL_NORMAL_MAP
+	float3 mapped;
+	mapped.xy = SampleMaterialMap(material.NormalMapArray, material.NormalMapIndex, MaterialNormalMap, texcoord, dx, dy).xy * 2.0f - 1.0f;
+	mapped.z = sqrt(saturate(1.0f - dot(mapped.xy, mapped.xy)));
+
+	float3 dpx = ddx(position);
+	float3 dpy = ddy(position);
+	float3 dpyPerp = cross(dpy, normal);
+	float3 dpxPerp = cross(normal, dpx);
+	float3 tangent = dpyPerp * dx.x + dpxPerp * dy.x;
+	float3 bitangent = dpyPerp * dx.y + dpxPerp * dy.y;
+	float scale = rsqrt(max(max(dot(tangent, tangent), dot(bitangent, bitangent)), 1e-20f));
+
+	normal = normalize(mul(mapped, float3x3(tangent * scale, bitangent * scale, normal)));
+#endif
+	return normal;
+}
+
+/**
+* -----------------------------------------------------------------------------
+*								LIGHT CLUSTERS
+* 
+* - screenPosition is SV_POSITION, its w holds the view depth
+* -----------------------------------------------------------------------------
+*/
+
+uint2 GetLightCluster(float4 screenPosition)
+{
+	uint3 cluster;
+	cluster.xy = (uint2)clamp((screenPosition.xy - Clusters.ScreenOffset) * Clusters.ScreenScale, 0.0f, float2(Clusters.GridX - 1, Clusters.GridY - 1));
+	cluster.z = (uint)clamp(log(screenPosition.w) * Clusters.DepthScale + Clusters.DepthBias, 0.0f, (float)(Clusters.GridZ - 1));
+
+	return LightClusters[cluster.x + cluster.y * Clusters.GridX + cluster.z * Clusters.GridX * Clusters.GridY].xy;
+}
+
+uint GetClusterLightIndex(uint2 cluster, uint i)
+{
+	uint index = cluster.x + i;
+	return LightIndexList[index >> 2][index & 3];
+}
+
+// Smooth falloff reaching zero at the radius
+float GetLightAttenuation(float distance, float radius)
+{
+	float falloff = saturate(1.0f - distance / radius);
+	return falloff * falloff;
+}
+
+/**
+* -----------------------------------------------------------------------------
+*								POINT LIGHT SHADING
+* 
+* - Shared by the forward pixel shader and the deferred light pass
+* -----------------------------------------------------------------------------
+*/
+
+static const float3 AMBIENT_LIGHT = float3(0.1f, 0.1f, 0.1f);
+static const float3 LIGHT_DIFFUSE = float3(0.6f, 0.6f, 0.6f);
+static const float3 LIGHT_SPECULAR = float3(0.8f, 0.8f, 0.8f);
+
+float3 ShadePointLight(PointLightData light, float3 position, float3 normal, float3 eyeDir, float3 diffuse, float3 specular, float specularExponent)
+{
+	float3 toLight = light.Position - position;
+	float distance = length(toLight);
+	if (distance >= light.Radius)
+	{
+		return float3(0.0f, 0.0f, 0.0f);
+	}
+
+	float3 lightDir = toLight / distance;
+	float3 lightReflect = normalize(reflect(lightDir * -1.0f, normal));
+	float3 radiance = light.Color * GetLightAttenuation(distance, light.Radius);
+
+	float3 color = diffuse * max(0.0f, dot(lightDir, normal)) * LIGHT_DIFFUSE * radiance;
+	color += specular * pow(max(0.0f, dot(lightReflect, eyeDir)), specularExponent) * LIGHT_SPECULAR * radiance;
+	return color;
+}
+
+/**
+* -----------------------------------------------------------------------------
+*								SUN SHADING
+* 
+* - viewDepth picks the cascade, SV_POSITION.w in pixel shaders
+* - Receivers are pushed along their normal by a few texels instead of
+*	biasing the rasterizer, the further cascades get the larger offset
+* -----------------------------------------------------------------------------
+*/
+
+static const float SHADOW_MAP_SIZE = 2048.0f;		// ShadowCascades::RESOLUTION
+static const float SHADOW_NORMAL_OFFSET = 1.5f;		// Texels
+static const float SHADOW_DEPTH_BIAS = 0.0005f;
+
+float SampleShadowCascade(uint cascade, float2 location, float depth)
+{
+	switch (cascade)
+	{
+	case 0: return ShadowCascade0.SampleCmpLevelZero(shadowSampler, location, depth);
+	case 1: return ShadowCascade1.SampleCmpLevelZero(shadowSampler, location, depth);
+	case 2: return ShadowCascade2.SampleCmpLevelZero(shadowSampler, location, depth);
+	default: return ShadowCascade3.SampleCmpLevelZero(shadowSampler, location, depth);
+	}
+}
+
+// 1 where the sun reaches, 0 in full shadow
+float GetSunShadow(float3 position, float3 normal, float viewDepth)
+{
+	uint cascade = 0;
+	[unroll]
+	for (uint i = 0; i < 3; i++)
+	{
+		cascade += (viewDepth > Shadow.SplitDepths[i]) ? 1 : 0;
+	}
+	if (viewDepth > Shadow.SplitDepths[3])
+	{
+		return 1.0f;
+	}
+
+	float3 offset = normal * Shadow.TexelSizes[cascade] * SHADOW_NORMAL_OFFSET;
+	float4 lightPosition = mul(float4(position + offset, 1.0f), Shadow.Cascades[cascade]);
+	float2 location = lightPosition.xy * float2(0.5f, -0.5f) + 0.5f;
+	float depth = lightPosition.z - SHADOW_DEPTH_BIAS;
+
+	// 3x3 taps, each filtered 2x2 by the sampler
+	float lit = 0.0f;
+	[unroll]
+	for (int y = -1; y <= 1; y++)
+	{
+		[unroll]
+		for (int x = -1; x <= 1; x++)
+		{
+			lit += SampleShadowCascade(cascade, location + float2(x, y) / SHADOW_MAP_SIZE, depth);
+		}
+	}
+	return lit / 9.0f;
+}
+
+float3 ShadeSun(float3 position, float3 normal, float viewDepth, float3 eyeDir, float3 diffuse, float3 specular, float specularExponent)
+{
+	float3 lightDir = -Shadow.Direction;
+	float lambert = dot(lightDir, normal);
+	if (Shadow.CascadeCount == 0 || lambert <= 0.0f)
+	{
+		return float3(0.0f, 0.0f, 0.0f);
+	}
+
+	float3 lightReflect = normalize(reflect(Shadow.Direction, normal));
+	float3 radiance = Shadow.Color * GetSunShadow(position, normal, viewDepth);
+
+	float3 color = diffuse * lambert * LIGHT_DIFFUSE * radiance;
+	color += specular * pow(max(0.0f, dot(lightReflect, eyeDir)), specularExponent) * LIGHT_SPECULAR * radiance;
+	return color;
+}
@@ -0,0 +1,27 @@
+//#define ENTRY_VERTEX VS_main
+
+#include "ShaderLib.hlsli"
+
+/**
+* -----------------------------------------------------------------------------
+*								SHADOW CASTERS
+*
+* - Depth only, drawn once per cascade without a pixel shader
+* - See Graphics::ShadowCascades
+* -----------------------------------------------------------------------------
+*/
+
+// Resource::ShadowCasterBufferData
+cbuffer ShadowCasterBuffer : register (b6)
+{
+	struct
+	{
+		float4x4 ViewProjection;
+	} ShadowCaster;
+}
+
+float4 VS_main(PositionInput input, uint instanceID : SV_InstanceID) : SV_POSITION
+{
+	float4 position = mul(float4(input.Position, 1.0f), InstanceBuffer[instanceID].WorldMatrix);
+	return mul(position, ShadowCaster.ViewProjection);
+}
@@ -0,0 +1,158 @@
+//#define ENTRY_COMPUTE CS_main
+
+#include "ShaderLib.hlsli"
+
+/**
+* -----------------------------------------------------------------------------
+*							TILED DEFERRED LIGHTING
+*
+* - One group per 16x16 pixel tile of the viewport
+* - The group finds the depth range of its tile, culls every light against
+*	the tile frustum into a shared list and then shades its pixels with it
+* - Pixels without geometry keep the cleared color
+* -----------------------------------------------------------------------------
+*/
+
+#define TILE_SIZE 16
+
+// Lights culled into a tile past this many are not shaded in it. Nothing
+// reports it, Graphics::Renderer notes the limit where the lights are uploaded.
+#define MAX_TILE_LIGHTS 512
+
+// Resource::TiledLightingBufferData
+cbuffer TiledLightingBuffer : register (b4)
+{
+	struct
+	{
+		float4x4 InverseProjection;
+		float4x4 InverseView;
+		float2 ScreenOffset;
+		float2 ScreenSize;
+		uint LightCount;
+		float3 Padding;
+	} TiledLighting;
+}
+
+// Written by GBufferShaderProgram.hlsl
+Texture2D<float4> GBufferColor : register (t14);
+Texture2D<float4> GBufferNormal : register (t15);
+Texture2D<float4> GBufferEmissive : register (t16);
+Texture2D<float> GBufferRoughness : register (t17);
+Texture2D<float> GBufferDepth : register (t18);
+
+RWTexture2D<unorm float4> Output : register (u0);
+
+groupshared uint tileMinDepth;
+groupshared uint tileMaxDepth;
+groupshared uint tileLightCount;
+groupshared uint tileLights[MAX_TILE_LIGHTS];
+
+// View space position of a pixel center at the given depth buffer value
+float3 GetViewPosition(float2 pixel, float depth)
+{
+	float2 ndc = (pixel - TiledLighting.ScreenOffset) / TiledLighting.ScreenSize * float2(2.0f, -2.0f) + float2(-1.0f, 1.0f);
+	float4 position = mul(float4(ndc, depth, 1.0f), TiledLighting.InverseProjection);
+	return position.xyz / position.w;
+}
+
+[numthreads(TILE_SIZE, TILE_SIZE, 1)]
+void CS_main(uint3 groupID : SV_GroupID, uint3 dispatchThreadID : SV_DispatchThreadID, uint groupIndex : SV_GroupIndex)
+{
+	if (groupIndex == 0)
+	{
+		tileMinDepth = 0x7F7FFFFF; // FLT_MAX
+		tileMaxDepth = 0;
+		tileLightCount = 0;
+	}
+	GroupMemoryBarrierWithGroupSync();
+
+	float2 pixel = TiledLighting.ScreenOffset + dispatchThreadID.xy + 0.5f;
+	bool inside = all(dispatchThreadID.xy < (uint2)TiledLighting.ScreenSize);
+
+	float depth = inside ? GBufferDepth.Load(int3(pixel, 0)) : 1.0f;
+	bool geometry = depth < 1.0f;
+	float3 viewPosition = GetViewPosition(pixel, depth);
+
+	// Positive floats order like their bits
+	if (geometry)
+	{
+		InterlockedMin(tileMinDepth, asuint(viewPosition.z));
+		InterlockedMax(tileMaxDepth, asuint(viewPosition.z));
+	}
+	GroupMemoryBarrierWithGroupSync();
+
+	float minDepth = asfloat(tileMinDepth);
+	float maxDepth = asfloat(tileMaxDepth);
+
+	// Side planes of the tile through the eye, pointing inwards
+	float2 tileMin = TiledLighting.ScreenOffset + groupID.xy * TILE_SIZE;
+	float2 tileMax = tileMin + TILE_SIZE;
+	float3 corners[4] =
+	{
+		GetViewPosition(float2(tileMin.x, tileMin.y), 1.0f),
+		GetViewPosition(float2(tileMax.x, tileMin.y), 1.0f),
+		GetViewPosition(float2(tileMax.x, tileMax.y), 1.0f),
+		GetViewPosition(float2(tileMin.x, tileMax.y), 1.0f)
+	};
+	float3 center = (corners[0] + corners[1] + corners[2] + corners[3]) * 0.25f;
+
+	float3 planes[4];
+	[unroll]
+	for (uint p = 0; p < 4; p++)
+	{
+		planes[p] = normalize(cross(corners[p], corners[(p + 1) & 3]));
+		planes[p] *= (dot(planes[p], center) < 0.0f) ? -1.0f : 1.0f;
+	}
+
+	// Every thread tests a share of the lights
+	for (uint i = groupIndex; i < TiledLighting.LightCount; i += TILE_SIZE * TILE_SIZE)
+	{
+		PointLightData light = PointLights[i];
+		float3 lightCenter = mul(float4(light.Position, 1.0f), Camera.ViewMatrix).xyz;
+
+		bool visible = lightCenter.z + light.Radius >= minDepth && lightCenter.z - light.Radius <= maxDepth;
+		[unroll]
+		for (uint p = 0; p < 4; p++)
+		{
+			visible = visible && dot(planes[p], lightCenter) >= -light.Radius;
+		}
+
+		if (visible)
+		{
+			uint slot;
+			InterlockedAdd(tileLightCount, 1, slot);
+			if (slot < MAX_TILE_LIGHTS)
+			{
+				tileLights[slot] = i;
+			}
+		}
+	}
+	GroupMemoryBarrierWithGroupSync();
+
+	if (!geometry)
+	{
+		return;
+	}
+
+	int3 location = int3(pixel, 0);
+	float4 color = GBufferColor.Load(location);
+	float3 normal = normalize(GBufferNormal.Load(location).xyz * 2.0f - 1.0f);
+	float4 emissive = GBufferEmissive.Load(location);
+	float roughness = max(GBufferRoughness.Load(location), 0.01f);
+
+	float3 position = mul(float4(viewPosition, 1.0f), TiledLighting.InverseView).xyz;
+	float3 eyeDir = normalize(Camera.Position - position);
+	float3 specular = color.aaa;
+	float specularExponent = 2.0f / (roughness * roughness) - 2.0f;
+
+	float3 final = emissive.rgb * emissive.a;
+	final += ShadeSun(position, normal, viewPosition.z, eyeDir, color.rgb, specular, specularExponent);
+
+	uint lightCount = min(tileLightCount, MAX_TILE_LIGHTS);
+	for (uint l = 0; l < lightCount; l++)
+	{
+		final += ShadePointLight(PointLights[tileLights[l]], position, normal, eyeDir, color.rgb, specular, specularExponent);
+	}
+
+	Output[(uint2)pixel] = float4(final, 1.0f);
+}
@@ -1,14 +1,64 @@
 #pragma once
 #include "pch.h"
 #include "Resource/Shaderprogram.h"
+#include "Graphics/GpuTimer.h"
+#include "Platform/Profiler.h"
+
+// Times the GPU work recorded in the rest of the enclosing scope
+#define PROFILE_GPU_SCOPE(commandBuffer, name) Graphics::GpuTimingScope PROFILE_CONCAT(gpuTimingScope, __LINE__)(commandBuffer, name)
 
 namespace Graphics
 {
+	// Resources by the names the shaders declare them with. Binding a set
+	// binds what the program's reflected binding table uses, to the slots it
+	// was compiled with and only in the stages reading it. Setting a name
+	// again replaces the resource.
+	class ResourceSet
+	{
+	public:
+
+		void SetConstantBuffer(const std::string& name, ID bufferID);
+		void SetBufferArray(const std::string& name, ID bufferID);
+		void SetTexture(const std::string& name, ID textureID);
+		void SetDepthTexture(const std::string& name, ID depthTextureID);
+		void SetUnorderedAccess(const std::string& name, ID textureID); // Compute only
+		void SetSampler(const std::string& name, ID samplerID);
+
+	private:
+
+		enum class EntryType
+		{
+			ConstantBuffer,
+			BufferArray,
+			Texture,
+			DepthTexture,
+			UnorderedAccess,
+			Sampler
+		};
+
+		struct Entry
+		{
+			std::string Name;
+			size_t NameHash;
+			EntryType Type;
+			ID ResourceID;
+		};
+
+		void Set(const std::string& name, EntryType type, ID resourceID);
+		const Entry* Find(const Resource::ShaderBinding& binding) const;
+
+		friend class CommandBuffer;
+
+	private:
+
+		std::vector<Entry> m_entries;
+	};
+
 	class CommandBuffer
 	{
 	public:
 
-		CommandBuffer();
+		CommandBuffer(GpuTimerMode timerMode = GpuTimerMode::Queries);
 		~CommandBuffer();
 
 	private:
@@ -33,12 +83,63 @@ namespace Graphics
 		void BindBufferArray(ID bufferID, UINT stages, UINT slot);
 		void BindConstantBuffer(ID bufferID, UINT stages, UINT slot);
 		void BindRenderTarget(ID textureID, UINT slot, ID depthTextureID);
+		void BindRenderTargets(const ID* textureIDs, UINT count, ID depthTextureID);
+		void UnbindRenderTargets();
 		void BindShaderResource(ID textureID, UINT stages, UINT slot);
+		void BindDepthShaderResource(ID depthTextureID, UINT stages, UINT slot);
+		void UnbindShaderResources(UINT stages, UINT slot, UINT count = 1);
+		void BindUnorderedAccess(ID textureID, UINT slot); // Compute only
+		void UnbindUnorderedAccess(UINT slot, UINT count = 1);
 		void BindSampler(ID samplerID, UINT stages, UINT slot);
 		void BindShaderProgram(ID programID);
+
+		// Everything in the set the program uses, resources it does not use are
+		// skipped. Textures and unordered access views set to 0 are unbound.
+		void BindResourceSet(ID programID, const ResourceSet& resources);
+
+		// Unbinds the textures and unordered access views of the set the program
+		// reads, so later passes can write them
+		void UnbindResourceSet(ID programID, const ResourceSet& resources);
+		void BindDepthStencilState(ID stateID); // 0 for the default, depth less with writes
 		void BindViewPort(const D3D11_VIEWPORT& viewPort);
 
 		void DrawIndexed(UINT indexCount, UINT indexOffset, UINT baseVertexLocation = 0);
 		void DrawIndexedInstanced(UINT indexCount, UINT indexOffset, UINT instanceCount, UINT instanceOffset = 0, UINT baseVertexLocation = 0);
+		void Dispatch(UINT groupCountX, UINT groupCountY, UINT groupCountZ = 1);
+
+		// GPU timings, scopes only count between BeginFrameTiming and EndFrameTiming
+		inline void SetTimerMode(GpuTimerMode mode) { m_timer.SetMode(mode); }
+		void BeginFrameTiming();
+		void EndFrameTiming();
+		void BeginTimingScope(const char* name);
+		void EndTimingScope();
+
+	private:
+
+		void Unbind(const Resource::ShaderBinding& binding);
+
+	private:
+
+		GpuTimer m_timer;
+	};
+
+	class GpuTimingScope
+	{
+	public:
+
+		GpuTimingScope(CommandBuffer& commandBuffer, const char* name) : m_commandBuffer(commandBuffer) { m_commandBuffer.BeginTimingScope(name); }
+		~GpuTimingScope() { m_commandBuffer.EndTimingScope(); }
+
+	private:
+
+		// No copy allowed
+		GpuTimingScope(const GpuTimingScope& other) = delete;
+		GpuTimingScope(const GpuTimingScope&& other) = delete;
+		GpuTimingScope& operator=(const GpuTimingScope& other) = delete;
+		GpuTimingScope& operator=(const GpuTimingScope&& other) = delete;
+
+	private:
+
+		CommandBuffer& m_commandBuffer;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+#include "pch.h"
+
+namespace Graphics
+{
+	// Front to back order of draws by a bucket sort on view depth. The depth
+	// range is split into BUCKET_COUNT buckets spaced logarithmically, like
+	// the light cluster slices, so near draws are told apart finely and far
+	// ones coarsely. Draws in the same bucket keep their submission order.
+	//
+	// Two passes over the draws and one over the buckets, no comparisons.
+	class DepthSort
+	{
+	public:
+
+		static constexpr UINT BUCKET_COUNT = 1024;
+
+		DepthSort();
+		~DepthSort();
+
+		void SetRange(float nearPlane, float farPlane);
+
+		// Depths before the near plane go in the first bucket, past the far plane in the last
+		UINT GetBucket(float depth) const;
+
+		// Indices into depths from the nearest to the furthest
+		void Sort(const float* depths, size_t count, std::vector<UINT>& order);
+
+	private:
+
+		// No copy allowed
+		DepthSort(const DepthSort& other) = delete;
+		DepthSort(const DepthSort&& other) = delete;
+		DepthSort& operator=(const DepthSort& other) = delete;
+		DepthSort& operator=(const DepthSort&& other) = delete;
+
+	private:
+
+		float m_nearPlane;
+		float m_scale;	// bucket = log(depth / near) * scale
+		std::vector<UINT> m_offsets;
+		std::vector<uint16_t> m_buckets;
+	};
+}
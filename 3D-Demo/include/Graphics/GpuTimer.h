@@ -0,0 +1,90 @@
+#pragma once
+#include "pch.h"
+
+namespace Graphics
+{
+	enum class GpuTimerMode
+	{
+		Queries,	// Timestamp queries, falls back to Emulated if the device has none
+		Emulated,	// CPU times of the scope calls, for devices without queries
+	};
+
+	// Times scopes of GPU work with timestamp queries inside a disjoint query
+	// per frame. Results are read FRAME_LATENCY frames later, or sooner if they
+	// are ready, so the CPU never waits on the GPU. Resolved scopes go to the
+	// Profiler's GPU track, placed on the CPU clock through a calibration taken
+	// every few seconds, so the clocks do not drift apart, and again whenever
+	// the GPU clock is reported disjoint.
+	class GpuTimer
+	{
+	public:
+
+		static constexpr UINT FRAME_LATENCY = 4;	// Frames in flight before a frame's queries are reused
+		static constexpr UINT MAX_SCOPES = 128;		// Per frame, later scopes are not timed
+
+		GpuTimer(GpuTimerMode mode = GpuTimerMode::Queries);
+		~GpuTimer();
+
+		void BeginFrame();
+		void EndFrame();
+
+		// Scopes nest, name must be a string literal
+		void BeginScope(const char* name);
+		void EndScope();
+
+		// Only between frames, results not read yet are dropped
+		void SetMode(GpuTimerMode mode);
+
+		inline bool IsEmulated() const { return m_mode == GpuTimerMode::Emulated; }
+
+	private:
+
+		// No copy allowed
+		GpuTimer(const GpuTimer& other) = delete;
+		GpuTimer(const GpuTimer&& other) = delete;
+		GpuTimer& operator=(const GpuTimer& other) = delete;
+		GpuTimer& operator=(const GpuTimer&& other) = delete;
+
+	private:
+
+		struct Scope
+		{
+			const char* Name = nullptr;
+			ComPtr<ID3D11Query> BeginQuery;
+			ComPtr<ID3D11Query> EndQuery;
+			UINT64 Begin = 0;	// Emulated, profiler clock
+			UINT64 End = 0;
+		};
+
+		struct Frame
+		{
+			ComPtr<ID3D11Query> Disjoint;
+			std::vector<Scope> Scopes;
+			UINT ScopeCount = 0;
+			bool Pending = false;	// Ended, not resolved yet
+		};
+
+		bool CreateQueries(Scope& scope);
+		bool Resolve(Frame& frame, bool wait);
+		void Calibrate();
+
+		// GPU ticks to the profiler clock
+		inline UINT64 ToCpuTime(UINT64 ticks, UINT64 frequency) const
+		{
+			return (UINT64)((INT64)m_cpuOrigin + (INT64)((double)(INT64)(ticks - m_gpuOrigin) * 1e9 / (double)frequency));
+		}
+
+	private:
+
+		GpuTimerMode m_mode;
+		Frame m_frames[FRAME_LATENCY];
+		UINT m_frameIndex;
+		bool m_inFrame;
+
+		std::vector<UINT> m_openScopes; // Indices into the current frame's scopes
+
+		bool m_calibrated;
+		UINT64 m_gpuOrigin;		// GPU ticks at the calibration
+		UINT64 m_cpuOrigin;		// Profiler clock at the calibration, also when it was taken
+	};
+}
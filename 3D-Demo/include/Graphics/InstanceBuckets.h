@@ -0,0 +1,77 @@
+#pragma once
+#include "pch.h"
+#include "Resource/ShaderBuffers.h"
+
+namespace Graphics
+{
+	struct InstanceSubmission
+	{
+		ID MeshID;
+		DirectX::XMFLOAT4X4 WorldTransposed;
+	};
+
+	// Instance data of one frame grouped per mesh. Clear keeps every bucket and
+	// its capacity, so a steady scene stops allocating after the first frames.
+	class InstanceBuckets
+	{
+	public:
+
+		struct Bucket
+		{
+			ID MeshID;
+			std::vector<Resource::ObjectBufferData> Instances;
+		};
+
+		InstanceBuckets();
+		~InstanceBuckets();
+
+		void Add(ID meshID, const DirectX::XMFLOAT4X4& worldTransposed);
+
+		// Bulk submission, large spans are bucketed in parallel. Within a mesh
+		// the instances keep the order of the span.
+		void Add(const InstanceSubmission* submissions, size_t count);
+
+		// Appends count uninitialized instances to the bucket of meshID
+		Resource::ObjectBufferData* Append(ID meshID, size_t count);
+
+		void Clear();
+
+		// Buckets may be empty, in the order meshes were first submitted
+		inline const std::vector<Bucket>& GetBuckets() const { return m_buckets; }
+		size_t GetInstanceCount() const;
+
+		// Spans shorter than this are bucketed on the calling thread, 0 never splits
+		inline void SetParallelThreshold(size_t count) { m_parallelThreshold = count; }
+
+	private:
+
+		// No copy allowed
+		InstanceBuckets(const InstanceBuckets& other) = delete;
+		InstanceBuckets(const InstanceBuckets&& other) = delete;
+		InstanceBuckets& operator=(const InstanceBuckets& other) = delete;
+		InstanceBuckets& operator=(const InstanceBuckets&& other) = delete;
+
+	private:
+
+		static constexpr uint32_t NO_BUCKET = UINT32_MAX;
+
+		uint32_t FindBucket(ID meshID) const;
+		uint32_t GetOrCreateBucket(ID meshID);
+
+	private:
+
+		std::vector<Bucket> m_buckets;
+		std::unordered_map<ID, uint32_t> m_bucketIndices;
+		size_t m_parallelThreshold;
+
+		// Consecutive submissions are usually of the same mesh
+		ID m_lastMeshID;
+		uint32_t m_lastBucket;
+
+		// Scratch of the bulk path, kept between frames. One row of per bucket
+		// counts, then write offsets, for every chunk of the span.
+		std::vector<uint32_t> m_submissionBuckets;
+		std::vector<std::vector<uint32_t>> m_chunkCounts;
+		std::vector<std::vector<size_t>> m_chunkMissing; // Submissions of meshes without a bucket yet
+	};
+}
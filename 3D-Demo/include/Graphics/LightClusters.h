@@ -0,0 +1,116 @@
+#pragma once
+#include "pch.h"
+#include "Resource/Light.h"
+#include "Resource/ShaderBuffers.h"
+
+namespace Graphics
+{
+	// Lights of one cluster are LightIndices[Offset, Offset + Count)
+	struct LightCluster
+	{
+		UINT Offset;
+		UINT Count;
+		UINT Padding[2];
+	};
+
+	struct ClusterView
+	{
+		DirectX::XMFLOAT4X4 View;	// Not transposed
+		float FOV;					// Vertical, radians
+		float AspectRatio;
+		float NearPlane;
+		float FarPlane;
+	};
+
+	// Splits the view frustum into GRID_X * GRID_Y screen tiles and GRID_Z depth
+	// slices, spaced exponentially so clusters are about as deep as they are
+	// wide, and lists the point lights touching each cluster. The pixel shader
+	// finds its cluster from the screen position and view depth and only
+	// shades with those lights.
+	//
+	// Lights are moved to view space and stored as SoA, every slice is binned
+	// as a job: lights overlapping the slice depth are gathered, then filtered
+	// per tile row and per tile with sphere against box tests four at a time.
+	class LightClusters
+	{
+	public:
+
+		static constexpr UINT GRID_X = 16;
+		static constexpr UINT GRID_Y = 9;
+		static constexpr UINT GRID_Z = 24;
+		static constexpr UINT CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+
+		static constexpr UINT MAX_LIGHTS_PER_CLUSTER = 256;
+		static constexpr UINT MAX_LIGHT_INDICES = 1024 * 1024; // Later clusters lose lights beyond this
+
+		LightClusters();
+		~LightClusters();
+
+		void Build(const ClusterView& view, const Resource::PointLight* lights, size_t lightCount, bool parallel = true);
+
+		// Cluster index is x + y * GRID_X + z * GRID_X * GRID_Y, y from the top of the screen
+		inline const std::vector<LightCluster>& GetClusters() const { return m_clusters; }
+
+		// Padded to a multiple of 4, the shader reads them as uint4
+		inline const std::vector<UINT>& GetLightIndices() const { return m_lightIndices; }
+
+		Resource::ClusterBufferData GetBufferData(const D3D11_VIEWPORT& viewPort, UINT lightCount) const;
+
+		// View space bounds of a cluster, for tests
+		void GetClusterBounds(UINT cluster, DirectX::XMFLOAT3& minimum, DirectX::XMFLOAT3& maximum) const;
+
+	private:
+
+		// No copy allowed
+		LightClusters(const LightClusters& other) = delete;
+		LightClusters(const LightClusters&& other) = delete;
+		LightClusters& operator=(const LightClusters& other) = delete;
+		LightClusters& operator=(const LightClusters&& other) = delete;
+
+	private:
+
+		struct Bounds
+		{
+			float MinX, MinY, MinZ;
+			float MaxX, MaxY, MaxZ;
+		};
+
+		// Lights as four arrays, padded to a multiple of 4 with lights that touch nothing
+		struct LightSoA
+		{
+			std::vector<float> X, Y, Z, Radius;
+			std::vector<UINT> Index;
+
+			void Clear();
+			void Push(float x, float y, float z, float radius, UINT index);
+			void Pad();
+			inline size_t Size() const { return X.size(); }
+		};
+
+		// Working memory of one slice, kept between frames
+		struct Slice
+		{
+			LightSoA Candidates;
+			LightSoA RowCandidates;
+			std::vector<UINT> Indices;	// The slice's clusters one after another
+			UINT Counts[GRID_X * GRID_Y];
+		};
+
+		void UpdateBounds(const ClusterView& view);
+		void BinSlice(UINT z);
+
+	private:
+
+		LightSoA m_lights; // View space
+		std::vector<Slice> m_slices;
+		std::vector<Bounds> m_bounds;		// Per cluster
+		std::vector<Bounds> m_rowBounds;	// Per tile row of a slice, GRID_Y * GRID_Z
+		float m_sliceDepths[GRID_Z + 1];
+
+		ClusterView m_view;
+		bool m_boundsValid;
+
+		std::vector<LightCluster> m_clusters;
+		std::vector<UINT> m_lightIndices;
+	};
+}
@@ -0,0 +1,253 @@
+#pragma once
+#include "pch.h"
+#include "Graphics/CommandBuffer.h"
+
+#include <climits>
+
+namespace Graphics
+{
+	// One version of a virtual resource, every write makes a new one
+	struct RenderResource
+	{
+		UINT Node = UINT_MAX;
+
+		inline bool IsValid() const { return Node != UINT_MAX; }
+	};
+
+	enum class RenderResourceType
+	{
+		Texture,
+		DepthTexture,
+		Buffer
+	};
+
+	struct RenderResourceDesc
+	{
+		RenderResourceType Type = RenderResourceType::Texture;
+		UINT Width = 0;		// Element count of buffers
+		UINT Height = 1;
+		DXGI_FORMAT Format = DXGI_FORMAT_UNKNOWN;
+		UINT Stride = 0;	// Bytes per texel or element
+
+		size_t GetSize() const;
+		bool operator==(const RenderResourceDesc& other) const;
+
+		static RenderResourceDesc Texture(UINT width, UINT height, DXGI_FORMAT format, UINT texelStride);
+		static RenderResourceDesc Depth(UINT width, UINT height);
+		static RenderResourceDesc Buffer(UINT elementCount, UINT elementStride);
+	};
+
+	// How a pass uses a resource, a change between passes is a barrier
+	enum class RenderResourceUsage
+	{
+		ShaderResource,
+		RenderTarget,
+		DepthStencil,
+		UnorderedAccess
+	};
+
+	struct RenderGraphStatistics
+	{
+		UINT Passes = 0;
+		UINT CulledPasses = 0;
+		UINT TransientResources = 0;
+		UINT PhysicalResources = 0;
+		UINT Barriers = 0;
+		size_t TransientBytes = 0;	// Every transient resource on its own
+		size_t AliasedBytes = 0;	// Physical resources after aliasing
+		size_t PeakLiveBytes = 0;	// Most transient bytes in use during one pass
+	};
+
+	class RenderGraph;
+
+	// Handed to the setup function of a pass to declare what it uses
+	class RenderGraphBuilder
+	{
+	public:
+
+		// Transient, lives from the first to the last pass using it and may share
+		// memory with others. Its contents are undefined until written.
+		RenderResource Create(const char* name, const RenderResourceDesc& desc);
+
+		RenderResource Read(RenderResource resource, RenderResourceUsage usage = RenderResourceUsage::ShaderResource);
+
+		// Returns the new version, later passes read that one
+		RenderResource Write(RenderResource resource, RenderResourceUsage usage = RenderResourceUsage::RenderTarget);
+
+		// Kept even if nothing reads what it writes
+		void SetSideEffect();
+
+	private:
+
+		RenderGraphBuilder(RenderGraph& graph, UINT pass) : m_graph(graph), m_pass(pass) {}
+		friend class RenderGraph;
+
+		RenderGraph& m_graph;
+		UINT m_pass;
+	};
+
+	// Handed to the execute function of a pass
+	class RenderPassResources
+	{
+	public:
+
+		// ResourceManager ID of the texture, depth texture or buffer array
+		ID Get(RenderResource resource) const;
+
+	private:
+
+		RenderPassResources(const RenderGraph& graph) : m_graph(graph) {}
+		friend class RenderGraph;
+
+		const RenderGraph& m_graph;
+	};
+
+	// Frame graph: every frame passes are added with the resources they read
+	// and write, then the graph is compiled and executed.
+	//
+	// Compiling culls the passes nothing depends on, finds the first and last
+	// pass using each transient resource and lets resources that are never
+	// alive at the same time share one physical resource. D3D11 cannot place
+	// resources in shared memory, so only resources with the same description
+	// are aliased. The usage changes between passes are recorded as barriers,
+	// executing them unbinds what D3D11 would otherwise keep bound as an
+	// output while it is read, or the other way around.
+	//
+	// Compiling needs no device, physical resources are created when executed
+	// and kept between frames.
+	class RenderGraph
+	{
+	public:
+
+		using SetupFunction = std::function<void(RenderGraphBuilder&)>;
+		using ExecuteFunction = std::function<void(CommandBuffer&, const RenderPassResources&)>;
+
+		RenderGraph();
+		~RenderGraph();
+
+		// Owned elsewhere, like the back buffer. Never aliased, passes writing them are kept.
+		RenderResource Import(const char* name, ID resourceID, const RenderResourceDesc& desc);
+
+		// Setup runs right away, execute when the graph is executed
+		void AddPass(const char* name, const SetupFunction& setup, ExecuteFunction execute);
+
+		// Setup fills in the pass data, usually the handles it declared, which
+		// execute gets back. The data lives until Reset, later passes read the
+		// handles from the returned reference.
+		template<typename PassData>
+		const PassData& AddPass(const char* name,
+			const std::function<void(RenderGraphBuilder&, PassData&)>& setup,
+			std::function<void(const PassData&, CommandBuffer&, const RenderPassResources&)> execute)
+		{
+			auto data = std::make_shared<PassData>();
+			AddPass(name,
+				[&setup, &data](RenderGraphBuilder& builder) { setup(builder, *data); },
+				[data, execute = std::move(execute)](CommandBuffer& commandBuffer, const RenderPassResources& resources) { execute(*data, commandBuffer, resources); });
+			return *data;
+		}
+
+		void Compile(bool aliasing = true);
+		void Execute(CommandBuffer& commandBuffer);
+
+		// Forgets the passes and virtual resources, physical resources are kept
+		void Reset();
+
+		inline const RenderGraphStatistics& GetStatistics() const { return m_statistics; }
+
+		// False if two resources sharing a physical resource are alive during the same pass
+		bool ValidateAliasing() const;
+
+	private:
+
+		// No copy allowed
+		RenderGraph(const RenderGraph& other) = delete;
+		RenderGraph(const RenderGraph&& other) = delete;
+		RenderGraph& operator=(const RenderGraph& other) = delete;
+		RenderGraph& operator=(const RenderGraph&& other) = delete;
+
+		friend class RenderGraphBuilder;
+		friend class RenderPassResources;
+
+	private:
+
+		struct VirtualResource
+		{
+			const char* Name;
+			RenderResourceDesc Desc;
+			ID ImportedID = 0;
+			UINT FirstPass = UINT_MAX;
+			UINT LastPass = 0;
+			UINT Physical = UINT_MAX;	// Index into m_physical, transient only
+		};
+
+		struct Node
+		{
+			UINT Resource;
+			UINT Producer = UINT_MAX;	// Pass writing this version
+			UINT Readers = 0;
+		};
+
+		struct Access
+		{
+			UINT Node;
+			RenderResourceUsage Usage;
+		};
+
+		struct Barrier
+		{
+			UINT Resource;
+			RenderResourceUsage Before;
+			RenderResourceUsage After;
+		};
+
+		struct Pass
+		{
+			const char* Name;
+			ExecuteFunction Execute;
+			std::vector<Access> Reads;
+			std::vector<Access> Writes;
+			std::vector<Barrier> Barriers;	// Before the pass runs
+			bool SideEffect = false;
+			bool Culled = false;
+			UINT References = 0;
+		};
+
+		// Backing for the transient resources of one frame
+		struct PhysicalResource
+		{
+			RenderResourceDesc Desc;
+			UINT LastPass = 0;
+			UINT Pooled = UINT_MAX;		// Index into m_pool once executed
+		};
+
+		struct PooledResource
+		{
+			RenderResourceDesc Desc;
+			ID ResourceID = 0;
+			bool InUse = false;
+		};
+
+		void Cull();
+		void ComputeLifetimes();
+		void AssignPhysicalResources(bool aliasing);
+		void RecordBarriers();
+		void ResolveBarriers(CommandBuffer& commandBuffer, const Pass& pass);
+		ID CreatePhysicalResource(const RenderResourceDesc& desc);
+
+	private:
+
+		std::vector<Pass> m_passes;
+		std::vector<VirtualResource> m_resources;
+		std::vector<Node> m_nodes;
+		std::vector<PhysicalResource> m_physical;
+		std::vector<PooledResource> m_pool; // Kept between frames
+		RenderGraphStatistics m_statistics;
+		bool m_compiled;
+
+		// Working memory of Compile
+		std::vector<UINT> m_stack;
+		std::vector<UINT> m_order;
+		std::vector<RenderResourceUsage> m_states;
+		std::vector<UINT> m_stateOwners;
+	};
+}
@@ -1,24 +1,37 @@
 #pragma once
 #include "pch.h"
 #include "Graphics/CommandBuffer.h"
+#include "Graphics/DepthSort.h"
+#include "Graphics/InstanceBuckets.h"
+#include "Graphics/LightClusters.h"
+#include "Graphics/RenderGraph.h"
+#include "Graphics/ShadowCascades.h"
 #include "Resource/Resource.h"
+#include "Resource/TransformBatch.h"
 
 /**
- *	1. GBufferPass		Opaque geometry
+ *	0. DepthPrepass		Optional, positions only, later passes test depth equal
+ *	1. GBufferPass		Opaque geometry, RenderPath::Deferred only
  *		- Color			RGBA
  *		- Normal		RGB
  *		- Emissive		RGBA, A = intensity
  *		- Roughness		R
  *		- DepthStencil	DS
  *	2. ReflectionPass
- *	3. ShadowPass
- *	4. LightPass
+ *	3. ShadowPass		Depth only, one 2048x2048 map per sun cascade
+ *	4. LightPass		Compute, lights culled per 16x16 screen tile
  *	5. SkyboxPass
  *	6. PostProcessPass
  */
 
 namespace Graphics
 {
+	enum class RenderPath
+	{
+		Forward,	// Clustered lights, shaded while drawing
+		Deferred	// G-buffer, then a tiled compute light pass
+	};
+
 	class Renderer
 	{
 	public:
@@ -40,12 +53,83 @@ namespace Graphics
 			s_instance->SubmitInternal(meshID, transform);
 		}
 
+		// World matrix already transposed, as cached in the WorldMatrixComponent
+		static inline void Submit(ID meshID, const DirectX::XMFLOAT4X4& worldTransposed)
+		{
+			if (!s_instance) { Initialize(); }
+			s_instance->SubmitInternal(meshID, worldTransposed);
+		}
+
+		// Many instances at once, bucketed per mesh in parallel when the span is large
+		static inline void Submit(const InstanceSubmission* submissions, size_t count)
+		{
+			if (!s_instance) { Initialize(); }
+			s_instance->m_instances.Add(submissions, count);
+		}
+
+		// One instance per transform in [begin, end), composed 4 or 8 at a time
+		static inline void Submit(ID meshID, const Resource::TransformBatch& transforms, size_t begin, size_t end)
+		{
+			if (!s_instance) { Initialize(); }
+			s_instance->SubmitInternal(meshID, transforms, begin, end);
+		}
+
+		// World space point lights of this frame, binned into clusters at EndFrame
+		static inline void SubmitLights(const Resource::PointLight* lights, size_t count)
+		{
+			if (!s_instance) { Initialize(); }
+			s_instance->m_lights.insert(s_instance->m_lights.end(), lights, lights + count);
+		}
+
+		// Only one per frame, the last one submitted is used
+		static inline void SubmitDirectionalLight(const Resource::DirectionalLight& light)
+		{
+			if (!s_instance) { Initialize(); }
+			s_instance->m_sun = light;
+			s_instance->m_hasSun = true;
+		}
+
 		static inline void EndFrame()
 		{
 			if (!s_instance) { Initialize(); }
 			s_instance->EndFrameInternal();
 		}
 
+		// Takes effect from the next frame
+		static inline void SetRenderPath(RenderPath path)
+		{
+			if (!s_instance) { Initialize(); }
+			s_instance->m_renderPath = path;
+		}
+
+		static inline RenderPath GetRenderPath()
+		{
+			if (!s_instance) { Initialize(); }
+			return s_instance->m_renderPath;
+		}
+
+		// Depth of the opaque geometry first, so the expensive pixel shaders
+		// only run once per pixel. Takes effect from the next frame.
+		static inline void SetDepthPrepass(bool enabled)
+		{
+			if (!s_instance) { Initialize(); }
+			s_instance->m_depthPrepass = enabled;
+		}
+
+		static inline bool GetDepthPrepass()
+		{
+			if (!s_instance) { Initialize(); }
+			return s_instance->m_depthPrepass;
+		}
+
+		// Emulated times the scope calls on the CPU, as on devices without
+		// timestamp queries. Only between frames.
+		static inline void SetGpuTimerMode(GpuTimerMode mode)
+		{
+			if (!s_instance) { Initialize(); }
+			s_instance->m_commandBuffer.SetTimerMode(mode);
+		}
+
 	private:
 
 		static std::unique_ptr<Renderer> s_instance;
@@ -65,30 +149,152 @@ namespace Graphics
 	private:
 
 		ID m_objectBuffer;
-		ID m_materialBuffer;
 		ID m_cameraBuffer;
-		ID m_defaultShader;
 
 		Graphics::CommandBuffer m_commandBuffer;
 
-	private:
+		// What the shaders read, by the names they declare. Bound along with
+		// every program, each one only gets what its reflection lists.
+		ResourceSet m_frameResources;
+		ResourceSet m_materialResources; // Maps bound on their own
 
-		// Temp stuff...
-		ID m_lightBuffer;
-		Resource::PointLight m_pointLight;
+		// Camera of the current frame, used to estimate the texture resolution needed
+		DirectX::XMFLOAT3 m_cameraPosition;
+		float m_cameraNearPlane;
+		float m_worldPerPixel; // Screen pixel footprint at a distance of one unit
 
 	private:
 
 		void BeginFrameInternal(const Resource::Camera& camera, const Resource::Transform& cameraTransform);
 		void SubmitInternal(ID meshID, const Resource::Transform& transform);
+		void SubmitInternal(ID meshID, const DirectX::XMFLOAT4X4& worldTransposed);
+		void SubmitInternal(ID meshID, const Resource::TransformBatch& transforms, size_t begin, size_t end);
 		void EndFrameInternal();
 
-	private:
+		struct DrawStatistics
+		{
+			int DrawCalls = 0;
+			int Instances = 0;
+			int Triangles = 0;
+			int ShadowDrawCalls = 0;
+			int ShadowInstances = 0;
+			int PrepassDrawCalls = 0;
+			int ShaderPermutations = 0;
+		};
+
+		// A mesh bucket's instances in m_sortedInstances
+		struct OpaqueBucket
+		{
+			UINT Bucket;
+			UINT InstanceOffset;
+			UINT InstanceCount;
+			UINT Features = 0; // Of every submesh together
+		};
+
+		// Indices of a mesh drawn with one shader permutation
+		struct OpaqueDraw
+		{
+			UINT Permutation;	// Resource::MATERIAL_FEATURE bits
+			UINT Bucket;		// Index into m_opaqueBuckets
+			UINT IndexOffset;
+			UINT IndexCount;
+			ID Material;		// Set when the material has maps of its own to bind
+		};
+
+		// A material shader compiled once per set of material features, only
+		// the permutations used by a loaded material are compiled
+		struct ShaderPermutations
+		{
+			const char* FilePath;
+			ID Programs[Resource::MATERIAL_PERMUTATION_COUNT] = {};
+			UINT Compiled = 0; // Bit per permutation
+		};
+
+		void CompilePermutations(ShaderPermutations& shaders);
+		void SortOpaque();
+		void AddOpaqueDraws(UINT opaqueBucket, const Resource::Mesh& mesh);
+		void DrawOpaque(const ShaderPermutations& shaders, bool depthEqual, DrawStatistics& statistics);
+		void DrawDepth(DrawStatistics& statistics);
+		void RequestTextureResolution(const Resource::Mesh& mesh, const std::vector<Resource::ObjectBufferData>& instances);
+		UINT UploadLights();
+		void BinLights();
+		void UpdateShadows();
+		void DrawShadowCasters(UINT cascade, DrawStatistics& statistics);
+
+		using ShadowMaps = RenderResource[ShadowCascades::CASCADE_COUNT];
 
-		// <meshID, instanceData>
+		// Leaves the shadow maps invalid without a sun
+		void AddShadowPass(ShadowMaps& shadowMaps, DrawStatistics& statistics);
+
+		// Returns the depth after the prepass, or depth as it was when disabled
+		RenderResource AddDepthPrepass(RenderResource depth, DrawStatistics& statistics);
+		void AddForwardPasses(RenderResource color, RenderResource depth, const ShadowMaps& shadowMaps, DrawStatistics& statistics);
+		void AddDeferredPasses(RenderResource color, RenderResource depth, const ShadowMaps& shadowMaps, DrawStatistics& statistics);
+
+	private:
 
 		ID m_instanceBufferID;
-		
-		std::map<ID, std::vector<Resource::ObjectBufferData>> m_instanceBufferData;
+
+		// Copy of the ResourceManager material table, grows as materials are added
+		ID m_materialTableBufferID;
+		size_t m_materialTableSize;
+
+		InstanceBuckets m_instances;
+
+		// Point lights, binned into view space clusters every frame
+		std::vector<Resource::PointLight> m_lights;
+		LightClusters m_lightClusters;
+		ClusterView m_clusterView;
+		D3D11_VIEWPORT m_viewPort;
+		ID m_lightBufferID;
+		ID m_lightClusterBufferID;
+		ID m_lightIndexBufferID;
+		ID m_clusterConstantBufferID;
+
+		RenderPath m_renderPath;
+
+		// Opaque draws front to back: buckets by their nearest instance and
+		// the instances of each bucket, sorted once a frame
+		bool m_depthPrepass;
+		ID m_depthPrepassShader;
+		ID m_depthEqualState;
+		DepthSort m_depthSort;
+		std::vector<OpaqueBucket> m_opaqueBuckets;
+		std::vector<OpaqueBucket> m_unsortedBuckets;
+		std::vector<Resource::ObjectBufferData> m_sortedInstances;
+		std::vector<float> m_sortDepths;
+		std::vector<UINT> m_sortOrder;
+
+		// Opaque draws grouped by permutation, front to back within each
+		std::vector<OpaqueDraw> m_opaqueDraws;
+		ShaderPermutations m_forwardShaders;
+		ShaderPermutations m_gBufferShaders;
+		UINT m_materialPermutations; // Bit per permutation used by a loaded material
+		size_t m_permutationMaterialCount;
+
+		// Targets of the current frame
+		ID m_colorTextureID;
+		ID m_depthTextureID;
+		DirectX::XMFLOAT4X4 m_projection; // Not transposed
+
+		// Passes of the frame, declared again every frame
+		RenderGraph m_renderGraph;
+
+		ID m_tiledLightingShader;
+		ID m_tiledLightingBufferID;
+
+		// Sun of the current frame and its shadow cascades
+		Resource::DirectionalLight m_sun;
+		bool m_hasSun;
+		ShadowCascades m_shadowCascades;
+		ID m_shadowShader;
+		ID m_shadowBufferID;
+		ID m_shadowCasterBufferID;
+
+		// Bounding sphere of every instance, the instances of bucket i start at m_shadowBucketOffsets[i]
+		std::vector<ShadowCaster> m_shadowCasters;
+		std::vector<UINT> m_shadowBucketOffsets;
+		std::vector<UINT> m_visibleShadowCasters[ShadowCascades::CASCADE_COUNT];
+		std::vector<Resource::ObjectBufferData> m_shadowInstances;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,87 @@
+#pragma once
+#include "pch.h"
+#include "Graphics/LightClusters.h"
+#include "Resource/ShaderBuffers.h"
+
+namespace Graphics
+{
+	// World space bounding sphere of something that casts a shadow
+	struct ShadowCaster
+	{
+		DirectX::XMFLOAT3 Center;
+		float Radius;
+	};
+
+	// Cascaded shadow maps for a directional light. The camera frustum up to
+	// the shadow distance is split into CASCADE_COUNT slices, each covered by
+	// an orthographic light projection fitted to the slice's bounding sphere.
+	//
+	// The sphere only depends on the slice, not on the camera orientation, and
+	// its center is snapped to whole shadow map texels in light space, so the
+	// shadow edges stay still while the camera turns and moves.
+	//
+	// Casters are culled against every cascade's light space box, extended
+	// towards the light so casters outside the view still shadow it.
+	class ShadowCascades
+	{
+	public:
+
+		static constexpr UINT CASCADE_COUNT = 4;
+		static constexpr UINT RESOLUTION = 2048;
+
+		struct Cascade
+		{
+			DirectX::XMFLOAT4X4 ViewProjection;	// Not transposed
+			DirectX::XMFLOAT3 Center;			// Light space, snapped to texels
+			float Radius;
+			float NearDepth;					// Camera view depth covered
+			float FarDepth;
+			float LightNear;					// Light space depth range
+			float LightFar;
+			float TexelSize;					// World units per shadow map texel
+		};
+
+		ShadowCascades();
+		~ShadowCascades();
+
+		// 0 splits the distance evenly, 1 logarithmically
+		inline void SetSplitLambda(float lambda) { m_splitLambda = lambda; }
+
+		// direction is the way the light travels. casterDistance is how far
+		// towards the light casters outside a slice are still drawn.
+		void Update(const ClusterView& camera, const DirectX::XMFLOAT3& direction, float shadowDistance, float casterDistance);
+
+		inline const Cascade& GetCascade(UINT cascade) const { return m_cascades[cascade]; }
+
+		// Rotation from world to light space, shared by every cascade
+		inline const DirectX::XMFLOAT4X4& GetLightView() const { return m_lightView; }
+
+		// Indices of the casters to draw into each cascade, four casters are
+		// tested against every cascade at a time
+		void Cull(const ShadowCaster* casters, size_t casterCount, std::vector<UINT> (&visible)[CASCADE_COUNT]) const;
+
+		// One caster against one cascade, as Cull does it
+		bool IsVisible(UINT cascade, const ShadowCaster& caster) const;
+
+		// View space corners of a cascade's slice of the camera frustum, for tests
+		void GetSliceCorners(UINT cascade, DirectX::XMFLOAT3 (&corners)[8]) const;
+
+		Resource::ShadowBufferData GetBufferData(const DirectX::XMFLOAT3& color) const;
+
+	private:
+
+		// No copy allowed
+		ShadowCascades(const ShadowCascades& other) = delete;
+		ShadowCascades(const ShadowCascades&& other) = delete;
+		ShadowCascades& operator=(const ShadowCascades& other) = delete;
+		ShadowCascades& operator=(const ShadowCascades&& other) = delete;
+
+	private:
+
+		Cascade m_cascades[CASCADE_COUNT];
+		DirectX::XMFLOAT4X4 m_lightView;
+		DirectX::XMFLOAT3 m_direction;
+		ClusterView m_camera;
+		float m_splitLambda;
+	};
+}
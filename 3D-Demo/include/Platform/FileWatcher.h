@@ -0,0 +1,54 @@
+#pragma once
+#include "pch.h"
+
+namespace Platform
+{
+	// Notices changes to a set of files on a background thread. The folders
+	// holding them are watched with change notifications, then the files in
+	// a folder that changed are compared by last write time, so editors that
+	// save through a temporary file and a rename are caught as well.
+	class FileWatcher
+	{
+	public:
+
+		FileWatcher();
+		~FileWatcher();
+
+		// Thread safe, watching a file twice does nothing
+		void Watch(const std::string& filePath);
+
+		// Files changed since the last call, each one once
+		std::vector<std::string> GetChangedFiles();
+
+	private:
+
+		// No copy allowed
+		FileWatcher(const FileWatcher& other) = delete;
+		FileWatcher(const FileWatcher&& other) = delete;
+		FileWatcher& operator=(const FileWatcher& other) = delete;
+		FileWatcher& operator=(const FileWatcher&& other) = delete;
+
+	private:
+
+		struct WatchedFile
+		{
+			std::string Path;
+			std::string Directory;
+			std::filesystem::file_time_type WriteTime;
+		};
+
+		void WatchThreadMain();
+		void CheckDirectory(const std::string& directory);
+
+	private:
+
+		std::vector<WatchedFile> m_files;
+		std::vector<std::string> m_directories;
+		std::vector<std::string> m_changed;
+		bool m_directoriesChanged;
+
+		std::thread m_thread;
+		std::mutex m_mutex;
+		bool m_running;
+	};
+}
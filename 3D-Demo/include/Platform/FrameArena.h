@@ -0,0 +1,134 @@
+#pragma once
+#include "pch.h"
+
+namespace Platform
+{
+	struct FrameArenaStatistics
+	{
+		size_t FrameBytes = 0;		// Allocated during the last frame
+		size_t PeakFrameBytes = 0;	// Largest frame since start
+		size_t ReservedBytes = 0;	// Held in blocks by all frames
+		size_t BlockAllocations = 0;	// Blocks taken from the heap during the last frame
+		size_t HeapAllocations = 0;	// Every operator new during the last frame
+	};
+
+	// Singleton
+	//
+	// Bump allocator for data that lives for one frame. Each of the
+	// FRAME_COUNT frames owns a set of blocks, allocating moves a pointer
+	// forward and nothing is freed on its own. NextFrame rewinds the oldest
+	// frame, so memory allocated in a frame stays valid while the next
+	// FRAME_COUNT - 1 frames are built. Every thread allocates from its own
+	// sub-arena, without locks. Blocks are kept, after a few frames nothing
+	// reaches the heap anymore.
+	class FrameArena
+	{
+	public:
+
+		static constexpr UINT FRAME_COUNT = 3;
+
+		static void Initialize();
+		static void Finalize();
+
+		static inline void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t))
+		{
+			if (!s_instance) { Initialize(); }
+			return s_instance->AllocateInternal(size, alignment);
+		}
+
+		template<typename T>
+		static inline T* Allocate(size_t count)
+		{
+			return (T*)Allocate(count * sizeof(T), alignof(T));
+		}
+
+		// Ends the frame and rewinds the oldest one. Nothing may allocate from
+		// the arena while this runs.
+		static inline void NextFrame()
+		{
+			if (!s_instance) { Initialize(); }
+			s_instance->NextFrameInternal();
+		}
+
+		static inline FrameArenaStatistics GetStatistics()
+		{
+			if (!s_instance) { Initialize(); }
+			return s_instance->m_statistics;
+		}
+
+	private:
+
+		static std::unique_ptr<FrameArena> s_instance;
+
+		FrameArena();
+		~FrameArena();
+
+		// No copy allowed
+		FrameArena(const FrameArena& other) = delete;
+		FrameArena(const FrameArena&& other) = delete;
+		FrameArena& operator=(const FrameArena& other) = delete;
+		FrameArena& operator=(const FrameArena&& other) = delete;
+
+		friend std::unique_ptr<FrameArena>::deleter_type;
+		friend std::unique_ptr<FrameArena> std::make_unique<FrameArena>();
+
+	private:
+
+		// Threads beyond this share one sub-arena behind a mutex
+		static constexpr UINT MAX_THREADS = 64;
+
+		struct Block
+		{
+			std::unique_ptr<unsigned char[]> Memory;
+			size_t Size = 0;
+		};
+
+		struct SubArena
+		{
+			std::vector<Block> Blocks;
+			size_t BlockIndex = 0;	// Block allocated from
+			size_t Offset = 0;		// In that block
+			size_t Used = 0;
+		};
+
+		// [frame][thread], the last sub-arena of a frame is the shared one
+		std::vector<SubArena> m_subArenas[FRAME_COUNT];
+		std::atomic<UINT> m_frame;
+		std::atomic<UINT> m_threadCount;
+		std::mutex m_sharedMutex;
+
+		std::atomic<size_t> m_blockAllocations;
+		size_t m_frameStartHeapAllocations;
+		FrameArenaStatistics m_statistics;
+
+	private:
+
+		void* AllocateInternal(size_t size, size_t alignment);
+		void* AllocateFrom(SubArena& subArena, size_t size, size_t alignment);
+		void NextFrameInternal();
+	};
+
+	// STL allocator taking its memory from the FrameArena, deallocation does
+	// nothing. Containers using it must not outlive the frame.
+	template<typename T>
+	struct FrameAllocator
+	{
+		using value_type = T;
+
+		FrameAllocator() = default;
+
+		template<typename U>
+		FrameAllocator(const FrameAllocator<U>& other) {}
+
+		inline T* allocate(size_t count) { return FrameArena::Allocate<T>(count); }
+		inline void deallocate(T* pointer, size_t count) {}
+
+		template<typename U>
+		inline bool operator==(const FrameAllocator<U>& other) const { return true; }
+		template<typename U>
+		inline bool operator!=(const FrameAllocator<U>& other) const { return false; }
+	};
+
+	template<typename T>
+	using FrameVector = std::vector<T, FrameAllocator<T>>;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "pch.h"
+
+namespace Platform
+{
+	struct GameLoopSettings
+	{
+		double FixedDelta = 1.0 / 60.0;	// Seconds simulated per update
+		UINT MaxUpdatesPerFrame = 5;	// Beyond this the simulation falls behind instead of spiralling
+		double TargetFrameTime = 0.0;	// Seconds, 0 renders as fast as possible
+		UINT HeadlessFrames = 0;		// Runs this many frames, one update each, without waiting
+	};
+
+	struct GameLoopStatistics
+	{
+		UINT64 Frames = 0;
+		UINT64 Updates = 0;
+		double Seconds = 0.0;
+		double MinFrameTime = 0.0;
+		double MaxFrameTime = 0.0;
+	};
+
+	// Simulation runs in fixed steps of FixedDelta, as many per frame as the
+	// elapsed time asks for. Rendering happens once per frame and gets how far
+	// the time is between the last two simulated states, to interpolate them.
+	// With a target frame time the loop sleeps on a high resolution timer and
+	// yields for the last stretch, instead of spinning.
+	class GameLoop
+	{
+	public:
+
+		using UpdateFunction = std::function<void(float delta)>;
+		// alpha goes from 0 for the previous to 1 for the current state. It is below 1
+		// when running in real time, headless frames always draw the current state.
+		using RenderFunction = std::function<void(float alpha)>;
+		using RunningFunction = std::function<bool()>;
+
+		GameLoop(const GameLoopSettings& settings);
+		~GameLoop();
+
+		// Returns when running returns false or the headless frames are done
+		void Run(const UpdateFunction& update, const RenderFunction& render, const RunningFunction& running);
+
+		inline const GameLoopStatistics& GetStatistics() const { return m_statistics; }
+
+	private:
+
+		// No copy allowed
+		GameLoop(const GameLoop& other) = delete;
+		GameLoop(const GameLoop&& other) = delete;
+		GameLoop& operator=(const GameLoop& other) = delete;
+		GameLoop& operator=(const GameLoop&& other) = delete;
+
+	private:
+
+		using Clock = std::chrono::steady_clock;
+
+		void WaitUntil(Clock::time_point time);
+
+	private:
+
+		GameLoopSettings m_settings;
+		GameLoopStatistics m_statistics;
+		HANDLE m_timer;
+	};
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include "pch.h"
+
+namespace Platform
+{
+	// Counts calls to the global operator new, which HeapCounter.cpp replaces.
+	// Allocations made with malloc or by the driver are not seen.
+	class HeapCounter
+	{
+	public:
+
+		// Since start, from every thread
+		static size_t GetAllocationCount();
+	};
+}
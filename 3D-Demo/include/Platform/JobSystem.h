@@ -0,0 +1,144 @@
+#pragma once
+#include "pch.h"
+#include "Platform/FrameArena.h"
+
+namespace Platform
+{
+	// Number of unfinished jobs started with it. Jobs can be held back until a
+	// counter reaches zero, which makes it a fence between groups of jobs. A
+	// counter must outlive its jobs and be waited on before it is reused.
+	class JobCounter
+	{
+	public:
+
+		JobCounter() : m_pending(0) {}
+
+		inline bool IsDone() const { return m_pending.load() == 0; }
+
+	private:
+
+		// No copy allowed
+		JobCounter(const JobCounter& other) = delete;
+		JobCounter(const JobCounter&& other) = delete;
+		JobCounter& operator=(const JobCounter& other) = delete;
+		JobCounter& operator=(const JobCounter&& other) = delete;
+
+		friend class JobSystem;
+
+	private:
+
+		struct Job
+		{
+			std::function<void()> Function;
+			JobCounter* Counter = nullptr;
+		};
+
+		std::atomic<size_t> m_pending;
+		std::mutex m_mutex;
+		std::vector<Job> m_continuations; // Started when m_pending reaches zero
+	};
+
+	// Singleton
+	//
+	// A fixed pool of workers, each with its own deque of jobs. A worker runs
+	// the newest job of its own deque first and steals the oldest job of another
+	// deque when it runs dry, so jobs spawned by a job stay on the same core
+	// while idle workers take the big, early pieces of work. Threads outside
+	// the pool share one extra deque. A thread waiting on a counter runs jobs
+	// until it is done instead of blocking, so jobs can wait on other jobs.
+	class JobSystem
+	{
+	public:
+
+		// 0 workers picks one per hardware thread, leaving one for the main thread
+		static void Initialize(UINT workerCount = 0);
+		static void Finalize();
+
+		static UINT WorkerCount();
+
+		// Starts job, counted by counter if given, once dependency (if given) is done
+		static void Run(std::function<void()> job, JobCounter* counter = nullptr, JobCounter* dependency = nullptr);
+
+		// Runs other jobs until counter is done
+		static void Wait(JobCounter& counter);
+
+		// Runs task(index) for every index in [0, count) and returns when all
+		// indices are done. The calling thread takes part in the work.
+		static void ParallelFor(size_t count, const std::function<void(size_t)>& task);
+
+		// Runs task(begin, end) over [0, count) in ranges of at most grainSize
+		static void ParallelForRange(size_t count, size_t grainSize, const std::function<void(size_t, size_t)>& task);
+
+		// Runs task(index, entity) for every entity of an entt view, grainSize
+		// entities per job. index is the entity's position in the view, results
+		// can be written there without locking. Components other than the ones
+		// task writes must only be read. Returns the number of entities.
+		template<typename View, typename Task>
+		static size_t ParallelForEach(const View& view, size_t grainSize, const Task& task)
+		{
+			FrameVector<entt::entity> entities;
+			entities.reserve(GetViewSize(view, 0));
+			for (entt::entity entity : view)
+			{
+				entities.push_back(entity);
+			}
+
+			ParallelForRange(entities.size(), grainSize, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; i++)
+				{
+					task(i, entities[i]);
+				}
+			});
+
+			return entities.size();
+		}
+
+	private:
+
+		static std::unique_ptr<JobSystem> s_instance;
+
+		JobSystem(UINT workerCount);
+		~JobSystem();
+
+		// No copy allowed
+		JobSystem(const JobSystem& other) = delete;
+		JobSystem(const JobSystem&& other) = delete;
+		JobSystem& operator=(const JobSystem& other) = delete;
+		JobSystem& operator=(const JobSystem&& other) = delete;
+
+		friend std::unique_ptr<JobSystem>::deleter_type;
+
+		// Single component views know their size, multi component views a bound
+		template<typename View>
+		static auto GetViewSize(const View& view, int) -> decltype(view.size()) { return view.size(); }
+		template<typename View>
+		static size_t GetViewSize(const View& view, long) { return view.size_hint(); }
+
+	private:
+
+		using Job = JobCounter::Job;
+
+		struct WorkerQueue
+		{
+			std::mutex Mutex;
+			std::deque<Job> Jobs;
+		};
+
+		void Push(Job&& job);
+		bool TryRunJob();
+		void Finish(JobCounter* counter);
+
+		void WorkerMain(size_t queueIndex);
+
+	private:
+
+		std::vector<std::thread> m_workers;
+		std::vector<std::unique_ptr<WorkerQueue>> m_queues; // One per worker, the last one is shared by other threads
+		std::atomic<size_t> m_queuedJobs;
+
+		std::mutex m_sleepMutex;
+		std::condition_variable m_wakeCondition;
+		std::atomic<size_t> m_sleepingWorkers;
+		std::atomic<bool> m_running;
+	};
+}
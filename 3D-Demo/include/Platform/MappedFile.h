@@ -0,0 +1,35 @@
+#pragma once
+#include "pch.h"
+
+namespace Platform
+{
+	// Read only view of a whole file mapped into memory, unmapped on destruction
+	class MappedFile
+	{
+	public:
+
+		MappedFile() = default;
+		~MappedFile();
+
+		MappedFile(MappedFile&& other) noexcept;
+		MappedFile& operator=(MappedFile&& other) noexcept;
+
+		// No copy allowed
+		MappedFile(const MappedFile& other) = delete;
+		MappedFile& operator=(const MappedFile& other) = delete;
+
+		bool Open(const std::string& filePath);
+		void Close();
+
+		const unsigned char* Data() const { return m_data; }
+		size_t Size() const { return m_size; }
+		bool IsOpen() const { return m_data != nullptr; }
+
+	private:
+
+		HANDLE m_file = INVALID_HANDLE_VALUE;
+		HANDLE m_mapping = NULL;
+		const unsigned char* m_data = nullptr;
+		size_t m_size = 0;
+	};
+}
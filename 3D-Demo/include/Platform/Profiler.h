@@ -0,0 +1,209 @@
+#pragma once
+#include "pch.h"
+
+// Times the rest of the enclosing scope, name must be a string literal
+#define PROFILE_SCOPE(name) Platform::ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_CONCAT_INNER(a, b) a##b
+
+namespace Platform
+{
+	struct ZoneSummary
+	{
+		std::string Name;
+		double Min = 0.0;		// Milliseconds per frame, over the rolling window
+		double Average = 0.0;
+		double P99 = 0.0;
+		double CallsPerFrame = 0.0;
+		bool Gpu = false;		// Measured on the GPU, reported a few frames late
+	};
+
+	// Singleton
+	//
+	// Zones, counters and frame marks are written to a ring buffer of the
+	// thread that records them, without locks. FrameMark drains every ring on
+	// the calling thread, adds the zone times of the frame to a rolling window
+	// and, while capturing, keeps the events for a Chrome trace
+	// (chrome://tracing or ui.perfetto.dev). GPU zones arrive late from the
+	// GpuTimer and are shown on a track of their own.
+	class Profiler
+	{
+	public:
+
+		static void Initialize();
+		static void Finalize();
+
+		// Nanoseconds on the profiler clock
+		static inline UINT64 Now()
+		{
+			return (UINT64)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		static inline void RecordZone(const char* name, UINT64 start, UINT64 end)
+		{
+			if (!s_instance) { Initialize(); }
+			s_instance->RecordInternal(EventType::Zone, name, start, end, 0.0);
+		}
+
+		// Zone on the GPU track, times already converted to the profiler clock
+		static inline void RecordGpuZone(const char* name, UINT64 start, UINT64 end)
+		{
+			if (!s_instance) { Initialize(); }
+			s_instance->RecordInternal(EventType::GpuZone, name, start, end, 0.0);
+		}
+
+		static inline void SetCounter(const char* name, double value)
+		{
+			if (!s_instance) { Initialize(); }
+			s_instance->RecordInternal(EventType::Counter, name, Now(), 0, value);
+		}
+
+		// Ends the frame, call once per frame from one thread
+		static inline void FrameMark()
+		{
+			if (!s_instance) { Initialize(); }
+			s_instance->FrameMarkInternal();
+		}
+
+		// Keeps every event until EndCapture writes them as a Chrome trace
+		static inline void BeginCapture()
+		{
+			if (!s_instance) { Initialize(); }
+			s_instance->m_capturing = true;
+		}
+
+		static inline bool EndCapture(const std::string& filePath)
+		{
+			if (!s_instance) { Initialize(); }
+			return s_instance->EndCaptureInternal(filePath);
+		}
+
+		// Zones sorted by average time, slowest first
+		static inline std::vector<ZoneSummary> GetSummary()
+		{
+			if (!s_instance) { Initialize(); }
+			return s_instance->GetSummaryInternal();
+		}
+
+		static void PrintSummary(std::ostream& stream);
+
+		// Prints the summary every frameCount frames, 0 never does
+		static inline void SetReportInterval(UINT frameCount)
+		{
+			if (!s_instance) { Initialize(); }
+			s_instance->m_reportInterval = frameCount;
+		}
+
+	private:
+
+		static std::unique_ptr<Profiler> s_instance;
+
+		Profiler();
+		~Profiler();
+
+		// No copy allowed
+		Profiler(const Profiler& other) = delete;
+		Profiler(const Profiler&& other) = delete;
+		Profiler& operator=(const Profiler& other) = delete;
+		Profiler& operator=(const Profiler&& other) = delete;
+
+		friend std::unique_ptr<Profiler>::deleter_type;
+		friend std::unique_ptr<Profiler> std::make_unique<Profiler>();
+
+	private:
+
+		static constexpr size_t RING_SIZE = 16384; // Events per thread between two frame marks
+		static constexpr size_t WINDOW_SIZE = 240; // Frames in the rolling summary
+
+		enum class EventType
+		{
+			Zone,
+			GpuZone,
+			Counter,
+			Frame,
+		};
+
+		struct Event
+		{
+			EventType Type;
+			const char* Name;
+			UINT64 Start;
+			UINT64 End;
+			double Value;
+		};
+
+		struct CapturedEvent
+		{
+			Event Data;
+			UINT Thread;
+		};
+
+		// Written by its thread only, read by FrameMark
+		struct ThreadRing
+		{
+			UINT Thread = 0;
+			Event Events[RING_SIZE];
+			std::atomic<size_t> Write = 0;
+			std::atomic<size_t> Read = 0;
+			std::atomic<size_t> Dropped = 0;
+		};
+
+		struct ZoneStatistics
+		{
+			std::string Name;
+			bool Gpu = false;
+			double FrameTime = 0.0;	// Milliseconds in the current frame
+			UINT FrameCalls = 0;
+			double History[WINDOW_SIZE] = {};
+			UINT CallHistory[WINDOW_SIZE] = {};
+		};
+
+		ThreadRing& GetThreadRing();
+		void RecordInternal(EventType type, const char* name, UINT64 start, UINT64 end, double value);
+		void FrameMarkInternal();
+		void Drain(ThreadRing& ring);
+		ZoneStatistics& GetZone(const char* name, bool gpu);
+		std::vector<ZoneSummary> GetSummaryInternal();
+		bool EndCaptureInternal(const std::string& filePath);
+
+	private:
+
+		std::vector<std::unique_ptr<ThreadRing>> m_rings;
+		std::mutex m_ringsMutex;
+
+		// Zones are found by the address of their name first, by text if it is
+		// new. GPU zones are kept apart, they may share names with CPU zones.
+		std::unordered_map<const char*, size_t> m_zoneIndices[2];
+		std::unordered_map<std::string, size_t> m_zoneNames[2];
+		std::vector<ZoneStatistics> m_zones;
+		std::map<std::string, double> m_counters; // Last value
+		UINT64 m_frame;
+		UINT64 m_frameStart;
+		UINT m_reportInterval;
+
+		std::atomic<bool> m_capturing;
+		std::vector<CapturedEvent> m_captured;
+	};
+
+	// Records a zone from construction to destruction
+	class ProfileScope
+	{
+	public:
+
+		ProfileScope(const char* name) : m_name(name), m_start(Profiler::Now()) {}
+		~ProfileScope() { Profiler::RecordZone(m_name, m_start, Profiler::Now()); }
+
+	private:
+
+		// No copy allowed
+		ProfileScope(const ProfileScope& other) = delete;
+		ProfileScope(const ProfileScope&& other) = delete;
+		ProfileScope& operator=(const ProfileScope& other) = delete;
+		ProfileScope& operator=(const ProfileScope&& other) = delete;
+
+	private:
+
+		const char* m_name;
+		UINT64 m_start;
+	};
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "pch.h"
+
+namespace Resource
+{
+	enum class CompressionQuality
+	{
+		Fast,	// Bounding box endpoints, used at load time
+		High,	// Principal axis endpoints with least squares refinement, used offline
+	};
+
+	// Bytes per 4x4 block, 0 if the format is not block compressed
+	UINT GetBlockSize(DXGI_FORMAT format);
+
+	// Bytes per texel of an uncompressed format
+	UINT GetTexelSize(DXGI_FORMAT format);
+
+	// Byte size and row pitch of one mip level in the given format
+	size_t GetSurfaceSize(DXGI_FORMAT format, UINT width, UINT height, UINT* rowPitch = nullptr);
+
+	// Compresses an RGBA8 image to BC1, BC3, BC4 (red), BC5 (red and green) or
+	// BC7. Edge blocks of sizes not divisible by four repeat the last texel.
+	std::vector<unsigned char> CompressImage(const unsigned char* pixels, UINT width, UINT height, DXGI_FORMAT format, CompressionQuality quality);
+
+	// Expands compressed blocks back to RGBA8, used to measure the error
+	std::vector<unsigned char> DecompressImage(const unsigned char* blocks, UINT width, UINT height, DXGI_FORMAT format);
+
+	// Peak signal-to-noise ratio in dB over the first channelCount channels
+	double CalculatePSNR(const unsigned char* a, const unsigned char* b, UINT width, UINT height, UINT channelCount);
+}
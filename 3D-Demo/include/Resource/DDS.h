@@ -0,0 +1,23 @@
+#pragma once
+#include "pch.h"
+#include "Resource/Texture.h"
+
+namespace Resource
+{
+	// A texture with all of its mip levels in CPU memory
+	struct TextureData
+	{
+		DXGI_FORMAT Format = DXGI_FORMAT_UNKNOWN;
+		UINT Width = 0;
+		UINT Height = 0;
+		std::vector<std::vector<unsigned char>> Levels; // Tightly packed mips, largest first
+	};
+
+	// Writes a DDS file with a DX10 header so any DXGI format can be stored
+	bool WriteDDS(const std::string& filePath, const TextureData& texture);
+
+	// Describes the subresources of DDS file contents without copying them,
+	// the image points into data. Handles 2D textures, arrays and cube maps
+	// with either a DX10 header or one of the common legacy pixel formats.
+	bool ParseDDS(const unsigned char* data, size_t size, TextureImage& image);
+}
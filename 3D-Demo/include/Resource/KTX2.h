@@ -0,0 +1,11 @@
+#pragma once
+#include "pch.h"
+#include "Resource/Texture.h"
+
+namespace Resource
+{
+	// Describes the subresources of KTX2 file contents without copying them,
+	// the image points into data. Supports 2D textures, arrays and cube maps
+	// in BCn or 8-bit RGBA formats without supercompression.
+	bool ParseKTX2(const unsigned char* data, size_t size, TextureImage& image);
+}
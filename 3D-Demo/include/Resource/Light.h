@@ -10,4 +10,11 @@ namespace Resource
 		DirectX::XMFLOAT3 Color;
 		float Padding;
 	};
+
+	// Sun, lights everything from one direction and casts cascaded shadows
+	struct DirectionalLight
+	{
+		DirectX::XMFLOAT3 Direction;	// The way the light travels
+		DirectX::XMFLOAT3 Color;
+	};
 }
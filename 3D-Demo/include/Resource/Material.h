@@ -3,8 +3,32 @@
 
 namespace Resource
 {
+	// Texture arrays holding material maps, bound together once per frame
+	const UINT MAX_MATERIAL_TEXTURE_ARRAYS = 8;
+
+	// Feature bits of a material, each one is a define of the material shaders
+	// so the shaders only branch on what the material actually has
+	constexpr UINT MATERIAL_FEATURE_DIFFUSE_MAP = 0x1 << 0;	// map_Kd
+	constexpr UINT MATERIAL_FEATURE_SPECULAR_MAP = 0x1 << 1;	// map_Ks
+	constexpr UINT MATERIAL_FEATURE_NORMAL_MAP = 0x1 << 2;		// map_Disp, map_bump, bump
+	constexpr UINT MATERIAL_FEATURE_ALPHA_TEST = 0x1 << 3;		// map_d, cut out by the diffuse map alpha
+
+	constexpr UINT MATERIAL_FEATURE_COUNT = 4;
+	constexpr UINT MATERIAL_PERMUTATION_COUNT = 0x1 << MATERIAL_FEATURE_COUNT;
+
+	// Indexed by bit, ShaderLib.hlsli
+	constexpr const char* MATERIAL_FEATURE_DEFINES[MATERIAL_FEATURE_COUNT] = {
+		"MATERIAL_DIFFUSE_MAP",
+		"MATERIAL_SPECULAR_MAP",
+		"MATERIAL_NORMAL_MAP",
+		"MATERIAL_ALPHA_TEST"
+	};
+
 	struct Material
 	{
+		// Map indices are slices of the texture array in the matching MapArray
+		// slot. A map that is not in an array has the slot -1 and index 0, and
+		// is bound on its own. Index -1 means the material has no such map.
 		struct MaterialData
 		{
 			DirectX::XMFLOAT3 Diffuse; // Kd
@@ -15,7 +39,13 @@ namespace Resource
 			int AmbientMapIndex;
 			float SpecularExponent; // Ns
 
-			DirectX::XMFLOAT3 Padding;
+			int DiffuseMapArray;
+			int SpecularMapArray;
+			int NormalMapArray;
+			int NormalMapIndex;
+
+			UINT Features; // MATERIAL_FEATURE bits, the shader permutation drawing it
+			DirectX::XMFLOAT2 Padding;
 
 			MaterialData() :
 				Diffuse({ 0.5f, 0.5f, 0.5f }),
@@ -25,11 +55,19 @@ namespace Resource
 				Ambient({ 0.2f, 0.2f, 0.2f }),
 				AmbientMapIndex(-1),
 				SpecularExponent(1.0f),
-				Padding({ 0.0f, 0.0f, 0.0f }) {}
+				DiffuseMapArray(-1),
+				SpecularMapArray(-1),
+				NormalMapArray(-1),
+				NormalMapIndex(-1),
+				Features(0),
+				Padding({ 0.0f, 0.0f }) {}
 		};
 
 		MaterialData Data;
 		ID DiffuseMap = 0;
+		ID SpecularMap = 0;
+		ID NormalMap = 0;
+		UINT TableIndex = 0; // Set when the material is added
 		std::string Name;
 
 		Material(const std::string& name) : Name(name) {}
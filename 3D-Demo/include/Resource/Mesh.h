@@ -8,10 +8,11 @@ namespace Resource
 		DirectX::XMFLOAT3 Position;
 		DirectX::XMFLOAT3 Normal;
 		DirectX::XMFLOAT2 Texcoord;
+		UINT MaterialIndex; // Slot in the material table
 
-		Vertex() : Position({ 0.0f, 0.0f, 0.0f }), Normal({ 0.0f, 0.0f, 0.0f }), Texcoord({ 0.0f, 0.0f }) {}
+		Vertex() : Position({ 0.0f, 0.0f, 0.0f }), Normal({ 0.0f, 0.0f, 0.0f }), Texcoord({ 0.0f, 0.0f }), MaterialIndex(0) {}
 		Vertex(DirectX::XMFLOAT3 position, DirectX::XMFLOAT3 normal, DirectX::XMFLOAT2 texcoord) :
-			Position(position), Normal(normal), Texcoord(texcoord) {}
+			Position(position), Normal(normal), Texcoord(texcoord), MaterialIndex(0) {}
 	};
 
 	struct Mesh
@@ -23,13 +24,22 @@ namespace Resource
 			UINT IndexCount = 0;
 			ID Material = 0;
 
+			// Calculated when the mesh is added
+			DirectX::XMFLOAT3 BoundsCenter = { 0.0f, 0.0f, 0.0f };
+			float BoundsRadius = 0.0f;
+			float TexcoordDensity = 0.0f; // Texcoord units per object space unit
+
 			Submesh() {}
 			Submesh(UINT offset, UINT count = 0) : IndexOffset(offset), IndexCount(count) {}
 			Submesh(std::string name, UINT offset = 0, UINT count = 0) : Name(name), IndexOffset(offset), IndexCount(count) {}
 		};
 
 		ID VertexBuffer;
+		ID PositionBuffer; // Positions only, for depth only passes
 		ID IndexBuffer;
 		std::vector<Submesh> Submeshes;
+
+		DirectX::XMFLOAT3 BoundsCenter = { 0.0f, 0.0f, 0.0f };
+		float BoundsRadius = 0.0f;
 	};
 }
@@ -0,0 +1,27 @@
+#pragma once
+#include "pch.h"
+
+namespace Resource
+{
+	struct MipLevel
+	{
+		UINT Width = 0;
+		UINT Height = 0;
+		std::vector<unsigned char> Pixels; // RGBA8
+	};
+
+	UINT CalculateMipCount(UINT width, UINT height);
+
+	// Generates mip level 1 and down of an RGBA8 image with a 2x2 box filter.
+	// If sRGB is set, color is filtered in linear space. If alpha coverage is
+	// preserved, alpha is rescaled per level so the share of texels at or above
+	// alphaReference matches level 0, keeping alpha tested cutouts from
+	// thinning out in the distance.
+	std::vector<MipLevel> GenerateMipLevels(
+		const unsigned char* pixels,
+		UINT width,
+		UINT height,
+		bool sRGB,
+		bool preserveAlphaCoverage,
+		float alphaReference = 0.5f);
+}
@@ -2,6 +2,7 @@
 #include "pch.h"
 #include "Platform/GPU.h"
 #include "Resource/ResourceTypes.h"
+#include "Resource/BlockCompression.h"
 
 namespace Resource
 {
@@ -71,10 +72,89 @@ namespace Resource
 			return s_instance->LoadMaterialInternal(filePath);
 		}
 
-		static inline ID LoadTexture2D(const std::string& filePath)
+		static inline ID LoadTexture2D(const std::string& filePath, TextureUsage usage = TextureUsage::Color)
 		{
 			if (!s_instance) { Initialize(); }
-			return s_instance->LoadTexture2DInternal(filePath);
+			return s_instance->LoadTexture2DInternal(filePath, usage);
+		}
+
+		static inline std::vector<ID> LoadTextures2D(const std::vector<std::string>& filePaths, const std::vector<TextureUsage>& usages = {})
+		{
+			if (!s_instance) { Initialize(); }
+			return s_instance->LoadTextures2DInternal(filePaths, usages);
+		}
+
+		// Quality used when textures are compressed, High is meant for baking the cache offline
+		static inline void SetTextureCompressionQuality(CompressionQuality quality)
+		{
+			if (!s_instance) { Initialize(); }
+			s_instance->m_textureCompressionQuality = quality;
+		}
+
+		// Streamed textures start at a low mip and are refined by the TextureStreamer
+		static inline void SetTextureStreaming(bool enabled)
+		{
+			if (!s_instance) { Initialize(); }
+			s_instance->m_textureStreaming = enabled;
+		}
+
+		// Maps of loaded materials are packed into texture arrays grouped by format
+		// and size, so draws do not have to bind them one by one. Off by default:
+		// arrays are created whole and immutable, so they are not streamed and
+		// the streaming budget does not cover them.
+		static inline void SetTextureArrays(bool enabled)
+		{
+			if (!s_instance) { Initialize(); }
+			s_instance->m_textureArrays = enabled;
+		}
+
+		// Compiled shaders are kept on disk and loaded again as long as their
+		// preprocessed source, entry point, profile and macros are the same
+		static inline void SetShaderCache(bool enabled)
+		{
+			if (!s_instance) { Initialize(); }
+			s_instance->m_shaderCache = enabled;
+		}
+
+		// Programs created from now on are recompiled when their files change
+		static inline void SetShaderHotReload(bool enabled)
+		{
+			if (!s_instance) { Initialize(); }
+			s_instance->m_shaderHotReload = enabled;
+		}
+
+		// Thread safe, compiles a program without adding it. Empty if it does not compile.
+		static inline std::shared_ptr<ShaderProgram> CompileShaderProgram(const std::string& filePath, const ShaderDefines& defines)
+		{
+			if (!s_instance) { Initialize(); }
+			return s_instance->CompileShaderProgramInternal(filePath, defines);
+		}
+
+		// Programs already bound keep their shaders until bound again
+		static inline void ReplaceShaderProgram(ID programID, const std::shared_ptr<ShaderProgram>& program)
+		{
+			if (!s_instance) { Initialize(); }
+			s_instance->ReplaceShaderProgramInternal(programID, program);
+		}
+
+		static inline const ShaderCacheStatistics& GetShaderCacheStatistics()
+		{
+			if (!s_instance) { Initialize(); }
+			return s_instance->m_shaderCacheStatistics;
+		}
+
+		// Data of every material indexed by Material::TableIndex, slot 0 is the default material
+		static inline const std::vector<Material::MaterialData>& GetMaterialTable()
+		{
+			if (!s_instance) { Initialize(); }
+			return s_instance->m_materialTable;
+		}
+
+		// Texture IDs of the material texture arrays, indexed by the MapArray slots
+		static inline const std::vector<ID>& GetMaterialTextureArrays()
+		{
+			if (!s_instance) { Initialize(); }
+			return s_instance->m_materialTextureArrays;
 		}
 
 		static inline ID CreateAppWindow(UINT width, UINT height, const std::string& title, WindowProcedureFunction windowProc = NULL)
@@ -113,6 +193,26 @@ namespace Resource
 			return s_instance->CreateTexture2DInternal(width, height, format, texelStride, initData);
 		}
 
+		static inline ID CreateTexture2D(const D3D11_TEXTURE2D_DESC& description, UINT texelStride, const D3D11_SUBRESOURCE_DATA* initData = nullptr)
+		{
+			if (!s_instance) { Initialize(); }
+			return s_instance->CreateTexture2DInternal(description, texelStride, initData);
+		}
+
+		// Always viewed as a Texture2DArray, even with a single slice
+		static inline ID CreateTexture2DArray(const D3D11_TEXTURE2D_DESC& description, UINT texelStride, const D3D11_SUBRESOURCE_DATA* initData = nullptr)
+		{
+			if (!s_instance) { Initialize(); }
+			return s_instance->CreateTexture2DArrayInternal(description, texelStride, initData);
+		}
+
+		// Swaps the texture behind an existing ID, used when streaming changes the resident mips
+		static inline void ReplaceTexture2D(ID textureID, const D3D11_TEXTURE2D_DESC& description, UINT texelStride, const D3D11_SUBRESOURCE_DATA* initData = nullptr)
+		{
+			if (!s_instance) { Initialize(); }
+			s_instance->ReplaceTexture2DInternal(textureID, description, texelStride, initData);
+		}
+
 		static inline ID CreateDepthTexture(UINT width, UINT height, const void* initData = nullptr)
 		{
 			if (!s_instance) { Initialize(); }
@@ -125,12 +225,26 @@ namespace Resource
 			return s_instance->CreateSamplerInternal(description);
 		}
 
+		static inline ID CreateDepthStencilState(const D3D11_DEPTH_STENCIL_DESC& description)
+		{
+			if (!s_instance) { Initialize(); }
+			return s_instance->CreateDepthStencilStateInternal(description);
+		}
+
 		static inline ID CreateShaderProgram(const std::string& filePath)
 		{
 			if (!s_instance) { Initialize(); }
 			return s_instance->CreateShaderProgramInternal(filePath);
 		}
 
+		// One program per set of defines, the stages of every permutation are
+		// compiled in parallel on the job system
+		static inline std::vector<ID> CreateShaderPrograms(const std::string& filePath, const std::vector<ShaderDefines>& permutations)
+		{
+			if (!s_instance) { Initialize(); }
+			return s_instance->CreateShaderProgramsInternal(filePath, permutations);
+		}
+
 		static inline std::shared_ptr<Window> GetWindow(ID windowID)
 		{
 			if (!s_instance) { Initialize(); }
@@ -179,6 +293,12 @@ namespace Resource
 			return s_instance->GetSamplerInternal(samplerID);
 		}
 
+		static inline std::shared_ptr<const DepthStencilState> GetDepthStencilState(ID stateID)
+		{
+			if (!s_instance) { Initialize(); }
+			return s_instance->GetDepthStencilStateInternal(stateID);
+		}
+
 		static inline std::shared_ptr<const ShaderProgram> GetShaderProgram(ID programID)
 		{
 			if (!s_instance) { Initialize(); }
@@ -208,6 +328,7 @@ namespace Resource
 		std::unordered_map<ID, std::shared_ptr<Mesh>> m_meshes;
 		std::unordered_map<ID, std::shared_ptr<Material>> m_materials;
 		std::unordered_map<std::string, ID> m_materialNames;
+		std::vector<Material::MaterialData> m_materialTable;
 
 		std::unordered_map<ID, std::shared_ptr<Window>> m_windows;
 
@@ -216,10 +337,21 @@ namespace Resource
 		std::unordered_map<ID, std::shared_ptr<BufferArray>> m_bufferArrays;
 		std::unordered_map<ID, std::shared_ptr<ConstantBuffer>> m_constantBuffers;
 		std::unordered_map<ID, std::shared_ptr<Texture2D>> m_textures;
+		std::unordered_map<std::string, ID> m_texturePaths;
+		CompressionQuality m_textureCompressionQuality;
+		bool m_textureStreaming;
+		bool m_textureArrays;
+		std::vector<ID> m_materialTextureArrays;
+		std::unordered_map<std::string, TextureArraySlice> m_textureArraySlices;
 		std::unordered_map<ID, std::shared_ptr<DepthTexture>> m_depthTextures;
 		std::unordered_map<ID, std::shared_ptr<Sampler>> m_samplers;
+		std::unordered_map<ID, std::shared_ptr<DepthStencilState>> m_depthStencilStates;
 
 		std::unordered_map<ID, std::shared_ptr<ShaderProgram>> m_shaderPrograms;
+		bool m_shaderCache;
+		ShaderCacheStatistics m_shaderCacheStatistics;
+		std::mutex m_shaderCacheMutex; // Permutations compile on worker threads
+		bool m_shaderHotReload;
 
 		ShaderProgram m_defaultShaderProgram;
 		ConstantBuffer m_cameraBuffer;
@@ -247,7 +379,8 @@ namespace Resource
 
 		ID LoadModelInternal(const std::string& filePath);
 		std::vector<ID> LoadMaterialInternal(const std::string& filePath);
-		ID LoadTexture2DInternal(const std::string& filePath);
+		ID LoadTexture2DInternal(const std::string& filePath, TextureUsage usage);
+		std::vector<ID> LoadTextures2DInternal(const std::vector<std::string>& filePaths, const std::vector<TextureUsage>& usages, std::vector<TextureArraySlice>* arraySlices = nullptr);
 
 		ID CreateAppWindowInternal(UINT width, UINT height, const std::string& title, WindowProcedureFunction windowProc);
 		
@@ -256,9 +389,16 @@ namespace Resource
 		ID CreateBufferArrayInternal(size_t maxElementCount, size_t elementStride, const void* initData);
 		ID CreateConstantBufferInternal(size_t size, const void* initData);
 		ID CreateTexture2DInternal(UINT width, UINT height, DXGI_FORMAT format, UINT texelStride, const void* initData);
+		ID CreateTexture2DInternal(const D3D11_TEXTURE2D_DESC& description, UINT texelStride, const D3D11_SUBRESOURCE_DATA* initData);
+		ID CreateTexture2DArrayInternal(const D3D11_TEXTURE2D_DESC& description, UINT texelStride, const D3D11_SUBRESOURCE_DATA* initData);
+		void ReplaceTexture2DInternal(ID textureID, const D3D11_TEXTURE2D_DESC& description, UINT texelStride, const D3D11_SUBRESOURCE_DATA* initData);
 		ID CreateDepthTextureInternal(UINT width, UINT height, const void* initData);
 		ID CreateSamplerInternal(const D3D11_SAMPLER_DESC& description);
+		ID CreateDepthStencilStateInternal(const D3D11_DEPTH_STENCIL_DESC& description);
 		ID CreateShaderProgramInternal(const std::string& filePath);
+		std::vector<ID> CreateShaderProgramsInternal(const std::string& filePath, const std::vector<ShaderDefines>& permutations);
+		std::shared_ptr<ShaderProgram> CompileShaderProgramInternal(const std::string& filePath, const ShaderDefines& defines);
+		void ReplaceShaderProgramInternal(ID programID, const std::shared_ptr<ShaderProgram>& program);
 
 		std::shared_ptr<Window> GetWindowInternal(ID windowID);
 		std::shared_ptr<const VertexBuffer> GetVertexBufferInternal(ID bufferID);
@@ -268,11 +408,14 @@ namespace Resource
 		std::shared_ptr<const Texture2D> GetTexture2DInternal(ID textureID);
 		std::shared_ptr<const DepthTexture> GetDepthTextureInternal(ID textureID);
 		std::shared_ptr<const Sampler> GetSamplerInternal(ID samplerID);
+		std::shared_ptr<const DepthStencilState> GetDepthStencilStateInternal(ID stateID);
 		std::shared_ptr<const ShaderProgram> GetShaderProgramInternal(ID programID);
 
 	private:
 
+		std::shared_ptr<Texture2D> BuildTexture2D(const D3D11_TEXTURE2D_DESC& description, UINT texelStride, const D3D11_SUBRESOURCE_DATA* initData, bool arrayView = false);
 		std::string FindEntryPoint(const std::string& content, const std::string& keyword);
-		ComPtr<ID3DBlob> CompileShader(const std::string& src, const std::string& entryPoint, const std::string& shaderModel, const std::string& sourceFile = "");
+		std::vector<std::shared_ptr<ShaderProgram>> CompileShaderProgramsInternal(const std::string& filePath, const std::vector<ShaderDefines>& permutations, bool parallel);
+		ComPtr<ID3DBlob> CompileShader(const std::string& src, const std::string& entryPoint, const std::string& shaderModel, const std::string& sourceFile = "", const D3D_SHADER_MACRO* defines = nullptr);
 	};
 }
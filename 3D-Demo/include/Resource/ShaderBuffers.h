@@ -15,4 +15,47 @@ namespace Resource
 		DirectX::XMFLOAT3 Position;
 		float Padding;
 	};
+
+	// Finds the light cluster of a pixel, see Graphics::LightClusters
+	struct ClusterBufferData
+	{
+		DirectX::XMFLOAT2 ScreenOffset;	// Viewport corner
+		DirectX::XMFLOAT2 ScreenScale;	// Tiles per pixel
+		float DepthScale;				// slice = log(depth) * DepthScale + DepthBias
+		float DepthBias;
+		UINT GridX;
+		UINT GridY;
+		UINT GridZ;
+		UINT LightCount;
+		DirectX::XMFLOAT2 Padding;
+	};
+
+	// Tiled deferred light pass, matrices transposed like the camera's
+	struct TiledLightingBufferData
+	{
+		DirectX::XMFLOAT4X4 InverseProjection;	// Clip to view space
+		DirectX::XMFLOAT4X4 InverseView;		// View to world space
+		DirectX::XMFLOAT2 ScreenOffset;			// Viewport corner
+		DirectX::XMFLOAT2 ScreenSize;
+		UINT LightCount;
+		DirectX::XMFLOAT3 Padding;
+	};
+
+	// Directional light with cascaded shadows, see Graphics::ShadowCascades
+	struct ShadowBufferData
+	{
+		DirectX::XMFLOAT4X4 Cascades[4];	// World to light clip space, transposed
+		DirectX::XMFLOAT4 SplitDepths;		// Far view depth of each cascade
+		DirectX::XMFLOAT4 TexelSizes;		// World units per texel of each cascade
+		DirectX::XMFLOAT3 Direction;		// The way the light travels
+		float Padding;
+		DirectX::XMFLOAT3 Color;
+		UINT CascadeCount;					// 0 without a directional light
+	};
+
+	// Cascade being drawn into
+	struct ShadowCasterBufferData
+	{
+		DirectX::XMFLOAT4X4 ViewProjection;	// Transposed
+	};
 }
\ No newline at end of file
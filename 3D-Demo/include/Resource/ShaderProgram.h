@@ -1,22 +1,62 @@
 #pragma once
 #include "pch.h"
 
-constexpr UINT SHADER_STAGE_VERTEX = 0x1 << 1;
+constexpr UINT SHADER_STAGE_VERTEX = 0x1 << 0;
 constexpr UINT SHADER_STAGE_HULL = 0x1 << 1;
 constexpr UINT SHADER_STAGE_DOMAIN = 0x1 << 2;
 constexpr UINT SHADER_STAGE_GEOMETRY = 0x1 << 3;
 constexpr UINT SHADER_STAGE_PIXEL = 0x1 << 4;
+constexpr UINT SHADER_STAGE_COMPUTE = 0x1 << 5;
 
 namespace Resource
 {
+	enum class ShaderBindingType
+	{
+		ConstantBuffer,
+		ShaderResource,	// Textures and structured buffers
+		UnorderedAccess,
+		Sampler
+	};
+
+	// A resource the program uses, found by reflecting its compiled stages
+	struct ShaderBinding
+	{
+		std::string Name;
+		size_t NameHash;
+		ShaderBindingType Type;
+		UINT Slot;
+		UINT Count;		// Array size
+		UINT Stages;	// Only the stages reading it
+	};
+
 	struct ShaderProgram
 	{
 		ComPtr<ID3D11InputLayout> InputLayout;
 		ComPtr<ID3D11VertexShader> Vertex;
 		ComPtr<ID3D11PixelShader> Pixel;
+		ComPtr<ID3D11ComputeShader> Compute;
 
 		UINT Stages = 0;
 
+		// Every resource of every stage, ordered by type and slot
+		std::vector<ShaderBinding> Bindings;
+
 		void Bind();
 	};
+
+	// "#define Name Value" for one compile of a shader program
+	struct ShaderDefine
+	{
+		std::string Name;
+		std::string Value = "1";
+	};
+
+	using ShaderDefines = std::vector<ShaderDefine>;
+
+	struct ShaderCacheStatistics
+	{
+		UINT Hits = 0;				// Shaders loaded from the cache
+		UINT Misses = 0;			// Shaders compiled
+		double Milliseconds = 0.0;	// Wall time spent getting shader bytecode, cached or not
+	};
 }
@@ -0,0 +1,113 @@
+#pragma once
+#include "pch.h"
+#include "Resource/ShaderProgram.h"
+#include "Platform/FileWatcher.h"
+
+namespace Resource
+{
+	struct ShaderReloadStatistics
+	{
+		UINT Programs = 0;
+		UINT PendingRequests = 0;	// Queued or being compiled by the reload thread
+		UINT Reloads = 0;			// Total since start
+		UINT Failures = 0;			// Total since start
+	};
+
+	// Singleton
+	//
+	// Watches the files of every shader program and the files they include.
+	// When one changes, the programs using it are compiled again on a
+	// background thread. The new program replaces the old one under the same
+	// ID once per frame, before anything is drawn. A program that does not
+	// compile is reported and the old one is kept.
+	class ShaderReloader
+	{
+	public:
+
+		static void Initialize();
+		static void Finalize();
+
+		static inline void Register(ID programID, const std::string& filePath, const ShaderDefines& defines)
+		{
+			if (!s_instance) { Initialize(); }
+			s_instance->RegisterInternal(programID, filePath, defines);
+		}
+
+		// Swaps in finished programs and queues changed ones, once per frame
+		static inline void Update()
+		{
+			if (!s_instance) { return; }
+			s_instance->UpdateInternal();
+		}
+
+		static inline ShaderReloadStatistics GetStatistics()
+		{
+			if (!s_instance) { return ShaderReloadStatistics(); }
+			return s_instance->GetStatisticsInternal();
+		}
+
+	private:
+
+		static std::unique_ptr<ShaderReloader> s_instance;
+
+		ShaderReloader();
+		~ShaderReloader();
+
+		// No copy allowed
+		ShaderReloader(const ShaderReloader& other) = delete;
+		ShaderReloader(const ShaderReloader&& other) = delete;
+		ShaderReloader& operator=(const ShaderReloader& other) = delete;
+		ShaderReloader& operator=(const ShaderReloader&& other) = delete;
+
+		friend std::unique_ptr<ShaderReloader>::deleter_type;
+		friend std::unique_ptr<ShaderReloader> std::make_unique<ShaderReloader>();
+
+	private:
+
+		struct WatchedProgram
+		{
+			std::string FilePath;
+			ShaderDefines Defines;
+			std::vector<std::string> Dependencies; // The file itself and everything it includes
+			bool Pending = false;
+			bool Dirty = false; // Changed again while pending
+		};
+
+		struct ReloadRequest
+		{
+			ID ProgramID;
+			std::string FilePath;
+			ShaderDefines Defines;
+		};
+
+		struct ReloadResult
+		{
+			ID ProgramID = 0;
+			std::shared_ptr<ShaderProgram> Program;
+		};
+
+		std::unordered_map<ID, WatchedProgram> m_programs;
+		Platform::FileWatcher m_watcher;
+
+		UINT m_reloads;
+		UINT m_failures;
+
+		std::thread m_thread;
+		std::deque<ReloadRequest> m_requests;
+		std::vector<ReloadResult> m_results;
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+		bool m_running;
+
+	private:
+
+		void RegisterInternal(ID programID, const std::string& filePath, const ShaderDefines& defines);
+		void UpdateInternal();
+		ShaderReloadStatistics GetStatisticsInternal() const;
+
+		void WatchDependencies(WatchedProgram& program);
+		void Queue(ID programID, WatchedProgram& program);
+
+		void ReloadThreadMain();
+	};
+}
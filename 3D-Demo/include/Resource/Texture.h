@@ -3,11 +3,46 @@
 
 namespace Resource
 {
+	// How the contents of a loaded texture are interpreted
+	enum class TextureUsage
+	{
+		Color,	// sRGB color
+		Cutout,	// sRGB color, alpha tested
+		Normal,	// Tangent space normals, only X and Y are kept
+		Data,	// Linear data
+	};
+
+	// Subresources of a texture in CPU memory owned elsewhere, typically a
+	// mapped texture file. Ordered like D3D11 expects them, all mips of the
+	// first array slice first.
+	struct TextureImage
+	{
+		DXGI_FORMAT Format = DXGI_FORMAT_UNKNOWN;
+		UINT Width = 0;
+		UINT Height = 0;
+		UINT MipLevels = 0;
+		UINT ArraySize = 0;
+		bool Cube = false;
+		std::vector<D3D11_SUBRESOURCE_DATA> Subresources;
+	};
+
 	struct Sampler
 	{
 		ComPtr<ID3D11SamplerState> SamplerState;
 	};
 
+	struct DepthStencilState
+	{
+		ComPtr<ID3D11DepthStencilState> State;
+	};
+
+	// Where a texture packed into one of the material texture arrays ended up
+	struct TextureArraySlice
+	{
+		int Array = -1;
+		int Slice = -1;
+	};
+
 	struct Texture2D
 	{
 		ComPtr<ID3D11Texture2D> Texture;
@@ -18,6 +53,8 @@ namespace Resource
 		UINT TexelStride;
 		UINT Width;
 		UINT Height;
+		UINT MipLevels = 1;
+		UINT ArraySize = 1;
 	};
 
 	struct DepthTexture
@@ -0,0 +1,149 @@
+#pragma once
+#include "pch.h"
+#include "Resource/Texture.h"
+#include "Platform/MappedFile.h"
+
+namespace Resource
+{
+	struct TextureStreamingStatistics
+	{
+		size_t ResidentBytes = 0;
+		size_t BudgetBytes = 0;
+		UINT StreamedTextures = 0;
+		UINT PendingRequests = 0;	// Queued or being read by the streaming thread
+		UINT Uploads = 0;			// Total since start
+		UINT Evictions = 0;			// Total since start
+	};
+
+	// Singleton
+	//
+	// Streamed textures are created with only their low mips resident. Every
+	// frame the renderer reports how finely each texture is sampled, and the
+	// streamer reads missing mips from the texture file on a background thread.
+	// Resident mips are kept within a byte budget, the least recently used
+	// textures are dropped back to their low mips when it is exceeded.
+	class TextureStreamer
+	{
+	public:
+
+		static void Initialize();
+		static void Finalize();
+
+		// First mip kept resident when a texture is created
+		static UINT GetInitialMip(DXGI_FORMAT format, UINT width, UINT height, UINT mipLevels);
+
+		static inline void Register(ID textureID, const std::string& filePath, const TextureImage& image, UINT residentMip)
+		{
+			if (!s_instance) { Initialize(); }
+			s_instance->RegisterInternal(textureID, filePath, image, residentMip);
+		}
+
+		// Texcoord units covered by one screen pixel where the texture is sampled
+		static inline void Request(ID textureID, float texcoordsPerPixel)
+		{
+			if (!s_instance) { Initialize(); }
+			s_instance->RequestInternal(textureID, texcoordsPerPixel);
+		}
+
+		// Applies finished loads, evicts and queues new loads, once per frame
+		static inline void Update()
+		{
+			if (!s_instance) { Initialize(); }
+			s_instance->UpdateInternal();
+		}
+
+		static inline void SetBudget(size_t bytes)
+		{
+			if (!s_instance) { Initialize(); }
+			s_instance->m_budget = bytes;
+		}
+
+		static inline TextureStreamingStatistics GetStatistics()
+		{
+			if (!s_instance) { Initialize(); }
+			return s_instance->GetStatisticsInternal();
+		}
+
+	private:
+
+		static std::unique_ptr<TextureStreamer> s_instance;
+
+		TextureStreamer();
+		~TextureStreamer();
+
+		// No copy allowed
+		TextureStreamer(const TextureStreamer& other) = delete;
+		TextureStreamer(const TextureStreamer&& other) = delete;
+		TextureStreamer& operator=(const TextureStreamer& other) = delete;
+		TextureStreamer& operator=(const TextureStreamer&& other) = delete;
+
+		friend std::unique_ptr<TextureStreamer>::deleter_type;
+		friend std::unique_ptr<TextureStreamer> std::make_unique<TextureStreamer>();
+
+	private:
+
+		struct StreamedTexture
+		{
+			std::string FilePath;
+			DXGI_FORMAT Format = DXGI_FORMAT_UNKNOWN;
+			UINT Width = 0;
+			UINT Height = 0;
+			UINT MipLevels = 0;
+			std::vector<size_t> MipSizes;
+
+			UINT InitialMip = 0;
+			UINT ResidentMip = 0;
+			UINT WantedMip = 0;
+			UINT LastUsedFrame = 0;
+
+			bool Pending = false;
+			size_t PendingBytes = 0;
+			bool Failed = false;
+		};
+
+		struct LoadRequest
+		{
+			ID TextureID;
+			std::string FilePath;
+			UINT TargetMip;
+		};
+
+		struct LoadResult
+		{
+			ID TextureID = 0;
+			UINT TargetMip = 0;
+			bool Succeeded = false;
+			Platform::MappedFile File;
+			TextureImage Image;
+		};
+
+		std::unordered_map<ID, StreamedTexture> m_textures;
+
+		size_t m_budget;
+		size_t m_residentBytes;
+		size_t m_pendingBytes;
+		UINT m_frame;
+		UINT m_uploads;
+		UINT m_evictions;
+
+		std::thread m_thread;
+		std::deque<LoadRequest> m_requests;
+		std::vector<LoadResult> m_results;
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+		bool m_running;
+
+	private:
+
+		void RegisterInternal(ID textureID, const std::string& filePath, const TextureImage& image, UINT residentMip);
+		void RequestInternal(ID textureID, float texcoordsPerPixel);
+		void UpdateInternal();
+		TextureStreamingStatistics GetStatisticsInternal() const;
+
+		size_t GetResidentSize(const StreamedTexture& texture, UINT mostDetailedMip) const;
+		void Upload(ID textureID, StreamedTexture& texture, const TextureImage& image, UINT targetMip);
+		void Evict(ID textureID, StreamedTexture& texture, UINT targetMip);
+
+		void StreamingThreadMain();
+	};
+}
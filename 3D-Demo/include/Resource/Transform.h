@@ -3,29 +3,124 @@
 
 namespace Resource
 {
+	/** --- QUATERNION HELPERS --- */
+
+	// Pitch (x), yaw (y) and roll (z) in radians, applied roll first, then pitch, then yaw
+	inline DirectX::XMVECTOR QuaternionFromEuler(const DirectX::XMFLOAT3& euler)
+	{
+		return DirectX::XMQuaternionRotationRollPitchYawFromVector(DirectX::XMLoadFloat3(&euler));
+	}
+
+	// Inverse of QuaternionFromEuler, pitch is kept within [-pi/2, pi/2]
+	inline DirectX::XMFLOAT3 QuaternionToEuler(DirectX::FXMVECTOR quaternion)
+	{
+		DirectX::XMFLOAT4 q;
+		DirectX::XMStoreFloat4(&q, quaternion);
+
+		// Elements of the rotation matrix, see XMMatrixRotationQuaternion
+		float m12 = 2.f * (q.x * q.y + q.z * q.w);
+		float m22 = 1.f - 2.f * (q.x * q.x + q.z * q.z);
+		float m31 = 2.f * (q.x * q.z + q.y * q.w);
+		float m32 = 2.f * (q.y * q.z - q.x * q.w);
+		float m33 = 1.f - 2.f * (q.x * q.x + q.y * q.y);
+
+		return {
+			std::asin(std::min(1.f, std::max(-1.f, -m32))),
+			std::atan2(m31, m33),
+			std::atan2(m12, m22),
+		};
+	}
+
+	// Normalized linear interpolation along the shortest arc, cheaper than
+	// slerp and close to it for the small steps between two frames
+	inline DirectX::XMVECTOR QuaternionNlerp(DirectX::FXMVECTOR from, DirectX::FXMVECTOR to, float t)
+	{
+		using namespace DirectX;
+
+		XMVECTOR target = (XMVectorGetX(XMQuaternionDot(from, to)) < 0.f) ? XMVectorNegate(to) : to;
+		return XMQuaternionNormalize(XMVectorLerp(from, target, t));
+	}
+
+	// Constant angular velocity, along the shortest arc
+	inline DirectX::XMVECTOR QuaternionSlerp(DirectX::FXMVECTOR from, DirectX::FXMVECTOR to, float t)
+	{
+		return DirectX::XMQuaternionSlerp(from, to, t);
+	}
+
 	struct Transform
 	{
 		DirectX::XMFLOAT3 Position;
-		DirectX::XMFLOAT3 Rotation;
+		DirectX::XMFLOAT4 Rotation; // Unit quaternion
 		DirectX::XMFLOAT3 Scale;
 
 		Transform() :
 			Position({ 0.0f, 0.0f, 0.0f }),
-			Rotation({ 0.0f, 0.0f, 0.0f }),
+			Rotation({ 0.0f, 0.0f, 0.0f, 1.0f }),
 			Scale({ 1.0f, 1.0f, 1.0f })
 		{
 		}
 
+		inline DirectX::XMVECTOR GetRotation() const
+		{
+			return DirectX::XMLoadFloat4(&Rotation);
+		}
+
+		inline void SetRotation(DirectX::FXMVECTOR quaternion)
+		{
+			DirectX::XMStoreFloat4(&Rotation, DirectX::XMQuaternionNormalize(quaternion));
+		}
+
+		inline DirectX::XMFLOAT3 GetEulerRotation() const
+		{
+			return QuaternionToEuler(GetRotation());
+		}
+
+		inline void SetEulerRotation(const DirectX::XMFLOAT3& euler)
+		{
+			DirectX::XMStoreFloat4(&Rotation, QuaternionFromEuler(euler));
+		}
+
+		// Rotates around an axis in world space, after the current rotation
+		inline void Rotate(DirectX::FXMVECTOR axis, float angle)
+		{
+			SetRotation(DirectX::XMQuaternionMultiply(GetRotation(), DirectX::XMQuaternionRotationAxis(axis, angle)));
+		}
+
+		// Rotates around an axis in local space, before the current rotation
+		inline void RotateLocal(DirectX::FXMVECTOR axis, float angle)
+		{
+			SetRotation(DirectX::XMQuaternionMultiply(DirectX::XMQuaternionRotationAxis(axis, angle), GetRotation()));
+		}
+
+		// Basis vectors are rows of the rotation matrix, read straight from the quaternion
+		inline DirectX::XMVECTOR GetRight() const
+		{
+			const DirectX::XMFLOAT4& q = Rotation;
+			return DirectX::XMVectorSet(1.f - 2.f * (q.y * q.y + q.z * q.z), 2.f * (q.x * q.y + q.z * q.w), 2.f * (q.x * q.z - q.y * q.w), 0.f);
+		}
+
+		inline DirectX::XMVECTOR GetUp() const
+		{
+			const DirectX::XMFLOAT4& q = Rotation;
+			return DirectX::XMVectorSet(2.f * (q.x * q.y - q.z * q.w), 1.f - 2.f * (q.x * q.x + q.z * q.z), 2.f * (q.y * q.z + q.x * q.w), 0.f);
+		}
+
+		inline DirectX::XMVECTOR GetForward() const
+		{
+			const DirectX::XMFLOAT4& q = Rotation;
+			return DirectX::XMVectorSet(2.f * (q.x * q.z + q.y * q.w), 2.f * (q.y * q.z - q.x * q.w), 1.f - 2.f * (q.x * q.x + q.y * q.y), 0.f);
+		}
+
 		inline DirectX::XMFLOAT4X4 GetMatrix() const
 		{
 			DirectX::XMMATRIX xmTranslation = DirectX::XMMatrixTranslationFromVector(
 				DirectX::XMLoadFloat3(&Position));
-			DirectX::XMMATRIX xmRotation = DirectX::XMMatrixRotationRollPitchYawFromVector(
-				DirectX::XMLoadFloat3(&Rotation));
+			DirectX::XMMATRIX xmRotation = DirectX::XMMatrixRotationQuaternion(
+				DirectX::XMLoadFloat4(&Rotation));
 			DirectX::XMMATRIX xmScale = DirectX::XMMatrixScalingFromVector(
 				DirectX::XMLoadFloat3(&Scale));
 			DirectX::XMFLOAT4X4 transform;
-			DirectX::XMStoreFloat4x4(&transform, xmTranslation * xmScale * xmRotation);
+			DirectX::XMStoreFloat4x4(&transform, xmScale * xmRotation * xmTranslation);
 			return transform;
 		}
 
@@ -33,8 +128,8 @@ namespace Resource
 		{
 			DirectX::XMMATRIX xmTranslation = DirectX::XMMatrixTranslationFromVector(
 				DirectX::XMLoadFloat3(&Position));
-			DirectX::XMMATRIX xmRotation = DirectX::XMMatrixRotationRollPitchYawFromVector(
-				DirectX::XMLoadFloat3(&Rotation));
+			DirectX::XMMATRIX xmRotation = DirectX::XMMatrixRotationQuaternion(
+				DirectX::XMLoadFloat4(&Rotation));
 			DirectX::XMMATRIX xmScale = DirectX::XMMatrixScalingFromVector(
 				DirectX::XMLoadFloat3(&Scale));
 			DirectX::XMFLOAT4X4 transform;
@@ -46,18 +141,26 @@ namespace Resource
 		{
 			using namespace DirectX;
 
-			DirectX::XMFLOAT4X4 worldMatrixFloat = GetMatrix();
-			DirectX::XMVECTOR forward = DirectX::XMVector3Normalize({ worldMatrixFloat._31, worldMatrixFloat._32, worldMatrixFloat._33, 0.f });
-			DirectX::XMVECTOR up = DirectX::XMVector3Normalize({ worldMatrixFloat._21, worldMatrixFloat._22, worldMatrixFloat._23, 0.f });
-
 			XMFLOAT4X4 view;
 			XMStoreFloat4x4(
 				&view,
 				XMMatrixTranspose(XMMatrixLookToLH(
 					XMLoadFloat3(&Position),
-					forward,
-					up)));
+					GetForward(),
+					GetUp())));
 			return view;
 		}
+
+		// Position and scale are interpolated linearly, rotation with nlerp
+		static inline Transform Interpolate(const Transform& from, const Transform& to, float t)
+		{
+			using namespace DirectX;
+
+			Transform transform;
+			XMStoreFloat3(&transform.Position, XMVectorLerp(XMLoadFloat3(&from.Position), XMLoadFloat3(&to.Position), t));
+			XMStoreFloat4(&transform.Rotation, QuaternionNlerp(from.GetRotation(), to.GetRotation(), t));
+			XMStoreFloat3(&transform.Scale, XMVectorLerp(XMLoadFloat3(&from.Scale), XMLoadFloat3(&to.Scale), t));
+			return transform;
+		}
 	};
 }
@@ -0,0 +1,42 @@
+#pragma once
+#include "pch.h"
+#include "Resource/Transform.h"
+
+namespace Resource
+{
+	// Transforms stored as one array per component, the layout the batch
+	// kernel reads 4 or 8 at a time
+	struct TransformBatch
+	{
+		std::vector<float> PositionX;
+		std::vector<float> PositionY;
+		std::vector<float> PositionZ;
+		std::vector<float> RotationX; // Unit quaternion
+		std::vector<float> RotationY;
+		std::vector<float> RotationZ;
+		std::vector<float> RotationW;
+		std::vector<float> ScaleX;
+		std::vector<float> ScaleY;
+		std::vector<float> ScaleZ;
+
+		inline size_t Size() const { return PositionX.size(); }
+
+		void Resize(size_t count);
+		void Set(size_t index, const Transform& transform);
+	};
+
+	enum class SimdLevel
+	{
+		Scalar,
+		SSE,	// 4 transforms at a time
+		AVX,	// 8 transforms at a time
+	};
+
+	// Widest level supported by the CPU and the OS, detected once
+	SimdLevel GetSimdLevel();
+
+	// Writes the transposed world matrix, scale * rotation * translation, of each
+	// transform in [begin, end) to output[index - begin]. Matches Transform::GetMatrixTransposed.
+	void ComposeMatricesTransposed(const TransformBatch& transforms, size_t begin, size_t end, DirectX::XMFLOAT4X4* output);
+	void ComposeMatricesTransposed(const TransformBatch& transforms, size_t begin, size_t end, DirectX::XMFLOAT4X4* output, SimdLevel level);
+}
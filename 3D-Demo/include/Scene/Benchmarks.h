@@ -0,0 +1,53 @@
+#pragma once
+#include "pch.h"
+
+// Headless measurements of the scene systems, no window or device is created.
+// Run with: 3D-Demo --benchmark <name> [entity count]
+namespace Benchmarks
+{
+	// Per frame cost of the world matrices of mostly static entities, rebuilding
+	// every matrix on submit versus the TransformSystem cache
+	void TransformCache(size_t entityCount, size_t frameCount = 100, float movingFraction = 0.01f);
+
+	// Rebuild, full and incremental update cost of a deep hierarchy made of long
+	// chains, a wide one with every entity under a few roots and the wide one
+	// beside a moving camera, serial and parallel
+	void TransformHierarchy(size_t entityCount, size_t frameCount = 20);
+
+	// Checks the scalar, SSE and AVX batch kernels against
+	// Transform::GetMatrixTransposed and measures their throughput. Returns false
+	// if a kernel is off by more than a rounding error.
+	bool TransformKernel(size_t transformCount, size_t iterationCount = 20);
+
+	// Cost per job of spawning from outside the pool and from inside a job,
+	// where the other workers have to steal, and the scaling of a full
+	// transform update with 1 up to every hardware thread
+	void Jobs(size_t jobCount, size_t frameCount = 20);
+
+	// Per frame cost of bucketing instances per mesh: one map lookup and
+	// push_back per instance as the renderer used to, the InstanceBuckets one
+	// at a time, and the bulk path serial and parallel
+	void Instances(size_t instanceCount, size_t frameCount = 20);
+
+	// Per frame cost of binning point lights into the light clusters, serial
+	// and parallel over the depth slices. Returns false if a cluster's list
+	// differs from testing every light against it one by one.
+	bool LightBinning(size_t lightCount, size_t frameCount = 20);
+
+	// Declares and compiles sample frame graphs headless and reports their
+	// peak transient memory with and without aliasing. Returns false if two
+	// resources sharing memory are ever alive at the same time.
+	bool RenderGraphAliasing(size_t frameCount = 1000);
+
+	// Per frame cost of fitting the shadow cascades to a moving camera and
+	// culling casters against them. Returns false if the SIMD cull differs
+	// from testing casters one by one, a cascade misses part of its slice or
+	// a cascade changes size or leaves the texel grid as the camera moves.
+	bool ShadowCascades(size_t casterCount, size_t frameCount = 100);
+
+	// Rasterizes random boxes into a CPU depth buffer and reports the
+	// overdraw the pixel shader would see in submission order, sorted front
+	// to back and after a depth prepass. Returns false if the orders end with
+	// different depth or the sort is not front to back.
+	bool Overdraw(size_t boxCount);
+}
\ No newline at end of file
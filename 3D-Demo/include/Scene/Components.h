@@ -4,9 +4,26 @@
 
 namespace Component
 {
+	// Changes must go through registry.patch/replace so the TransformSystem
+	// sees them and updates the WorldMatrixComponent. The transform is relative
+	// to the parent entity when it has one.
 	struct TransformComponent : public Resource::Transform
 	{
-		entt::id_type ParentEntity = 0;
+		EntityID ParentEntity = entt::null;
+	};
+
+	// Cached by the TransformSystem, includes the parent transforms. Transposed
+	// and ready to be uploaded.
+	struct WorldMatrixComponent
+	{
+		DirectX::XMFLOAT4X4 WorldTransposed;
+	};
+
+	// The transform before the last simulation step, for entities without a
+	// parent that are drawn between two steps. Scene::Update fills it.
+	struct PreviousTransformComponent
+	{
+		Resource::Transform Transform;
 	};
 
 	struct CameraControllerFPS
@@ -40,9 +57,18 @@ namespace Component
 		ID MeshID;
 	};
 
+	// Placed by the entity's TransformComponent, lights nothing past the radius
 	struct PointLightComponent
 	{
-		float Radius;
+		float Radius = 10.f;
+		DirectX::XMFLOAT3 Color = { 1.f, 1.f, 1.f };
+	};
+
+	// The first one found is the sun, the only light casting shadows
+	struct DirectionalLightComponent
+	{
+		DirectX::XMFLOAT3 Direction = { -0.4f, -1.f, 0.3f };
+		DirectX::XMFLOAT3 Color = { 1.f, 1.f, 1.f };
 	};
 
 	struct WindowComponent
@@ -1,6 +1,7 @@
 #pragma once
 #include "pch.h"
 #include "Resource/ResourceTypes.h"
+#include "Scene/TransformSystem.h"
 
 class Scene
 {
@@ -11,7 +12,12 @@ public:
 
 	void Setup();
 	void Update(float delta);
-	void Draw();
+
+	// alpha is how far the frame is from the previous simulation step to the last one
+	void Draw(float alpha = 1.f);
+
+	// False once the main window is closed
+	bool IsRunning() const;
 
 private:
 
@@ -21,4 +27,5 @@ private:
 	EntityID m_mainWindow; // Temp
 
 	std::shared_ptr<entt::registry> m_registry;
+	std::unique_ptr<TransformSystem> m_transformSystem;
 };
\ No newline at end of file
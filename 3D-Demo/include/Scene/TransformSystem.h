@@ -0,0 +1,75 @@
+#pragma once
+#include "pch.h"
+#include "Resource/TransformBatch.h"
+
+// Keeps the WorldMatrixComponent of every entity with a TransformComponent in
+// sync, following TransformComponent::ParentEntity.
+//
+// The hierarchy is stored as flat arrays in breadth first order, so parents
+// always come before their children and the children of a range of nodes are
+// a range of the next level. Only transforms that were added, patched or
+// replaced since the last update are recomputed, together with the subtrees
+// below them, by walking those ranges down the levels. Static geometry costs
+// nothing per frame. Wide ranges are split over the job system.
+class TransformSystem
+{
+public:
+
+	TransformSystem(entt::registry& registry);
+	~TransformSystem();
+
+	// Returns the number of world matrices recomputed
+	size_t Update();
+
+	// Ranges of at least this many nodes are updated in parallel, 0 disables it
+	inline void SetParallelThreshold(size_t nodeCount) { m_parallelThreshold = nodeCount; }
+
+private:
+
+	// No copy allowed
+	TransformSystem(const TransformSystem& other) = delete;
+	TransformSystem(const TransformSystem&& other) = delete;
+	TransformSystem& operator=(const TransformSystem& other) = delete;
+	TransformSystem& operator=(const TransformSystem&& other) = delete;
+
+private:
+
+	static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+	void OnTransformDestroyed(entt::registry& registry, entt::entity entity);
+
+	void Rebuild();
+	void UpdateNodes(size_t begin, size_t end);
+
+private:
+
+	entt::registry& m_registry;
+	entt::observer m_changedTransforms;
+	bool m_hierarchyChanged;
+	size_t m_parallelThreshold;
+
+	struct NodeRange
+	{
+		uint32_t Begin;
+		uint32_t End;
+	};
+
+	// One entry per node, breadth first. Level d holds the nodes in
+	// [m_levels[d], m_levels[d + 1]), the children of node i are the nodes in
+	// [m_childBegin[i], m_childEnd[i]).
+	std::vector<entt::entity> m_entities;
+	std::vector<uint32_t> m_parents;
+	std::vector<uint32_t> m_childBegin;
+	std::vector<uint32_t> m_childEnd;
+	std::vector<DirectX::XMFLOAT4X4> m_localMatrices; // Transposed
+	std::vector<DirectX::XMFLOAT4X4> m_worldMatrices; // Transposed
+	std::vector<size_t> m_levels;
+	std::unordered_map<entt::entity, uint32_t> m_nodeIndices;
+
+	// Changed transforms gathered for the batch kernel, reused between updates
+	Resource::TransformBatch m_changedBatch;
+	std::vector<uint32_t> m_changedNodes;
+	std::vector<DirectX::XMFLOAT4X4> m_changedMatrices;
+	std::vector<NodeRange> m_dirtyRanges;
+	std::vector<NodeRange> m_levelRanges;
+};
@@ -1,14 +1,24 @@
 #pragma once
 
+#define NOMINMAX
 #include <Windows.h>
 #include <iostream>
 #include <string>
 #include <sstream>
 #include <assert.h>
 #include <vector>
+#include <algorithm>
+#include <cmath>
 #include <unordered_map>
 #include <map>
 #include <fstream>
+#include <filesystem>
+#include <deque>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 
 #include <wrl/client.h> // ComPtr
 using Microsoft::WRL::ComPtr;
@@ -1,37 +1,182 @@
 #include "pch.h"
 #include "Resource/Window.h"
 #include "Resource/Resource.h"
+#include "Resource/ShaderReloader.h"
 #include "Scene/Scene.h"
+#include "Scene/Benchmarks.h"
+#include "Graphics/Renderer.h"
+#include "Platform/GameLoop.h"
+#include "Platform/Profiler.h"
 
-#include <chrono>
-
-int main()
+int main(int argc, char** argv)
 {	
-	Scene scene;
-	scene.Setup();
-
-	using Clock = std::chrono::high_resolution_clock;
-	Clock::duration elapsed = std::chrono::seconds(0);
-	Clock::time_point then = Clock::now();
-	Clock::time_point now = then;
-
-	const Clock::duration TARGET_DELTA = std::chrono::microseconds(16667); // 16.667 ms -> 60 fps
+	// Offline texture bake: compress the textures of a material file at high
+	// quality into the texture cache, later runs load them from there
+	if (argc == 3 && std::string(argv[1]) == "--bake-textures")
+	{
+		Resource::Manager::SetTextureCompressionQuality(Resource::CompressionQuality::High);
+		Resource::Manager::LoadMaterial(argv[2]);
+		return 0;
+	}
 
-	while (true) // temp
+	if (argc >= 3 && std::string(argv[1]) == "--benchmark")
 	{
-		now = Clock::now();
-		elapsed += now - then;
-		then = now;
+		std::string name = argv[2];
+		size_t entityCount = (argc >= 4) ? std::stoul(argv[3]) : 100000;
 
-		if (elapsed >= TARGET_DELTA || true)
+		if (name == "transforms")
+		{
+			Benchmarks::TransformCache(entityCount);
+			return 0;
+		}
+		if (name == "hierarchy")
+		{
+			Benchmarks::TransformHierarchy(entityCount);
+			return 0;
+		}
+		if (name == "transform-kernel")
+		{
+			return Benchmarks::TransformKernel(entityCount) ? 0 : 1;
+		}
+		if (name == "instances")
+		{
+			// Without a count the usual scene sizes are measured
+			for (size_t instanceCount : (argc >= 4) ? std::vector<size_t>{ entityCount } : std::vector<size_t>{ 10000, 100000, 1000000 })
+			{
+				Benchmarks::Instances(instanceCount);
+			}
+			return 0;
+		}
+		if (name == "lights")
 		{
-			elapsed -= TARGET_DELTA;
+			// Without a count 1k and 10k lights are measured
+			bool matches = true;
+			for (size_t lightCount : (argc >= 4) ? std::vector<size_t>{ entityCount } : std::vector<size_t>{ 1000, 10000 })
+			{
+				matches &= Benchmarks::LightBinning(lightCount);
+			}
+			return matches ? 0 : 1;
+		}
+		if (name == "render-graph")
+		{
+			return Benchmarks::RenderGraphAliasing((argc >= 4) ? entityCount : 1000) ? 0 : 1;
+		}
+		if (name == "shadows")
+		{
+			return Benchmarks::ShadowCascades(entityCount) ? 0 : 1;
+		}
+		if (name == "overdraw")
+		{
+			return Benchmarks::Overdraw((argc >= 4) ? entityCount : 2000) ? 0 : 1;
+		}
+		if (name == "jobs")
+		{
+			Benchmarks::Jobs(entityCount);
+			return 0;
+		}
 
-			float delta = TARGET_DELTA.count() / 1000000000.f;
+		std::cerr << "Unknown benchmark '" << name << "'" << std::endl;
+		return 1;
+	}
 
-			scene.Update(delta);
-			scene.Draw();
+	// --frames N runs N frames as fast as possible and reports the frame times,
+	// --fps N limits the frame rate, 0 for no limit, --trace FILE writes a
+	// Chrome trace of the whole run, --report N prints the profiler summary
+	// every N frames, 0 for never, --render-path forward|deferred picks how
+	// the scene is lit, --depth-prepass on|off draws the depth of opaque
+	// geometry before shading it, --shader-cache on|off loads compiled
+	// shaders from disk instead of compiling them, --shader-reload on|off
+	// compiles shaders again when their files are saved, --gpu-timer
+	// queries|emulated times GPU scopes with timestamp queries or on the CPU,
+	// --texture-arrays on|off packs material maps into texture arrays that
+	// are kept fully resident instead of streamed
+	Platform::GameLoopSettings loopSettings;
+	loopSettings.TargetFrameTime = 1.0 / 240.0;
+	std::string tracePath;
+	UINT reportInterval = 240;
+	Graphics::RenderPath renderPath = Graphics::RenderPath::Forward;
+	bool depthPrepass = false;
+	Graphics::GpuTimerMode gpuTimerMode = Graphics::GpuTimerMode::Queries;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		std::string option = argv[i];
+		if (option == "--frames")
+		{
+			loopSettings.HeadlessFrames = (UINT)std::stoul(argv[i + 1]);
 		}
+		else if (option == "--fps")
+		{
+			double fps = std::stod(argv[i + 1]);
+			loopSettings.TargetFrameTime = (fps > 0.0) ? 1.0 / fps : 0.0;
+		}
+		else if (option == "--trace")
+		{
+			tracePath = argv[i + 1];
+		}
+		else if (option == "--report")
+		{
+			reportInterval = (UINT)std::stoul(argv[i + 1]);
+		}
+		else if (option == "--render-path")
+		{
+			renderPath = (std::string(argv[i + 1]) == "deferred") ? Graphics::RenderPath::Deferred : Graphics::RenderPath::Forward;
+		}
+		else if (option == "--depth-prepass")
+		{
+			depthPrepass = (std::string(argv[i + 1]) == "on");
+		}
+		else if (option == "--shader-cache")
+		{
+			Resource::Manager::SetShaderCache(std::string(argv[i + 1]) != "off");
+		}
+		else if (option == "--texture-arrays")
+		{
+			Resource::Manager::SetTextureArrays(std::string(argv[i + 1]) == "on");
+		}
+		else if (option == "--gpu-timer")
+		{
+			gpuTimerMode = (std::string(argv[i + 1]) == "emulated") ? Graphics::GpuTimerMode::Emulated : Graphics::GpuTimerMode::Queries;
+		}
+		else if (option == "--shader-reload")
+		{
+			Resource::Manager::SetShaderHotReload(std::string(argv[i + 1]) != "off");
+		}
+	}
+
+	Platform::Profiler::SetReportInterval(reportInterval);
+	if (!tracePath.empty())
+	{
+		Platform::Profiler::BeginCapture();
+	}
+
+	Scene scene;
+	scene.Setup();
+	Graphics::Renderer::SetRenderPath(renderPath);
+	Graphics::Renderer::SetDepthPrepass(depthPrepass);
+	Graphics::Renderer::SetGpuTimerMode(gpuTimerMode);
+
+	Platform::GameLoop loop(loopSettings);
+	loop.Run(
+		[&scene](float delta) { scene.Update(delta); },
+		[&scene](float alpha) { scene.Draw(alpha); },
+		[&scene]() { return scene.IsRunning(); });
+
+	// Stops the reload thread while the resource manager and device it
+	// compiles with are still alive
+	Resource::ShaderReloader::Finalize();
+
+	if (loopSettings.HeadlessFrames > 0)
+	{
+		const Platform::GameLoopStatistics& statistics = loop.GetStatistics();
+		std::cout << statistics.Frames << " frames in " << statistics.Seconds << " s, "
+			<< statistics.Seconds * 1000.0 / std::max((UINT64)1, statistics.Frames) << " ms/frame average, "
+			<< statistics.MinFrameTime * 1000.0 << " ms min, " << statistics.MaxFrameTime * 1000.0 << " ms max" << std::endl;
+		Platform::Profiler::PrintSummary(std::cout);
+	}
+
+	if (!tracePath.empty() && Platform::Profiler::EndCapture(tracePath))
+	{
+		std::cout << "Trace written to " << tracePath << std::endl;
 	}
 
 	return 0;
@@ -6,7 +6,66 @@
 using Platform::GPU;
 using Resource::Manager;
 
-Graphics::CommandBuffer::CommandBuffer()
+void Graphics::ResourceSet::SetConstantBuffer(const std::string& name, ID bufferID)
+{
+	Set(name, EntryType::ConstantBuffer, bufferID);
+}
+
+void Graphics::ResourceSet::SetBufferArray(const std::string& name, ID bufferID)
+{
+	Set(name, EntryType::BufferArray, bufferID);
+}
+
+void Graphics::ResourceSet::SetTexture(const std::string& name, ID textureID)
+{
+	Set(name, EntryType::Texture, textureID);
+}
+
+void Graphics::ResourceSet::SetDepthTexture(const std::string& name, ID depthTextureID)
+{
+	Set(name, EntryType::DepthTexture, depthTextureID);
+}
+
+void Graphics::ResourceSet::SetUnorderedAccess(const std::string& name, ID textureID)
+{
+	Set(name, EntryType::UnorderedAccess, textureID);
+}
+
+void Graphics::ResourceSet::SetSampler(const std::string& name, ID samplerID)
+{
+	Set(name, EntryType::Sampler, samplerID);
+}
+
+void Graphics::ResourceSet::Set(const std::string& name, EntryType type, ID resourceID)
+{
+	size_t nameHash = std::hash<std::string>()(name);
+	for (Entry& entry : m_entries)
+	{
+		if (entry.NameHash == nameHash && entry.Name == name)
+		{
+			entry.Type = type;
+			entry.ResourceID = resourceID;
+			return;
+		}
+	}
+
+	m_entries.push_back({ name, nameHash, type, resourceID });
+}
+
+const Graphics::ResourceSet::Entry* Graphics::ResourceSet::Find(const Resource::ShaderBinding& binding) const
+{
+	for (const Entry& entry : m_entries)
+	{
+		if (entry.NameHash == binding.NameHash && entry.Name == binding.Name)
+		{
+			return &entry;
+		}
+	}
+	return nullptr;
+}
+
+Graphics::CommandBuffer::CommandBuffer(GpuTimerMode timerMode) :
+	m_timer(timerMode)
 {
 	//
 }
@@ -104,6 +163,8 @@ void Graphics::CommandBuffer::BindBufferArray(ID bufferID, UINT stages, UINT slo
 			Platform::GPU::Context()->GSSetShaderResources(slot, 1, buffer->SRV.GetAddressOf());
 		if (stages & SHADER_STAGE_PIXEL)
 			Platform::GPU::Context()->PSSetShaderResources(slot, 1, buffer->SRV.GetAddressOf());
+		if (stages & SHADER_STAGE_COMPUTE)
+			Platform::GPU::Context()->CSSetShaderResources(slot, 1, buffer->SRV.GetAddressOf());
 	}
 }
 
@@ -123,6 +184,8 @@ void Graphics::CommandBuffer::BindConstantBuffer(ID bufferID, UINT stages, UINT
 			Platform::GPU::Context()->GSSetConstantBuffers(slot, 1, buffer->Buffer.GetAddressOf());
 		if (stages & SHADER_STAGE_PIXEL)
 			Platform::GPU::Context()->PSSetConstantBuffers(slot, 1, buffer->Buffer.GetAddressOf());
+		if (stages & SHADER_STAGE_COMPUTE)
+			Platform::GPU::Context()->CSSetConstantBuffers(slot, 1, buffer->Buffer.GetAddressOf());
 	}
 }
 
@@ -144,6 +207,25 @@ void Graphics::CommandBuffer::BindRenderTarget(ID textureID, UINT slot, ID depth
 	}
 }
 
+void Graphics::CommandBuffer::BindRenderTargets(const ID* textureIDs, UINT count, ID depthTextureID)
+{
+	ID3D11RenderTargetView* targets[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT] = {};
+	count = std::min(count, (UINT)D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT);
+	for (UINT i = 0; i < count; i++)
+	{
+		auto target = Manager::GetTexture2D(textureIDs[i]);
+		targets[i] = target ? target->RTV.Get() : NULL;
+	}
+
+	auto depth = Manager::GetDepthTexture(depthTextureID);
+	Platform::GPU::Context()->OMSetRenderTargets(count, targets, depth ? depth->DSV.Get() : NULL);
+}
+
+void Graphics::CommandBuffer::UnbindRenderTargets()
+{
+	Platform::GPU::Context()->OMSetRenderTargets(0, NULL, NULL);
+}
+
 void Graphics::CommandBuffer::BindShaderResource(ID textureID, UINT stages, UINT slot)
 {
 	auto texture = Manager::GetTexture2D(textureID);
@@ -160,9 +242,54 @@ void Graphics::CommandBuffer::BindShaderResource(ID textureID, UINT stages, UINT
 			Platform::GPU::Context()->GSSetShaderResources(slot, 1, texture->SRV.GetAddressOf());
 		if (stages & SHADER_STAGE_PIXEL)
 			Platform::GPU::Context()->PSSetShaderResources(slot, 1, texture->SRV.GetAddressOf());
+		if (stages & SHADER_STAGE_COMPUTE)
+			Platform::GPU::Context()->CSSetShaderResources(slot, 1, texture->SRV.GetAddressOf());
+	}
+}
+
+void Graphics::CommandBuffer::BindDepthShaderResource(ID depthTextureID, UINT stages, UINT slot)
+{
+	auto texture = Manager::GetDepthTexture(depthTextureID);
+
+	if (texture && texture->SRV)
+	{
+		if (stages & SHADER_STAGE_PIXEL)
+			Platform::GPU::Context()->PSSetShaderResources(slot, 1, texture->SRV.GetAddressOf());
+		if (stages & SHADER_STAGE_COMPUTE)
+			Platform::GPU::Context()->CSSetShaderResources(slot, 1, texture->SRV.GetAddressOf());
+	}
+}
+
+void Graphics::CommandBuffer::UnbindShaderResources(UINT stages, UINT slot, UINT count)
+{
+	ID3D11ShaderResourceView* views[D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT] = {};
+	count = std::min(count, (UINT)D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT - slot);
+
+	if (stages & SHADER_STAGE_VERTEX)
+		Platform::GPU::Context()->VSSetShaderResources(slot, count, views);
+	if (stages & SHADER_STAGE_PIXEL)
+		Platform::GPU::Context()->PSSetShaderResources(slot, count, views);
+	if (stages & SHADER_STAGE_COMPUTE)
+		Platform::GPU::Context()->CSSetShaderResources(slot, count, views);
+}
+
+void Graphics::CommandBuffer::BindUnorderedAccess(ID textureID, UINT slot)
+{
+	auto texture = Manager::GetTexture2D(textureID);
+
+	if (texture && texture->UAV)
+	{
+		Platform::GPU::Context()->CSSetUnorderedAccessViews(slot, 1, texture->UAV.GetAddressOf(), NULL);
 	}
 }
 
+void Graphics::CommandBuffer::UnbindUnorderedAccess(UINT slot, UINT count)
+{
+	ID3D11UnorderedAccessView* views[D3D11_PS_CS_UAV_REGISTER_COUNT] = {};
+	count = std::min(count, (UINT)D3D11_PS_CS_UAV_REGISTER_COUNT - slot);
+	Platform::GPU::Context()->CSSetUnorderedAccessViews(slot, count, views, NULL);
+}
+
 void Graphics::CommandBuffer::BindSampler(ID samplerID, UINT stages, UINT slot)
 {
 	auto sampler = Manager::GetSampler(samplerID);
@@ -179,21 +306,122 @@ void Graphics::CommandBuffer::BindSampler(ID samplerID, UINT stages, UINT slot)
 			Platform::GPU::Context()->GSSetSamplers(slot, 1, sampler->SamplerState.GetAddressOf());
 		if (stages & SHADER_STAGE_PIXEL)
 			Platform::GPU::Context()->PSSetSamplers(slot, 1, sampler->SamplerState.GetAddressOf());
+		if (stages & SHADER_STAGE_COMPUTE)
+			Platform::GPU::Context()->CSSetSamplers(slot, 1, sampler->SamplerState.GetAddressOf());
 	}
 }
 
+void Graphics::CommandBuffer::BindDepthStencilState(ID stateID)
+{
+	auto state = Manager::GetDepthStencilState(stateID);
+	Platform::GPU::Context()->OMSetDepthStencilState(state ? state->State.Get() : NULL, 0);
+}
+
 void Graphics::CommandBuffer::BindShaderProgram(ID programID)
 {
 	auto shaderProgram = Manager::GetShaderProgram(programID);
 
 	if (shaderProgram)
 	{
+		// Compute programs leave the graphics pipeline alone
+		if (shaderProgram->Stages & SHADER_STAGE_COMPUTE)
+		{
+			GPU::Context()->CSSetShader(shaderProgram->Compute.Get(), NULL, NULL);
+			return;
+		}
+
 		GPU::Context()->IASetInputLayout(shaderProgram->InputLayout.Get());
 		GPU::Context()->VSSetShader(shaderProgram->Vertex.Get(), NULL, NULL);
 		GPU::Context()->PSSetShader(shaderProgram->Pixel.Get(), NULL, NULL);
 	}
 }
 
+void Graphics::CommandBuffer::BindResourceSet(ID programID, const ResourceSet& resources)
+{
+	using Resource::ShaderBindingType;
+	using EntryType = ResourceSet::EntryType;
+
+	auto shaderProgram = Manager::GetShaderProgram(programID);
+	if (!shaderProgram)
+	{
+		return;
+	}
+
+	for (const Resource::ShaderBinding& binding : shaderProgram->Bindings)
+	{
+		const ResourceSet::Entry* entry = resources.Find(binding);
+		if (!entry)
+		{
+			continue;
+		}
+
+		// Otherwise what was bound last stays there
+		if (!entry->ResourceID)
+		{
+			Unbind(binding);
+			continue;
+		}
+
+		switch (entry->Type)
+		{
+		case EntryType::ConstantBuffer:
+			if (binding.Type == ShaderBindingType::ConstantBuffer)
+				BindConstantBuffer(entry->ResourceID, binding.Stages, binding.Slot);
+			break;
+		case EntryType::BufferArray:
+			if (binding.Type == ShaderBindingType::ShaderResource)
+				BindBufferArray(entry->ResourceID, binding.Stages, binding.Slot);
+			break;
+		case EntryType::Texture:
+			if (binding.Type == ShaderBindingType::ShaderResource)
+				BindShaderResource(entry->ResourceID, binding.Stages, binding.Slot);
+			break;
+		case EntryType::DepthTexture:
+			if (binding.Type == ShaderBindingType::ShaderResource)
+				BindDepthShaderResource(entry->ResourceID, binding.Stages, binding.Slot);
+			break;
+		case EntryType::UnorderedAccess:
+			if (binding.Type == ShaderBindingType::UnorderedAccess)
+				BindUnorderedAccess(entry->ResourceID, binding.Slot);
+			break;
+		case EntryType::Sampler:
+			if (binding.Type == ShaderBindingType::Sampler)
+				BindSampler(entry->ResourceID, binding.Stages, binding.Slot);
+			break;
+		}
+	}
+}
+
+void Graphics::CommandBuffer::UnbindResourceSet(ID programID, const ResourceSet& resources)
+{
+	auto shaderProgram = Manager::GetShaderProgram(programID);
+	if (!shaderProgram)
+	{
+		return;
+	}
+
+	for (const Resource::ShaderBinding& binding : shaderProgram->Bindings)
+	{
+		if (resources.Find(binding))
+		{
+			Unbind(binding);
+		}
+	}
+}
+
+void Graphics::CommandBuffer::Unbind(const Resource::ShaderBinding& binding)
+{
+	// Constant buffers and samplers are never written, they can stay bound
+	if (binding.Type == Resource::ShaderBindingType::ShaderResource)
+	{
+		UnbindShaderResources(binding.Stages, binding.Slot, binding.Count);
+	}
+	else if (binding.Type == Resource::ShaderBindingType::UnorderedAccess)
+	{
+		UnbindUnorderedAccess(binding.Slot, binding.Count);
+	}
+}
+
 void Graphics::CommandBuffer::BindViewPort(const D3D11_VIEWPORT& viewPort)
 {
 	GPU::Context()->RSSetViewports(1, &viewPort);
@@ -208,3 +436,28 @@ void Graphics::CommandBuffer::DrawIndexedInstanced(UINT indexCount, UINT indexOf
 {
 	GPU::Context()->DrawIndexedInstanced(indexCount, instanceCount, indexOffset, baseVertexLocation, instanceOffset);
 }
+
+void Graphics::CommandBuffer::Dispatch(UINT groupCountX, UINT groupCountY, UINT groupCountZ)
+{
+	GPU::Context()->Dispatch(groupCountX, groupCountY, groupCountZ);
+}
+
+void Graphics::CommandBuffer::BeginFrameTiming()
+{
+	m_timer.BeginFrame();
+}
+
+void Graphics::CommandBuffer::EndFrameTiming()
+{
+	m_timer.EndFrame();
+}
+
+void Graphics::CommandBuffer::BeginTimingScope(const char* name)
+{
+	m_timer.BeginScope(name);
+}
+
+void Graphics::CommandBuffer::EndTimingScope()
+{
+	m_timer.EndScope();
+}
@@ -0,0 +1,60 @@
+#include "pch.h"
+#include "Graphics/DepthSort.h"
+
+namespace Graphics
+{
+	DepthSort::DepthSort() :
+		m_nearPlane(0.1f),
+		m_scale(0.f),
+		m_offsets(BUCKET_COUNT + 1)
+	{
+		SetRange(0.1f, 1000.f);
+	}
+
+	DepthSort::~DepthSort()
+	{
+	}
+
+	void DepthSort::SetRange(float nearPlane, float farPlane)
+	{
+		m_nearPlane = std::max(nearPlane, 1e-4f);
+		m_scale = BUCKET_COUNT / std::log(std::max(farPlane / m_nearPlane, 1.0001f));
+	}
+
+	UINT DepthSort::GetBucket(float depth) const
+	{
+		if (!(depth > m_nearPlane))
+		{
+			return 0;
+		}
+
+		float bucket = std::log(depth / m_nearPlane) * m_scale;
+		return (bucket < (float)BUCKET_COUNT) ? (UINT)bucket : BUCKET_COUNT - 1;
+	}
+
+	void DepthSort::Sort(const float* depths, size_t count, std::vector<UINT>& order)
+	{
+		static_assert(BUCKET_COUNT <= 65536, "Buckets are kept as 16 bit");
+
+		order.resize(count);
+		m_buckets.resize(count);
+		std::fill(m_offsets.begin(), m_offsets.end(), 0);
+
+		for (size_t i = 0; i < count; i++)
+		{
+			UINT bucket = GetBucket(depths[i]);
+			m_buckets[i] = (uint16_t)bucket;
+			m_offsets[bucket + 1]++;
+		}
+
+		for (UINT bucket = 0; bucket < BUCKET_COUNT; bucket++)
+		{
+			m_offsets[bucket + 1] += m_offsets[bucket];
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			order[m_offsets[m_buckets[i]]++] = (UINT)i;
+		}
+	}
+}
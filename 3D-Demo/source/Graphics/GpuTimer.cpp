@@ -0,0 +1,309 @@
+#include "pch.h"
+#include "Graphics/GpuTimer.h"
+#include "Platform/GPU.h"
+#include "Platform/Profiler.h"
+
+#include <climits>
+
+using Platform::GPU;
+using Platform::Profiler;
+
+namespace
+{
+	// Profiler clock nanoseconds between calibrations
+	const UINT64 CALIBRATION_INTERVAL = 5000000000ull;
+}
+
+namespace Graphics
+{
+	GpuTimer::GpuTimer(GpuTimerMode mode) :
+		m_mode(mode),
+		m_frameIndex(0),
+		m_inFrame(false),
+		m_calibrated(false),
+		m_gpuOrigin(0),
+		m_cpuOrigin(0)
+	{
+		SetMode(mode);
+		m_openScopes.reserve(MAX_SCOPES);
+	}
+
+	GpuTimer::~GpuTimer()
+	{
+		//
+	}
+
+	void GpuTimer::SetMode(GpuTimerMode mode)
+	{
+		m_mode = mode;
+		m_calibrated = false;
+
+		// Scopes hold queries in one mode and CPU times in the other
+		for (Frame& frame : m_frames)
+		{
+			frame.Disjoint.Reset();
+			frame.Scopes.clear();
+			frame.Scopes.reserve(MAX_SCOPES);
+			frame.ScopeCount = 0;
+			frame.Pending = false;
+		}
+
+		if (m_mode == GpuTimerMode::Queries)
+		{
+			D3D11_QUERY_DESC description;
+			ZERO_MEMORY(description);
+			description.Query = D3D11_QUERY_TIMESTAMP_DISJOINT;
+
+			for (Frame& frame : m_frames)
+			{
+				if (FAILED(GPU::Device()->CreateQuery(&description, frame.Disjoint.GetAddressOf())))
+				{
+					m_mode = GpuTimerMode::Emulated;
+					break;
+				}
+			}
+		}
+	}
+
+	void GpuTimer::BeginFrame()
+	{
+		Frame& frame = m_frames[m_frameIndex];
+
+		// Only waits when the GPU is more than FRAME_LATENCY frames behind
+		if (frame.Pending)
+		{
+			Resolve(frame, true);
+		}
+
+		frame.ScopeCount = 0;
+		m_openScopes.clear();
+		m_inFrame = true;
+
+		if (!IsEmulated())
+		{
+			GPU::Context()->Begin(frame.Disjoint.Get());
+		}
+
+		BeginScope("Frame");
+	}
+
+	void GpuTimer::EndFrame()
+	{
+		if (!m_inFrame)
+		{
+			return;
+		}
+
+		// Scopes left open end with the frame
+		while (!m_openScopes.empty())
+		{
+			EndScope();
+		}
+
+		Frame& frame = m_frames[m_frameIndex];
+		if (!IsEmulated())
+		{
+			GPU::Context()->End(frame.Disjoint.Get());
+		}
+		frame.Pending = true;
+		m_inFrame = false;
+		m_frameIndex = (m_frameIndex + 1) % FRAME_LATENCY;
+
+		if (IsEmulated())
+		{
+			// Reported when the frame is reused, as late as real queries can be
+			return;
+		}
+
+		// Oldest first, frames finish in order
+		for (UINT i = 0; i < FRAME_LATENCY; i++)
+		{
+			Frame& oldest = m_frames[(m_frameIndex + i) % FRAME_LATENCY];
+			if (oldest.Pending && !Resolve(oldest, false))
+			{
+				break;
+			}
+		}
+	}
+
+	void GpuTimer::BeginScope(const char* name)
+	{
+		Frame& frame = m_frames[m_frameIndex];
+		if (!m_inFrame || frame.ScopeCount >= MAX_SCOPES)
+		{
+			// Still pushed, so the matching EndScope pops it
+			m_openScopes.push_back(UINT_MAX);
+			return;
+		}
+
+		if (frame.ScopeCount == frame.Scopes.size())
+		{
+			frame.Scopes.emplace_back();
+			if (!IsEmulated() && !CreateQueries(frame.Scopes.back()))
+			{
+				frame.Scopes.pop_back();
+				m_openScopes.push_back(UINT_MAX);
+				return;
+			}
+		}
+
+		UINT index = frame.ScopeCount++;
+		Scope& scope = frame.Scopes[index];
+		scope.Name = name;
+		m_openScopes.push_back(index);
+
+		if (IsEmulated())
+		{
+			scope.Begin = Profiler::Now();
+		}
+		else
+		{
+			GPU::Context()->End(scope.BeginQuery.Get());
+		}
+	}
+
+	void GpuTimer::EndScope()
+	{
+		if (m_openScopes.empty())
+		{
+			return;
+		}
+
+		UINT index = m_openScopes.back();
+		m_openScopes.pop_back();
+		if (index == UINT_MAX)
+		{
+			return;
+		}
+
+		Scope& scope = m_frames[m_frameIndex].Scopes[index];
+		if (IsEmulated())
+		{
+			scope.End = Profiler::Now();
+		}
+		else
+		{
+			GPU::Context()->End(scope.EndQuery.Get());
+		}
+	}
+
+	bool GpuTimer::CreateQueries(Scope& scope)
+	{
+		D3D11_QUERY_DESC description;
+		ZERO_MEMORY(description);
+		description.Query = D3D11_QUERY_TIMESTAMP;
+
+		return SUCCEEDED(GPU::Device()->CreateQuery(&description, scope.BeginQuery.GetAddressOf()))
+			&& SUCCEEDED(GPU::Device()->CreateQuery(&description, scope.EndQuery.GetAddressOf()));
+	}
+
+	bool GpuTimer::Resolve(Frame& frame, bool wait)
+	{
+		if (IsEmulated())
+		{
+			for (UINT i = 0; i < frame.ScopeCount; i++)
+			{
+				Profiler::RecordGpuZone(frame.Scopes[i].Name, frame.Scopes[i].Begin, frame.Scopes[i].End);
+			}
+			frame.Pending = false;
+			return true;
+		}
+
+		// The disjoint query ends after every timestamp of the frame
+		D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+		UINT flags = wait ? 0 : D3D11_ASYNC_GETDATA_DONOTFLUSH;
+		HRESULT result;
+		while ((result = GPU::Context()->GetData(frame.Disjoint.Get(), &disjoint, sizeof(disjoint), flags)) == S_FALSE)
+		{
+			if (!wait)
+			{
+				return false;
+			}
+			std::this_thread::yield();
+		}
+		frame.Pending = false;
+
+		// The clock changed during the frame, its times mean nothing
+		if (FAILED(result) || disjoint.Disjoint || disjoint.Frequency == 0)
+		{
+			m_calibrated = false;
+			return true;
+		}
+
+		if (!m_calibrated || Profiler::Now() - m_cpuOrigin >= CALIBRATION_INTERVAL)
+		{
+			Calibrate();
+		}
+
+		if (!m_calibrated)
+		{
+			return true;
+		}
+
+		for (UINT i = 0; i < frame.ScopeCount; i++)
+		{
+			const Scope& scope = frame.Scopes[i];
+			UINT64 begin = 0;
+			UINT64 end = 0;
+			if (GPU::Context()->GetData(scope.BeginQuery.Get(), &begin, sizeof(begin), 0) == S_OK
+				&& GPU::Context()->GetData(scope.EndQuery.Get(), &end, sizeof(end), 0) == S_OK)
+			{
+				Profiler::RecordGpuZone(scope.Name, ToCpuTime(begin, disjoint.Frequency), ToCpuTime(end, disjoint.Frequency));
+			}
+		}
+		return true;
+	}
+
+	void GpuTimer::Calibrate()
+	{
+		// One stall: a timestamp is flushed and waited for, the CPU time it
+		// arrives at stands for the GPU time it holds. Never called inside a
+		// frame's disjoint query, the timestamp gets one of its own.
+		D3D11_QUERY_DESC description;
+		ZERO_MEMORY(description);
+		description.Query = D3D11_QUERY_TIMESTAMP;
+
+		ComPtr<ID3D11Query> timestamp;
+		if (FAILED(GPU::Device()->CreateQuery(&description, timestamp.GetAddressOf())))
+		{
+			return;
+		}
+
+		description.Query = D3D11_QUERY_TIMESTAMP_DISJOINT;
+		ComPtr<ID3D11Query> disjoint;
+		if (FAILED(GPU::Device()->CreateQuery(&description, disjoint.GetAddressOf())))
+		{
+			return;
+		}
+
+		GPU::Context()->Begin(disjoint.Get());
+		GPU::Context()->End(timestamp.Get());
+		GPU::Context()->End(disjoint.Get());
+		GPU::Context()->Flush();
+
+		UINT64 ticks = 0;
+		while (GPU::Context()->GetData(timestamp.Get(), &ticks, sizeof(ticks), 0) == S_FALSE)
+		{
+			std::this_thread::yield();
+		}
+		UINT64 cpuTime = Profiler::Now();
+
+		D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjointData;
+		HRESULT result;
+		while ((result = GPU::Context()->GetData(disjoint.Get(), &disjointData, sizeof(disjointData), 0)) == S_FALSE)
+		{
+			std::this_thread::yield();
+		}
+
+		// Tried again with the next frame
+		if (FAILED(result) || disjointData.Disjoint)
+		{
+			m_calibrated = false;
+			return;
+		}
+
+		m_cpuOrigin = cpuTime;
+		m_gpuOrigin = ticks;
+		m_calibrated = true;
+	}
+}
@@ -0,0 +1,189 @@
+#include "pch.h"
+#include "Graphics/InstanceBuckets.h"
+#include "Platform/JobSystem.h"
+
+namespace
+{
+	// Submissions per chunk of the bulk path, each chunk bins on its own
+	const size_t SUBMISSIONS_PER_CHUNK = 16384;
+}
+
+namespace Graphics
+{
+	InstanceBuckets::InstanceBuckets() :
+		m_parallelThreshold(2 * SUBMISSIONS_PER_CHUNK),
+		m_lastMeshID(0),
+		m_lastBucket(NO_BUCKET)
+	{
+	}
+
+	InstanceBuckets::~InstanceBuckets()
+	{
+	}
+
+	void InstanceBuckets::Add(ID meshID, const DirectX::XMFLOAT4X4& worldTransposed)
+	{
+		Resource::ObjectBufferData data;
+		data.World = worldTransposed;
+		m_buckets[GetOrCreateBucket(meshID)].Instances.push_back(data);
+	}
+
+	void InstanceBuckets::Add(const InstanceSubmission* submissions, size_t count)
+	{
+		if (count == 0)
+		{
+			return;
+		}
+
+		// Counting first only pays off when the chunks run in parallel
+		size_t chunkCount = (count + SUBMISSIONS_PER_CHUNK - 1) / SUBMISSIONS_PER_CHUNK;
+		if (m_parallelThreshold == 0 || count < m_parallelThreshold || chunkCount < 2)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				Add(submissions[i].MeshID, submissions[i].WorldTransposed);
+			}
+			return;
+		}
+
+		size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+		auto forEachChunk = [&](const std::function<void(size_t, size_t, size_t)>& task) {
+			Platform::JobSystem::ParallelFor(chunkCount, [&](size_t chunk) {
+				task(chunk, chunk * chunkSize, std::min(count, (chunk + 1) * chunkSize));
+			});
+		};
+
+		m_submissionBuckets.resize(count);
+		if (m_chunkCounts.size() < chunkCount)
+		{
+			m_chunkCounts.resize(chunkCount);
+			m_chunkMissing.resize(chunkCount);
+		}
+
+		// 1. Every chunk finds the buckets of its submissions and counts them.
+		//    The bucket table is only read here.
+		size_t bucketCount = m_buckets.size();
+		forEachChunk([&](size_t chunk, size_t begin, size_t end) {
+			std::vector<uint32_t>& counts = m_chunkCounts[chunk];
+			std::vector<size_t>& missing = m_chunkMissing[chunk];
+			counts.assign(bucketCount, 0);
+			missing.clear();
+
+			ID lastMeshID = 0;
+			uint32_t lastBucket = NO_BUCKET;
+			for (size_t i = begin; i < end; i++)
+			{
+				ID meshID = submissions[i].MeshID;
+				uint32_t bucket = (meshID == lastMeshID && lastBucket != NO_BUCKET) ? lastBucket : FindBucket(meshID);
+				m_submissionBuckets[i] = bucket;
+
+				if (bucket == NO_BUCKET)
+				{
+					missing.push_back(i);
+					continue;
+				}
+
+				counts[bucket]++;
+				lastMeshID = meshID;
+				lastBucket = bucket;
+			}
+		});
+
+		// 2. New meshes get their buckets, then a prefix sum over the chunks turns
+		//    the counts into the offset each chunk writes its instances to
+		for (size_t chunk = 0; chunk < chunkCount; chunk++)
+		{
+			for (size_t i : m_chunkMissing[chunk])
+			{
+				m_submissionBuckets[i] = GetOrCreateBucket(submissions[i].MeshID);
+			}
+		}
+
+		bucketCount = m_buckets.size();
+		for (size_t chunk = 0; chunk < chunkCount; chunk++)
+		{
+			std::vector<uint32_t>& counts = m_chunkCounts[chunk];
+			counts.resize(bucketCount, 0);
+			for (size_t i : m_chunkMissing[chunk])
+			{
+				counts[m_submissionBuckets[i]]++;
+			}
+		}
+
+		for (size_t bucket = 0; bucket < bucketCount; bucket++)
+		{
+			std::vector<Resource::ObjectBufferData>& instances = m_buckets[bucket].Instances;
+
+			size_t offset = instances.size();
+			for (size_t chunk = 0; chunk < chunkCount; chunk++)
+			{
+				uint32_t chunkCountInBucket = m_chunkCounts[chunk][bucket];
+				m_chunkCounts[chunk][bucket] = (uint32_t)offset;
+				offset += chunkCountInBucket;
+			}
+			instances.resize(offset);
+		}
+
+		// 3. Every chunk copies its instances to its own ranges
+		forEachChunk([&](size_t chunk, size_t begin, size_t end) {
+			std::vector<uint32_t>& offsets = m_chunkCounts[chunk];
+			for (size_t i = begin; i < end; i++)
+			{
+				uint32_t bucket = m_submissionBuckets[i];
+				m_buckets[bucket].Instances[offsets[bucket]++].World = submissions[i].WorldTransposed;
+			}
+		});
+	}
+
+	Resource::ObjectBufferData* InstanceBuckets::Append(ID meshID, size_t count)
+	{
+		std::vector<Resource::ObjectBufferData>& instances = m_buckets[GetOrCreateBucket(meshID)].Instances;
+		size_t first = instances.size();
+		instances.resize(first + count);
+		return instances.data() + first;
+	}
+
+	void InstanceBuckets::Clear()
+	{
+		for (Bucket& bucket : m_buckets)
+		{
+			bucket.Instances.clear();
+		}
+	}
+
+	size_t InstanceBuckets::GetInstanceCount() const
+	{
+		size_t count = 0;
+		for (const Bucket& bucket : m_buckets)
+		{
+			count += bucket.Instances.size();
+		}
+		return count;
+	}
+
+	uint32_t InstanceBuckets::FindBucket(ID meshID) const
+	{
+		auto bucket = m_bucketIndices.find(meshID);
+		return (bucket != m_bucketIndices.end()) ? bucket->second : NO_BUCKET;
+	}
+
+	uint32_t InstanceBuckets::GetOrCreateBucket(ID meshID)
+	{
+		if (meshID == m_lastMeshID && m_lastBucket != NO_BUCKET)
+		{
+			return m_lastBucket;
+		}
+
+		uint32_t bucket = FindBucket(meshID);
+		if (bucket == NO_BUCKET)
+		{
+			bucket = (uint32_t)m_buckets.size();
+			m_buckets.push_back({ meshID, {} });
+			m_bucketIndices[meshID] = bucket;
+		}
+
+		m_lastMeshID = meshID;
+		m_lastBucket = bucket;
+		return bucket;
+	}
+}
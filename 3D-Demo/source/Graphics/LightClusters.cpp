@@ -0,0 +1,283 @@
+#include "pch.h"
+#include "Graphics/LightClusters.h"
+#include "Platform/JobSystem.h"
+
+#include <climits>
+#include <immintrin.h>
+
+namespace
+{
+	// Padding lights sit far away with no radius, so they fail every test
+	const float FAR_AWAY = 1e18f;
+
+	// Bit i of the result is set if light i of the four touches the box
+	inline int TestSpheres(const float* x, const float* y, const float* z, const float* radius,
+		__m128 minX, __m128 minY, __m128 minZ, __m128 maxX, __m128 maxY, __m128 maxZ)
+	{
+		const __m128 zero = _mm_setzero_ps();
+
+		__m128 centerX = _mm_loadu_ps(x);
+		__m128 centerY = _mm_loadu_ps(y);
+		__m128 centerZ = _mm_loadu_ps(z);
+		__m128 r = _mm_loadu_ps(radius);
+
+		// Distance from the center to the closest point of the box, per axis
+		__m128 dx = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(minX, centerX), _mm_sub_ps(centerX, maxX)));
+		__m128 dy = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(minY, centerY), _mm_sub_ps(centerY, maxY)));
+		__m128 dz = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(minZ, centerZ), _mm_sub_ps(centerZ, maxZ)));
+
+		__m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		return _mm_movemask_ps(_mm_cmple_ps(distanceSquared, _mm_mul_ps(r, r)));
+	}
+}
+
+namespace Graphics
+{
+	void LightClusters::LightSoA::Clear()
+	{
+		X.clear();
+		Y.clear();
+		Z.clear();
+		Radius.clear();
+		Index.clear();
+	}
+
+	void LightClusters::LightSoA::Push(float x, float y, float z, float radius, UINT index)
+	{
+		X.push_back(x);
+		Y.push_back(y);
+		Z.push_back(z);
+		Radius.push_back(radius);
+		Index.push_back(index);
+	}
+
+	void LightClusters::LightSoA::Pad()
+	{
+		while (X.size() % 4 != 0)
+		{
+			Push(FAR_AWAY, FAR_AWAY, FAR_AWAY, 0.f, UINT_MAX);
+		}
+	}
+
+	LightClusters::LightClusters() :
+		m_slices(GRID_Z),
+		m_bounds(CLUSTER_COUNT),
+		m_rowBounds(GRID_Y * GRID_Z),
+		m_view(),
+		m_boundsValid(false),
+		m_clusters(CLUSTER_COUNT)
+	{
+	}
+
+	LightClusters::~LightClusters()
+	{
+	}
+
+	void LightClusters::Build(const ClusterView& view, const Resource::PointLight* lights, size_t lightCount, bool parallel)
+	{
+		using namespace DirectX;
+
+		UpdateBounds(view);
+
+		// To view space
+		XMMATRIX viewMatrix = XMLoadFloat4x4(&view.View);
+		m_lights.Clear();
+		for (size_t i = 0; i < lightCount; i++)
+		{
+			XMFLOAT3 position;
+			XMStoreFloat3(&position, XMVector3TransformCoord(XMLoadFloat3(&lights[i].Position), viewMatrix));
+			m_lights.Push(position.x, position.y, position.z, lights[i].Radius, (UINT)i);
+		}
+		m_lights.Pad();
+
+		if (parallel)
+		{
+			Platform::JobSystem::ParallelFor(GRID_Z, [this](size_t z) { BinSlice((UINT)z); });
+		}
+		else
+		{
+			for (UINT z = 0; z < GRID_Z; z++)
+			{
+				BinSlice(z);
+			}
+		}
+
+		// Slices one after another into one list
+		m_lightIndices.clear();
+		UINT cluster = 0;
+		for (const Slice& slice : m_slices)
+		{
+			UINT sliceOffset = 0;
+			for (UINT tile = 0; tile < GRID_X * GRID_Y; tile++, cluster++)
+			{
+				UINT count = std::min(slice.Counts[tile], MAX_LIGHT_INDICES - (UINT)m_lightIndices.size());
+				m_clusters[cluster].Offset = (UINT)m_lightIndices.size();
+				m_clusters[cluster].Count = count;
+				m_lightIndices.insert(m_lightIndices.end(), slice.Indices.begin() + sliceOffset, slice.Indices.begin() + sliceOffset + count);
+				sliceOffset += slice.Counts[tile];
+			}
+		}
+
+		// At least one element, empty buffers cannot be bound
+		m_lightIndices.resize(std::max((size_t)4, (m_lightIndices.size() + 3) & ~(size_t)3), 0);
+	}
+
+	void LightClusters::BinSlice(UINT z)
+	{
+		Slice& slice = m_slices[z];
+		slice.Indices.clear();
+
+		// Lights overlapping the depth of the slice
+		const float nearDepth = m_sliceDepths[z];
+		const float farDepth = m_sliceDepths[z + 1];
+		slice.Candidates.Clear();
+		{
+			__m128 minZ = _mm_set1_ps(nearDepth);
+			__m128 maxZ = _mm_set1_ps(farDepth);
+			for (size_t i = 0; i < m_lights.Size(); i += 4)
+			{
+				__m128 z = _mm_loadu_ps(&m_lights.Z[i]);
+				__m128 r = _mm_loadu_ps(&m_lights.Radius[i]);
+				int mask = _mm_movemask_ps(_mm_and_ps(_mm_cmpge_ps(_mm_add_ps(z, r), minZ), _mm_cmple_ps(_mm_sub_ps(z, r), maxZ)));
+				for (size_t lane = i; mask; lane++, mask >>= 1)
+				{
+					if (mask & 1)
+					{
+						slice.Candidates.Push(m_lights.X[lane], m_lights.Y[lane], m_lights.Z[lane], m_lights.Radius[lane], m_lights.Index[lane]);
+					}
+				}
+			}
+		}
+		slice.Candidates.Pad();
+
+		for (UINT y = 0; y < GRID_Y; y++)
+		{
+			// Then the ones touching the row
+			const Bounds& row = m_rowBounds[y + z * GRID_Y];
+			{
+				__m128 minX = _mm_set1_ps(row.MinX), minY = _mm_set1_ps(row.MinY), minZ = _mm_set1_ps(row.MinZ);
+				__m128 maxX = _mm_set1_ps(row.MaxX), maxY = _mm_set1_ps(row.MaxY), maxZ = _mm_set1_ps(row.MaxZ);
+
+				const LightSoA& candidates = slice.Candidates;
+				slice.RowCandidates.Clear();
+				for (size_t i = 0; i < candidates.Size(); i += 4)
+				{
+					int mask = TestSpheres(&candidates.X[i], &candidates.Y[i], &candidates.Z[i], &candidates.Radius[i], minX, minY, minZ, maxX, maxY, maxZ);
+					for (size_t lane = i; mask; lane++, mask >>= 1)
+					{
+						if (mask & 1)
+						{
+							slice.RowCandidates.Push(candidates.X[lane], candidates.Y[lane], candidates.Z[lane], candidates.Radius[lane], candidates.Index[lane]);
+						}
+					}
+				}
+				slice.RowCandidates.Pad();
+			}
+
+			// And finally the ones touching each cluster of the row
+			const LightSoA& candidates = slice.RowCandidates;
+			for (UINT x = 0; x < GRID_X; x++)
+			{
+				const Bounds& bounds = m_bounds[x + y * GRID_X + z * GRID_X * GRID_Y];
+				__m128 minX = _mm_set1_ps(bounds.MinX), minY = _mm_set1_ps(bounds.MinY), minZ = _mm_set1_ps(bounds.MinZ);
+				__m128 maxX = _mm_set1_ps(bounds.MaxX), maxY = _mm_set1_ps(bounds.MaxY), maxZ = _mm_set1_ps(bounds.MaxZ);
+
+				UINT count = 0;
+				for (size_t i = 0; i < candidates.Size() && count < MAX_LIGHTS_PER_CLUSTER; i += 4)
+				{
+					int mask = TestSpheres(&candidates.X[i], &candidates.Y[i], &candidates.Z[i], &candidates.Radius[i], minX, minY, minZ, maxX, maxY, maxZ);
+					for (size_t lane = i; mask && count < MAX_LIGHTS_PER_CLUSTER; lane++, mask >>= 1)
+					{
+						if (mask & 1)
+						{
+							slice.Indices.push_back(candidates.Index[lane]);
+							count++;
+						}
+					}
+				}
+				slice.Counts[x + y * GRID_X] = count;
+			}
+		}
+	}
+
+	void LightClusters::UpdateBounds(const ClusterView& view)
+	{
+		if (m_boundsValid && view.FOV == m_view.FOV && view.AspectRatio == m_view.AspectRatio
+			&& view.NearPlane == m_view.NearPlane && view.FarPlane == m_view.FarPlane)
+		{
+			m_view.View = view.View;
+			return;
+		}
+		m_view = view;
+		m_boundsValid = true;
+
+		for (UINT z = 0; z <= GRID_Z; z++)
+		{
+			m_sliceDepths[z] = view.NearPlane * std::pow(view.FarPlane / view.NearPlane, (float)z / GRID_Z);
+		}
+
+		// View space x and y grow linearly with depth, the corners of a cluster
+		// are at the near and far depth of its slice
+		const float tanY = std::tan(view.FOV * 0.5f);
+		const float tanX = tanY * view.AspectRatio;
+
+		for (UINT z = 0; z < GRID_Z; z++)
+		{
+			const float nearDepth = m_sliceDepths[z];
+			const float farDepth = m_sliceDepths[z + 1];
+
+			for (UINT y = 0; y < GRID_Y; y++)
+			{
+				// Rows count from the top of the screen
+				float top = 1.f - 2.f * y / GRID_Y;
+				float bottom = 1.f - 2.f * (y + 1) / GRID_Y;
+
+				Bounds& row = m_rowBounds[y + z * GRID_Y];
+				row.MinX = -tanX * farDepth;
+				row.MaxX = tanX * farDepth;
+				row.MinY = std::min(bottom * nearDepth, bottom * farDepth) * tanY;
+				row.MaxY = std::max(top * nearDepth, top * farDepth) * tanY;
+				row.MinZ = nearDepth;
+				row.MaxZ = farDepth;
+
+				for (UINT x = 0; x < GRID_X; x++)
+				{
+					float left = -1.f + 2.f * x / GRID_X;
+					float right = -1.f + 2.f * (x + 1) / GRID_X;
+
+					Bounds& bounds = m_bounds[x + y * GRID_X + z * GRID_X * GRID_Y];
+					bounds.MinX = std::min(left * nearDepth, left * farDepth) * tanX;
+					bounds.MaxX = std::max(right * nearDepth, right * farDepth) * tanX;
+					bounds.MinY = row.MinY;
+					bounds.MaxY = row.MaxY;
+					bounds.MinZ = nearDepth;
+					bounds.MaxZ = farDepth;
+				}
+			}
+		}
+	}
+
+	Resource::ClusterBufferData LightClusters::GetBufferData(const D3D11_VIEWPORT& viewPort, UINT lightCount) const
+	{
+		Resource::ClusterBufferData data;
+		ZERO_MEMORY(data);
+
+		float logRatio = std::log(m_view.FarPlane / m_view.NearPlane);
+		data.ScreenOffset = { viewPort.TopLeftX, viewPort.TopLeftY };
+		data.ScreenScale = { GRID_X / viewPort.Width, GRID_Y / viewPort.Height };
+		data.DepthScale = GRID_Z / logRatio;
+		data.DepthBias = -GRID_Z * std::log(m_view.NearPlane) / logRatio;
+		data.GridX = GRID_X;
+		data.GridY = GRID_Y;
+		data.GridZ = GRID_Z;
+		data.LightCount = lightCount;
+		return data;
+	}
+
+	void LightClusters::GetClusterBounds(UINT cluster, DirectX::XMFLOAT3& minimum, DirectX::XMFLOAT3& maximum) const
+	{
+		const Bounds& bounds = m_bounds[cluster];
+		minimum = { bounds.MinX, bounds.MinY, bounds.MinZ };
+		maximum = { bounds.MaxX, bounds.MaxY, bounds.MaxZ };
+	}
+}
@@ -0,0 +1,496 @@
+#include "pch.h"
+#include "Graphics/RenderGraph.h"
+#include "Resource/ResourceManager.h"
+
+using Resource::Manager;
+
+namespace
+{
+	const UINT ALL_SHADER_STAGES = SHADER_STAGE_VERTEX | SHADER_STAGE_PIXEL | SHADER_STAGE_COMPUTE;
+}
+
+namespace Graphics
+{
+	size_t RenderResourceDesc::GetSize() const
+	{
+		return (size_t)Width * Height * Stride;
+	}
+
+	bool RenderResourceDesc::operator==(const RenderResourceDesc& other) const
+	{
+		return Type == other.Type && Width == other.Width && Height == other.Height
+			&& Format == other.Format && Stride == other.Stride;
+	}
+
+	RenderResourceDesc RenderResourceDesc::Texture(UINT width, UINT height, DXGI_FORMAT format, UINT texelStride)
+	{
+		RenderResourceDesc desc;
+		desc.Type = RenderResourceType::Texture;
+		desc.Width = width;
+		desc.Height = height;
+		desc.Format = format;
+		desc.Stride = texelStride;
+		return desc;
+	}
+
+	RenderResourceDesc RenderResourceDesc::Depth(UINT width, UINT height)
+	{
+		RenderResourceDesc desc;
+		desc.Type = RenderResourceType::DepthTexture;
+		desc.Width = width;
+		desc.Height = height;
+		desc.Format = DXGI_FORMAT_R32_TYPELESS;
+		desc.Stride = 4;
+		return desc;
+	}
+
+	RenderResourceDesc RenderResourceDesc::Buffer(UINT elementCount, UINT elementStride)
+	{
+		RenderResourceDesc desc;
+		desc.Type = RenderResourceType::Buffer;
+		desc.Width = elementCount;
+		desc.Height = 1;
+		desc.Stride = elementStride;
+		return desc;
+	}
+
+	RenderResource RenderGraphBuilder::Create(const char* name, const RenderResourceDesc& desc)
+	{
+		RenderGraph::VirtualResource resource;
+		resource.Name = name;
+		resource.Desc = desc;
+		m_graph.m_resources.push_back(resource);
+
+		RenderGraph::Node node;
+		node.Resource = (UINT)m_graph.m_resources.size() - 1;
+		m_graph.m_nodes.push_back(node);
+
+		return { (UINT)m_graph.m_nodes.size() - 1 };
+	}
+
+	RenderResource RenderGraphBuilder::Read(RenderResource resource, RenderResourceUsage usage)
+	{
+		assert(resource.IsValid() && resource.Node < m_graph.m_nodes.size());
+		m_graph.m_passes[m_pass].Reads.push_back({ resource.Node, usage });
+		return resource;
+	}
+
+	RenderResource RenderGraphBuilder::Write(RenderResource resource, RenderResourceUsage usage)
+	{
+		assert(resource.IsValid() && resource.Node < m_graph.m_nodes.size());
+
+		// Writes land on top of the previous version, blending and depth
+		// testing read it, so its producer is kept alive too
+		m_graph.m_passes[m_pass].Reads.push_back({ resource.Node, usage });
+
+		RenderGraph::Node node;
+		node.Resource = m_graph.m_nodes[resource.Node].Resource;
+		node.Producer = m_pass;
+		m_graph.m_nodes.push_back(node);
+
+		RenderResource written = { (UINT)m_graph.m_nodes.size() - 1 };
+		m_graph.m_passes[m_pass].Writes.push_back({ written.Node, usage });
+		return written;
+	}
+
+	void RenderGraphBuilder::SetSideEffect()
+	{
+		m_graph.m_passes[m_pass].SideEffect = true;
+	}
+
+	ID RenderPassResources::Get(RenderResource resource) const
+	{
+		const RenderGraph::VirtualResource& virtualResource = m_graph.m_resources[m_graph.m_nodes[resource.Node].Resource];
+		if (virtualResource.ImportedID)
+		{
+			return virtualResource.ImportedID;
+		}
+		if (virtualResource.Physical == UINT_MAX)
+		{
+			return 0;
+		}
+
+		UINT pooled = m_graph.m_physical[virtualResource.Physical].Pooled;
+		return (pooled != UINT_MAX) ? m_graph.m_pool[pooled].ResourceID : 0;
+	}
+
+	RenderGraph::RenderGraph() :
+		m_compiled(false)
+	{
+		//
+	}
+
+	RenderGraph::~RenderGraph()
+	{
+		//
+	}
+
+	RenderResource RenderGraph::Import(const char* name, ID resourceID, const RenderResourceDesc& desc)
+	{
+		VirtualResource resource;
+		resource.Name = name;
+		resource.Desc = desc;
+		resource.ImportedID = resourceID;
+		m_resources.push_back(resource);
+
+		Node node;
+		node.Resource = (UINT)m_resources.size() - 1;
+		m_nodes.push_back(node);
+
+		m_compiled = false;
+		return { (UINT)m_nodes.size() - 1 };
+	}
+
+	void RenderGraph::AddPass(const char* name, const SetupFunction& setup, ExecuteFunction execute)
+	{
+		m_passes.emplace_back();
+		m_passes.back().Name = name;
+		m_passes.back().Execute = std::move(execute);
+
+		RenderGraphBuilder builder(*this, (UINT)m_passes.size() - 1);
+		setup(builder);
+
+		m_compiled = false;
+	}
+
+	void RenderGraph::Reset()
+	{
+		m_passes.clear();
+		m_resources.clear();
+		m_nodes.clear();
+		m_physical.clear();
+		m_compiled = false;
+	}
+
+	void RenderGraph::Compile(bool aliasing)
+	{
+		m_statistics = RenderGraphStatistics();
+		m_statistics.Passes = (UINT)m_passes.size();
+
+		Cull();
+		ComputeLifetimes();
+		AssignPhysicalResources(aliasing);
+		RecordBarriers();
+
+		m_compiled = true;
+	}
+
+	void RenderGraph::Cull()
+	{
+		// Every pass is referenced once per version it writes, a version once
+		// per pass reading it. Versions nobody reads release their producer,
+		// producers left without references are culled and release their inputs.
+		for (Node& node : m_nodes)
+		{
+			node.Readers = 0;
+		}
+
+		for (Pass& pass : m_passes)
+		{
+			pass.Culled = false;
+			pass.References = (UINT)pass.Writes.size() + (pass.SideEffect ? 1 : 0);
+			for (const Access& write : pass.Writes)
+			{
+				// Results leaving the graph are always needed
+				pass.References += m_resources[m_nodes[write.Node].Resource].ImportedID ? 1 : 0;
+			}
+			for (const Access& read : pass.Reads)
+			{
+				m_nodes[read.Node].Readers++;
+			}
+		}
+
+		m_stack.clear();
+		for (UINT node = 0; node < (UINT)m_nodes.size(); node++)
+		{
+			if (m_nodes[node].Readers == 0)
+			{
+				m_stack.push_back(node);
+			}
+		}
+
+		// Passes without outputs do nothing anyone could see
+		for (Pass& pass : m_passes)
+		{
+			if (pass.References == 0)
+			{
+				pass.Culled = true;
+				m_statistics.CulledPasses++;
+				for (const Access& read : pass.Reads)
+				{
+					if (--m_nodes[read.Node].Readers == 0)
+					{
+						m_stack.push_back(read.Node);
+					}
+				}
+			}
+		}
+
+		while (!m_stack.empty())
+		{
+			UINT producer = m_nodes[m_stack.back()].Producer;
+			m_stack.pop_back();
+			if (producer == UINT_MAX)
+			{
+				continue;
+			}
+
+			Pass& pass = m_passes[producer];
+			if (--pass.References > 0)
+			{
+				continue;
+			}
+
+			pass.Culled = true;
+			m_statistics.CulledPasses++;
+			for (const Access& read : pass.Reads)
+			{
+				if (--m_nodes[read.Node].Readers == 0)
+				{
+					m_stack.push_back(read.Node);
+				}
+			}
+		}
+	}
+
+	void RenderGraph::ComputeLifetimes()
+	{
+		for (VirtualResource& resource : m_resources)
+		{
+			resource.FirstPass = UINT_MAX;
+			resource.LastPass = 0;
+			resource.Physical = UINT_MAX;
+		}
+
+		for (UINT i = 0; i < (UINT)m_passes.size(); i++)
+		{
+			const Pass& pass = m_passes[i];
+			if (pass.Culled)
+			{
+				continue;
+			}
+
+			for (const std::vector<Access>* accesses : { &pass.Reads, &pass.Writes })
+			{
+				for (const Access& access : *accesses)
+				{
+					VirtualResource& resource = m_resources[m_nodes[access.Node].Resource];
+					resource.FirstPass = std::min(resource.FirstPass, i);
+					resource.LastPass = std::max(resource.LastPass, i);
+				}
+			}
+		}
+	}
+
+	void RenderGraph::AssignPhysicalResources(bool aliasing)
+	{
+		m_physical.clear();
+
+		// Transient resources in the order they come alive
+		m_order.clear();
+		for (UINT i = 0; i < (UINT)m_resources.size(); i++)
+		{
+			if (!m_resources[i].ImportedID && m_resources[i].FirstPass != UINT_MAX)
+			{
+				m_order.push_back(i);
+			}
+		}
+		std::stable_sort(m_order.begin(), m_order.end(), [this](UINT a, UINT b) {
+			return m_resources[a].FirstPass < m_resources[b].FirstPass;
+		});
+
+		for (UINT index : m_order)
+		{
+			VirtualResource& resource = m_resources[index];
+			m_statistics.TransientResources++;
+			m_statistics.TransientBytes += resource.Desc.GetSize();
+
+			// A physical resource is free again once its last user has run
+			UINT physical = UINT_MAX;
+			for (UINT i = 0; aliasing && i < (UINT)m_physical.size(); i++)
+			{
+				if (m_physical[i].LastPass < resource.FirstPass && m_physical[i].Desc == resource.Desc)
+				{
+					physical = i;
+					break;
+				}
+			}
+
+			if (physical == UINT_MAX)
+			{
+				PhysicalResource created;
+				created.Desc = resource.Desc;
+				m_physical.push_back(created);
+				physical = (UINT)m_physical.size() - 1;
+				m_statistics.AliasedBytes += resource.Desc.GetSize();
+			}
+
+			m_physical[physical].LastPass = resource.LastPass;
+			resource.Physical = physical;
+		}
+		m_statistics.PhysicalResources = (UINT)m_physical.size();
+
+		for (UINT i = 0; i < (UINT)m_passes.size(); i++)
+		{
+			size_t liveBytes = 0;
+			for (UINT index : m_order)
+			{
+				const VirtualResource& resource = m_resources[index];
+				if (resource.FirstPass <= i && i <= resource.LastPass)
+				{
+					liveBytes += resource.Desc.GetSize();
+				}
+			}
+			m_statistics.PeakLiveBytes = std::max(m_statistics.PeakLiveBytes, liveBytes);
+		}
+	}
+
+	void RenderGraph::RecordBarriers()
+	{
+		// States are kept per physical resource, imported ones after the transient ones
+		const UINT importedBase = (UINT)m_physical.size();
+		m_states.assign(importedBase + m_resources.size(), RenderResourceUsage::ShaderResource);
+		m_stateOwners.assign(importedBase + m_resources.size(), UINT_MAX);
+
+		for (Pass& pass : m_passes)
+		{
+			pass.Barriers.clear();
+			if (pass.Culled)
+			{
+				continue;
+			}
+
+			for (const std::vector<Access>* accesses : { &pass.Reads, &pass.Writes })
+			{
+				for (const Access& access : *accesses)
+				{
+					UINT resourceIndex = m_nodes[access.Node].Resource;
+					const VirtualResource& resource = m_resources[resourceIndex];
+					UINT state = resource.ImportedID ? importedBase + resourceIndex : resource.Physical;
+
+					// Another resource taking over aliased memory counts as a change too
+					if (m_stateOwners[state] != UINT_MAX && (m_stateOwners[state] != resourceIndex || m_states[state] != access.Usage))
+					{
+						pass.Barriers.push_back({ resourceIndex, m_states[state], access.Usage });
+						m_statistics.Barriers++;
+					}
+					m_stateOwners[state] = resourceIndex;
+					m_states[state] = access.Usage;
+				}
+			}
+		}
+	}
+
+	void RenderGraph::Execute(CommandBuffer& commandBuffer)
+	{
+		if (!m_compiled)
+		{
+			Compile();
+		}
+
+		// Physical resources of the last frames are reused when they fit
+		for (PooledResource& pooled : m_pool)
+		{
+			pooled.InUse = false;
+		}
+		for (PhysicalResource& physical : m_physical)
+		{
+			physical.Pooled = UINT_MAX;
+			for (UINT i = 0; i < (UINT)m_pool.size(); i++)
+			{
+				if (!m_pool[i].InUse && m_pool[i].Desc == physical.Desc)
+				{
+					physical.Pooled = i;
+					break;
+				}
+			}
+
+			if (physical.Pooled == UINT_MAX)
+			{
+				PooledResource pooled;
+				pooled.Desc = physical.Desc;
+				pooled.ResourceID = CreatePhysicalResource(physical.Desc);
+				m_pool.push_back(pooled);
+				physical.Pooled = (UINT)m_pool.size() - 1;
+			}
+			m_pool[physical.Pooled].InUse = true;
+		}
+
+		RenderPassResources resources(*this);
+		for (const Pass& pass : m_passes)
+		{
+			if (pass.Culled)
+			{
+				continue;
+			}
+
+			ResolveBarriers(commandBuffer, pass);
+
+			PROFILE_GPU_SCOPE(commandBuffer, pass.Name);
+			if (pass.Execute)
+			{
+				pass.Execute(commandBuffer, resources);
+			}
+		}
+	}
+
+	void RenderGraph::ResolveBarriers(CommandBuffer& commandBuffer, const Pass& pass)
+	{
+		// D3D11 tracks the hazards itself but refuses to read what is still
+		// bound as an output, so leaving a state means unbinding it
+		bool targets = false;
+		bool unorderedAccess = false;
+		bool shaderResources = false;
+		for (const Barrier& barrier : pass.Barriers)
+		{
+			targets |= barrier.Before == RenderResourceUsage::RenderTarget || barrier.Before == RenderResourceUsage::DepthStencil;
+			unorderedAccess |= barrier.Before == RenderResourceUsage::UnorderedAccess;
+			shaderResources |= barrier.Before == RenderResourceUsage::ShaderResource && barrier.After != RenderResourceUsage::ShaderResource;
+		}
+
+		if (targets)
+		{
+			commandBuffer.UnbindRenderTargets();
+		}
+		if (unorderedAccess)
+		{
+			commandBuffer.UnbindUnorderedAccess(0, D3D11_PS_CS_UAV_REGISTER_COUNT);
+		}
+		if (shaderResources)
+		{
+			commandBuffer.UnbindShaderResources(ALL_SHADER_STAGES, 0, D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT);
+		}
+	}
+
+	ID RenderGraph::CreatePhysicalResource(const RenderResourceDesc& desc)
+	{
+		switch (desc.Type)
+		{
+		case RenderResourceType::DepthTexture:	return Manager::CreateDepthTexture(desc.Width, desc.Height);
+		case RenderResourceType::Buffer:		return Manager::CreateBufferArray(desc.Width, desc.Stride);
+		default:								return Manager::CreateTexture2D(desc.Width, desc.Height, desc.Format, desc.Stride);
+		}
+	}
+
+	bool RenderGraph::ValidateAliasing() const
+	{
+		for (size_t a = 0; a < m_resources.size(); a++)
+		{
+			for (size_t b = a + 1; b < m_resources.size(); b++)
+			{
+				const VirtualResource& first = m_resources[a];
+				const VirtualResource& second = m_resources[b];
+				if (first.Physical == UINT_MAX || first.Physical != second.Physical)
+				{
+					continue;
+				}
+
+				if (first.FirstPass <= second.LastPass && second.FirstPass <= first.LastPass)
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+}
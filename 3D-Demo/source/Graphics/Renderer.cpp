@@ -1,6 +1,127 @@
 #include "pch.h"
 #include "Resource/Resource.h"
 #include "Graphics/Renderer.h"
+#include "Resource/TextureStreamer.h"
+#include "Resource/ShaderReloader.h"
+#include "Platform/FrameArena.h"
+#include "Platform/Profiler.h"
+
+#include <climits>
+
+namespace
+{
+	const size_t MAX_MATERIALS = 1024;
+	const size_t MAX_LIGHTS = 16384;
+	const UINT TILE_SIZE = 16; // TiledDeferredLighting.hlsl
+
+	// Sun shadows reach this far from the camera, casters this far beyond them towards the sun
+	const float SHADOW_DISTANCE = 400.f;
+	const float SHADOW_CASTER_DISTANCE = 500.f;
+	const char* const SHADOW_MAP_NAMES[] = { "Shadow cascade 0", "Shadow cascade 1", "Shadow cascade 2", "Shadow cascade 3" };
+	const char* const SHADOW_CASCADE_RESOURCES[] = { "ShadowCascade0", "ShadowCascade1", "ShadowCascade2", "ShadowCascade3" };
+
+	using Graphics::RenderResource;
+	using Graphics::ShadowCascades;
+
+	struct DepthPrepassData
+	{
+		RenderResource Depth;
+	};
+
+	struct ShadowData
+	{
+		RenderResource Cascades[ShadowCascades::CASCADE_COUNT];
+	};
+
+	struct OpaqueData
+	{
+		RenderResource Color;
+		RenderResource Depth;
+		ShadowData Shadows;
+	};
+
+	// Laid out as in the comment at the top of Renderer.h
+	struct GBufferData
+	{
+		RenderResource Color;		// RGB = diffuse, A = specular intensity
+		RenderResource Normal;		// RGB = world normal
+		RenderResource Emissive;	// RGB = ambient color, A = intensity
+		RenderResource Roughness;	// From the specular exponent
+		RenderResource Depth;
+	};
+
+	struct TiledLightingData
+	{
+		GBufferData GBuffer;
+		RenderResource Color;
+		ShadowData Shadows;
+	};
+
+	// World matrices are stored transposed, columns hold the basis and translation
+	DirectX::XMVECTOR TransformPoint(const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT3& point)
+	{
+		return DirectX::XMVectorSet(
+			point.x * world._11 + point.y * world._12 + point.z * world._13 + world._14,
+			point.x * world._21 + point.y * world._22 + point.z * world._23 + world._24,
+			point.x * world._31 + point.y * world._32 + point.z * world._33 + world._34,
+			1.f);
+	}
+
+	float GetMaxScale(const DirectX::XMFLOAT4X4& world)
+	{
+		float x = world._11 * world._11 + world._21 * world._21 + world._31 * world._31;
+		float y = world._12 * world._12 + world._22 * world._22 + world._32 * world._32;
+		float z = world._13 * world._13 + world._23 * world._23 + world._33 * world._33;
+		return std::sqrt(std::max(x, std::max(y, z)));
+	}
+
+	// Smallest range of indices covering every submesh, false for an empty mesh
+	bool GetIndexRange(const Resource::Mesh& mesh, UINT& indexBegin, UINT& indexEnd)
+	{
+		indexBegin = UINT_MAX;
+		indexEnd = 0;
+		for (const Resource::Mesh::Submesh& sm : mesh.Submeshes)
+		{
+			indexBegin = std::min(indexBegin, sm.IndexOffset);
+			indexEnd = std::max(indexEnd, sm.IndexOffset + sm.IndexCount);
+		}
+		return indexEnd > indexBegin;
+	}
+
+	UINT GetMaterialFeatures(ID materialID)
+	{
+		auto material = Resource::Manager::GetMaterial(materialID);
+		return material ? material->Data.Features : 0;
+	}
+
+	// Maps bound on their own instead of through a texture array
+	bool HasSeparateMaps(ID materialID)
+	{
+		auto material = Resource::Manager::GetMaterial(materialID);
+		return material && (material->DiffuseMap || material->SpecularMap || material->NormalMap);
+	}
+
+	// Shadow maps the pass read, the invalid ones are unbound
+	void SetShadowMaps(Graphics::ResourceSet& resourceSet, const ShadowData& shadows, const Graphics::RenderPassResources& resources)
+	{
+		for (UINT cascade = 0; cascade < ShadowCascades::CASCADE_COUNT; cascade++)
+		{
+			ID depthID = shadows.Cascades[cascade].IsValid() ? resources.Get(shadows.Cascades[cascade]) : 0;
+			resourceSet.SetDepthTexture(SHADOW_CASCADE_RESOURCES[cascade], depthID);
+		}
+	}
+
+	void ReadShadowMaps(Graphics::RenderGraphBuilder& builder, const RenderResource (&shadowMaps)[ShadowCascades::CASCADE_COUNT], ShadowData& shadows)
+	{
+		for (UINT cascade = 0; cascade < ShadowCascades::CASCADE_COUNT; cascade++)
+		{
+			if (shadowMaps[cascade].IsValid())
+			{
+				shadows.Cascades[cascade] = builder.Read(shadowMaps[cascade]);
+			}
+		}
+	}
+}
 
 namespace Graphics
 {
@@ -19,20 +140,97 @@ namespace Graphics
 		s_instance.release();
 	}
 
-	Renderer::Renderer()
+	Renderer::Renderer() :
+		m_cameraPosition({ 0.f, 0.f, 0.f }),
+		m_cameraNearPlane(0.1f),
+		m_worldPerPixel(0.f),
+		m_materialTableSize(0),
+		m_clusterView(),
+		m_viewPort(),
+		m_renderPath(RenderPath::Forward),
+		m_depthPrepass(false),
+		m_materialPermutations(0),
+		m_permutationMaterialCount(0),
+		m_colorTextureID(0),
+		m_depthTextureID(0),
+		m_projection(),
+		m_sun(),
+		m_hasSun(false)
 	{
-		m_pointLight.Position = { -50.f, 20.f, 20.f };
-		m_pointLight.Color = { 1.0f, 1.0f, 1.0f };
-		m_pointLight.Radius = 100.f;
-		m_lightBuffer = Resource::Manager::CreateConstantBuffer(sizeof(Resource::PointLight), &m_pointLight);
-
 		m_objectBuffer = Resource::Manager::CreateConstantBuffer(sizeof(Resource::ObjectBufferData));
-		m_materialBuffer = Resource::Manager::CreateConstantBuffer(sizeof(Resource::Material::MaterialData));
 		m_cameraBuffer = Resource::Manager::CreateConstantBuffer(sizeof(Resource::CameraBufferData));
 
-		m_defaultShader = Resource::Manager::CreateShaderProgram("assets/shaders/DefaultShaderProgram.hlsl");
+		// Permutations are compiled once the materials using them are loaded
+		m_forwardShaders.FilePath = "assets/shaders/DefaultShaderProgram.hlsl";
+		m_gBufferShaders.FilePath = "assets/shaders/GBufferShaderProgram.hlsl";
+		CompilePermutations(m_forwardShaders);
 
 		m_instanceBufferID = Resource::Manager::CreateBufferArray(10000, sizeof(Resource::ObjectBufferData));
+		m_materialTableBufferID = Resource::Manager::CreateBufferArray(MAX_MATERIALS, sizeof(Resource::Material::MaterialData));
+
+		// Light indices are read four at a time, elements must be 16 bytes
+		m_lightBufferID = Resource::Manager::CreateBufferArray(MAX_LIGHTS, sizeof(Resource::PointLight));
+		m_lightClusterBufferID = Resource::Manager::CreateBufferArray(LightClusters::CLUSTER_COUNT, sizeof(LightCluster));
+		m_lightIndexBufferID = Resource::Manager::CreateBufferArray(LightClusters::MAX_LIGHT_INDICES / 4, 4 * sizeof(UINT));
+		m_clusterConstantBufferID = Resource::Manager::CreateConstantBuffer(sizeof(Resource::ClusterBufferData));
+		m_lights.reserve(MAX_LIGHTS);
+
+		// Buffer contents change every frame, the buffers do not
+		m_frameResources.SetConstantBuffer("CameraBuffer", m_cameraBuffer);
+		m_frameResources.SetConstantBuffer("ClusterBuffer", m_clusterConstantBufferID);
+		m_frameResources.SetBufferArray("InstanceBuffer", m_instanceBufferID);
+		m_frameResources.SetBufferArray("MaterialTable", m_materialTableBufferID);
+		m_frameResources.SetBufferArray("PointLights", m_lightBufferID);
+		m_frameResources.SetBufferArray("LightClusters", m_lightClusterBufferID);
+		m_frameResources.SetBufferArray("LightIndexList", m_lightIndexBufferID);
+
+		m_tiledLightingShader = Resource::Manager::CreateShaderProgram("assets/shaders/TiledDeferredLighting.hlsl");
+		m_tiledLightingBufferID = Resource::Manager::CreateConstantBuffer(sizeof(Resource::TiledLightingBufferData));
+		m_frameResources.SetConstantBuffer("TiledLightingBuffer", m_tiledLightingBufferID);
+
+		// After the prepass only the nearest surface passes, depth is already written
+		m_depthPrepassShader = Resource::Manager::CreateShaderProgram("assets/shaders/DepthPrepassShaderProgram.hlsl");
+		{
+			D3D11_DEPTH_STENCIL_DESC depthDesc;
+			ZERO_MEMORY(depthDesc);
+			depthDesc.DepthEnable = TRUE;
+			depthDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
+			depthDesc.DepthFunc = D3D11_COMPARISON_EQUAL;
+			m_depthEqualState = Resource::Manager::CreateDepthStencilState(depthDesc);
+		}
+
+		m_shadowShader = Resource::Manager::CreateShaderProgram("assets/shaders/ShadowShaderProgram.hlsl");
+		m_shadowBufferID = Resource::Manager::CreateConstantBuffer(sizeof(Resource::ShadowBufferData));
+		m_shadowCasterBufferID = Resource::Manager::CreateConstantBuffer(sizeof(Resource::ShadowCasterBufferData));
+		m_frameResources.SetConstantBuffer("ShadowBuffer", m_shadowBufferID);
+		m_frameResources.SetConstantBuffer("ShadowCasterBuffer", m_shadowCasterBufferID);
+
+		// Shadow map lookups compare against the stored depth, 2x2 filtered.
+		// Outside the map counts as lit.
+		{
+			D3D11_SAMPLER_DESC samplerDesc;
+			ZERO_MEMORY(samplerDesc);
+			samplerDesc.Filter = D3D11_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT;
+			samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_BORDER;
+			samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_BORDER;
+			samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_BORDER;
+			samplerDesc.MaxAnisotropy = 1;
+			samplerDesc.ComparisonFunc = D3D11_COMPARISON_LESS_EQUAL;
+			samplerDesc.BorderColor[0] = 1.f;
+			samplerDesc.BorderColor[1] = 1.f;
+			samplerDesc.BorderColor[2] = 1.f;
+			samplerDesc.BorderColor[3] = 1.f;
+			samplerDesc.MaxLOD = FLT_MAX;
+
+			m_frameResources.SetSampler("shadowSampler", Resource::Manager::CreateSampler(samplerDesc));
+		}
+
+		// Every shader program exists by now, this is their share of the startup time
+		{
+			const Resource::ShaderCacheStatistics& shaders = Resource::Manager::GetShaderCacheStatistics();
+			std::cout << "Shaders ready in " << shaders.Milliseconds << " ms (" << shaders.Hits << " cached, "
+				<< shaders.Misses << " compiled)" << std::endl;
+		}
 
 		// Temp
 
@@ -51,7 +249,7 @@ namespace Graphics
 
 		ID sampler = Resource::Manager::CreateSampler(samplerDesc);
 
-		m_commandBuffer.BindSampler(sampler, SHADER_STAGE_PIXEL, 0);
+		m_frameResources.SetSampler("defaultSampler", sampler);
 	}
 
 	Renderer::~Renderer()
@@ -61,7 +259,18 @@ namespace Graphics
 
 	void Renderer::BeginFrameInternal(const Resource::Camera& camera, const Resource::Transform& cameraTransform)
 	{
+		PROFILE_SCOPE("Renderer::BeginFrame");
+
+		// Programs only change between frames
 		{
+			PROFILE_SCOPE("ShaderReloader::Update");
+			Resource::ShaderReloader::Update();
+		}
+
+		m_commandBuffer.BeginFrameTiming();
+
+		{
+			PROFILE_GPU_SCOPE(m_commandBuffer, "Clear");
 			m_commandBuffer.ClearRenderTarget(camera.ColorTextureID, { 0.2f, 0.3f, 0.4f });
 			m_commandBuffer.ClearDepthStencil(camera.DepthTextureID);
 			m_commandBuffer.BindRenderTarget(camera.ColorTextureID, 0, camera.DepthTextureID);
@@ -71,6 +280,29 @@ namespace Graphics
 			m_commandBuffer.BindViewPort(camera.GetViewPort());
 		}
 
+		{
+			m_cameraPosition = cameraTransform.Position;
+			m_cameraNearPlane = camera.NearPlane;
+			m_worldPerPixel = 2.f * std::tan(camera.FOV * 0.5f) / camera.GetViewPort().Height;
+		}
+
+		{
+			DirectX::XMFLOAT4X4 viewTransposed = cameraTransform.GetViewMatrixTransposed();
+			DirectX::XMStoreFloat4x4(&m_clusterView.View, DirectX::XMMatrixTranspose(DirectX::XMLoadFloat4x4(&viewTransposed)));
+			m_clusterView.FOV = camera.FOV;
+			m_clusterView.AspectRatio = camera.AspectRatio;
+			m_clusterView.NearPlane = camera.NearPlane;
+			m_clusterView.FarPlane = camera.FarPlane;
+			m_viewPort = camera.GetViewPort();
+		}
+
+		{
+			DirectX::XMFLOAT4X4 projectionTransposed = camera.GetProjectionMatrixTransposed();
+			DirectX::XMStoreFloat4x4(&m_projection, DirectX::XMMatrixTranspose(DirectX::XMLoadFloat4x4(&projectionTransposed)));
+			m_colorTextureID = camera.ColorTextureID;
+			m_depthTextureID = camera.DepthTextureID;
+		}
+
 		Resource::CameraBufferData cameraBufferData;
 
 		{
@@ -79,67 +311,735 @@ namespace Graphics
 			cameraBufferData.Projection = camera.GetProjectionMatrixTransposed();
 
 			m_commandBuffer.UpdateConstantBuffer(m_cameraBuffer, &cameraBufferData, sizeof(cameraBufferData));
-			m_commandBuffer.BindConstantBuffer(m_cameraBuffer, SHADER_STAGE_VERTEX | SHADER_STAGE_PIXEL, 2);
 		}
+	}
+
+	void Renderer::SubmitInternal(ID meshID, const Resource::Transform& transform)
+	{
+		m_instances.Add(meshID, transform.GetMatrixTransposed());
+	}
 
+	void Renderer::SubmitInternal(ID meshID, const DirectX::XMFLOAT4X4& worldTransposed)
+	{
+		m_instances.Add(meshID, worldTransposed);
+	}
+
+	void Renderer::SubmitInternal(ID meshID, const Resource::TransformBatch& transforms, size_t begin, size_t end)
+	{
+		static_assert(sizeof(Resource::ObjectBufferData) == sizeof(DirectX::XMFLOAT4X4), "Instance data must be a bare world matrix");
+
+		// The kernel writes straight into the instance data, no per-instance copy
+		Resource::ObjectBufferData* instances = m_instances.Append(meshID, end - begin);
+		Resource::ComposeMatricesTransposed(transforms, begin, end, &instances->World);
+	}
+
+	void Renderer::EndFrameInternal()
+	{
+		PROFILE_SCOPE("Renderer::EndFrame");
+
+		DrawStatistics statistics;
+
+		m_renderGraph.Reset();
+
+		RenderResource color;
+		RenderResource depth;
+		{
+			auto colorTexture = Resource::Manager::GetTexture2D(m_colorTextureID);
+			auto depthTexture = Resource::Manager::GetDepthTexture(m_depthTextureID);
+			color = m_renderGraph.Import("Color", m_colorTextureID, RenderResourceDesc::Texture(colorTexture->Width, colorTexture->Height, colorTexture->Format, colorTexture->TexelStride));
+			depth = m_renderGraph.Import("Depth", m_depthTextureID, RenderResourceDesc::Depth(depthTexture->Width, depthTexture->Height));
+		}
+
+		CompilePermutations((m_renderPath == RenderPath::Deferred) ? m_gBufferShaders : m_forwardShaders);
+		UpdateShadows();
+		SortOpaque();
+
+		ShadowMaps shadowMaps;
+		AddShadowPass(shadowMaps, statistics);
+
+		depth = AddDepthPrepass(depth, statistics);
+
+		if (m_renderPath == RenderPath::Deferred)
+		{
+			AddDeferredPasses(color, depth, shadowMaps, statistics);
+		}
+		else
+		{
+			AddForwardPasses(color, depth, shadowMaps, statistics);
+		}
+
+		// Writes nothing the graph knows of, but has to run every frame
+		m_renderGraph.AddPass("Texture streaming",
+			[](RenderGraphBuilder& builder) { builder.SetSideEffect(); },
+			[](CommandBuffer&, const RenderPassResources&) {
+				PROFILE_SCOPE("TextureStreamer::Update");
+				Resource::TextureStreamer::Update();
+			});
+
+		{
+			PROFILE_SCOPE("RenderGraph::Compile");
+			m_renderGraph.Compile();
+		}
+		m_renderGraph.Execute(m_commandBuffer);
+
+		m_instances.Clear();
+
+		Resource::TextureStreamingStatistics streaming = Resource::TextureStreamer::GetStatistics();
+		Resource::ShaderReloadStatistics reload = Resource::ShaderReloader::GetStatistics();
+
+		// Timings of this frame reach the profiler a few frames from now
+		m_commandBuffer.EndFrameTiming();
+
+		// Everything allocated for this frame is released FRAME_COUNT frames later
+		Platform::FrameArena::NextFrame();
+		Platform::FrameArenaStatistics memory = Platform::FrameArena::GetStatistics();
+
+		// Reported with the profiler summary instead of every frame
+		Platform::Profiler::SetCounter("Draw calls", statistics.DrawCalls);
+		Platform::Profiler::SetCounter("Instances", statistics.Instances);
+		Platform::Profiler::SetCounter("Triangles", statistics.Triangles);
+		Platform::Profiler::SetCounter("Shader permutations", statistics.ShaderPermutations);
+		Platform::Profiler::SetCounter("Lights", (double)std::min(m_lights.size(), MAX_LIGHTS));
+		if (m_renderPath == RenderPath::Forward)
+		{
+			Platform::Profiler::SetCounter("Light indices", (double)m_lightClusters.GetLightIndices().size());
+		}
+		m_lights.clear();
+		Platform::Profiler::SetCounter("Shadow draw calls", statistics.ShadowDrawCalls);
+		Platform::Profiler::SetCounter("Shadow casters", statistics.ShadowInstances);
+		if (m_depthPrepass)
 		{
-			// Temp
-			m_commandBuffer.UpdateConstantBuffer(m_lightBuffer, &m_pointLight, sizeof(m_pointLight));
-			m_commandBuffer.BindConstantBuffer(m_lightBuffer, SHADER_STAGE_PIXEL, 3);
+			Platform::Profiler::SetCounter("Prepass draw calls", statistics.PrepassDrawCalls);
 		}
+		m_hasSun = false;
+		Platform::Profiler::SetCounter("Texture memory (MB)", (double)(streaming.ResidentBytes / (1024 * 1024)));
+		Platform::Profiler::SetCounter("Texture budget (MB)", (double)(streaming.BudgetBytes / (1024 * 1024)));
+		Platform::Profiler::SetCounter("Texture requests pending", streaming.PendingRequests);
+		Platform::Profiler::SetCounter("Texture evictions", streaming.Evictions);
+		Platform::Profiler::SetCounter("Watched shader programs", reload.Programs);
+		Platform::Profiler::SetCounter("Shader reloads pending", reload.PendingRequests);
+		Platform::Profiler::SetCounter("Shader reloads", reload.Reloads);
+		Platform::Profiler::SetCounter("Shader reload failures", reload.Failures);
+		Platform::Profiler::SetCounter("Frame memory (KB)", (double)(memory.FrameBytes / 1024));
+		Platform::Profiler::SetCounter("Frame memory peak (KB)", (double)(memory.PeakFrameBytes / 1024));
+		Platform::Profiler::SetCounter("Heap allocations", (double)memory.HeapAllocations);
+
+		const RenderGraphStatistics& graph = m_renderGraph.GetStatistics();
+		Platform::Profiler::SetCounter("Render passes", graph.Passes - graph.CulledPasses);
+		Platform::Profiler::SetCounter("Transient memory (MB)", (double)graph.AliasedBytes / (1024 * 1024));
 	}
 
-	void Renderer::SubmitInternal(ID meshID, const Resource::Transform& transform)
+	void Renderer::CompilePermutations(ShaderPermutations& shaders)
 	{
-		Resource::ObjectBufferData data;
-		data.World = transform.GetMatrixTransposed();
-		m_instanceBufferData[meshID].push_back(data);
+		// The default material is always there
+		const auto& materialTable = Resource::Manager::GetMaterialTable();
+		for (; m_permutationMaterialCount < materialTable.size(); m_permutationMaterialCount++)
+		{
+			m_materialPermutations |= 0x1 << materialTable[m_permutationMaterialCount].Features;
+		}
+		m_materialPermutations |= 0x1;
+
+		UINT missing = m_materialPermutations & ~shaders.Compiled;
+		if (!missing)
+		{
+			return;
+		}
+
+		PROFILE_SCOPE("Renderer::CompilePermutations");
+
+		std::vector<UINT> permutations;
+		std::vector<Resource::ShaderDefines> defines;
+		for (UINT permutation = 0; permutation < Resource::MATERIAL_PERMUTATION_COUNT; permutation++)
+		{
+			if (!(missing & (0x1 << permutation)))
+			{
+				continue;
+			}
+
+			permutations.push_back(permutation);
+			defines.emplace_back();
+			for (UINT feature = 0; feature < Resource::MATERIAL_FEATURE_COUNT; feature++)
+			{
+				if (permutation & (0x1 << feature))
+				{
+					defines.back().push_back({ Resource::MATERIAL_FEATURE_DEFINES[feature] });
+				}
+			}
+		}
+
+		double milliseconds = Resource::Manager::GetShaderCacheStatistics().Milliseconds;
+		std::vector<ID> programs = Resource::Manager::CreateShaderPrograms(shaders.FilePath, defines);
+		std::cout << shaders.FilePath << ": " << permutations.size() << " permutations ready in "
+			<< Resource::Manager::GetShaderCacheStatistics().Milliseconds - milliseconds << " ms" << std::endl;
+		for (size_t i = 0; i < permutations.size(); i++)
+		{
+			// One that does not compile draws with the plain permutation instead
+			shaders.Programs[permutations[i]] = programs[i] ? programs[i] : shaders.Programs[0];
+		}
+		shaders.Compiled |= missing;
 	}
 
-	void Renderer::EndFrameInternal()
+	void Renderer::DrawOpaque(const ShaderPermutations& shaders, bool depthEqual, DrawStatistics& statistics)
 	{
-		int drawCalls = 0;
-		int instanceCount = 0;
-		int triangleCount = 0;
+		// Materials and their texture arrays are shared by every draw
+		{
+			const auto& materialTable = Resource::Manager::GetMaterialTable();
+			// Materials past MAX_MATERIALS are not uploaded, the clamped size
+			// is compared so a larger table is not uploaded every frame
+			size_t materialCount = std::min(materialTable.size(), MAX_MATERIALS);
+			if (materialCount != m_materialTableSize)
+			{
+				m_materialTableSize = materialCount;
+				m_commandBuffer.UpdateBufferArray(m_materialTableBufferID, materialTable.data(), m_materialTableSize * sizeof(Resource::Material::MaterialData));
+			}
+
+			const auto& textureArrays = Resource::Manager::GetMaterialTextureArrays();
+			for (UINT slot = 0; slot < (UINT)textureArrays.size(); slot++)
+			{
+				m_frameResources.SetTexture("MaterialTextureArray" + std::to_string(slot), textureArrays[slot]);
+			}
+		}
 
-		m_commandBuffer.BindShaderProgram(m_defaultShader);
+		const auto& buckets = m_instances.GetBuckets();
+		for (const OpaqueBucket& opaque : m_opaqueBuckets)
+		{
+			statistics.Instances += opaque.InstanceCount;
+			RequestTextureResolution(*Resource::Manager::GetMesh(buckets[opaque.Bucket].MeshID), buckets[opaque.Bucket].Instances);
+		}
 
-		for (auto& job : m_instanceBufferData)
+		// A bucket drawn with several permutations uploads its instances once per permutation
+		UINT boundPermutation = UINT_MAX;
+		UINT boundBucket = UINT_MAX;
+		for (const OpaqueDraw& draw : m_opaqueDraws)
 		{
-			ID meshID = job.first;
-			auto& instances = job.second;
+			const OpaqueBucket& opaque = m_opaqueBuckets[draw.Bucket];
+
+			if (draw.Permutation != boundPermutation)
+			{
+				// Alpha tested draws come last, the prepass leaves them out so they test and write depth as usual
+				bool alphaTested = (draw.Permutation & Resource::MATERIAL_FEATURE_ALPHA_TEST) != 0;
+				m_commandBuffer.BindShaderProgram(shaders.Programs[draw.Permutation]);
+				m_commandBuffer.BindResourceSet(shaders.Programs[draw.Permutation], m_frameResources);
+				m_commandBuffer.BindDepthStencilState((depthEqual && !alphaTested) ? m_depthEqualState : 0);
+				boundPermutation = draw.Permutation;
+				statistics.ShaderPermutations++;
+			}
+
+			if (draw.Bucket != boundBucket)
+			{
+				auto mesh = Resource::Manager::GetMesh(buckets[opaque.Bucket].MeshID);
+				m_commandBuffer.BindVertexBuffer(mesh->VertexBuffer);
+				m_commandBuffer.BindIndexBuffer(mesh->IndexBuffer);
+				m_commandBuffer.UpdateBufferArray(m_instanceBufferID, &m_sortedInstances[opaque.InstanceOffset], opaque.InstanceCount * sizeof(Resource::ObjectBufferData));
+				boundBucket = draw.Bucket;
+			}
+
+			if (draw.Material)
+			{
+				auto material = Resource::Manager::GetMaterial(draw.Material);
+				m_materialResources.SetTexture("MaterialDiffuseMap", material->DiffuseMap);
+				m_materialResources.SetTexture("MaterialSpecularMap", material->SpecularMap);
+				m_materialResources.SetTexture("MaterialNormalMap", material->NormalMap);
+				m_commandBuffer.BindResourceSet(shaders.Programs[draw.Permutation], m_materialResources);
+			}
+
+			m_commandBuffer.DrawIndexedInstanced(draw.IndexCount, draw.IndexOffset, opaque.InstanceCount);
+
+			statistics.DrawCalls++;
+			statistics.Triangles += (draw.IndexCount / 3) * opaque.InstanceCount;
+		}
+	}
 
-			instanceCount = instances.size();
+	void Renderer::AddOpaqueDraws(UINT opaqueBucket, const Resource::Mesh& mesh)
+	{
+		OpaqueBucket& opaque = m_opaqueBuckets[opaqueBucket];
 
-			auto mesh = Resource::Manager::GetMesh(meshID);
-			m_commandBuffer.BindVertexBuffer(mesh->VertexBuffer);
+		bool separateMaps = false;
+		for (const Resource::Mesh::Submesh& sm : mesh.Submeshes)
+		{
+			separateMaps |= HasSeparateMaps(sm.Material);
+			opaque.Features |= GetMaterialFeatures(sm.Material);
+		}
+
+		// Vertices know their material, so unless a submesh has a map of its own
+		// to bind, submeshes next to each other with the same permutation are
+		// drawn at once
+		if (!separateMaps)
+		{
+			Platform::FrameVector<UINT> submeshes(mesh.Submeshes.size());
+			for (UINT i = 0; i < (UINT)submeshes.size(); i++)
+			{
+				submeshes[i] = i;
+			}
+			std::sort(submeshes.begin(), submeshes.end(), [&mesh](UINT a, UINT b) { return mesh.Submeshes[a].IndexOffset < mesh.Submeshes[b].IndexOffset; });
+
+			size_t first = m_opaqueDraws.size();
+			for (UINT submesh : submeshes)
+			{
+				const Resource::Mesh::Submesh& sm = mesh.Submeshes[submesh];
+				UINT permutation = GetMaterialFeatures(sm.Material);
+				if (sm.IndexCount == 0)
+				{
+					continue;
+				}
+
+				OpaqueDraw* last = (m_opaqueDraws.size() > first) ? &m_opaqueDraws.back() : nullptr;
+				if (last && last->Permutation == permutation && last->IndexOffset + last->IndexCount == sm.IndexOffset)
+				{
+					last->IndexCount += sm.IndexCount;
+					continue;
+				}
+				m_opaqueDraws.push_back({ permutation, opaqueBucket, sm.IndexOffset, sm.IndexCount, 0 });
+			}
+			return;
+		}
+
+		// Submeshes front to back as seen on the nearest instance
+		const Resource::ObjectBufferData& nearest = m_sortedInstances[opaque.InstanceOffset];
+		m_sortDepths.resize(mesh.Submeshes.size());
+		{
+			DirectX::XMMATRIX view = DirectX::XMLoadFloat4x4(&m_clusterView.View);
+			float scale = GetMaxScale(nearest.World);
+			for (size_t i = 0; i < mesh.Submeshes.size(); i++)
+			{
+				const Resource::Mesh::Submesh& sm = mesh.Submeshes[i];
+				DirectX::XMVECTOR center = DirectX::XMVector3Transform(TransformPoint(nearest.World, sm.BoundsCenter), view);
+				m_sortDepths[i] = DirectX::XMVectorGetZ(center) - sm.BoundsRadius * scale;
+			}
+		}
+		m_depthSort.Sort(m_sortDepths.data(), m_sortDepths.size(), m_sortOrder);
+
+		for (UINT submesh : m_sortOrder)
+		{
+			const Resource::Mesh::Submesh& sm = mesh.Submeshes[submesh];
+			m_opaqueDraws.push_back({ GetMaterialFeatures(sm.Material), opaqueBucket, sm.IndexOffset, sm.IndexCount, HasSeparateMaps(sm.Material) ? sm.Material : 0 });
+		}
+	}
+
+	void Renderer::SortOpaque()
+	{
+		using namespace DirectX;
+
+		PROFILE_SCOPE("Renderer::SortOpaque");
+
+		m_depthSort.SetRange(m_clusterView.NearPlane, m_clusterView.FarPlane);
+		XMMATRIX view = XMLoadFloat4x4(&m_clusterView.View);
+
+		// Instances by the depth of the nearest point of their bounds
+		m_sortedInstances.clear();
+		m_unsortedBuckets.clear();
+		Platform::FrameVector<float> bucketDepths;
+		const auto& buckets = m_instances.GetBuckets();
+		for (UINT b = 0; b < (UINT)buckets.size(); b++)
+		{
+			const auto& instances = buckets[b].Instances;
+			auto mesh = Resource::Manager::GetMesh(buckets[b].MeshID);
+			if (instances.empty() || !mesh)
+			{
+				continue;
+			}
+
+			m_sortDepths.resize(instances.size());
+			for (size_t i = 0; i < instances.size(); i++)
+			{
+				XMVECTOR center = XMVector3Transform(TransformPoint(instances[i].World, mesh->BoundsCenter), view);
+				m_sortDepths[i] = XMVectorGetZ(center) - mesh->BoundsRadius * GetMaxScale(instances[i].World);
+			}
+			m_depthSort.Sort(m_sortDepths.data(), m_sortDepths.size(), m_sortOrder);
+
+			m_unsortedBuckets.push_back({ b, (UINT)m_sortedInstances.size(), (UINT)instances.size() });
+			bucketDepths.push_back(m_sortDepths[m_sortOrder[0]]);
+			for (UINT instance : m_sortOrder)
+			{
+				m_sortedInstances.push_back(instances[instance]);
+			}
+		}
+
+		// Then the buckets by their nearest instance
+		m_depthSort.Sort(bucketDepths.data(), bucketDepths.size(), m_sortOrder);
+		m_opaqueBuckets.clear();
+		for (UINT bucket : m_sortOrder)
+		{
+			m_opaqueBuckets.push_back(m_unsortedBuckets[bucket]);
+		}
+
+		// And the draws of every bucket by permutation, keeping them front to
+		// back within one, so each permutation is bound once
+		m_opaqueDraws.clear();
+		for (UINT o = 0; o < (UINT)m_opaqueBuckets.size(); o++)
+		{
+			AddOpaqueDraws(o, *Resource::Manager::GetMesh(buckets[m_opaqueBuckets[o].Bucket].MeshID));
+		}
+		std::stable_sort(m_opaqueDraws.begin(), m_opaqueDraws.end(), [](const OpaqueDraw& a, const OpaqueDraw& b) { return a.Permutation < b.Permutation; });
+	}
+
+	void Renderer::DrawDepth(DrawStatistics& statistics)
+	{
+		// Materials do not matter, every mesh is one draw from its position stream.
+		// Alpha tested submeshes are left out, their depth depends on the diffuse map.
+		const auto& buckets = m_instances.GetBuckets();
+		for (const OpaqueBucket& opaque : m_opaqueBuckets)
+		{
+			auto mesh = Resource::Manager::GetMesh(buckets[opaque.Bucket].MeshID);
+			UINT indexBegin, indexEnd;
+			if (!GetIndexRange(*mesh, indexBegin, indexEnd))
+			{
+				continue;
+			}
+
+			m_commandBuffer.BindVertexBuffer(mesh->PositionBuffer);
 			m_commandBuffer.BindIndexBuffer(mesh->IndexBuffer);
+			m_commandBuffer.UpdateBufferArray(m_instanceBufferID, &m_sortedInstances[opaque.InstanceOffset], opaque.InstanceCount * sizeof(Resource::ObjectBufferData));
+
+			if (!(opaque.Features & Resource::MATERIAL_FEATURE_ALPHA_TEST))
+			{
+				m_commandBuffer.DrawIndexedInstanced(indexEnd - indexBegin, indexBegin, opaque.InstanceCount);
+				statistics.PrepassDrawCalls++;
+				continue;
+			}
+
+			for (const Resource::Mesh::Submesh& sm : mesh->Submeshes)
+			{
+				if (!(GetMaterialFeatures(sm.Material) & Resource::MATERIAL_FEATURE_ALPHA_TEST) && sm.IndexCount > 0)
+				{
+					m_commandBuffer.DrawIndexedInstanced(sm.IndexCount, sm.IndexOffset, opaque.InstanceCount);
+					statistics.PrepassDrawCalls++;
+				}
+			}
+		}
+	}
+
+	UINT Renderer::UploadLights()
+	{
+		// Lights past the buffer are dropped
+		size_t lightCount = std::min(m_lights.size(), MAX_LIGHTS);
+		if (lightCount > 0)
+		{
+			m_commandBuffer.UpdateBufferArray(m_lightBufferID, m_lights.data(), lightCount * sizeof(Resource::PointLight));
+		}
+		return (UINT)lightCount;
+	}
+
+	void Renderer::BinLights()
+	{
+		PROFILE_SCOPE("Renderer::BinLights");
+
+		UINT lightCount = UploadLights();
+		m_lightClusters.Build(m_clusterView, m_lights.data(), lightCount);
+
+		const auto& clusters = m_lightClusters.GetClusters();
+		const auto& lightIndices = m_lightClusters.GetLightIndices();
+		Resource::ClusterBufferData clusterData = m_lightClusters.GetBufferData(m_viewPort, lightCount);
+
+		m_commandBuffer.UpdateBufferArray(m_lightClusterBufferID, clusters.data(), clusters.size() * sizeof(LightCluster));
+		m_commandBuffer.UpdateBufferArray(m_lightIndexBufferID, lightIndices.data(), lightIndices.size() * sizeof(UINT));
+		m_commandBuffer.UpdateConstantBuffer(m_clusterConstantBufferID, &clusterData, sizeof(clusterData));
+	}
+
+	void Renderer::UpdateShadows()
+	{
+		PROFILE_SCOPE("Renderer::CullShadowCasters");
+
+		// Without a sun the shaders skip it, CascadeCount stays 0
+		Resource::ShadowBufferData shadowData;
+		ZERO_MEMORY(shadowData);
+
+		if (m_hasSun)
+		{
+			m_shadowCascades.Update(m_clusterView, m_sun.Direction, SHADOW_DISTANCE, SHADOW_CASTER_DISTANCE);
+			shadowData = m_shadowCascades.GetBufferData(m_sun.Color);
+
+			m_shadowCasters.clear();
+			m_shadowBucketOffsets.clear();
+			for (const auto& bucket : m_instances.GetBuckets())
+			{
+				m_shadowBucketOffsets.push_back((UINT)m_shadowCasters.size());
+
+				auto mesh = Resource::Manager::GetMesh(bucket.MeshID);
+				if (!mesh)
+				{
+					continue;
+				}
+
+				for (const Resource::ObjectBufferData& instance : bucket.Instances)
+				{
+					ShadowCaster caster;
+					DirectX::XMStoreFloat3(&caster.Center, TransformPoint(instance.World, mesh->BoundsCenter));
+					caster.Radius = mesh->BoundsRadius * GetMaxScale(instance.World);
+					m_shadowCasters.push_back(caster);
+				}
+			}
+			m_shadowBucketOffsets.push_back((UINT)m_shadowCasters.size());
+
+			m_shadowCascades.Cull(m_shadowCasters.data(), m_shadowCasters.size(), m_visibleShadowCasters);
+		}
+
+		m_commandBuffer.UpdateConstantBuffer(m_shadowBufferID, &shadowData, sizeof(shadowData));
+	}
+
+	void Renderer::DrawShadowCasters(UINT cascade, DrawStatistics& statistics)
+	{
+		const auto& buckets = m_instances.GetBuckets();
+		const std::vector<UINT>& visible = m_visibleShadowCasters[cascade];
+
+		// Visible casters are in bucket order, each bucket is one instanced draw
+		size_t next = 0;
+		for (size_t b = 0; b < buckets.size() && next < visible.size(); b++)
+		{
+			const UINT bucketBegin = m_shadowBucketOffsets[b];
+			const UINT bucketEnd = m_shadowBucketOffsets[b + 1];
 
-			size_t instanceBufferSize = instances.size() * sizeof(Resource::ObjectBufferData);
-			m_commandBuffer.UpdateBufferArray(m_instanceBufferID, instances.data(), instanceBufferSize);
-			m_commandBuffer.BindBufferArray(m_instanceBufferID, SHADER_STAGE_VERTEX, 0);
+			m_shadowInstances.clear();
+			for (; next < visible.size() && visible[next] < bucketEnd; next++)
+			{
+				m_shadowInstances.push_back(buckets[b].Instances[visible[next] - bucketBegin]);
+			}
+			if (m_shadowInstances.empty())
+			{
+				continue;
+			}
 
-			for (auto& sm : mesh->Submeshes)
+			// Materials do not matter for depth, every submesh is drawn at once
+			auto mesh = Resource::Manager::GetMesh(buckets[b].MeshID);
+			UINT indexBegin, indexEnd;
+			if (!GetIndexRange(*mesh, indexBegin, indexEnd))
 			{
-				auto material = Resource::Manager::GetMaterial(sm.Material);
+				continue;
+			}
+
+			m_commandBuffer.BindVertexBuffer(mesh->PositionBuffer);
+			m_commandBuffer.BindIndexBuffer(mesh->IndexBuffer);
+			m_commandBuffer.UpdateBufferArray(m_instanceBufferID, m_shadowInstances.data(), m_shadowInstances.size() * sizeof(Resource::ObjectBufferData));
+			m_commandBuffer.DrawIndexedInstanced(indexEnd - indexBegin, indexBegin, (UINT)m_shadowInstances.size());
+
+			statistics.ShadowDrawCalls++;
+			statistics.ShadowInstances += (int)m_shadowInstances.size();
+		}
+	}
+
+	void Renderer::AddShadowPass(ShadowMaps& shadowMaps, DrawStatistics& statistics)
+	{
+		using namespace DirectX;
+
+		if (!m_hasSun)
+		{
+			return;
+		}
 
-				m_commandBuffer.UpdateConstantBuffer(m_materialBuffer, &material->Data, sizeof(material->Data));
-				m_commandBuffer.BindConstantBuffer(m_materialBuffer, SHADER_STAGE_PIXEL, 1);
+		// Depth only, no shading happens while drawing the casters
+		const ShadowData& shadows = m_renderGraph.AddPass<ShadowData>("Shadows",
+			[&](RenderGraphBuilder& builder, ShadowData& data) {
+				for (UINT cascade = 0; cascade < ShadowCascades::CASCADE_COUNT; cascade++)
+				{
+					RenderResourceDesc desc = RenderResourceDesc::Depth(ShadowCascades::RESOLUTION, ShadowCascades::RESOLUTION);
+					data.Cascades[cascade] = builder.Write(builder.Create(SHADOW_MAP_NAMES[cascade], desc), RenderResourceUsage::DepthStencil);
+				}
+			},
+			[this, &statistics](const ShadowData& data, CommandBuffer& commandBuffer, const RenderPassResources& resources) {
+				D3D11_VIEWPORT viewPort;
+				ZERO_MEMORY(viewPort);
+				viewPort.Width = (float)ShadowCascades::RESOLUTION;
+				viewPort.Height = (float)ShadowCascades::RESOLUTION;
+				viewPort.MaxDepth = 1.f;
+				commandBuffer.BindViewPort(viewPort);
 
-				if (material->DiffuseMap)
+				commandBuffer.BindShaderProgram(m_shadowShader);
+				commandBuffer.BindResourceSet(m_shadowShader, m_frameResources);
+
+				for (UINT cascade = 0; cascade < ShadowCascades::CASCADE_COUNT; cascade++)
 				{
-					m_commandBuffer.BindShaderResource(material->DiffuseMap, SHADER_STAGE_PIXEL, 0);
+					ID depthID = resources.Get(data.Cascades[cascade]);
+					commandBuffer.ClearDepthStencil(depthID, true, false);
+					commandBuffer.BindRenderTargets(nullptr, 0, depthID);
+
+					Resource::ShadowCasterBufferData casterData;
+					XMStoreFloat4x4(&casterData.ViewProjection, XMMatrixTranspose(XMLoadFloat4x4(&m_shadowCascades.GetCascade(cascade).ViewProjection)));
+					commandBuffer.UpdateConstantBuffer(m_shadowCasterBufferID, &casterData, sizeof(casterData));
+
+					DrawShadowCasters(cascade, statistics);
 				}
 
-				m_commandBuffer.DrawIndexedInstanced(sm.IndexCount, sm.IndexOffset, instances.size());
+				commandBuffer.BindViewPort(m_viewPort);
+			});
+
+		for (UINT cascade = 0; cascade < ShadowCascades::CASCADE_COUNT; cascade++)
+		{
+			shadowMaps[cascade] = shadows.Cascades[cascade];
+		}
+	}
+
+	RenderResource Renderer::AddDepthPrepass(RenderResource depth, DrawStatistics& statistics)
+	{
+		if (!m_depthPrepass)
+		{
+			return depth;
+		}
+
+		const DepthPrepassData& prepass = m_renderGraph.AddPass<DepthPrepassData>("Depth prepass",
+			[&](RenderGraphBuilder& builder, DepthPrepassData& data) {
+				data.Depth = builder.Write(depth, RenderResourceUsage::DepthStencil);
+			},
+			[this, &statistics](const DepthPrepassData& data, CommandBuffer& commandBuffer, const RenderPassResources& resources) {
+				commandBuffer.BindRenderTargets(nullptr, 0, resources.Get(data.Depth));
+				commandBuffer.BindShaderProgram(m_depthPrepassShader);
+				commandBuffer.BindResourceSet(m_depthPrepassShader, m_frameResources);
+				DrawDepth(statistics);
+			});
 
-				drawCalls++;
-				triangleCount += (sm.IndexCount / 3.f) * instanceCount;
+		return prepass.Depth;
+	}
+
+	void Renderer::AddForwardPasses(RenderResource color, RenderResource depth, const ShadowMaps& shadowMaps, DrawStatistics& statistics)
+	{
+		m_renderGraph.AddPass<OpaqueData>("Opaque",
+			[&](RenderGraphBuilder& builder, OpaqueData& data) {
+				data.Color = builder.Write(color);
+				data.Depth = builder.Write(depth, RenderResourceUsage::DepthStencil);
+				ReadShadowMaps(builder, shadowMaps, data.Shadows);
+			},
+			[this, &statistics, depthEqual = m_depthPrepass](const OpaqueData& data, CommandBuffer& commandBuffer, const RenderPassResources& resources) {
+				BinLights();
+				SetShadowMaps(m_frameResources, data.Shadows, resources);
+				commandBuffer.BindRenderTarget(resources.Get(data.Color), 0, resources.Get(data.Depth));
+				DrawOpaque(m_forwardShaders, depthEqual, statistics);
+				commandBuffer.BindDepthStencilState(0);
+
+				// The next frame starts by drawing into the shadow maps again. Every
+				// permutation reads the frame resources at the same slots.
+				commandBuffer.UnbindResourceSet(m_forwardShaders.Programs[0], m_frameResources);
+			});
+	}
+
+	void Renderer::AddDeferredPasses(RenderResource color, RenderResource depth, const ShadowMaps& shadowMaps, DrawStatistics& statistics)
+	{
+		using namespace DirectX;
+
+		auto colorTexture = Resource::Manager::GetTexture2D(m_colorTextureID);
+		const UINT width = colorTexture->Width;
+		const UINT height = colorTexture->Height;
+
+		// Pixels the geometry does not cover are skipped by the light pass,
+		// so the G-buffer is never cleared
+		const GBufferData& gBuffer = m_renderGraph.AddPass<GBufferData>("G-buffer",
+			[&](RenderGraphBuilder& builder, GBufferData& data) {
+				data.Color = builder.Write(builder.Create("G-buffer color", RenderResourceDesc::Texture(width, height, DXGI_FORMAT_R8G8B8A8_UNORM, 4)));
+				data.Normal = builder.Write(builder.Create("G-buffer normal", RenderResourceDesc::Texture(width, height, DXGI_FORMAT_R10G10B10A2_UNORM, 4)));
+				data.Emissive = builder.Write(builder.Create("G-buffer emissive", RenderResourceDesc::Texture(width, height, DXGI_FORMAT_R8G8B8A8_UNORM, 4)));
+				data.Roughness = builder.Write(builder.Create("G-buffer roughness", RenderResourceDesc::Texture(width, height, DXGI_FORMAT_R8_UNORM, 1)));
+				data.Depth = builder.Write(depth, RenderResourceUsage::DepthStencil);
+			},
+			[this, &statistics, depthEqual = m_depthPrepass](const GBufferData& data, CommandBuffer& commandBuffer, const RenderPassResources& resources) {
+				const ID targets[] = { resources.Get(data.Color), resources.Get(data.Normal), resources.Get(data.Emissive), resources.Get(data.Roughness) };
+				commandBuffer.BindRenderTargets(targets, (UINT)std::size(targets), resources.Get(data.Depth));
+				DrawOpaque(m_gBufferShaders, depthEqual, statistics);
+				commandBuffer.BindDepthStencilState(0);
+			});
+
+		// Lights are culled per tile on the GPU, no clusters needed
+		m_renderGraph.AddPass<TiledLightingData>("Tiled lighting",
+			[&](RenderGraphBuilder& builder, TiledLightingData& data) {
+				data.GBuffer.Color = builder.Read(gBuffer.Color);
+				data.GBuffer.Normal = builder.Read(gBuffer.Normal);
+				data.GBuffer.Emissive = builder.Read(gBuffer.Emissive);
+				data.GBuffer.Roughness = builder.Read(gBuffer.Roughness);
+				data.GBuffer.Depth = builder.Read(gBuffer.Depth);
+				data.Color = builder.Write(color, RenderResourceUsage::UnorderedAccess);
+				ReadShadowMaps(builder, shadowMaps, data.Shadows);
+			},
+			[this](const TiledLightingData& data, CommandBuffer& commandBuffer, const RenderPassResources& resources) {
+				// A tile shades with at most MAX_TILE_LIGHTS (512) of the lights touching
+				// it, see TiledDeferredLighting.hlsl. The others are left out of that
+				// tile without notice, there is no counter for it.
+				UINT lightCount = UploadLights();
+
+				XMMATRIX view = XMLoadFloat4x4(&m_clusterView.View);
+				XMMATRIX projection = XMLoadFloat4x4(&m_projection);
+
+				Resource::TiledLightingBufferData lightingData;
+				ZERO_MEMORY(lightingData);
+				XMStoreFloat4x4(&lightingData.InverseProjection, XMMatrixTranspose(XMMatrixInverse(nullptr, projection)));
+				XMStoreFloat4x4(&lightingData.InverseView, XMMatrixTranspose(XMMatrixInverse(nullptr, view)));
+				lightingData.ScreenOffset = { m_viewPort.TopLeftX, m_viewPort.TopLeftY };
+				lightingData.ScreenSize = { m_viewPort.Width, m_viewPort.Height };
+				lightingData.LightCount = lightCount;
+
+				commandBuffer.UpdateConstantBuffer(m_tiledLightingBufferID, &lightingData, sizeof(lightingData));
+				m_frameResources.SetTexture("GBufferColor", resources.Get(data.GBuffer.Color));
+				m_frameResources.SetTexture("GBufferNormal", resources.Get(data.GBuffer.Normal));
+				m_frameResources.SetTexture("GBufferEmissive", resources.Get(data.GBuffer.Emissive));
+				m_frameResources.SetTexture("GBufferRoughness", resources.Get(data.GBuffer.Roughness));
+				m_frameResources.SetDepthTexture("GBufferDepth", resources.Get(data.GBuffer.Depth));
+				m_frameResources.SetUnorderedAccess("Output", resources.Get(data.Color));
+				SetShadowMaps(m_frameResources, data.Shadows, resources);
+				commandBuffer.BindShaderProgram(m_tiledLightingShader);
+				commandBuffer.BindResourceSet(m_tiledLightingShader, m_frameResources);
+
+				UINT tilesX = ((UINT)m_viewPort.Width + TILE_SIZE - 1) / TILE_SIZE;
+				UINT tilesY = ((UINT)m_viewPort.Height + TILE_SIZE - 1) / TILE_SIZE;
+				commandBuffer.Dispatch(tilesX, tilesY);
+
+				// The next frame starts by writing these again, G-buffer, shadow maps and output
+				commandBuffer.UnbindResourceSet(m_tiledLightingShader, m_frameResources);
+			});
+	}
+
+	void Renderer::RequestTextureResolution(const Resource::Mesh& mesh, const std::vector<Resource::ObjectBufferData>& instances)
+	{
+		using namespace DirectX;
+
+		XMVECTOR cameraPosition = XMLoadFloat3(&m_cameraPosition);
+
+		// The instance closest to the camera decides the resolution for all of them
+		const XMFLOAT4X4* nearestWorld = nullptr;
+		float nearestDistance = FLT_MAX;
+		for (const Resource::ObjectBufferData& instance : instances)
+		{
+			XMVECTOR center = TransformPoint(instance.World, mesh.BoundsCenter);
+			float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(center, cameraPosition))) - mesh.BoundsRadius * GetMaxScale(instance.World);
+			if (distance < nearestDistance)
+			{
+				nearestDistance = distance;
+				nearestWorld = &instance.World;
 			}
 		}
 
-		m_instanceBufferData.clear();
+		if (!nearestWorld)
+		{
+			return;
+		}
+
+		float scale = GetMaxScale(*nearestWorld);
+		if (scale <= 0.f)
+		{
+			return;
+		}
+
+		for (const Resource::Mesh::Submesh& submesh : mesh.Submeshes)
+		{
+			auto material = Resource::Manager::GetMaterial(submesh.Material);
+			if (!material || submesh.TexcoordDensity <= 0.f)
+			{
+				continue;
+			}
+
+			XMVECTOR center = TransformPoint(*nearestWorld, submesh.BoundsCenter);
+			float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(center, cameraPosition))) - submesh.BoundsRadius * scale;
+			distance = std::max(distance, m_cameraNearPlane);
+
+			float texcoordsPerPixel = submesh.TexcoordDensity / scale * distance * m_worldPerPixel;
 
-		std::cout << "Draw calls: " << drawCalls << "\tInstances: " << instanceCount << "\tTriangle count: " << triangleCount << std::endl;
+			if (material->DiffuseMap)
+			{
+				Resource::TextureStreamer::Request(material->DiffuseMap, texcoordsPerPixel);
+			}
+			if (material->SpecularMap)
+			{
+				Resource::TextureStreamer::Request(material->SpecularMap, texcoordsPerPixel);
+			}
+			if (material->NormalMap)
+			{
+				Resource::TextureStreamer::Request(material->NormalMap, texcoordsPerPixel);
+			}
+		}
 	}
 }
@@ -0,0 +1,217 @@
+#include "pch.h"
+#include "Graphics/ShadowCascades.h"
+
+#include <immintrin.h>
+
+namespace
+{
+	// Fills the last group of four, touches no cascade
+	const float FAR_AWAY = 1e18f;
+}
+
+namespace Graphics
+{
+	ShadowCascades::ShadowCascades() :
+		m_cascades(),
+		m_lightView(),
+		m_direction({ 0.f, -1.f, 0.f }),
+		m_camera(),
+		m_splitLambda(0.8f)
+	{
+	}
+
+	ShadowCascades::~ShadowCascades()
+	{
+	}
+
+	void ShadowCascades::Update(const ClusterView& camera, const DirectX::XMFLOAT3& direction, float shadowDistance, float casterDistance)
+	{
+		using namespace DirectX;
+
+		m_camera = camera;
+
+		XMVECTOR lightDirection = XMVector3Normalize(XMLoadFloat3(&direction));
+		XMStoreFloat3(&m_direction, lightDirection);
+
+		// Only a rotation, the cascades place themselves in light space
+		XMVECTOR up = (std::abs(m_direction.y) > 0.99f) ? XMVectorSet(1.f, 0.f, 0.f, 0.f) : XMVectorSet(0.f, 1.f, 0.f, 0.f);
+		XMMATRIX lightView = XMMatrixLookToLH(XMVectorZero(), lightDirection, up);
+		XMStoreFloat4x4(&m_lightView, lightView);
+
+		XMMATRIX inverseCameraView = XMMatrixInverse(nullptr, XMLoadFloat4x4(&camera.View));
+
+		const float nearPlane = camera.NearPlane;
+		const float farPlane = std::max(std::min(camera.FarPlane, shadowDistance), nearPlane * 2.f);
+		const float tanY = std::tan(camera.FOV * 0.5f);
+		const float tanX = tanY * camera.AspectRatio;
+		const float diagonal = std::sqrt(tanX * tanX + tanY * tanY);
+
+		for (UINT i = 0; i < CASCADE_COUNT; i++)
+		{
+			Cascade& cascade = m_cascades[i];
+
+			// Blend of logarithmic and even splits
+			float fraction = (float)(i + 1) / CASCADE_COUNT;
+			float logSplit = nearPlane * std::pow(farPlane / nearPlane, fraction);
+			float evenSplit = nearPlane + (farPlane - nearPlane) * fraction;
+			cascade.NearDepth = (i == 0) ? nearPlane : m_cascades[i - 1].FarDepth;
+			cascade.FarDepth = m_splitLambda * logSplit + (1.f - m_splitLambda) * evenSplit;
+
+			// Smallest sphere around the slice, its center is on the view axis
+			// where the near and far corners are equally far away
+			float nearDepth = cascade.NearDepth;
+			float farDepth = cascade.FarDepth;
+			float nearSquared = nearDepth * diagonal * nearDepth * diagonal;
+			float farSquared = farDepth * diagonal * farDepth * diagonal;
+			float centerDepth = (farSquared - nearSquared + farDepth * farDepth - nearDepth * nearDepth) / (2.f * (farDepth - nearDepth));
+			centerDepth = std::min(std::max(centerDepth, nearDepth), farDepth);
+			float radius = std::sqrt(std::max(nearSquared + (centerDepth - nearDepth) * (centerDepth - nearDepth),
+				farSquared + (farDepth - centerDepth) * (farDepth - centerDepth)));
+
+			// Rounded up, float noise must not change the texel size
+			radius = std::ceil(radius * 16.f) / 16.f;
+			cascade.Radius = radius;
+			cascade.TexelSize = 2.f * radius / RESOLUTION;
+
+			XMVECTOR center = XMVector3TransformCoord(XMVectorSet(0.f, 0.f, centerDepth, 1.f), inverseCameraView);
+			center = XMVector3TransformCoord(center, lightView);
+
+			// Whole texels, so moving the camera never shifts the texel grid
+			XMFLOAT3 lightCenter;
+			XMStoreFloat3(&lightCenter, center);
+			lightCenter.x = std::floor(lightCenter.x / cascade.TexelSize) * cascade.TexelSize;
+			lightCenter.y = std::floor(lightCenter.y / cascade.TexelSize) * cascade.TexelSize;
+			cascade.Center = lightCenter;
+			cascade.LightNear = lightCenter.z - radius - casterDistance;
+			cascade.LightFar = lightCenter.z + radius;
+
+			XMMATRIX projection = XMMatrixOrthographicOffCenterLH(
+				lightCenter.x - radius, lightCenter.x + radius,
+				lightCenter.y - radius, lightCenter.y + radius,
+				cascade.LightNear, cascade.LightFar);
+			XMStoreFloat4x4(&cascade.ViewProjection, XMMatrixMultiply(lightView, projection));
+		}
+	}
+
+	void ShadowCascades::Cull(const ShadowCaster* casters, size_t casterCount, std::vector<UINT> (&visible)[CASCADE_COUNT]) const
+	{
+		static_assert(sizeof(ShadowCaster) == 4 * sizeof(float), "Casters are loaded as one vector each");
+
+		for (std::vector<UINT>& list : visible)
+		{
+			list.clear();
+		}
+
+		const DirectX::XMFLOAT4X4& view = m_lightView;
+		const __m128 signMask = _mm_set1_ps(-0.f);
+
+		__m128 centerX[CASCADE_COUNT], centerY[CASCADE_COUNT], radius[CASCADE_COUNT], lightNear[CASCADE_COUNT], lightFar[CASCADE_COUNT];
+		for (UINT c = 0; c < CASCADE_COUNT; c++)
+		{
+			centerX[c] = _mm_set1_ps(m_cascades[c].Center.x);
+			centerY[c] = _mm_set1_ps(m_cascades[c].Center.y);
+			radius[c] = _mm_set1_ps(m_cascades[c].Radius);
+			lightNear[c] = _mm_set1_ps(m_cascades[c].LightNear);
+			lightFar[c] = _mm_set1_ps(m_cascades[c].LightFar);
+		}
+
+		ShadowCaster padded[4];
+		for (size_t i = 0; i < casterCount; i += 4)
+		{
+			const ShadowCaster* group = casters + i;
+			if (i + 4 > casterCount)
+			{
+				for (size_t lane = 0; lane < 4; lane++)
+				{
+					padded[lane] = (i + lane < casterCount) ? casters[i + lane] : ShadowCaster{ { FAR_AWAY, FAR_AWAY, FAR_AWAY }, 0.f };
+				}
+				group = padded;
+			}
+
+			// Four casters as x, y, z and radius vectors
+			__m128 x = _mm_loadu_ps(&group[0].Center.x);
+			__m128 y = _mm_loadu_ps(&group[1].Center.x);
+			__m128 z = _mm_loadu_ps(&group[2].Center.x);
+			__m128 r = _mm_loadu_ps(&group[3].Center.x);
+			_MM_TRANSPOSE4_PS(x, y, z, r);
+
+			__m128 lightX = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(view._11)), _mm_mul_ps(y, _mm_set1_ps(view._21))), _mm_mul_ps(z, _mm_set1_ps(view._31)));
+			__m128 lightY = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(view._12)), _mm_mul_ps(y, _mm_set1_ps(view._22))), _mm_mul_ps(z, _mm_set1_ps(view._32)));
+			__m128 lightZ = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(view._13)), _mm_mul_ps(y, _mm_set1_ps(view._23))), _mm_mul_ps(z, _mm_set1_ps(view._33)));
+
+			for (UINT c = 0; c < CASCADE_COUNT; c++)
+			{
+				// Sphere against the cascade's light space box
+				__m128 extent = _mm_add_ps(radius[c], r);
+				__m128 dx = _mm_andnot_ps(signMask, _mm_sub_ps(lightX, centerX[c]));
+				__m128 dy = _mm_andnot_ps(signMask, _mm_sub_ps(lightY, centerY[c]));
+				__m128 inside = _mm_and_ps(_mm_cmple_ps(dx, extent), _mm_cmple_ps(dy, extent));
+				inside = _mm_and_ps(inside, _mm_cmple_ps(_mm_sub_ps(lightZ, r), lightFar[c]));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(lightZ, r), lightNear[c]));
+
+				int mask = _mm_movemask_ps(inside);
+				for (UINT lane = (UINT)i; mask; lane++, mask >>= 1)
+				{
+					if (mask & 1)
+					{
+						visible[c].push_back(lane);
+					}
+				}
+			}
+		}
+	}
+
+	bool ShadowCascades::IsVisible(UINT cascade, const ShadowCaster& caster) const
+	{
+		const DirectX::XMFLOAT4X4& view = m_lightView;
+		const Cascade& box = m_cascades[cascade];
+		const DirectX::XMFLOAT3& center = caster.Center;
+
+		float lightX = center.x * view._11 + center.y * view._21 + center.z * view._31;
+		float lightY = center.x * view._12 + center.y * view._22 + center.z * view._32;
+		float lightZ = center.x * view._13 + center.y * view._23 + center.z * view._33;
+
+		return std::abs(lightX - box.Center.x) <= box.Radius + caster.Radius
+			&& std::abs(lightY - box.Center.y) <= box.Radius + caster.Radius
+			&& lightZ - caster.Radius <= box.LightFar
+			&& lightZ + caster.Radius >= box.LightNear;
+	}
+
+	void ShadowCascades::GetSliceCorners(UINT cascade, DirectX::XMFLOAT3 (&corners)[8]) const
+	{
+		const float tanY = std::tan(m_camera.FOV * 0.5f);
+		const float tanX = tanY * m_camera.AspectRatio;
+
+		UINT corner = 0;
+		for (float depth : { m_cascades[cascade].NearDepth, m_cascades[cascade].FarDepth })
+		{
+			for (float y : { -1.f, 1.f })
+			{
+				for (float x : { -1.f, 1.f })
+				{
+					corners[corner++] = { x * tanX * depth, y * tanY * depth, depth };
+				}
+			}
+		}
+	}
+
+	Resource::ShadowBufferData ShadowCascades::GetBufferData(const DirectX::XMFLOAT3& color) const
+	{
+		using namespace DirectX;
+
+		static_assert(CASCADE_COUNT == 4, "ShadowBufferData holds four cascades");
+
+		Resource::ShadowBufferData data;
+		ZERO_MEMORY(data);
+		for (UINT i = 0; i < CASCADE_COUNT; i++)
+		{
+			XMStoreFloat4x4(&data.Cascades[i], XMMatrixTranspose(XMLoadFloat4x4(&m_cascades[i].ViewProjection)));
+		}
+		data.SplitDepths = { m_cascades[0].FarDepth, m_cascades[1].FarDepth, m_cascades[2].FarDepth, m_cascades[3].FarDepth };
+		data.TexelSizes = { m_cascades[0].TexelSize, m_cascades[1].TexelSize, m_cascades[2].TexelSize, m_cascades[3].TexelSize };
+		data.Direction = m_direction;
+		data.Color = color;
+		data.CascadeCount = CASCADE_COUNT;
+		return data;
+	}
+}
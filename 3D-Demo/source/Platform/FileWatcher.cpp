@@ -0,0 +1,159 @@
+#include "pch.h"
+#include "Platform/FileWatcher.h"
+
+namespace
+{
+	// How long the thread waits before it looks at new directories or stops
+	const DWORD WAIT_INTERVAL_MS = 250;
+
+	// Editors write a file in more than one go, read it once they are done
+	const auto SETTLE_TIME = std::chrono::milliseconds(50);
+
+	std::filesystem::file_time_type GetWriteTime(const std::string& filePath)
+	{
+		std::error_code error;
+		std::filesystem::file_time_type writeTime = std::filesystem::last_write_time(filePath, error);
+		return error ? std::filesystem::file_time_type::min() : writeTime;
+	}
+}
+
+namespace Platform
+{
+	FileWatcher::FileWatcher() :
+		m_directoriesChanged(false),
+		m_running(true)
+	{
+		m_thread = std::thread(&FileWatcher::WatchThreadMain, this);
+	}
+
+	FileWatcher::~FileWatcher()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_running = false;
+		}
+		m_thread.join();
+	}
+
+	void FileWatcher::Watch(const std::string& filePath)
+	{
+		std::filesystem::path path = std::filesystem::absolute(filePath).lexically_normal();
+		std::string directory = path.parent_path().string();
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		for (const WatchedFile& file : m_files)
+		{
+			if (file.Path == filePath)
+			{
+				return;
+			}
+		}
+
+		m_files.push_back({ filePath, directory, GetWriteTime(filePath) });
+
+		if (std::find(m_directories.begin(), m_directories.end(), directory) == m_directories.end())
+		{
+			m_directories.push_back(directory);
+			m_directoriesChanged = true;
+		}
+	}
+
+	std::vector<std::string> FileWatcher::GetChangedFiles()
+	{
+		std::vector<std::string> changed;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			changed.swap(m_changed);
+		}
+		return changed;
+	}
+
+	void FileWatcher::CheckDirectory(const std::string& directory)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		for (WatchedFile& file : m_files)
+		{
+			if (file.Directory != directory)
+			{
+				continue;
+			}
+
+			std::filesystem::file_time_type writeTime = GetWriteTime(file.Path);
+			if (writeTime == file.WriteTime)
+			{
+				continue;
+			}
+
+			file.WriteTime = writeTime;
+			if (std::find(m_changed.begin(), m_changed.end(), file.Path) == m_changed.end())
+			{
+				m_changed.push_back(file.Path);
+			}
+		}
+	}
+
+	void FileWatcher::WatchThreadMain()
+	{
+		std::vector<HANDLE> handles;
+		std::vector<std::string> handleDirectories;
+
+		auto closeHandles = [&]() {
+			for (HANDLE handle : handles)
+			{
+				FindCloseChangeNotification(handle);
+			}
+			handles.clear();
+			handleDirectories.clear();
+		};
+
+		while (true)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				if (!m_running)
+				{
+					break;
+				}
+
+				// One notification per directory, opened again when a directory is added
+				if (m_directoriesChanged)
+				{
+					m_directoriesChanged = false;
+					closeHandles();
+
+					for (const std::string& directory : m_directories)
+					{
+						HANDLE handle = FindFirstChangeNotificationA(directory.c_str(), FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+						if (handle != INVALID_HANDLE_VALUE)
+						{
+							handles.push_back(handle);
+							handleDirectories.push_back(directory);
+						}
+					}
+				}
+			}
+
+			if (handles.empty())
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(WAIT_INTERVAL_MS));
+				continue;
+			}
+
+			DWORD result = WaitForMultipleObjects((DWORD)handles.size(), handles.data(), FALSE, WAIT_INTERVAL_MS);
+			if (result < WAIT_OBJECT_0 || result >= WAIT_OBJECT_0 + handles.size())
+			{
+				continue;
+			}
+
+			size_t index = result - WAIT_OBJECT_0;
+			std::this_thread::sleep_for(SETTLE_TIME);
+			FindNextChangeNotification(handles[index]);
+			CheckDirectory(handleDirectories[index]);
+		}
+
+		closeHandles();
+	}
+}
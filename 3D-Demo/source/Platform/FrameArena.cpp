@@ -0,0 +1,138 @@
+#include "pch.h"
+#include "Platform/FrameArena.h"
+#include "Platform/HeapCounter.h"
+
+#include <climits>
+
+namespace
+{
+	// Larger allocations get a block of their own
+	const size_t BLOCK_SIZE = 256 * 1024;
+
+	// Sub-arena of the current thread, assigned on its first allocation
+	const UINT NO_THREAD = UINT_MAX;
+	thread_local UINT t_threadIndex = NO_THREAD;
+}
+
+namespace Platform
+{
+	std::unique_ptr<FrameArena> FrameArena::s_instance;
+
+	void FrameArena::Initialize()
+	{
+		if (!s_instance)
+		{
+			s_instance = std::make_unique<FrameArena>();
+		}
+	}
+
+	void FrameArena::Finalize()
+	{
+		s_instance.reset();
+	}
+
+	FrameArena::FrameArena() :
+		m_frame(0),
+		m_threadCount(0),
+		m_blockAllocations(0),
+		m_frameStartHeapAllocations(HeapCounter::GetAllocationCount())
+	{
+		for (UINT frame = 0; frame < FRAME_COUNT; frame++)
+		{
+			m_subArenas[frame].resize(MAX_THREADS + 1);
+		}
+	}
+
+	FrameArena::~FrameArena()
+	{
+	}
+
+	void* FrameArena::AllocateInternal(size_t size, size_t alignment)
+	{
+		if (t_threadIndex == NO_THREAD)
+		{
+			t_threadIndex = std::min(m_threadCount.fetch_add(1), MAX_THREADS);
+		}
+
+		SubArena& subArena = m_subArenas[m_frame.load()][t_threadIndex];
+		if (t_threadIndex < MAX_THREADS)
+		{
+			return AllocateFrom(subArena, size, alignment);
+		}
+
+		std::lock_guard<std::mutex> lock(m_sharedMutex);
+		return AllocateFrom(subArena, size, alignment);
+	}
+
+	void* FrameArena::AllocateFrom(SubArena& subArena, size_t size, size_t alignment)
+	{
+		size = std::max(size, (size_t)1);
+
+		// Rest of the current block, then the kept blocks, then a new one
+		for (; subArena.BlockIndex < subArena.Blocks.size(); subArena.BlockIndex++, subArena.Offset = 0)
+		{
+			Block& block = subArena.Blocks[subArena.BlockIndex];
+			uintptr_t address = (uintptr_t)block.Memory.get() + subArena.Offset;
+			size_t padding = (alignment - address % alignment) % alignment;
+			if (subArena.Offset + padding + size <= block.Size)
+			{
+				subArena.Offset += padding + size;
+				subArena.Used += padding + size;
+				return (void*)(address + padding);
+			}
+		}
+
+		Block block;
+		block.Size = std::max(BLOCK_SIZE, size + alignment);
+		block.Memory = std::make_unique<unsigned char[]>(block.Size);
+		m_blockAllocations++;
+
+		uintptr_t address = (uintptr_t)block.Memory.get();
+		size_t padding = (alignment - address % alignment) % alignment;
+		subArena.Blocks.push_back(std::move(block));
+		subArena.BlockIndex = subArena.Blocks.size() - 1;
+		subArena.Offset = padding + size;
+		subArena.Used += padding + size;
+		return (void*)(address + padding);
+	}
+
+	void FrameArena::NextFrameInternal()
+	{
+		UINT frame = m_frame.load();
+
+		m_statistics.FrameBytes = 0;
+		for (const SubArena& subArena : m_subArenas[frame])
+		{
+			m_statistics.FrameBytes += subArena.Used;
+		}
+		m_statistics.PeakFrameBytes = std::max(m_statistics.PeakFrameBytes, m_statistics.FrameBytes);
+
+		m_statistics.ReservedBytes = 0;
+		for (UINT i = 0; i < FRAME_COUNT; i++)
+		{
+			for (const SubArena& subArena : m_subArenas[i])
+			{
+				for (const Block& block : subArena.Blocks)
+				{
+					m_statistics.ReservedBytes += block.Size;
+				}
+			}
+		}
+
+		m_statistics.BlockAllocations = m_blockAllocations.exchange(0);
+
+		size_t heapAllocations = HeapCounter::GetAllocationCount();
+		m_statistics.HeapAllocations = heapAllocations - m_frameStartHeapAllocations;
+		m_frameStartHeapAllocations = heapAllocations;
+
+		// The oldest frame becomes the current one
+		frame = (frame + 1) % FRAME_COUNT;
+		for (SubArena& subArena : m_subArenas[frame])
+		{
+			subArena.BlockIndex = 0;
+			subArena.Offset = 0;
+			subArena.Used = 0;
+		}
+		m_frame = frame;
+	}
+}
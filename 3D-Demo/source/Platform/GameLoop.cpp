@@ -0,0 +1,145 @@
+#include "pch.h"
+#include "Platform/GameLoop.h"
+#include "Platform/Profiler.h"
+
+#include <cfloat>
+
+namespace
+{
+	// Timer wake ups can be late by about this much, the rest is spent yielding
+	const std::chrono::microseconds TIMER_SLACK(1000);
+}
+
+namespace Platform
+{
+	GameLoop::GameLoop(const GameLoopSettings& settings) :
+		m_settings(settings),
+		m_timer(NULL)
+	{
+		// High resolution timers need Windows 10 1803, older versions get a
+		// regular timer with the system tick granularity
+		m_timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+		if (!m_timer)
+		{
+			m_timer = CreateWaitableTimerA(NULL, TRUE, NULL);
+		}
+	}
+
+	GameLoop::~GameLoop()
+	{
+		if (m_timer)
+		{
+			CloseHandle(m_timer);
+		}
+	}
+
+	void GameLoop::Run(const UpdateFunction& update, const RenderFunction& render, const RunningFunction& running)
+	{
+		using Seconds = std::chrono::duration<double>;
+
+		const Clock::duration fixedDelta = std::chrono::duration_cast<Clock::duration>(Seconds(m_settings.FixedDelta));
+		const Clock::duration targetFrameTime = std::chrono::duration_cast<Clock::duration>(Seconds(m_settings.TargetFrameTime));
+		const bool headless = m_settings.HeadlessFrames > 0;
+
+		m_statistics = GameLoopStatistics();
+		m_statistics.MinFrameTime = DBL_MAX;
+
+		Clock::time_point start = Clock::now();
+		Clock::time_point previous = start;
+		Clock::time_point nextFrame = start;
+		Clock::duration accumulated = Clock::duration::zero();
+
+		while (running())
+		{
+			if (headless && m_statistics.Frames >= m_settings.HeadlessFrames)
+			{
+				break;
+			}
+
+			Clock::time_point now = Clock::now();
+			Clock::duration frameTime = now - previous;
+			previous = now;
+
+			if (m_statistics.Frames > 0)
+			{
+				double frameSeconds = Seconds(frameTime).count();
+				m_statistics.MinFrameTime = std::min(m_statistics.MinFrameTime, frameSeconds);
+				m_statistics.MaxFrameTime = std::max(m_statistics.MaxFrameTime, frameSeconds);
+			}
+
+			float alpha;
+			if (headless)
+			{
+				// One update per frame, so runs are repeatable however fast they go
+				update((float)m_settings.FixedDelta);
+				m_statistics.Updates++;
+				alpha = 1.f;
+			}
+			else
+			{
+				accumulated += frameTime;
+
+				UINT updates = 0;
+				while (accumulated >= fixedDelta && updates < m_settings.MaxUpdatesPerFrame)
+				{
+					update((float)m_settings.FixedDelta);
+					accumulated -= fixedDelta;
+					updates++;
+				}
+				m_statistics.Updates += updates;
+
+				// Too slow to keep up, the remaining time is dropped
+				if (accumulated >= fixedDelta)
+				{
+					accumulated = Clock::duration::zero();
+				}
+
+				alpha = (float)(Seconds(accumulated).count() / m_settings.FixedDelta);
+			}
+
+			render(alpha);
+			m_statistics.Frames++;
+
+			// The frame zone runs mark to mark, so it includes the wait
+			Profiler::FrameMark();
+
+			if (!headless && targetFrameTime > Clock::duration::zero())
+			{
+				// Paced against a schedule so waking up late does not add up,
+				// a frame that ran over starts the schedule again
+				nextFrame += targetFrameTime;
+				if (nextFrame < Clock::now())
+				{
+					nextFrame = Clock::now();
+				}
+				WaitUntil(nextFrame);
+			}
+		}
+
+		m_statistics.Seconds = Seconds(Clock::now() - start).count();
+		if (m_statistics.Frames < 2)
+		{
+			m_statistics.MinFrameTime = m_statistics.MaxFrameTime = m_statistics.Seconds;
+		}
+	}
+
+	void GameLoop::WaitUntil(Clock::time_point time)
+	{
+		Clock::duration remaining = time - Clock::now();
+		if (m_timer && remaining > TIMER_SLACK)
+		{
+			// Relative due time, in 100 ns units
+			LARGE_INTEGER dueTime;
+			dueTime.QuadPart = -(LONGLONG)(std::chrono::duration_cast<std::chrono::nanoseconds>(remaining - TIMER_SLACK).count() / 100);
+			if (SetWaitableTimer(m_timer, &dueTime, 0, NULL, NULL, FALSE))
+			{
+				WaitForSingleObject(m_timer, INFINITE);
+			}
+		}
+
+		while (Clock::now() < time)
+		{
+			std::this_thread::yield();
+		}
+	}
+}
@@ -0,0 +1,37 @@
+#include "pch.h"
+#include "Platform/HeapCounter.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+	std::atomic<size_t> s_allocationCount = 0;
+}
+
+// The array, nothrow and sized forms of the standard library all end up in
+// these two, aligned allocations keep their default implementation
+void* operator new(size_t size)
+{
+	s_allocationCount.fetch_add(1, std::memory_order_relaxed);
+
+	void* memory = std::malloc(size ? size : 1);
+	if (!memory)
+	{
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+namespace Platform
+{
+	size_t HeapCounter::GetAllocationCount()
+	{
+		return s_allocationCount.load(std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,293 @@
+#include "pch.h"
+#include "Platform/JobSystem.h"
+
+namespace
+{
+	// Deque of the current thread, threads outside the pool use the shared one
+	const size_t NO_QUEUE = SIZE_MAX;
+	thread_local size_t t_queueIndex = NO_QUEUE;
+
+	// Attempts to find a job before a worker goes to sleep
+	const int SPIN_COUNT = 64;
+}
+
+namespace Platform
+{
+	std::unique_ptr<JobSystem> JobSystem::s_instance;
+
+	void JobSystem::Initialize(UINT workerCount)
+	{
+		if (!s_instance)
+		{
+			s_instance.reset(new JobSystem(workerCount));
+		}
+	}
+
+	void JobSystem::Finalize()
+	{
+		s_instance.reset();
+	}
+
+	UINT JobSystem::WorkerCount()
+	{
+		if (!s_instance)
+		{
+			Initialize();
+		}
+		return (UINT)s_instance->m_workers.size();
+	}
+
+	void JobSystem::Run(std::function<void()> job, JobCounter* counter, JobCounter* dependency)
+	{
+		if (!s_instance)
+		{
+			Initialize();
+		}
+
+		if (counter)
+		{
+			counter->m_pending++;
+		}
+
+		if (dependency)
+		{
+			std::lock_guard<std::mutex> lock(dependency->m_mutex);
+			if (!dependency->IsDone())
+			{
+				dependency->m_continuations.push_back({ std::move(job), counter });
+				return;
+			}
+		}
+
+		s_instance->Push({ std::move(job), counter });
+	}
+
+	void JobSystem::Wait(JobCounter& counter)
+	{
+		if (!s_instance)
+		{
+			Initialize();
+		}
+
+		while (!counter.IsDone())
+		{
+			if (!s_instance->TryRunJob())
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(counter.m_mutex);
+	}
+
+	void JobSystem::ParallelFor(size_t count, const std::function<void(size_t)>& task)
+	{
+		if (count == 0)
+		{
+			return;
+		}
+
+		// Indices are handed out one at a time, which balances uneven tasks
+		std::atomic<size_t> next = 0;
+		auto work = [&]() {
+			size_t index;
+			while ((index = next.fetch_add(1)) < count)
+			{
+				task(index);
+			}
+		};
+
+		JobCounter counter;
+		size_t helperCount = std::min(count - 1, (size_t)WorkerCount());
+		for (size_t i = 0; i < helperCount; i++)
+		{
+			Run(work, &counter);
+		}
+
+		work();
+		Wait(counter);
+	}
+
+	void JobSystem::ParallelForRange(size_t count, size_t grainSize, const std::function<void(size_t, size_t)>& task)
+	{
+		grainSize = std::max((size_t)1, grainSize);
+		if (count <= grainSize)
+		{
+			if (count > 0)
+			{
+				task(0, count);
+			}
+			return;
+		}
+
+		// The caller keeps the first range, the others can be stolen
+		JobCounter counter;
+		for (size_t begin = grainSize; begin < count; begin += grainSize)
+		{
+			size_t end = std::min(count, begin + grainSize);
+			Run([&task, begin, end]() { task(begin, end); }, &counter);
+		}
+
+		task(0, grainSize);
+		Wait(counter);
+	}
+
+	JobSystem::JobSystem(UINT workerCount) :
+		m_queuedJobs(0),
+		m_sleepingWorkers(0),
+		m_running(true)
+	{
+		if (workerCount == 0)
+		{
+			// Leave one hardware thread for the main thread
+			UINT hardwareThreads = std::thread::hardware_concurrency();
+			workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+		}
+
+		for (UINT i = 0; i <= workerCount; i++)
+		{
+			m_queues.push_back(std::make_unique<WorkerQueue>());
+		}
+
+		for (UINT i = 0; i < workerCount; i++)
+		{
+			m_workers.emplace_back(&JobSystem::WorkerMain, this, (size_t)i);
+		}
+	}
+
+	JobSystem::~JobSystem()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+			m_running = false;
+		}
+		m_wakeCondition.notify_all();
+
+		for (auto& worker : m_workers)
+		{
+			worker.join();
+		}
+	}
+
+	void JobSystem::Push(Job&& job)
+	{
+		size_t queueIndex = (t_queueIndex != NO_QUEUE) ? t_queueIndex : m_queues.size() - 1;
+		{
+			WorkerQueue& queue = *m_queues[queueIndex];
+			std::lock_guard<std::mutex> lock(queue.Mutex);
+			queue.Jobs.push_back(std::move(job));
+			m_queuedJobs++;
+		}
+
+		if (m_sleepingWorkers.load() > 0)
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+			m_wakeCondition.notify_one();
+		}
+	}
+
+	bool JobSystem::TryRunJob()
+	{
+		if (m_queuedJobs.load() == 0)
+		{
+			return false;
+		}
+
+		size_t ownIndex = (t_queueIndex != NO_QUEUE) ? t_queueIndex : m_queues.size() - 1;
+		Job job;
+		bool found = false;
+
+		// Newest job of the own deque, it is most likely still in the cache
+		{
+			WorkerQueue& queue = *m_queues[ownIndex];
+			std::lock_guard<std::mutex> lock(queue.Mutex);
+			if (!queue.Jobs.empty())
+			{
+				job = std::move(queue.Jobs.back());
+				queue.Jobs.pop_back();
+				found = true;
+			}
+		}
+
+		// Oldest job of another deque, starting with the next one so thieves spread out
+		for (size_t i = 1; !found && i < m_queues.size(); i++)
+		{
+			WorkerQueue& queue = *m_queues[(ownIndex + i) % m_queues.size()];
+			std::lock_guard<std::mutex> lock(queue.Mutex);
+			if (!queue.Jobs.empty())
+			{
+				job = std::move(queue.Jobs.front());
+				queue.Jobs.pop_front();
+				found = true;
+			}
+		}
+
+		if (!found)
+		{
+			return false;
+		}
+
+		m_queuedJobs--;
+		job.Function();
+		Finish(job.Counter);
+		return true;
+	}
+
+	void JobSystem::Finish(JobCounter* counter)
+	{
+		if (!counter)
+		{
+			return;
+		}
+
+		// Decremented under the lock, Wait takes it before returning so the
+		// counter is not destroyed while it is still in use here
+		std::vector<Job> continuations;
+		{
+			std::lock_guard<std::mutex> lock(counter->m_mutex);
+			if (--counter->m_pending != 0)
+			{
+				return;
+			}
+			continuations.swap(counter->m_continuations);
+		}
+
+		for (Job& continuation : continuations)
+		{
+			Push(std::move(continuation));
+		}
+	}
+
+	void JobSystem::WorkerMain(size_t queueIndex)
+	{
+		t_queueIndex = queueIndex;
+
+		while (true)
+		{
+			bool ranJob = false;
+			for (int spin = 0; spin < SPIN_COUNT && !ranJob; spin++)
+			{
+				ranJob = TryRunJob();
+				if (!ranJob)
+				{
+					std::this_thread::yield();
+				}
+			}
+
+			if (ranJob)
+			{
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(m_sleepMutex);
+			m_sleepingWorkers++;
+			m_wakeCondition.wait(lock, [this]() { return !m_running || m_queuedJobs.load() > 0; });
+			m_sleepingWorkers--;
+
+			if (!m_running && m_queuedJobs.load() == 0)
+			{
+				return;
+			}
+		}
+	}
+}
@@ -0,0 +1,322 @@
+#include "pch.h"
+#include "Platform/Profiler.h"
+
+#include <fstream>
+#include <iomanip>
+
+namespace
+{
+	// A capture stops keeping events past this, about 200 MB
+	const size_t MAX_CAPTURED_EVENTS = 4 * 1024 * 1024;
+
+	// Trace thread the GPU zones are shown on
+	const UINT GPU_TRACE_THREAD = 0xFFFF;
+
+	// Ring of the current thread, registered on its first event
+	thread_local void* t_ringOwner = nullptr;
+	thread_local void* t_ring = nullptr;
+
+	void WriteJsonString(std::ostream& stream, const char* text)
+	{
+		stream << '"';
+		for (const char* c = text; *c; c++)
+		{
+			if (*c == '"' || *c == '\\')
+			{
+				stream << '\\';
+			}
+			stream << *c;
+		}
+		stream << '"';
+	}
+}
+
+namespace Platform
+{
+	std::unique_ptr<Profiler> Profiler::s_instance;
+
+	void Profiler::Initialize()
+	{
+		if (!s_instance)
+		{
+			s_instance = std::make_unique<Profiler>();
+		}
+	}
+
+	void Profiler::Finalize()
+	{
+		s_instance.reset();
+	}
+
+	Profiler::Profiler() :
+		m_frame(0),
+		m_frameStart(Now()),
+		m_reportInterval(0),
+		m_capturing(false)
+	{
+	}
+
+	Profiler::~Profiler()
+	{
+	}
+
+	Profiler::ThreadRing& Profiler::GetThreadRing()
+	{
+		if (t_ringOwner != this)
+		{
+			std::lock_guard<std::mutex> lock(m_ringsMutex);
+			m_rings.push_back(std::make_unique<ThreadRing>());
+			m_rings.back()->Thread = (UINT)m_rings.size() - 1;
+			t_ring = m_rings.back().get();
+			t_ringOwner = this;
+		}
+		return *(ThreadRing*)t_ring;
+	}
+
+	void Profiler::RecordInternal(EventType type, const char* name, UINT64 start, UINT64 end, double value)
+	{
+		ThreadRing& ring = GetThreadRing();
+
+		// Only this thread writes, FrameMark only moves Read forward
+		size_t write = ring.Write.load(std::memory_order_relaxed);
+		if (write - ring.Read.load(std::memory_order_acquire) >= RING_SIZE)
+		{
+			ring.Dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		Event& event = ring.Events[write % RING_SIZE];
+		event.Type = type;
+		event.Name = name;
+		event.Start = start;
+		event.End = end;
+		event.Value = value;
+		ring.Write.store(write + 1, std::memory_order_release);
+	}
+
+	void Profiler::FrameMarkInternal()
+	{
+		UINT64 now = Now();
+		RecordInternal(EventType::Frame, "Frame", m_frameStart, now, 0.0);
+		m_frameStart = now;
+
+		size_t dropped = 0;
+		{
+			std::lock_guard<std::mutex> lock(m_ringsMutex);
+			for (auto& ring : m_rings)
+			{
+				Drain(*ring);
+				dropped += ring->Dropped.exchange(0);
+			}
+		}
+		if (dropped > 0)
+		{
+			m_counters["Dropped profiler events"] = (double)dropped;
+		}
+
+		size_t slot = m_frame % WINDOW_SIZE;
+		for (ZoneStatistics& zone : m_zones)
+		{
+			zone.History[slot] = zone.FrameTime;
+			zone.CallHistory[slot] = zone.FrameCalls;
+			zone.FrameTime = 0.0;
+			zone.FrameCalls = 0;
+		}
+		m_frame++;
+
+		if (m_reportInterval > 0 && m_frame % m_reportInterval == 0)
+		{
+			PrintSummary(std::cout);
+		}
+	}
+
+	void Profiler::Drain(ThreadRing& ring)
+	{
+		size_t read = ring.Read.load(std::memory_order_relaxed);
+		size_t write = ring.Write.load(std::memory_order_acquire);
+		bool capturing = m_capturing.load();
+
+		for (; read != write; read++)
+		{
+			const Event& event = ring.Events[read % RING_SIZE];
+			if (event.Type == EventType::Counter)
+			{
+				m_counters[event.Name] = event.Value;
+			}
+			else
+			{
+				ZoneStatistics& zone = GetZone(event.Name, event.Type == EventType::GpuZone);
+				zone.FrameTime += (event.End - event.Start) / 1000000.0;
+				zone.FrameCalls++;
+			}
+
+			if (capturing && m_captured.size() < MAX_CAPTURED_EVENTS)
+			{
+				m_captured.push_back({ event, ring.Thread });
+			}
+		}
+
+		ring.Read.store(read, std::memory_order_release);
+	}
+
+	Profiler::ZoneStatistics& Profiler::GetZone(const char* name, bool gpu)
+	{
+		auto index = m_zoneIndices[gpu].find(name);
+		if (index != m_zoneIndices[gpu].end())
+		{
+			return m_zones[index->second];
+		}
+
+		// The same literal can have a different address in every translation unit
+		auto named = m_zoneNames[gpu].find(name);
+		if (named == m_zoneNames[gpu].end())
+		{
+			named = m_zoneNames[gpu].emplace(name, m_zones.size()).first;
+			m_zones.emplace_back();
+			m_zones.back().Name = name;
+			m_zones.back().Gpu = gpu;
+		}
+		m_zoneIndices[gpu][name] = named->second;
+		return m_zones[named->second];
+	}
+
+	std::vector<ZoneSummary> Profiler::GetSummaryInternal()
+	{
+		std::vector<ZoneSummary> summaries;
+		size_t frameCount = (size_t)std::min<UINT64>(m_frame, WINDOW_SIZE);
+		if (frameCount == 0)
+		{
+			return summaries;
+		}
+
+		std::vector<double> times(frameCount);
+		for (const ZoneStatistics& zone : m_zones)
+		{
+			ZoneSummary summary;
+			summary.Name = zone.Name;
+			summary.Gpu = zone.Gpu;
+			summary.Min = zone.History[0];
+
+			UINT64 calls = 0;
+			for (size_t i = 0; i < frameCount; i++)
+			{
+				times[i] = zone.History[i];
+				summary.Min = std::min(summary.Min, times[i]);
+				summary.Average += times[i];
+				calls += zone.CallHistory[i];
+			}
+			summary.Average /= frameCount;
+			summary.CallsPerFrame = (double)calls / frameCount;
+
+			size_t p99 = (frameCount * 99 + 99) / 100 - 1;
+			std::nth_element(times.begin(), times.begin() + p99, times.end());
+			summary.P99 = times[p99];
+
+			summaries.push_back(summary);
+		}
+
+		std::sort(summaries.begin(), summaries.end(), [](const ZoneSummary& a, const ZoneSummary& b) { return a.Average > b.Average; });
+		return summaries;
+	}
+
+	void Profiler::PrintSummary(std::ostream& stream)
+	{
+		if (!s_instance) { Initialize(); }
+
+		std::ostringstream text;
+		text << std::fixed << std::setprecision(3);
+		text << "Frame " << s_instance->m_frame << ", last " << std::min<UINT64>(s_instance->m_frame, WINDOW_SIZE) << " frames (ms min / avg / p99, calls):" << std::endl;
+		for (const ZoneSummary& zone : s_instance->GetSummaryInternal())
+		{
+			text << "\t" << std::left << std::setw(32) << (zone.Gpu ? "GPU " + zone.Name : zone.Name) << std::right
+				<< std::setw(9) << zone.Min << std::setw(9) << zone.Average << std::setw(9) << zone.P99
+				<< std::setw(9) << std::setprecision(1) << zone.CallsPerFrame << std::setprecision(3) << std::endl;
+		}
+		for (const auto& counter : s_instance->m_counters)
+		{
+			text << "\t" << std::left << std::setw(32) << counter.first << std::right << std::setprecision(0) << counter.second << std::setprecision(3) << std::endl;
+		}
+
+		// One write, the console is slow
+		stream << text.str() << std::flush;
+	}
+
+	bool Profiler::EndCaptureInternal(const std::string& filePath)
+	{
+		// Events after the last frame mark are still in the rings
+		{
+			std::lock_guard<std::mutex> lock(m_ringsMutex);
+			for (auto& ring : m_rings)
+			{
+				Drain(*ring);
+			}
+		}
+		m_capturing = false;
+
+		std::vector<CapturedEvent> events;
+		events.swap(m_captured);
+
+		std::ofstream file(filePath);
+		if (!file)
+		{
+			std::cerr << "Could not write the trace " << filePath << std::endl;
+			return false;
+		}
+
+		UINT64 origin = UINT64_MAX;
+		bool gpuEvents = false;
+		for (const CapturedEvent& captured : events)
+		{
+			origin = std::min(origin, captured.Data.Start);
+			gpuEvents |= captured.Data.Type == EventType::GpuZone;
+		}
+
+		// Chrome trace format, timestamps in microseconds
+		file << std::fixed << std::setprecision(3);
+		file << "{\"traceEvents\":[" << std::endl;
+		file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"3D-Demo\"}}";
+		{
+			std::lock_guard<std::mutex> lock(m_ringsMutex);
+			for (auto& ring : m_rings)
+			{
+				std::string name = (ring->Thread == 0) ? "Main" : "Thread " + std::to_string(ring->Thread);
+				file << "," << std::endl << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << ring->Thread
+					<< ",\"args\":{\"name\":\"" << name << "\"}}";
+			}
+		}
+		if (gpuEvents)
+		{
+			file << "," << std::endl << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << GPU_TRACE_THREAD
+				<< ",\"args\":{\"name\":\"GPU\"}}";
+		}
+
+		for (const CapturedEvent& captured : events)
+		{
+			const Event& event = captured.Data;
+			// Frame marks are instants at the end of their frame
+			double time = ((event.Type == EventType::Frame ? event.End : event.Start) - origin) / 1000.0;
+
+			file << "," << std::endl << "{\"name\":";
+			WriteJsonString(file, event.Name);
+			UINT thread = (event.Type == EventType::GpuZone) ? GPU_TRACE_THREAD : captured.Thread;
+			file << ",\"pid\":0,\"tid\":" << thread << ",\"ts\":" << time;
+
+			switch (event.Type)
+			{
+			case EventType::Zone:
+			case EventType::GpuZone:
+				file << ",\"ph\":\"X\",\"dur\":" << (event.End - event.Start) / 1000.0 << "}";
+				break;
+			case EventType::Counter:
+				file << ",\"ph\":\"C\",\"args\":{\"value\":" << event.Value << "}}";
+				break;
+			case EventType::Frame:
+				file << ",\"ph\":\"i\",\"s\":\"g\"}";
+				break;
+			}
+		}
+
+		file << std::endl << "]}" << std::endl;
+		return (bool)file;
+	}
+}
@@ -0,0 +1,930 @@
+#include "pch.h"
+#include "Resource/BlockCompression.h"
+#include "Platform/JobSystem.h"
+
+#include <climits>
+#include <cmath>
+
+namespace
+{
+	using Resource::CompressionQuality;
+
+	/**
+	* -------------------------------------------------------------------------
+	*								SHARED HELPERS
+	* -------------------------------------------------------------------------
+	*/
+
+	inline int Clamp(int value, int low, int high)
+	{
+		return (value < low) ? low : (value > high) ? high : value;
+	}
+
+	void FetchBlock(const unsigned char* pixels, UINT width, UINT height, UINT blockX, UINT blockY, unsigned char block[64])
+	{
+		for (UINT y = 0; y < 4; y++)
+		{
+			UINT sourceY = std::min(blockY * 4 + y, height - 1);
+			for (UINT x = 0; x < 4; x++)
+			{
+				UINT sourceX = std::min(blockX * 4 + x, width - 1);
+				memcpy(block + (y * 4 + x) * 4, pixels + ((size_t)sourceY * width + sourceX) * 4, 4);
+			}
+		}
+	}
+
+	void StoreBlock(const unsigned char block[64], unsigned char* pixels, UINT width, UINT height, UINT blockX, UINT blockY)
+	{
+		for (UINT y = 0; y < 4 && blockY * 4 + y < height; y++)
+		{
+			for (UINT x = 0; x < 4 && blockX * 4 + x < width; x++)
+			{
+				memcpy(pixels + ((size_t)(blockY * 4 + y) * width + blockX * 4 + x) * 4, block + (y * 4 + x) * 4, 4);
+			}
+		}
+	}
+
+	// Endpoints spanning the per channel minimum and maximum, pulled in by a
+	// sixteenth of the range since the extremes are rarely hit exactly
+	void BoundingBoxEndpoints(const float points[16][4], int channels, float a[4], float b[4])
+	{
+		for (int c = 0; c < channels; c++)
+		{
+			float low = points[0][c];
+			float high = points[0][c];
+			for (int i = 1; i < 16; i++)
+			{
+				low = std::min(low, points[i][c]);
+				high = std::max(high, points[i][c]);
+			}
+
+			float inset = (high - low) / 16.f;
+			a[c] = high - inset;
+			b[c] = low + inset;
+		}
+	}
+
+	// Endpoints at the extremes of the block projected on its principal axis
+	void PrincipalAxisEndpoints(const float points[16][4], int channels, float a[4], float b[4])
+	{
+		float mean[4] = { 0.f, 0.f, 0.f, 0.f };
+		for (int i = 0; i < 16; i++)
+			for (int c = 0; c < channels; c++)
+				mean[c] += points[i][c] / 16.f;
+
+		float covariance[4][4] = {};
+		for (int i = 0; i < 16; i++)
+		{
+			for (int r = 0; r < channels; r++)
+			{
+				for (int c = 0; c < channels; c++)
+				{
+					covariance[r][c] += (points[i][r] - mean[r]) * (points[i][c] - mean[c]);
+				}
+			}
+		}
+
+		// Power iteration, starting along the bounding box diagonal
+		float axis[4] = { 0.f, 0.f, 0.f, 0.f };
+		{
+			float low[4], high[4];
+			BoundingBoxEndpoints(points, channels, high, low);
+			for (int c = 0; c < channels; c++)
+				axis[c] = high[c] - low[c] + 1e-3f;
+		}
+
+		for (int iteration = 0; iteration < 8; iteration++)
+		{
+			float next[4] = { 0.f, 0.f, 0.f, 0.f };
+			for (int r = 0; r < channels; r++)
+				for (int c = 0; c < channels; c++)
+					next[r] += covariance[r][c] * axis[c];
+
+			float length = 0.f;
+			for (int c = 0; c < channels; c++)
+				length = std::max(length, std::abs(next[c]));
+
+			if (length < 1e-6f)
+				break;
+
+			for (int c = 0; c < channels; c++)
+				axis[c] = next[c] / length;
+		}
+
+		float minProjection = FLT_MAX;
+		float maxProjection = -FLT_MAX;
+		for (int i = 0; i < 16; i++)
+		{
+			float projection = 0.f;
+			for (int c = 0; c < channels; c++)
+				projection += (points[i][c] - mean[c]) * axis[c];
+
+			minProjection = std::min(minProjection, projection);
+			maxProjection = std::max(maxProjection, projection);
+		}
+
+		float lengthSquared = 0.f;
+		for (int c = 0; c < channels; c++)
+			lengthSquared += axis[c] * axis[c];
+		lengthSquared = std::max(lengthSquared, 1e-6f);
+
+		for (int c = 0; c < channels; c++)
+		{
+			a[c] = mean[c] + axis[c] * maxProjection / lengthSquared;
+			b[c] = mean[c] + axis[c] * minProjection / lengthSquared;
+		}
+	}
+
+	// Least squares endpoints for fixed interpolation weights, weight is the
+	// fraction of b in each texel. Returns false if the system is singular.
+	bool RefineEndpoints(const float points[16][4], int channels, const float weights[16], float a[4], float b[4])
+	{
+		float alpha2 = 0.f;
+		float beta2 = 0.f;
+		float alphaBeta = 0.f;
+		float alphaX[4] = { 0.f, 0.f, 0.f, 0.f };
+		float betaX[4] = { 0.f, 0.f, 0.f, 0.f };
+
+		for (int i = 0; i < 16; i++)
+		{
+			float beta = weights[i];
+			float alpha = 1.f - beta;
+
+			alpha2 += alpha * alpha;
+			beta2 += beta * beta;
+			alphaBeta += alpha * beta;
+
+			for (int c = 0; c < channels; c++)
+			{
+				alphaX[c] += alpha * points[i][c];
+				betaX[c] += beta * points[i][c];
+			}
+		}
+
+		float determinant = alpha2 * beta2 - alphaBeta * alphaBeta;
+		if (std::abs(determinant) < 1e-6f)
+		{
+			return false;
+		}
+
+		for (int c = 0; c < channels; c++)
+		{
+			a[c] = std::min(std::max((alphaX[c] * beta2 - betaX[c] * alphaBeta) / determinant, 0.f), 255.f);
+			b[c] = std::min(std::max((betaX[c] * alpha2 - alphaX[c] * alphaBeta) / determinant, 0.f), 255.f);
+		}
+
+		return true;
+	}
+
+	/**
+	* -------------------------------------------------------------------------
+	*							BC1 COLOR BLOCKS
+	* -------------------------------------------------------------------------
+	*/
+
+	inline uint16_t Pack565(const float color[4])
+	{
+		int r = Clamp((int)(color[0] * 31.f / 255.f + 0.5f), 0, 31);
+		int g = Clamp((int)(color[1] * 63.f / 255.f + 0.5f), 0, 63);
+		int b = Clamp((int)(color[2] * 31.f / 255.f + 0.5f), 0, 31);
+		return (uint16_t)((r << 11) | (g << 5) | b);
+	}
+
+	inline void Unpack565(uint16_t packed, int color[3])
+	{
+		int r = (packed >> 11) & 31;
+		int g = (packed >> 5) & 63;
+		int b = packed & 31;
+		color[0] = (r << 3) | (r >> 2);
+		color[1] = (g << 2) | (g >> 4);
+		color[2] = (b << 3) | (b >> 2);
+	}
+
+	// Weight of the second endpoint for each BC1 index in four color mode
+	const float BC1_WEIGHTS[4] = { 0.f, 1.f, 1.f / 3.f, 2.f / 3.f };
+
+	// Picks indices for quantized endpoints, returns the squared error
+	float SelectColorIndices(const float points[16][4], uint16_t color0, uint16_t color1, uint32_t& indices)
+	{
+		int palette[4][3];
+		Unpack565(color0, palette[0]);
+		Unpack565(color1, palette[1]);
+		for (int c = 0; c < 3; c++)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+
+		float totalError = 0.f;
+		indices = 0;
+
+		for (int i = 0; i < 16; i++)
+		{
+			int bestIndex = 0;
+			float bestError = FLT_MAX;
+			for (int p = 0; p < 4; p++)
+			{
+				float error = 0.f;
+				for (int c = 0; c < 3; c++)
+				{
+					float difference = points[i][c] - palette[p][c];
+					error += difference * difference;
+				}
+
+				if (error < bestError)
+				{
+					bestError = error;
+					bestIndex = p;
+				}
+			}
+
+			indices |= (uint32_t)bestIndex << (i * 2);
+			totalError += bestError;
+		}
+
+		return totalError;
+	}
+
+	float QuantizeColorBlock(const float points[16][4], const float a[4], const float b[4], uint16_t& color0, uint16_t& color1, uint32_t& indices)
+	{
+		color0 = Pack565(a);
+		color1 = Pack565(b);
+
+		// Four color mode requires color0 > color1, a flat block ends up in three
+		// color mode where index 0 still decodes to color0
+		if (color0 < color1)
+		{
+			std::swap(color0, color1);
+		}
+
+		float error = SelectColorIndices(points, color0, color1, indices);
+		if (color0 == color1)
+		{
+			indices = 0;
+		}
+		return error;
+	}
+
+	void EncodeColorBlock(const unsigned char block[64], unsigned char* out, CompressionQuality quality)
+	{
+		float points[16][4];
+		for (int i = 0; i < 16; i++)
+			for (int c = 0; c < 4; c++)
+				points[i][c] = block[i * 4 + c];
+
+		float a[4], b[4];
+		uint16_t color0, color1;
+		uint32_t indices;
+
+		if (quality == CompressionQuality::Fast)
+		{
+			BoundingBoxEndpoints(points, 3, a, b);
+			QuantizeColorBlock(points, a, b, color0, color1, indices);
+		}
+		else
+		{
+			PrincipalAxisEndpoints(points, 3, a, b);
+			float error = QuantizeColorBlock(points, a, b, color0, color1, indices);
+
+			for (int iteration = 0; iteration < 2 && color0 != color1; iteration++)
+			{
+				float weights[16];
+				for (int i = 0; i < 16; i++)
+					weights[i] = BC1_WEIGHTS[(indices >> (i * 2)) & 3];
+
+				float refinedA[4], refinedB[4];
+				if (!RefineEndpoints(points, 3, weights, refinedA, refinedB))
+					break;
+
+				uint16_t refinedColor0, refinedColor1;
+				uint32_t refinedIndices;
+				float refinedError = QuantizeColorBlock(points, refinedA, refinedB, refinedColor0, refinedColor1, refinedIndices);
+
+				if (refinedError >= error)
+					break;
+
+				error = refinedError;
+				color0 = refinedColor0;
+				color1 = refinedColor1;
+				indices = refinedIndices;
+			}
+		}
+
+		out[0] = (unsigned char)(color0 & 0xff);
+		out[1] = (unsigned char)(color0 >> 8);
+		out[2] = (unsigned char)(color1 & 0xff);
+		out[3] = (unsigned char)(color1 >> 8);
+		out[4] = (unsigned char)(indices & 0xff);
+		out[5] = (unsigned char)((indices >> 8) & 0xff);
+		out[6] = (unsigned char)((indices >> 16) & 0xff);
+		out[7] = (unsigned char)(indices >> 24);
+	}
+
+	void DecodeColorBlock(const unsigned char* in, unsigned char block[64], bool allowThreeColor)
+	{
+		uint16_t color0 = (uint16_t)(in[0] | (in[1] << 8));
+		uint16_t color1 = (uint16_t)(in[2] | (in[3] << 8));
+		uint32_t indices = in[4] | (in[5] << 8) | (in[6] << 16) | ((uint32_t)in[7] << 24);
+
+		int palette[4][4];
+		Unpack565(color0, palette[0]);
+		Unpack565(color1, palette[1]);
+		palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+
+		if (color0 > color1 || !allowThreeColor)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+		}
+		else
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+				palette[3][c] = 0;
+			}
+			palette[3][3] = 0;
+		}
+
+		for (int i = 0; i < 16; i++)
+		{
+			int index = (indices >> (i * 2)) & 3;
+			for (int c = 0; c < 4; c++)
+				block[i * 4 + c] = (unsigned char)palette[index][c];
+		}
+	}
+
+	/**
+	* -------------------------------------------------------------------------
+	*						BC4 SINGLE CHANNEL BLOCKS
+	* -------------------------------------------------------------------------
+	*/
+
+	void BuildChannelPalette(int value0, int value1, int palette[8])
+	{
+		palette[0] = value0;
+		palette[1] = value1;
+
+		if (value0 > value1)
+		{
+			for (int i = 2; i < 8; i++)
+				palette[i] = ((8 - i) * value0 + (i - 1) * value1) / 7;
+		}
+		else
+		{
+			for (int i = 2; i < 6; i++)
+				palette[i] = ((6 - i) * value0 + (i - 1) * value1) / 5;
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+	}
+
+	int SelectChannelIndices(const int values[16], int value0, int value1, int indices[16])
+	{
+		int palette[8];
+		BuildChannelPalette(value0, value1, palette);
+
+		int totalError = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			int bestIndex = 0;
+			int bestError = INT_MAX;
+			for (int p = 0; p < 8; p++)
+			{
+				int error = (values[i] - palette[p]) * (values[i] - palette[p]);
+				if (error < bestError)
+				{
+					bestError = error;
+					bestIndex = p;
+				}
+			}
+			indices[i] = bestIndex;
+			totalError += bestError;
+		}
+		return totalError;
+	}
+
+	void EncodeChannelBlock(const unsigned char block[64], int channel, unsigned char* out, CompressionQuality quality)
+	{
+		int values[16];
+		int low = 255;
+		int high = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			values[i] = block[i * 4 + channel];
+			low = std::min(low, values[i]);
+			high = std::max(high, values[i]);
+		}
+
+		// Eight value mode spanning the block range
+		int value0 = high;
+		int value1 = low;
+		int indices[16];
+		int error = SelectChannelIndices(values, value0, value1, indices);
+
+		if (quality == CompressionQuality::High)
+		{
+			// Six value mode has exact 0 and 255, so the range only has to span the rest
+			int innerLow = 255;
+			int innerHigh = 0;
+			for (int i = 0; i < 16; i++)
+			{
+				if (values[i] != 0 && values[i] != 255)
+				{
+					innerLow = std::min(innerLow, values[i]);
+					innerHigh = std::max(innerHigh, values[i]);
+				}
+			}
+
+			if (innerLow <= innerHigh)
+			{
+				int sixIndices[16];
+				int sixError = SelectChannelIndices(values, innerLow, innerHigh, sixIndices);
+				if (sixError < error)
+				{
+					error = sixError;
+					value0 = innerLow;
+					value1 = innerHigh;
+					memcpy(indices, sixIndices, sizeof(indices));
+				}
+			}
+
+			// Try nudging the eight value endpoints inwards
+			for (int inset = 1; inset <= 4 && high - low > 2 * inset; inset++)
+			{
+				int insetIndices[16];
+				int insetError = SelectChannelIndices(values, high - inset, low + inset, insetIndices);
+				if (insetError < error)
+				{
+					error = insetError;
+					value0 = high - inset;
+					value1 = low + inset;
+					memcpy(indices, insetIndices, sizeof(indices));
+				}
+			}
+		}
+
+		out[0] = (unsigned char)value0;
+		out[1] = (unsigned char)value1;
+
+		uint64_t bits = 0;
+		for (int i = 0; i < 16; i++)
+			bits |= (uint64_t)indices[i] << (i * 3);
+
+		for (int i = 0; i < 6; i++)
+			out[2 + i] = (unsigned char)((bits >> (i * 8)) & 0xff);
+	}
+
+	void DecodeChannelBlock(const unsigned char* in, unsigned char block[64], int channel)
+	{
+		int palette[8];
+		BuildChannelPalette(in[0], in[1], palette);
+
+		uint64_t bits = 0;
+		for (int i = 0; i < 6; i++)
+			bits |= (uint64_t)in[2 + i] << (i * 8);
+
+		for (int i = 0; i < 16; i++)
+			block[i * 4 + channel] = (unsigned char)palette[(bits >> (i * 3)) & 7];
+	}
+
+	/**
+	* -------------------------------------------------------------------------
+	*						BC7 BLOCKS (MODE 6 ONLY)
+	*
+	* - One subset, RGBA endpoints with 7 bits and a shared bit per endpoint,
+	*   4-bit indices. Covers most color and alpha content well.
+	* -------------------------------------------------------------------------
+	*/
+
+	const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	class BitWriter
+	{
+	public:
+		BitWriter(unsigned char* out) : m_out(out), m_position(0) { memset(out, 0, 16); }
+
+		void Write(uint32_t value, int count)
+		{
+			for (int i = 0; i < count; i++, m_position++)
+				m_out[m_position / 8] |= (unsigned char)(((value >> i) & 1) << (m_position % 8));
+		}
+
+	private:
+		unsigned char* m_out;
+		int m_position;
+	};
+
+	class BitReader
+	{
+	public:
+		BitReader(const unsigned char* in) : m_in(in), m_position(0) {}
+
+		uint32_t Read(int count)
+		{
+			uint32_t value = 0;
+			for (int i = 0; i < count; i++, m_position++)
+				value |= (uint32_t)((m_in[m_position / 8] >> (m_position % 8)) & 1) << i;
+			return value;
+		}
+
+	private:
+		const unsigned char* m_in;
+		int m_position;
+	};
+
+	// Quantizes an endpoint to 7 bits per channel plus the shared bit that fits best
+	void QuantizeBC7Endpoint(const float endpoint[4], int quantized[4], int& pBit)
+	{
+		float bestError = FLT_MAX;
+		for (int p = 0; p < 2; p++)
+		{
+			int candidate[4];
+			float error = 0.f;
+			for (int c = 0; c < 4; c++)
+			{
+				candidate[c] = Clamp((int)((endpoint[c] - p) / 2.f + 0.5f), 0, 127);
+				float difference = endpoint[c] - ((candidate[c] << 1) | p);
+				error += difference * difference;
+			}
+
+			if (error < bestError)
+			{
+				bestError = error;
+				pBit = p;
+				memcpy(quantized, candidate, sizeof(candidate));
+			}
+		}
+	}
+
+	float SelectBC7Indices(const float points[16][4], const int endpoint0[4], int pBit0, const int endpoint1[4], int pBit1, int indices[16])
+	{
+		int palette[16][4];
+		for (int c = 0; c < 4; c++)
+		{
+			int value0 = (endpoint0[c] << 1) | pBit0;
+			int value1 = (endpoint1[c] << 1) | pBit1;
+			for (int i = 0; i < 16; i++)
+				palette[i][c] = ((64 - BC7_WEIGHTS[i]) * value0 + BC7_WEIGHTS[i] * value1 + 32) >> 6;
+		}
+
+		float totalError = 0.f;
+		for (int i = 0; i < 16; i++)
+		{
+			float bestError = FLT_MAX;
+			for (int p = 0; p < 16; p++)
+			{
+				float error = 0.f;
+				for (int c = 0; c < 4; c++)
+				{
+					float difference = points[i][c] - palette[p][c];
+					error += difference * difference;
+				}
+
+				if (error < bestError)
+				{
+					bestError = error;
+					indices[i] = p;
+				}
+			}
+			totalError += bestError;
+		}
+		return totalError;
+	}
+
+	void EncodeBC7Block(const unsigned char block[64], unsigned char* out, CompressionQuality quality)
+	{
+		float points[16][4];
+		for (int i = 0; i < 16; i++)
+			for (int c = 0; c < 4; c++)
+				points[i][c] = block[i * 4 + c];
+
+		float a[4], b[4];
+		if (quality == CompressionQuality::Fast)
+			BoundingBoxEndpoints(points, 4, a, b);
+		else
+			PrincipalAxisEndpoints(points, 4, a, b);
+
+		int endpoint0[4], endpoint1[4], pBit0, pBit1;
+		int indices[16];
+
+		QuantizeBC7Endpoint(a, endpoint0, pBit0);
+		QuantizeBC7Endpoint(b, endpoint1, pBit1);
+		float error = SelectBC7Indices(points, endpoint0, pBit0, endpoint1, pBit1, indices);
+
+		for (int iteration = 0; quality == CompressionQuality::High && iteration < 2; iteration++)
+		{
+			float weights[16];
+			for (int i = 0; i < 16; i++)
+				weights[i] = BC7_WEIGHTS[indices[i]] / 64.f;
+
+			float refinedA[4], refinedB[4];
+			if (!RefineEndpoints(points, 4, weights, refinedA, refinedB))
+				break;
+
+			int refined0[4], refined1[4], refinedPBit0, refinedPBit1, refinedIndices[16];
+			QuantizeBC7Endpoint(refinedA, refined0, refinedPBit0);
+			QuantizeBC7Endpoint(refinedB, refined1, refinedPBit1);
+			float refinedError = SelectBC7Indices(points, refined0, refinedPBit0, refined1, refinedPBit1, refinedIndices);
+
+			if (refinedError >= error)
+				break;
+
+			error = refinedError;
+			memcpy(endpoint0, refined0, sizeof(endpoint0));
+			memcpy(endpoint1, refined1, sizeof(endpoint1));
+			pBit0 = refinedPBit0;
+			pBit1 = refinedPBit1;
+			memcpy(indices, refinedIndices, sizeof(indices));
+		}
+
+		// The anchor index is stored without its top bit, so it has to be below 8
+		if (indices[0] & 8)
+		{
+			std::swap(endpoint0, endpoint1);
+			std::swap(pBit0, pBit1);
+			for (int i = 0; i < 16; i++)
+				indices[i] = 15 - indices[i];
+		}
+
+		BitWriter writer(out);
+		writer.Write(1 << 6, 7); // Mode 6
+		for (int c = 0; c < 4; c++)
+		{
+			writer.Write(endpoint0[c], 7);
+			writer.Write(endpoint1[c], 7);
+		}
+		writer.Write(pBit0, 1);
+		writer.Write(pBit1, 1);
+		writer.Write(indices[0], 3);
+		for (int i = 1; i < 16; i++)
+			writer.Write(indices[i], 4);
+	}
+
+	void DecodeBC7Block(const unsigned char* in, unsigned char block[64])
+	{
+		BitReader reader(in);
+
+		// Only mode 6 is written by the encoder, other modes decode as magenta
+		if (reader.Read(7) != (1 << 6))
+		{
+			for (int i = 0; i < 16; i++)
+			{
+				block[i * 4 + 0] = 255;
+				block[i * 4 + 1] = 0;
+				block[i * 4 + 2] = 255;
+				block[i * 4 + 3] = 255;
+			}
+			return;
+		}
+
+		int endpoint0[4], endpoint1[4];
+		for (int c = 0; c < 4; c++)
+		{
+			endpoint0[c] = reader.Read(7);
+			endpoint1[c] = reader.Read(7);
+		}
+		int pBit0 = reader.Read(1);
+		int pBit1 = reader.Read(1);
+
+		for (int i = 0; i < 16; i++)
+		{
+			int index = reader.Read(i == 0 ? 3 : 4);
+			for (int c = 0; c < 4; c++)
+			{
+				int value0 = (endpoint0[c] << 1) | pBit0;
+				int value1 = (endpoint1[c] << 1) | pBit1;
+				block[i * 4 + c] = (unsigned char)(((64 - BC7_WEIGHTS[index]) * value0 + BC7_WEIGHTS[index] * value1 + 32) >> 6);
+			}
+		}
+	}
+
+	/**
+	* -------------------------------------------------------------------------
+	*							BLOCK DISPATCH
+	* -------------------------------------------------------------------------
+	*/
+
+	void EncodeBlock(const unsigned char block[64], unsigned char* out, DXGI_FORMAT format, CompressionQuality quality)
+	{
+		switch (format)
+		{
+		case DXGI_FORMAT_BC1_UNORM:
+		case DXGI_FORMAT_BC1_UNORM_SRGB:
+			EncodeColorBlock(block, out, quality);
+			break;
+
+		case DXGI_FORMAT_BC3_UNORM:
+		case DXGI_FORMAT_BC3_UNORM_SRGB:
+			EncodeChannelBlock(block, 3, out, quality);
+			EncodeColorBlock(block, out + 8, quality);
+			break;
+
+		case DXGI_FORMAT_BC4_UNORM:
+			EncodeChannelBlock(block, 0, out, quality);
+			break;
+
+		case DXGI_FORMAT_BC5_UNORM:
+			EncodeChannelBlock(block, 0, out, quality);
+			EncodeChannelBlock(block, 1, out + 8, quality);
+			break;
+
+		case DXGI_FORMAT_BC7_UNORM:
+		case DXGI_FORMAT_BC7_UNORM_SRGB:
+			EncodeBC7Block(block, out, quality);
+			break;
+
+		default:
+			assert(false && "Unsupported block compression format");
+		}
+	}
+
+	void DecodeBlock(const unsigned char* in, unsigned char block[64], DXGI_FORMAT format)
+	{
+		switch (format)
+		{
+		case DXGI_FORMAT_BC1_UNORM:
+		case DXGI_FORMAT_BC1_UNORM_SRGB:
+			DecodeColorBlock(in, block, true);
+			break;
+
+		case DXGI_FORMAT_BC3_UNORM:
+		case DXGI_FORMAT_BC3_UNORM_SRGB:
+			DecodeColorBlock(in + 8, block, false);
+			DecodeChannelBlock(in, block, 3);
+			break;
+
+		case DXGI_FORMAT_BC4_UNORM:
+			for (int i = 0; i < 16; i++)
+			{
+				block[i * 4 + 1] = 0;
+				block[i * 4 + 2] = 0;
+				block[i * 4 + 3] = 255;
+			}
+			DecodeChannelBlock(in, block, 0);
+			break;
+
+		case DXGI_FORMAT_BC5_UNORM:
+			for (int i = 0; i < 16; i++)
+			{
+				block[i * 4 + 2] = 0;
+				block[i * 4 + 3] = 255;
+			}
+			DecodeChannelBlock(in, block, 0);
+			DecodeChannelBlock(in + 8, block, 1);
+			break;
+
+		case DXGI_FORMAT_BC7_UNORM:
+		case DXGI_FORMAT_BC7_UNORM_SRGB:
+			DecodeBC7Block(in, block);
+			break;
+
+		default:
+			memset(block, 0, 64);
+		}
+	}
+}
+
+namespace Resource
+{
+	UINT GetBlockSize(DXGI_FORMAT format)
+	{
+		switch (format)
+		{
+		case DXGI_FORMAT_BC1_UNORM:
+		case DXGI_FORMAT_BC1_UNORM_SRGB:
+		case DXGI_FORMAT_BC4_UNORM:
+		case DXGI_FORMAT_BC4_SNORM:
+			return 8;
+
+		case DXGI_FORMAT_BC2_UNORM:
+		case DXGI_FORMAT_BC2_UNORM_SRGB:
+		case DXGI_FORMAT_BC3_UNORM:
+		case DXGI_FORMAT_BC3_UNORM_SRGB:
+		case DXGI_FORMAT_BC5_UNORM:
+		case DXGI_FORMAT_BC5_SNORM:
+		case DXGI_FORMAT_BC6H_UF16:
+		case DXGI_FORMAT_BC6H_SF16:
+		case DXGI_FORMAT_BC7_UNORM:
+		case DXGI_FORMAT_BC7_UNORM_SRGB:
+			return 16;
+
+		default:
+			return 0;
+		}
+	}
+
+	UINT GetTexelSize(DXGI_FORMAT format)
+	{
+		switch (format)
+		{
+		case DXGI_FORMAT_R8_UNORM:
+			return 1;
+
+		case DXGI_FORMAT_R8G8_UNORM:
+		case DXGI_FORMAT_R16_UNORM:
+		case DXGI_FORMAT_R16_FLOAT:
+			return 2;
+
+		case DXGI_FORMAT_R16G16B16A16_FLOAT:
+		case DXGI_FORMAT_R16G16B16A16_UNORM:
+		case DXGI_FORMAT_R32G32_FLOAT:
+			return 8;
+
+		case DXGI_FORMAT_R32G32B32A32_FLOAT:
+			return 16;
+
+		default:
+			return 4;
+		}
+	}
+
+	size_t GetSurfaceSize(DXGI_FORMAT format, UINT width, UINT height, UINT* rowPitch)
+	{
+		UINT blockSize = GetBlockSize(format);
+		UINT pitch;
+		UINT rows;
+
+		if (blockSize)
+		{
+			pitch = std::max(1u, (width + 3) / 4) * blockSize;
+			rows = std::max(1u, (height + 3) / 4);
+		}
+		else
+		{
+			pitch = width * GetTexelSize(format);
+			rows = height;
+		}
+
+		if (rowPitch)
+		{
+			*rowPitch = pitch;
+		}
+		return (size_t)pitch * rows;
+	}
+
+	std::vector<unsigned char> CompressImage(const unsigned char* pixels, UINT width, UINT height, DXGI_FORMAT format, CompressionQuality quality)
+	{
+		UINT blockSize = GetBlockSize(format);
+		UINT blocksX = std::max(1u, (width + 3) / 4);
+		UINT blocksY = std::max(1u, (height + 3) / 4);
+
+		std::vector<unsigned char> blocks((size_t)blocksX * blocksY * blockSize);
+
+		Platform::JobSystem::ParallelFor(blocksY, [&](size_t blockY) {
+			unsigned char block[64];
+			for (UINT blockX = 0; blockX < blocksX; blockX++)
+			{
+				FetchBlock(pixels, width, height, blockX, (UINT)blockY, block);
+				EncodeBlock(block, blocks.data() + (blockY * blocksX + blockX) * blockSize, format, quality);
+			}
+		});
+
+		return blocks;
+	}
+
+	std::vector<unsigned char> DecompressImage(const unsigned char* blocks, UINT width, UINT height, DXGI_FORMAT format)
+	{
+		UINT blockSize = GetBlockSize(format);
+		UINT blocksX = std::max(1u, (width + 3) / 4);
+		UINT blocksY = std::max(1u, (height + 3) / 4);
+
+		std::vector<unsigned char> pixels((size_t)width * height * 4);
+
+		for (UINT blockY = 0; blockY < blocksY; blockY++)
+		{
+			for (UINT blockX = 0; blockX < blocksX; blockX++)
+			{
+				unsigned char block[64];
+				DecodeBlock(blocks + ((size_t)blockY * blocksX + blockX) * blockSize, block, format);
+				StoreBlock(block, pixels.data(), width, height, blockX, blockY);
+			}
+		}
+
+		return pixels;
+	}
+
+	double CalculatePSNR(const unsigned char* a, const unsigned char* b, UINT width, UINT height, UINT channelCount)
+	{
+		double squaredError = 0.0;
+		for (size_t i = 0; i < (size_t)width * height; i++)
+		{
+			for (UINT c = 0; c < channelCount; c++)
+			{
+				double difference = (double)a[i * 4 + c] - (double)b[i * 4 + c];
+				squaredError += difference * difference;
+			}
+		}
+
+		double meanSquaredError = squaredError / ((double)width * height * channelCount);
+		if (meanSquaredError <= 0.0)
+		{
+			return 99.0;
+		}
+
+		return 10.0 * std::log10(255.0 * 255.0 / meanSquaredError);
+	}
+}
@@ -0,0 +1,274 @@
+#include "pch.h"
+#include "Resource/DDS.h"
+#include "Resource/BlockCompression.h"
+
+namespace
+{
+	const uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+	const uint32_t DDS_FOURCC_DX10 = 0x30315844; // "DX10"
+
+	const uint32_t DDSD_CAPS = 0x1;
+	const uint32_t DDSD_HEIGHT = 0x2;
+	const uint32_t DDSD_WIDTH = 0x4;
+	const uint32_t DDSD_PITCH = 0x8;
+	const uint32_t DDSD_PIXELFORMAT = 0x1000;
+	const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+	const uint32_t DDSD_LINEARSIZE = 0x80000;
+
+	const uint32_t DDPF_FOURCC = 0x4;
+	const uint32_t DDPF_RGB = 0x40;
+
+	const uint32_t DDSCAPS_COMPLEX = 0x8;
+	const uint32_t DDSCAPS_TEXTURE = 0x1000;
+	const uint32_t DDSCAPS_MIPMAP = 0x400000;
+
+	const uint32_t DDSCAPS2_CUBEMAP_ALLFACES = 0xFE00;
+	const uint32_t DDSCAPS2_VOLUME = 0x200000;
+
+	const uint32_t DDS_DIMENSION_TEXTURE2D = 3;
+	const uint32_t DDS_RESOURCE_MISC_TEXTURECUBE = 0x4;
+
+	struct DDSPixelFormat
+	{
+		uint32_t Size;
+		uint32_t Flags;
+		uint32_t FourCC;
+		uint32_t RGBBitCount;
+		uint32_t RBitMask;
+		uint32_t GBitMask;
+		uint32_t BBitMask;
+		uint32_t ABitMask;
+	};
+
+	struct DDSHeader
+	{
+		uint32_t Size;
+		uint32_t Flags;
+		uint32_t Height;
+		uint32_t Width;
+		uint32_t PitchOrLinearSize;
+		uint32_t Depth;
+		uint32_t MipMapCount;
+		uint32_t Reserved1[11];
+		DDSPixelFormat PixelFormat;
+		uint32_t Caps;
+		uint32_t Caps2;
+		uint32_t Caps3;
+		uint32_t Caps4;
+		uint32_t Reserved2;
+	};
+
+	struct DDSHeaderDX10
+	{
+		uint32_t DXGIFormat;
+		uint32_t ResourceDimension;
+		uint32_t MiscFlag;
+		uint32_t ArraySize;
+		uint32_t MiscFlags2;
+	};
+
+	static_assert(sizeof(DDSHeader) == 124, "DDS header must be 124 bytes");
+	static_assert(sizeof(DDSHeaderDX10) == 20, "DDS DX10 header must be 20 bytes");
+
+	constexpr uint32_t MakeFourCC(char a, char b, char c, char d)
+	{
+		return (uint32_t)(unsigned char)a | ((uint32_t)(unsigned char)b << 8) | ((uint32_t)(unsigned char)c << 16) | ((uint32_t)(unsigned char)d << 24);
+	}
+
+	// Files written by older tools describe the format with a FourCC or bit masks
+	DXGI_FORMAT GetLegacyFormat(const DDSPixelFormat& pixelFormat)
+	{
+		if (pixelFormat.Flags & DDPF_FOURCC)
+		{
+			switch (pixelFormat.FourCC)
+			{
+			case MakeFourCC('D', 'X', 'T', '1'): return DXGI_FORMAT_BC1_UNORM;
+			case MakeFourCC('D', 'X', 'T', '2'):
+			case MakeFourCC('D', 'X', 'T', '3'): return DXGI_FORMAT_BC2_UNORM;
+			case MakeFourCC('D', 'X', 'T', '4'):
+			case MakeFourCC('D', 'X', 'T', '5'): return DXGI_FORMAT_BC3_UNORM;
+			case MakeFourCC('A', 'T', 'I', '1'):
+			case MakeFourCC('B', 'C', '4', 'U'): return DXGI_FORMAT_BC4_UNORM;
+			case MakeFourCC('A', 'T', 'I', '2'):
+			case MakeFourCC('B', 'C', '5', 'U'): return DXGI_FORMAT_BC5_UNORM;
+			default: return DXGI_FORMAT_UNKNOWN;
+			}
+		}
+
+		if ((pixelFormat.Flags & DDPF_RGB) && pixelFormat.RGBBitCount == 32)
+		{
+			if (pixelFormat.RBitMask == 0x000000ff && pixelFormat.GBitMask == 0x0000ff00 && pixelFormat.BBitMask == 0x00ff0000)
+			{
+				return DXGI_FORMAT_R8G8B8A8_UNORM;
+			}
+			if (pixelFormat.RBitMask == 0x00ff0000 && pixelFormat.GBitMask == 0x0000ff00 && pixelFormat.BBitMask == 0x000000ff)
+			{
+				return DXGI_FORMAT_B8G8R8A8_UNORM;
+			}
+		}
+
+		return DXGI_FORMAT_UNKNOWN;
+	}
+}
+
+namespace Resource
+{
+	bool WriteDDS(const std::string& filePath, const TextureData& texture)
+	{
+		if (texture.Levels.empty())
+		{
+			return false;
+		}
+
+		bool compressed = GetBlockSize(texture.Format) != 0;
+
+		UINT rowPitch;
+		size_t topLevelSize = GetSurfaceSize(texture.Format, texture.Width, texture.Height, &rowPitch);
+
+		DDSHeader header;
+		ZERO_MEMORY(header);
+		header.Size = sizeof(DDSHeader);
+		header.Flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT;
+		header.Flags |= compressed ? DDSD_LINEARSIZE : DDSD_PITCH;
+		header.Height = texture.Height;
+		header.Width = texture.Width;
+		header.PitchOrLinearSize = compressed ? (uint32_t)topLevelSize : rowPitch;
+		header.MipMapCount = (uint32_t)texture.Levels.size();
+		header.PixelFormat.Size = sizeof(DDSPixelFormat);
+		header.PixelFormat.Flags = DDPF_FOURCC;
+		header.PixelFormat.FourCC = DDS_FOURCC_DX10;
+		header.Caps = DDSCAPS_TEXTURE;
+		if (texture.Levels.size() > 1)
+		{
+			header.Caps |= DDSCAPS_MIPMAP | DDSCAPS_COMPLEX;
+		}
+
+		DDSHeaderDX10 headerDX10;
+		ZERO_MEMORY(headerDX10);
+		headerDX10.DXGIFormat = texture.Format;
+		headerDX10.ResourceDimension = DDS_DIMENSION_TEXTURE2D;
+		headerDX10.ArraySize = 1;
+
+		// Written to a temporary file first so an interrupted write never leaves a
+		// truncated file behind
+		std::string temporaryPath = filePath + ".tmp";
+		{
+			std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+			if (!file)
+			{
+				return false;
+			}
+
+			file.write((const char*)&DDS_MAGIC, sizeof(DDS_MAGIC));
+			file.write((const char*)&header, sizeof(header));
+			file.write((const char*)&headerDX10, sizeof(headerDX10));
+			for (const auto& level : texture.Levels)
+			{
+				file.write((const char*)level.data(), level.size());
+			}
+
+			if (!file)
+			{
+				return false;
+			}
+		}
+
+		std::error_code error;
+		std::filesystem::rename(temporaryPath, filePath, error);
+		return !error;
+	}
+
+	bool ParseDDS(const unsigned char* data, size_t size, TextureImage& image)
+	{
+		size_t offset = sizeof(uint32_t) + sizeof(DDSHeader);
+		if (size < offset || *(const uint32_t*)data != DDS_MAGIC)
+		{
+			return false;
+		}
+
+		DDSHeader header;
+		memcpy(&header, data + sizeof(uint32_t), sizeof(header));
+		if (header.Size != sizeof(DDSHeader) || header.PixelFormat.Size != sizeof(DDSPixelFormat))
+		{
+			return false;
+		}
+
+		image = TextureImage();
+		image.Width = header.Width;
+		image.Height = header.Height;
+		image.MipLevels = (header.Flags & DDSD_MIPMAPCOUNT) ? std::max(1u, header.MipMapCount) : 1;
+		image.ArraySize = 1;
+
+		if ((header.PixelFormat.Flags & DDPF_FOURCC) && header.PixelFormat.FourCC == DDS_FOURCC_DX10)
+		{
+			if (size < offset + sizeof(DDSHeaderDX10))
+			{
+				return false;
+			}
+
+			DDSHeaderDX10 headerDX10;
+			memcpy(&headerDX10, data + offset, sizeof(headerDX10));
+			offset += sizeof(DDSHeaderDX10);
+
+			if (headerDX10.ResourceDimension != DDS_DIMENSION_TEXTURE2D || headerDX10.ArraySize == 0)
+			{
+				return false;
+			}
+
+			image.Format = (DXGI_FORMAT)headerDX10.DXGIFormat;
+			image.ArraySize = headerDX10.ArraySize;
+			if (headerDX10.MiscFlag & DDS_RESOURCE_MISC_TEXTURECUBE)
+			{
+				image.Cube = true;
+				image.ArraySize *= 6;
+			}
+		}
+		else
+		{
+			image.Format = GetLegacyFormat(header.PixelFormat);
+			if ((header.Caps2 & DDSCAPS2_CUBEMAP_ALLFACES) == DDSCAPS2_CUBEMAP_ALLFACES)
+			{
+				image.Cube = true;
+				image.ArraySize = 6;
+			}
+			else if (header.Caps2 & DDSCAPS2_VOLUME)
+			{
+				return false;
+			}
+		}
+
+		if (image.Format == DXGI_FORMAT_UNKNOWN)
+		{
+			return false;
+		}
+
+		// Slices are stored one after the other, each with all of its mips
+		image.Subresources.resize((size_t)image.ArraySize * image.MipLevels);
+		for (UINT slice = 0; slice < image.ArraySize; slice++)
+		{
+			UINT width = image.Width;
+			UINT height = image.Height;
+
+			for (UINT level = 0; level < image.MipLevels; level++)
+			{
+				UINT rowPitch;
+				size_t surfaceSize = GetSurfaceSize(image.Format, width, height, &rowPitch);
+				if (offset + surfaceSize > size)
+				{
+					return false;
+				}
+
+				D3D11_SUBRESOURCE_DATA& subresource = image.Subresources[(size_t)slice * image.MipLevels + level];
+				subresource.pSysMem = data + offset;
+				subresource.SysMemPitch = rowPitch;
+				subresource.SysMemSlicePitch = (UINT)surfaceSize;
+
+				offset += surfaceSize;
+				width = std::max(1u, width / 2);
+				height = std::max(1u, height / 2);
+			}
+		}
+
+		return true;
+	}
+}
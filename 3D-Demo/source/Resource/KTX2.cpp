@@ -0,0 +1,154 @@
+#include "pch.h"
+#include "Resource/KTX2.h"
+#include "Resource/BlockCompression.h"
+
+namespace
+{
+	const unsigned char KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+	// The 64-bit fields follow an odd number of 32-bit ones, so the header is packed
+#pragma pack(push, 4)
+	struct KTX2Header
+	{
+		uint32_t VkFormat;
+		uint32_t TypeSize;
+		uint32_t PixelWidth;
+		uint32_t PixelHeight;
+		uint32_t PixelDepth;
+		uint32_t LayerCount;
+		uint32_t FaceCount;
+		uint32_t LevelCount;
+		uint32_t SupercompressionScheme;
+		uint32_t DFDByteOffset;
+		uint32_t DFDByteLength;
+		uint32_t KVDByteOffset;
+		uint32_t KVDByteLength;
+		uint64_t SGDByteOffset;
+		uint64_t SGDByteLength;
+	};
+#pragma pack(pop)
+
+	struct KTX2LevelIndex
+	{
+		uint64_t ByteOffset;
+		uint64_t ByteLength;
+		uint64_t UncompressedByteLength;
+	};
+
+	static_assert(sizeof(KTX2Header) == 68, "KTX2 header must be 68 bytes");
+	static_assert(sizeof(KTX2LevelIndex) == 24, "KTX2 level index entries must be 24 bytes");
+
+	DXGI_FORMAT GetFormatFromVk(uint32_t vkFormat)
+	{
+		switch (vkFormat)
+		{
+		case 37:	return DXGI_FORMAT_R8G8B8A8_UNORM;		// VK_FORMAT_R8G8B8A8_UNORM
+		case 43:	return DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;	// VK_FORMAT_R8G8B8A8_SRGB
+		case 44:	return DXGI_FORMAT_B8G8R8A8_UNORM;		// VK_FORMAT_B8G8R8A8_UNORM
+		case 50:	return DXGI_FORMAT_B8G8R8A8_UNORM_SRGB;	// VK_FORMAT_B8G8R8A8_SRGB
+		case 131:
+		case 133:	return DXGI_FORMAT_BC1_UNORM;			// VK_FORMAT_BC1_RGB(A)_UNORM_BLOCK
+		case 132:
+		case 134:	return DXGI_FORMAT_BC1_UNORM_SRGB;		// VK_FORMAT_BC1_RGB(A)_SRGB_BLOCK
+		case 135:	return DXGI_FORMAT_BC2_UNORM;
+		case 136:	return DXGI_FORMAT_BC2_UNORM_SRGB;
+		case 137:	return DXGI_FORMAT_BC3_UNORM;
+		case 138:	return DXGI_FORMAT_BC3_UNORM_SRGB;
+		case 139:	return DXGI_FORMAT_BC4_UNORM;
+		case 140:	return DXGI_FORMAT_BC4_SNORM;
+		case 141:	return DXGI_FORMAT_BC5_UNORM;
+		case 142:	return DXGI_FORMAT_BC5_SNORM;
+		case 143:	return DXGI_FORMAT_BC6H_UF16;
+		case 144:	return DXGI_FORMAT_BC6H_SF16;
+		case 145:	return DXGI_FORMAT_BC7_UNORM;
+		case 146:	return DXGI_FORMAT_BC7_UNORM_SRGB;
+		default:	return DXGI_FORMAT_UNKNOWN;
+		}
+	}
+}
+
+namespace Resource
+{
+	bool ParseKTX2(const unsigned char* data, size_t size, TextureImage& image)
+	{
+		size_t offset = sizeof(KTX2_IDENTIFIER) + sizeof(KTX2Header);
+		if (size < offset || memcmp(data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0)
+		{
+			return false;
+		}
+
+		KTX2Header header;
+		memcpy(&header, data + sizeof(KTX2_IDENTIFIER), sizeof(header));
+
+		// Depth textures and supercompressed (Basis, Zstandard) payloads are not handled
+		if (header.PixelHeight == 0 || header.PixelDepth > 1 || header.SupercompressionScheme != 0)
+		{
+			return false;
+		}
+
+		image = TextureImage();
+		image.Format = GetFormatFromVk(header.VkFormat);
+		image.Width = header.PixelWidth;
+		image.Height = header.PixelHeight;
+		image.MipLevels = std::max(1u, header.LevelCount);
+		image.Cube = header.FaceCount == 6;
+
+		size_t layerCount = std::max(1u, header.LayerCount);
+		size_t faceCount = image.Cube ? 6 : 1;
+
+		if (image.Format == DXGI_FORMAT_UNKNOWN)
+		{
+			return false;
+		}
+
+		// The counts come from the file, every subresource takes at least a byte of it
+		if (layerCount * faceCount > size || layerCount * faceCount * image.MipLevels > size)
+		{
+			return false;
+		}
+		image.ArraySize = (UINT)(layerCount * faceCount);
+
+		if (size < offset + (size_t)image.MipLevels * sizeof(KTX2LevelIndex))
+		{
+			return false;
+		}
+
+		// Unlike DDS, levels are stored one after the other, each holding every
+		// layer and face of that mip
+		image.Subresources.resize((size_t)image.ArraySize * image.MipLevels);
+
+		UINT width = image.Width;
+		UINT height = image.Height;
+
+		for (UINT level = 0; level < image.MipLevels; level++)
+		{
+			KTX2LevelIndex levelIndex;
+			memcpy(&levelIndex, data + offset + level * sizeof(KTX2LevelIndex), sizeof(levelIndex));
+
+			UINT rowPitch;
+			size_t surfaceSize = GetSurfaceSize(image.Format, width, height, &rowPitch);
+
+			// Written so nothing can wrap around
+			if (surfaceSize > size / image.ArraySize
+				|| levelIndex.ByteOffset > size
+				|| levelIndex.ByteLength > size - levelIndex.ByteOffset
+				|| levelIndex.ByteLength < surfaceSize * image.ArraySize)
+			{
+				return false;
+			}
+
+			for (UINT slice = 0; slice < image.ArraySize; slice++)
+			{
+				D3D11_SUBRESOURCE_DATA& subresource = image.Subresources[(size_t)slice * image.MipLevels + level];
+				subresource.pSysMem = data + levelIndex.ByteOffset + surfaceSize * slice;
+				subresource.SysMemPitch = rowPitch;
+				subresource.SysMemSlicePitch = (UINT)surfaceSize;
+			}
+
+			width = std::max(1u, width / 2);
+			height = std::max(1u, height / 2);
+		}
+
+		return true;
+	}
+}
@@ -0,0 +1,217 @@
+#include "pch.h"
+#include "Resource/MipChain.h"
+#include "Platform/JobSystem.h"
+
+#include <cmath>
+#include <emmintrin.h>
+
+namespace
+{
+	struct SRGBTables
+	{
+		float ToLinear[256];
+		unsigned char FromLinear[4096];
+
+		SRGBTables()
+		{
+			for (int i = 0; i < 256; i++)
+			{
+				float c = i / 255.f;
+				ToLinear[i] = (c <= 0.04045f) ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			}
+
+			for (int i = 0; i < 4096; i++)
+			{
+				float l = i / 4095.f;
+				float c = (l <= 0.0031308f) ? l * 12.92f : 1.055f * std::pow(l, 1.f / 2.4f) - 0.055f;
+				FromLinear[i] = (unsigned char)(c * 255.f + 0.5f);
+			}
+		}
+	};
+
+	const SRGBTables& GetSRGBTables()
+	{
+		static SRGBTables tables;
+		return tables;
+	}
+
+	inline unsigned char UnitToByte(float value)
+	{
+		value = (value < 0.f) ? 0.f : (value > 1.f) ? 1.f : value;
+		return (unsigned char)(value * 255.f + 0.5f);
+	}
+
+	float AlphaCoverage(const float* texels, size_t texelCount, float alphaReference, float scale)
+	{
+		size_t covered = 0;
+		for (size_t i = 0; i < texelCount; i++)
+		{
+			if (texels[i * 4 + 3] * scale >= alphaReference)
+			{
+				covered++;
+			}
+		}
+		return (float)covered / (float)texelCount;
+	}
+
+	float FindAlphaScale(const float* texels, size_t texelCount, float alphaReference, float targetCoverage)
+	{
+		float low = 0.f;
+		float high = 4.f;
+		float scale = 1.f;
+
+		float bestScale = 1.f;
+		float bestError = FLT_MAX;
+
+		for (int i = 0; i < 10; i++)
+		{
+			float coverage = AlphaCoverage(texels, texelCount, alphaReference, scale);
+			float error = std::abs(coverage - targetCoverage);
+
+			if (error < bestError)
+			{
+				bestError = error;
+				bestScale = scale;
+			}
+
+			if (coverage < targetCoverage)
+			{
+				low = scale;
+			}
+			else if (coverage > targetCoverage)
+			{
+				high = scale;
+			}
+			else
+			{
+				break;
+			}
+
+			scale = (low + high) * 0.5f;
+		}
+
+		return bestScale;
+	}
+}
+
+namespace Resource
+{
+	UINT CalculateMipCount(UINT width, UINT height)
+	{
+		UINT count = 1;
+		UINT size = (width > height) ? width : height;
+		while (size > 1)
+		{
+			size >>= 1;
+			count++;
+		}
+		return count;
+	}
+
+	std::vector<MipLevel> GenerateMipLevels(const unsigned char* pixels, UINT width, UINT height, bool sRGB, bool preserveAlphaCoverage, float alphaReference)
+	{
+		const SRGBTables& tables = GetSRGBTables();
+
+		std::vector<MipLevel> levels;
+
+		// Filtering is done on linear floats, each level is built from the
+		// unquantized level above it
+		std::vector<float> source((size_t)width * height * 4);
+		std::vector<float> destination;
+
+		for (size_t i = 0; i < (size_t)width * height; i++)
+		{
+			const unsigned char* texel = pixels + i * 4;
+			float* linear = source.data() + i * 4;
+
+			for (int c = 0; c < 3; c++)
+			{
+				linear[c] = sRGB ? tables.ToLinear[texel[c]] : texel[c] / 255.f;
+			}
+			linear[3] = texel[3] / 255.f;
+		}
+
+		float targetCoverage = 0.f;
+		if (preserveAlphaCoverage)
+		{
+			targetCoverage = AlphaCoverage(source.data(), (size_t)width * height, alphaReference, 1.f);
+		}
+
+		UINT sourceWidth = width;
+		UINT sourceHeight = height;
+
+		const __m128 quarter = _mm_set1_ps(0.25f);
+
+		while (sourceWidth > 1 || sourceHeight > 1)
+		{
+			UINT levelWidth = (sourceWidth > 1) ? sourceWidth / 2 : 1;
+			UINT levelHeight = (sourceHeight > 1) ? sourceHeight / 2 : 1;
+
+			destination.resize((size_t)levelWidth * levelHeight * 4);
+
+			// Large levels are split in row blocks over the worker pool
+			const UINT ROWS_PER_BLOCK = 64;
+			UINT blockCount = (levelHeight + ROWS_PER_BLOCK - 1) / ROWS_PER_BLOCK;
+
+			Platform::JobSystem::ParallelFor(blockCount, [&](size_t block) {
+				UINT rowBegin = (UINT)block * ROWS_PER_BLOCK;
+				UINT rowEnd = std::min(rowBegin + ROWS_PER_BLOCK, levelHeight);
+
+				for (UINT y = rowBegin; y < rowEnd; y++)
+				{
+					UINT y0 = std::min(y * 2, sourceHeight - 1);
+					UINT y1 = std::min(y * 2 + 1, sourceHeight - 1);
+
+					const float* row0 = source.data() + (size_t)y0 * sourceWidth * 4;
+					const float* row1 = source.data() + (size_t)y1 * sourceWidth * 4;
+					float* out = destination.data() + (size_t)y * levelWidth * 4;
+
+					for (UINT x = 0; x < levelWidth; x++)
+					{
+						UINT x0 = std::min(x * 2, sourceWidth - 1) * 4;
+						UINT x1 = std::min(x * 2 + 1, sourceWidth - 1) * 4;
+
+						__m128 sum = _mm_add_ps(
+							_mm_add_ps(_mm_loadu_ps(row0 + x0), _mm_loadu_ps(row0 + x1)),
+							_mm_add_ps(_mm_loadu_ps(row1 + x0), _mm_loadu_ps(row1 + x1)));
+
+						_mm_storeu_ps(out + (size_t)x * 4, _mm_mul_ps(sum, quarter));
+					}
+				}
+			});
+
+			size_t texelCount = (size_t)levelWidth * levelHeight;
+
+			float alphaScale = 1.f;
+			if (preserveAlphaCoverage)
+			{
+				alphaScale = FindAlphaScale(destination.data(), texelCount, alphaReference, targetCoverage);
+			}
+
+			MipLevel level;
+			level.Width = levelWidth;
+			level.Height = levelHeight;
+			level.Pixels.resize(texelCount * 4);
+
+			for (size_t i = 0; i < texelCount; i++)
+			{
+				const float* linear = destination.data() + i * 4;
+				unsigned char* texel = level.Pixels.data() + i * 4;
+
+				for (int c = 0; c < 3; c++)
+				{
+					texel[c] = sRGB ? tables.FromLinear[(int)(std::min(std::max(linear[c], 0.f), 1.f) * 4095.f + 0.5f)] : UnitToByte(linear[c]);
+				}
+				texel[3] = UnitToByte(linear[3] * alphaScale);
+			}
+
+			levels.push_back(std::move(level));
+
+			std::swap(source, destination);
+			sourceWidth = levelWidth;
+			sourceHeight = levelHeight;
+		}
+
+		return levels;
+	}
+}
@@ -1,10 +1,271 @@
 #include "pch.h"
 #include "Resource/ResourceTypes.h"
 #include "Resource/ResourceManager.h"
+#include "Resource/MipChain.h"
+#include "Resource/BlockCompression.h"
+#include "Resource/DDS.h"
+#include "Resource/KTX2.h"
+#include "Resource/TextureStreamer.h"
+#include "Platform/MappedFile.h"
+#include "Platform/JobSystem.h"
+#include "Resource/ShaderReloader.h"
+#include "Platform/Profiler.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb/stb_image.h"
 
+namespace
+{
+	// Compressed textures with their mips are cached next to the executable,
+	// bump the version whenever the encoder output changes
+	const std::string TEXTURE_CACHE_DIRECTORY = "cache/textures/";
+	const int TEXTURE_CACHE_VERSION = 1;
+
+	// The key covers everything the cached result depends on, an empty path
+	// is returned if the source file is missing
+	std::string GetTextureCachePath(const std::string& filePath, Resource::TextureUsage usage, Resource::CompressionQuality quality)
+	{
+		std::error_code error;
+		auto fileSize = std::filesystem::file_size(filePath, error);
+		if (error) return "";
+		auto writeTime = std::filesystem::last_write_time(filePath, error);
+		if (error) return "";
+
+		std::stringstream key;
+		key << filePath << "|" << fileSize << "|" << writeTime.time_since_epoch().count() << "|"
+			<< (int)usage << "|" << (int)quality << "|" << TEXTURE_CACHE_VERSION;
+
+		std::stringstream cachePath;
+		cachePath << TEXTURE_CACHE_DIRECTORY << std::filesystem::path(filePath).stem().string() << "_"
+			<< std::hex << std::hash<std::string>()(key.str()) << ".dds";
+		return cachePath.str();
+	}
+
+	// Compiled shaders are cached next to the executable, bump the version
+	// whenever the compile flags change
+	const std::string SHADER_CACHE_DIRECTORY = "cache/shaders/";
+	const int SHADER_CACHE_VERSION = 1;
+
+	// Keyed by the preprocessed source, which pulls in the included files, so
+	// editing ShaderLib.hlsli misses the cache of every shader using it. An
+	// empty path is returned if the source does not preprocess, compiling
+	// reports the error.
+	std::string GetShaderCachePath(const std::string& source, const std::string& sourceFile, const std::string& entryPoint, const std::string& shaderModel, const D3D_SHADER_MACRO* defines)
+	{
+		ComPtr<ID3DBlob> preprocessed;
+		ComPtr<ID3DBlob> errorBlob;
+		HRESULT hr = D3DPreprocess(source.c_str(), source.size(), sourceFile.c_str(), defines, D3D_COMPILE_STANDARD_FILE_INCLUDE, preprocessed.GetAddressOf(), errorBlob.GetAddressOf());
+		if (FAILED(hr) || !preprocessed)
+		{
+			return "";
+		}
+
+		std::stringstream key;
+		key.write((const char*)preprocessed->GetBufferPointer(), preprocessed->GetBufferSize());
+		key << "|" << entryPoint << "|" << shaderModel;
+		for (const D3D_SHADER_MACRO* define = defines; define && define->Name; define++)
+		{
+			key << "|" << define->Name << "=" << (define->Definition ? define->Definition : "");
+		}
+		key << "|" << D3D_COMPILER_VERSION << "|" << SHADER_CACHE_VERSION;
+
+		std::stringstream cachePath;
+		cachePath << SHADER_CACHE_DIRECTORY << std::filesystem::path(sourceFile).stem().string() << "_" << entryPoint << "_"
+			<< std::hex << std::hash<std::string>()(key.str()) << ".cso";
+		return cachePath.str();
+	}
+
+	ComPtr<ID3DBlob> ReadShaderCache(const std::string& cachePath)
+	{
+		std::ifstream file(cachePath, std::ios::binary | std::ios::ate);
+		if (!file)
+		{
+			return ComPtr<ID3DBlob>();
+		}
+
+		std::streamsize size = file.tellg();
+		file.seekg(0);
+
+		ComPtr<ID3DBlob> blob;
+		if (size <= 0 || FAILED(D3DCreateBlob((SIZE_T)size, blob.GetAddressOf())) || !file.read((char*)blob->GetBufferPointer(), size))
+		{
+			return ComPtr<ID3DBlob>();
+		}
+		return blob;
+	}
+
+	// Written to a temporary file first, like the texture cache
+	bool WriteShaderCache(const std::string& cachePath, ID3DBlob* blob)
+	{
+		std::error_code error;
+		std::filesystem::create_directories(SHADER_CACHE_DIRECTORY, error);
+
+		std::string temporaryPath = cachePath + ".tmp";
+		{
+			std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+			if (!file || !file.write((const char*)blob->GetBufferPointer(), blob->GetBufferSize()))
+			{
+				return false;
+			}
+		}
+
+		std::filesystem::rename(temporaryPath, cachePath, error);
+		return !error;
+	}
+
+	// Adds the resources a stage uses to the binding table, resources other
+	// stages use as well get the stage added
+	void ReflectBindings(ID3D11ShaderReflection* reflection, UINT stage, std::vector<Resource::ShaderBinding>& bindings)
+	{
+		using Resource::ShaderBindingType;
+
+		D3D11_SHADER_DESC shaderDesc;
+		reflection->GetDesc(&shaderDesc);
+
+		for (UINT i = 0; i < shaderDesc.BoundResources; i++)
+		{
+			D3D11_SHADER_INPUT_BIND_DESC bindDesc;
+			reflection->GetResourceBindingDesc(i, &bindDesc);
+
+			ShaderBindingType type;
+			switch (bindDesc.Type)
+			{
+			case D3D_SIT_CBUFFER:		type = ShaderBindingType::ConstantBuffer; break;
+			case D3D_SIT_SAMPLER:		type = ShaderBindingType::Sampler; break;
+			case D3D_SIT_TBUFFER:
+			case D3D_SIT_TEXTURE:
+			case D3D_SIT_STRUCTURED:
+			case D3D_SIT_BYTEADDRESS:	type = ShaderBindingType::ShaderResource; break;
+			default:					type = ShaderBindingType::UnorderedAccess; break;
+			}
+
+			auto existing = std::find_if(bindings.begin(), bindings.end(), [&](const Resource::ShaderBinding& binding) {
+				return binding.Type == type && binding.Slot == bindDesc.BindPoint && binding.Name == bindDesc.Name;
+			});
+
+			if (existing != bindings.end())
+			{
+				existing->Stages |= stage;
+				continue;
+			}
+
+			bindings.push_back({ bindDesc.Name, std::hash<std::string>()(bindDesc.Name), type, bindDesc.BindPoint, bindDesc.BindCount, stage });
+		}
+	}
+
+	// Where the vertex shader inputs are in Resource::Vertex. The position
+	// stream of a mesh holds the positions only, also at offset 0.
+	UINT GetVertexElementOffset(const char* semantic)
+	{
+		const std::string name = semantic;
+		if (name == "POSITION")	return offsetof(Resource::Vertex, Position);
+		if (name == "NORMAL")	return offsetof(Resource::Vertex, Normal);
+		if (name == "TEXCOORD")	return offsetof(Resource::Vertex, Texcoord);
+		if (name == "MATERIAL")	return offsetof(Resource::Vertex, MaterialIndex);
+		return D3D11_APPEND_ALIGNED_ELEMENT;
+	}
+
+	DXGI_FORMAT GetVertexElementFormat(D3D_REGISTER_COMPONENT_TYPE componentType, BYTE mask)
+	{
+		const DXGI_FORMAT floatFormats[] = { DXGI_FORMAT_R32_FLOAT, DXGI_FORMAT_R32G32_FLOAT, DXGI_FORMAT_R32G32B32_FLOAT, DXGI_FORMAT_R32G32B32A32_FLOAT };
+		const DXGI_FORMAT uintFormats[] = { DXGI_FORMAT_R32_UINT, DXGI_FORMAT_R32G32_UINT, DXGI_FORMAT_R32G32B32_UINT, DXGI_FORMAT_R32G32B32A32_UINT };
+		const DXGI_FORMAT sintFormats[] = { DXGI_FORMAT_R32_SINT, DXGI_FORMAT_R32G32_SINT, DXGI_FORMAT_R32G32B32_SINT, DXGI_FORMAT_R32G32B32A32_SINT };
+
+		int components = 0;
+		for (BYTE bits = mask; bits; bits >>= 1)
+		{
+			components += bits & 0x1;
+		}
+		if (components == 0)
+		{
+			return DXGI_FORMAT_UNKNOWN;
+		}
+
+		switch (componentType)
+		{
+		case D3D_REGISTER_COMPONENT_FLOAT32:	return floatFormats[components - 1];
+		case D3D_REGISTER_COMPONENT_UINT32:		return uintFormats[components - 1];
+		case D3D_REGISTER_COMPONENT_SINT32:		return sintFormats[components - 1];
+		default:								return DXGI_FORMAT_UNKNOWN;
+		}
+	}
+
+	// One element per vertex shader input that is not a system value. The
+	// semantic names belong to the reflection, create the layout before releasing it.
+	std::vector<D3D11_INPUT_ELEMENT_DESC> ReflectInputLayout(ID3D11ShaderReflection* reflection)
+	{
+		D3D11_SHADER_DESC shaderDesc;
+		reflection->GetDesc(&shaderDesc);
+
+		std::vector<D3D11_INPUT_ELEMENT_DESC> elements;
+		for (UINT i = 0; i < shaderDesc.InputParameters; i++)
+		{
+			D3D11_SIGNATURE_PARAMETER_DESC parameterDesc;
+			reflection->GetInputParameterDesc(i, &parameterDesc);
+			if (parameterDesc.SystemValueType != D3D_NAME_UNDEFINED)
+			{
+				continue;
+			}
+
+			D3D11_INPUT_ELEMENT_DESC element;
+			ZERO_MEMORY(element);
+			element.SemanticName = parameterDesc.SemanticName;
+			element.SemanticIndex = parameterDesc.SemanticIndex;
+			element.Format = GetVertexElementFormat(parameterDesc.ComponentType, parameterDesc.Mask);
+			element.AlignedByteOffset = GetVertexElementOffset(parameterDesc.SemanticName);
+			element.InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
+			elements.push_back(element);
+		}
+		return elements;
+	}
+
+	DXGI_FORMAT GetTextureFormat(Resource::TextureUsage usage, Resource::CompressionQuality quality)
+	{
+		bool fast = quality == Resource::CompressionQuality::Fast;
+
+		switch (usage)
+		{
+		case Resource::TextureUsage::Color:		return fast ? DXGI_FORMAT_BC1_UNORM : DXGI_FORMAT_BC7_UNORM;
+		case Resource::TextureUsage::Cutout:	return fast ? DXGI_FORMAT_BC3_UNORM : DXGI_FORMAT_BC7_UNORM;
+		case Resource::TextureUsage::Normal:	return DXGI_FORMAT_BC5_UNORM;
+		default:								return DXGI_FORMAT_R8G8B8A8_UNORM;
+		}
+	}
+
+	// Channels that survive compression, used for the error measurement
+	UINT GetMeaningfulChannelCount(Resource::TextureUsage usage)
+	{
+		switch (usage)
+		{
+		case Resource::TextureUsage::Color:		return 3;
+		case Resource::TextureUsage::Normal:	return 2;
+		default:								return 4;
+		}
+	}
+
+	const char* GetFormatName(DXGI_FORMAT format)
+	{
+		switch (format)
+		{
+		case DXGI_FORMAT_BC1_UNORM:
+		case DXGI_FORMAT_BC1_UNORM_SRGB:	return "BC1";
+		case DXGI_FORMAT_BC2_UNORM:
+		case DXGI_FORMAT_BC2_UNORM_SRGB:	return "BC2";
+		case DXGI_FORMAT_BC3_UNORM:
+		case DXGI_FORMAT_BC3_UNORM_SRGB:	return "BC3";
+		case DXGI_FORMAT_BC4_UNORM:
+		case DXGI_FORMAT_BC4_SNORM:			return "BC4";
+		case DXGI_FORMAT_BC5_UNORM:
+		case DXGI_FORMAT_BC5_SNORM:			return "BC5";
+		case DXGI_FORMAT_BC6H_UF16:
+		case DXGI_FORMAT_BC6H_SF16:			return "BC6H";
+		case DXGI_FORMAT_BC7_UNORM:
+		case DXGI_FORMAT_BC7_UNORM_SRGB:	return "BC7";
+		default:							return "uncompressed";
+		}
+	}
+}
+
 namespace Resource
 {
 	std::unique_ptr<ResourceManager> ResourceManager::s_instance;
@@ -22,8 +283,11 @@ namespace Resource
 		//
 	}
 
-	ResourceManager::ResourceManager() : m_IDCounter(1)
+	ResourceManager::ResourceManager() : m_IDCounter(1), m_textureCompressionQuality(CompressionQuality::Fast), m_textureStreaming(true), m_textureArrays(false), m_shaderCache(true), m_shaderHotReload(true)
 	{
+		// Submeshes without a material use the default one in the first slot
+		m_materialTable.push_back(Material::MaterialData());
+
 		// Create the camera constant buffer
 		{
 			m_cameraBuffer.ByteWidth = sizeof(CameraBuffer);
@@ -51,8 +315,75 @@ namespace Resource
 		mesh->VertexBuffer = CreateVertexBuffer(sizeof(Vertex), vertices.size(), D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST, vertices.data());
 		mesh->IndexBuffer = CreateIndexBuffer(indices.size(), DXGI_FORMAT_R32_UINT, indices.data());
 
+		// Positions again on their own, depth only passes fetch a third of the bytes
+		{
+			std::vector<DirectX::XMFLOAT3> positions(vertices.size());
+			for (size_t i = 0; i < vertices.size(); i++)
+			{
+				positions[i] = vertices[i].Position;
+			}
+			mesh->PositionBuffer = CreateVertexBuffer(sizeof(DirectX::XMFLOAT3), (UINT)positions.size(), D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST, positions.data());
+		}
+
 		mesh->Submeshes = subMeshes;
 
+		// Bounding spheres around the box centers, and how densely the texcoords
+		// are laid out over the surface
+		auto calculateBounds = [&](UINT indexOffset, UINT indexCount, DirectX::XMFLOAT3& center, float& radius) {
+			using namespace DirectX;
+
+			XMVECTOR low = XMVectorReplicate(FLT_MAX);
+			XMVECTOR high = XMVectorReplicate(-FLT_MAX);
+			for (UINT i = indexOffset; i < indexOffset + indexCount; i++)
+			{
+				XMVECTOR position = XMLoadFloat3(&vertices[indices[i]].Position);
+				low = XMVectorMin(low, position);
+				high = XMVectorMax(high, position);
+			}
+
+			XMVECTOR boundsCenter = (indexCount > 0) ? XMVectorScale(XMVectorAdd(low, high), 0.5f) : XMVectorZero();
+			float boundsRadius = 0.0f;
+			for (UINT i = indexOffset; i < indexOffset + indexCount; i++)
+			{
+				XMVECTOR position = XMLoadFloat3(&vertices[indices[i]].Position);
+				boundsRadius = std::max(boundsRadius, XMVectorGetX(XMVector3Length(XMVectorSubtract(position, boundsCenter))));
+			}
+
+			XMStoreFloat3(&center, boundsCenter);
+			radius = boundsRadius;
+		};
+
+		calculateBounds(0, (UINT)indices.size(), mesh->BoundsCenter, mesh->BoundsRadius);
+
+		for (Mesh::Submesh& submesh : mesh->Submeshes)
+		{
+			using namespace DirectX;
+
+			calculateBounds(submesh.IndexOffset, submesh.IndexCount, submesh.BoundsCenter, submesh.BoundsRadius);
+
+			float surfaceArea = 0.0f;
+			float texcoordArea = 0.0f;
+			for (UINT i = submesh.IndexOffset; i + 2 < submesh.IndexOffset + submesh.IndexCount; i += 3)
+			{
+				const Vertex& v0 = vertices[indices[i]];
+				const Vertex& v1 = vertices[indices[i + 1]];
+				const Vertex& v2 = vertices[indices[i + 2]];
+
+				XMVECTOR p0 = XMLoadFloat3(&v0.Position);
+				XMVECTOR edge0 = XMVectorSubtract(XMLoadFloat3(&v1.Position), p0);
+				XMVECTOR edge1 = XMVectorSubtract(XMLoadFloat3(&v2.Position), p0);
+				surfaceArea += 0.5f * XMVectorGetX(XMVector3Length(XMVector3Cross(edge0, edge1)));
+
+				float u0 = v1.Texcoord.x - v0.Texcoord.x;
+				float w0 = v1.Texcoord.y - v0.Texcoord.y;
+				float u1 = v2.Texcoord.x - v0.Texcoord.x;
+				float w1 = v2.Texcoord.y - v0.Texcoord.y;
+				texcoordArea += 0.5f * std::abs(u0 * w1 - u1 * w0);
+			}
+
+			submesh.TexcoordDensity = (surfaceArea > 0.0f) ? std::sqrt(texcoordArea / surfaceArea) : 0.0f;
+		}
+
 		ID meshID = m_IDCounter++;
 		m_meshes[meshID] = mesh;
 
@@ -77,7 +408,9 @@ namespace Resource
 
 		ID materialID = m_IDCounter++;
 		m_materials[materialID] = std::make_shared<Material>(material);
+		m_materials[materialID]->TableIndex = (UINT)m_materialTable.size();
 		m_materialNames[material.Name] = materialID;
+		m_materialTable.push_back(material.Data);
 
 		return materialID;
 	}
@@ -114,6 +447,8 @@ namespace Resource
 
 	ID ResourceManager::LoadModelInternal(const std::string& filePath)
 	{
+		PROFILE_SCOPE("ResourceManager::LoadModel");
+
 		std::ifstream file(filePath);
 		if (!file) return 0;
 
@@ -270,6 +605,17 @@ namespace Resource
 				offset -= count;
 			}
 
+			// Vertices carry their material so a whole mesh can be drawn at once
+			for (const Mesh::Submesh& subMesh : subMeshes)
+			{
+				auto material = GetMaterial(subMesh.Material);
+				UINT materialIndex = material ? material->TableIndex : 0;
+				for (UINT i = subMesh.IndexOffset; i < subMesh.IndexOffset + subMesh.IndexCount; i++)
+				{
+					vertices[indices[i]].MaterialIndex = materialIndex;
+				}
+			}
+
 			return s_instance->AddMesh(vertices, indices, subMeshes);
 		}
 
@@ -278,11 +624,31 @@ namespace Resource
 
 	std::vector<ID> ResourceManager::LoadMaterialInternal(const std::string& filePath)
 	{
+		PROFILE_SCOPE("ResourceManager::LoadMaterial");
+
 		std::vector<ID> newMaterials;
 
 		std::ifstream file(filePath);
 		if (!file) return newMaterials;
 
+		// Find textures in the same directory as the .mtl-file
+		std::string directory;
+		auto lastDiv = filePath.rfind("/");
+		if (lastDiv != std::string::npos)
+		{
+			directory = filePath.substr(0, lastDiv + 1);
+		}
+
+		// Textures are decoded together once the whole file is parsed, until
+		// then materials refer to their maps by index into texturePaths
+		std::vector<Material> materials;
+		std::vector<int> diffuseMapIndices;
+		std::vector<int> specularMapIndices;
+		std::vector<int> normalMapIndices;
+		std::vector<bool> alphaTested;
+		std::vector<std::string> texturePaths;
+		std::unordered_map<std::string, int> texturePathIndices;
+
 		std::string header;
 		
 		std::string name;
@@ -290,7 +656,34 @@ namespace Resource
 		DirectX::XMFLOAT3 specular = { 1.0f, 1.0f, 1.0f }; // Ks
 		DirectX::XMFLOAT3 ambient = { 1.0f, 1.0f, 1.0f }; // Ka
 		float specularExponent = 1; // Ns
-		ID diffuseMapID = 0; // map_Kd
+		int diffuseMapIndex = -1; // map_Kd
+		int specularMapIndex = -1; // map_Ks
+		int normalMapIndex = -1; // map_Disp, map_bump, bump
+		bool hasAlphaMap = false; // map_d
+
+		auto addMaterial = [&]() {
+			Material material(name);
+			material.Data.Diffuse = diffuse;
+			material.Data.Specular = specular;
+			material.Data.Ambient = ambient;
+			material.Data.SpecularExponent = specularExponent;
+
+			materials.push_back(material);
+			diffuseMapIndices.push_back(diffuseMapIndex);
+			specularMapIndices.push_back(specularMapIndex);
+			normalMapIndices.push_back(normalMapIndex);
+			alphaTested.push_back(hasAlphaMap);
+		};
+
+		auto addTexturePath = [&](const std::string& texturePath) -> int {
+			std::string path = directory + texturePath;
+			if (texturePathIndices.count(path) == 0)
+			{
+				texturePathIndices[path] = (int)texturePaths.size();
+				texturePaths.push_back(path);
+			}
+			return texturePathIndices[path];
+		};
 
 		while (std::getline(file, header))
 		{
@@ -301,17 +694,7 @@ namespace Resource
 			{
 				if (name != "") // If not first name in file
 				{
-					Material material(name);
-					material.Data.Diffuse = diffuse;
-					material.Data.Specular = specular;
-					material.Data.Ambient = ambient;
-					material.Data.SpecularExponent = specularExponent;
-
-					material.DiffuseMap = diffuseMapID;
-					material.Data.DiffuseMapIndex = diffuseMapID ? 0 : -1;
-					
-					ID materialID = AddMaterial(material);
-					newMaterials.push_back(materialID);
+					addMaterial();
 				}
 
 				stream >> name;
@@ -319,7 +702,10 @@ namespace Resource
 				specular = { 1.0f, 1.0f, 1.0f };
 				ambient = { 1.0f, 1.0f, 1.0f };
 				specularExponent = 1.0f;
-				diffuseMapID = 0;
+				diffuseMapIndex = -1;
+				specularMapIndex = -1;
+				normalMapIndex = -1;
+				hasAlphaMap = false;
 			}
 			else if (header == "Kd") // Diffuse
 			{
@@ -342,27 +728,80 @@ namespace Resource
 				std::string texturePath;
 				stream >> texturePath;
 
-				std::string directory;
-				auto lastDiv = filePath.rfind("/");
-				if (lastDiv != std::string::npos)
-				{
-					directory = filePath.substr(0, lastDiv + 1);
-				}
+				diffuseMapIndex = addTexturePath(texturePath);
+			}
+			else if (header == "map_Ks") // Specular map
+			{
+				std::string texturePath;
+				stream >> texturePath;
 
-				diffuseMapID = LoadTexture2D(directory + texturePath);
+				specularMapIndex = addTexturePath(texturePath);
+			}
+			else if (header == "map_Disp" || header == "map_bump" || header == "bump") // Normal map
+			{
+				std::string texturePath;
+				stream >> texturePath;
+
+				normalMapIndex = addTexturePath(texturePath);
+			}
+			else if (header == "map_d") // Alpha map
+			{
+				// The diffuse map alpha is used for the cutout
+				hasAlphaMap = true;
 			}
 		}
 
 		// Add the last material in the file
+		addMaterial();
+
+		// Diffuse maps of materials with an alpha map keep their alpha coverage in the mips
+		std::vector<TextureUsage> textureUsages(texturePaths.size(), TextureUsage::Color);
+		for (size_t i = 0; i < materials.size(); i++)
 		{
-			Material material(name);
-			material.Data.Diffuse = diffuse;
-			material.Data.Specular = specular;
-			material.Data.Ambient = ambient;
-			material.Data.SpecularExponent = specularExponent;
+			if (alphaTested[i] && diffuseMapIndices[i] != -1)
+			{
+				textureUsages[diffuseMapIndices[i]] = TextureUsage::Cutout;
+			}
+			if (normalMapIndices[i] != -1)
+			{
+				textureUsages[normalMapIndices[i]] = TextureUsage::Normal;
+			}
+		}
+
+		std::vector<TextureArraySlice> arraySlices(texturePaths.size());
+		std::vector<ID> textureIDs = LoadTextures2DInternal(texturePaths, textureUsages, m_textureArrays ? &arraySlices : nullptr);
+
+		auto assignMap = [&](int pathIndex, ID& map, int& mapIndex, int& mapArray) {
+			if (pathIndex == -1)
+			{
+				return;
+			}
+
+			if (arraySlices[pathIndex].Array != -1)
+			{
+				mapArray = arraySlices[pathIndex].Array;
+				mapIndex = arraySlices[pathIndex].Slice;
+			}
+			else if (textureIDs[pathIndex])
+			{
+				map = textureIDs[pathIndex];
+				mapIndex = 0;
+			}
+		};
 
-			material.DiffuseMap = diffuseMapID;
-			material.Data.DiffuseMapIndex = diffuseMapID ? 0 : -1;
+		for (size_t i = 0; i < materials.size(); i++)
+		{
+			Material& material = materials[i];
+
+			assignMap(diffuseMapIndices[i], material.DiffuseMap, material.Data.DiffuseMapIndex, material.Data.DiffuseMapArray);
+			assignMap(specularMapIndices[i], material.SpecularMap, material.Data.SpecularMapIndex, material.Data.SpecularMapArray);
+			assignMap(normalMapIndices[i], material.NormalMap, material.Data.NormalMapIndex, material.Data.NormalMapArray);
+
+			// Only maps that were loaded, alpha is cut out of the diffuse map
+			material.Data.Features |= (material.Data.DiffuseMapIndex != -1) ? MATERIAL_FEATURE_DIFFUSE_MAP : 0;
+			material.Data.Features |= (material.Data.SpecularMapIndex != -1) ? MATERIAL_FEATURE_SPECULAR_MAP : 0;
+			material.Data.Features |= (material.Data.NormalMapIndex != -1) ? MATERIAL_FEATURE_NORMAL_MAP : 0;
+			material.Data.Features |= (alphaTested[i] && material.Data.DiffuseMapIndex != -1) ? MATERIAL_FEATURE_ALPHA_TEST : 0;
 
 			ID materialID = AddMaterial(material);
 			newMaterials.push_back(materialID);
@@ -371,18 +810,438 @@ namespace Resource
 		return newMaterials;
 	}
 
-	ID ResourceManager::LoadTexture2DInternal(const std::string& filePath)
+	ID ResourceManager::LoadTexture2DInternal(const std::string& filePath, TextureUsage usage)
+	{
+		return LoadTextures2DInternal({ filePath }, { usage }).front();
+	}
+
+	std::vector<ID> ResourceManager::LoadTextures2DInternal(const std::vector<std::string>& filePaths, const std::vector<TextureUsage>& usages, std::vector<TextureArraySlice>* arraySlices)
 	{
-		int width;
-		int height;
-		unsigned char* imageData = stbi_load(filePath.c_str(), &width, &height, nullptr, 4);
+		PROFILE_SCOPE("ResourceManager::LoadTextures");
 
-		if (!imageData)
+		using Clock = std::chrono::high_resolution_clock;
+		using Milliseconds = std::chrono::duration<double, std::milli>;
+
+		// Decode each new path once, paths loaded earlier reuse their texture
+		std::vector<std::string> decodePaths;
+		std::vector<TextureUsage> decodeUsages;
+		std::unordered_map<std::string, size_t> decodeIndices;
+		for (size_t i = 0; i < filePaths.size(); i++)
 		{
-			return 0;
+			const std::string& path = filePaths[i];
+			if (m_texturePaths.count(path) == 0 && m_textureArraySlices.count(path) == 0 && decodeIndices.count(path) == 0)
+			{
+				decodeIndices[path] = decodePaths.size();
+				decodePaths.push_back(path);
+				decodeUsages.push_back(i < usages.size() ? usages[i] : TextureUsage::Color);
+			}
 		}
 
-		return CreateTexture2D(width, height, DXGI_FORMAT_R8G8B8A8_UNORM, 4, imageData);
+		if (decodePaths.size())
+		{
+			enum class ImageSource
+			{
+				Missing,
+				Mapped,		// DDS or KTX2 file used as is
+				Cached,		// Previously encoded DDS from the texture cache
+				Decoded,	// Source image decoded and encoded on this run
+			};
+
+			struct LoadedImage
+			{
+				ImageSource Source = ImageSource::Missing;
+				TextureImage Image;
+				Platform::MappedFile File; // Backs Image when mapped or cached
+				TextureData Data; // Backs Image when decoded
+				std::string FilePath; // GPU ready file with the same contents, read by the streamer
+				bool CacheWriteFailed = false;
+				double DecodeTime = 0.0; // ms, mapping and parsing when not decoded
+				double MipTime = 0.0; // ms
+				double EncodeTime = 0.0; // ms
+				double PSNR = 0.0; // dB, top level only
+			};
+
+			std::vector<LoadedImage> images(decodePaths.size());
+			CompressionQuality quality = m_textureCompressionQuality;
+
+			std::error_code error;
+			std::filesystem::create_directories(TEXTURE_CACHE_DIRECTORY, error);
+
+			Clock::time_point loadStart = Clock::now();
+
+			Platform::JobSystem::ParallelFor(decodePaths.size(), [&](size_t i) {
+				PROFILE_SCOPE("ResourceManager::DecodeTexture");
+				LoadedImage& image = images[i];
+				TextureUsage usage = decodeUsages[i];
+				const std::string& path = decodePaths[i];
+
+				Clock::time_point start = Clock::now();
+
+				// GPU ready files are mapped and handed to the device without a copy
+				std::string extension = std::filesystem::path(path).extension().string();
+				std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return (char)tolower(c); });
+				if (extension == ".dds" || extension == ".ktx2")
+				{
+					if (image.File.Open(path))
+					{
+						bool parsed = (extension == ".dds")
+							? ParseDDS(image.File.Data(), image.File.Size(), image.Image)
+							: ParseKTX2(image.File.Data(), image.File.Size(), image.Image);
+
+						if (parsed)
+						{
+							image.Source = ImageSource::Mapped;
+							image.FilePath = path;
+						}
+					}
+					image.DecodeTime = Milliseconds(Clock::now() - start).count();
+					return;
+				}
+
+				std::string highQualityCachePath = GetTextureCachePath(path, usage, CompressionQuality::High);
+				std::string cachePath = GetTextureCachePath(path, usage, quality);
+				if (cachePath.empty())
+				{
+					return; // Source file is missing
+				}
+
+				// A baked high quality version is preferred over one at the current quality
+				for (const std::string& candidate : { highQualityCachePath, cachePath })
+				{
+					if (image.File.Open(candidate) && ParseDDS(image.File.Data(), image.File.Size(), image.Image))
+					{
+						image.Source = ImageSource::Cached;
+						image.FilePath = candidate;
+						image.DecodeTime = Milliseconds(Clock::now() - start).count();
+						return;
+					}
+				}
+				image.File.Close();
+
+				int width = 0;
+				int height = 0;
+				unsigned char* pixels = stbi_load(path.c_str(), &width, &height, nullptr, 4);
+				image.DecodeTime = Milliseconds(Clock::now() - start).count();
+
+				if (!pixels)
+				{
+					return;
+				}
+
+				start = Clock::now();
+				std::vector<MipLevel> mipLevels = GenerateMipLevels(
+					pixels,
+					width,
+					height,
+					usage == TextureUsage::Color || usage == TextureUsage::Cutout,
+					usage == TextureUsage::Cutout);
+				image.MipTime = Milliseconds(Clock::now() - start).count();
+
+				TextureData& data = image.Data;
+				data.Format = GetTextureFormat(usage, quality);
+				data.Width = width;
+				data.Height = height;
+
+				// Block compression needs the top level in whole blocks
+				if (width % 4 != 0 || height % 4 != 0)
+				{
+					data.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+				}
+
+				start = Clock::now();
+				if (GetBlockSize(data.Format))
+				{
+					data.Levels.push_back(CompressImage(pixels, width, height, data.Format, quality));
+					for (const MipLevel& level : mipLevels)
+					{
+						data.Levels.push_back(CompressImage(level.Pixels.data(), level.Width, level.Height, data.Format, quality));
+					}
+					image.EncodeTime = Milliseconds(Clock::now() - start).count();
+
+					std::vector<unsigned char> decompressed = DecompressImage(data.Levels[0].data(), width, height, data.Format);
+					image.PSNR = CalculatePSNR(pixels, decompressed.data(), width, height, GetMeaningfulChannelCount(usage));
+				}
+				else
+				{
+					data.Levels.emplace_back(pixels, pixels + (size_t)width * height * 4);
+					for (MipLevel& level : mipLevels)
+					{
+						data.Levels.push_back(std::move(level.Pixels));
+					}
+				}
+
+				stbi_image_free(pixels);
+
+				image.CacheWriteFailed = !WriteDDS(cachePath, data);
+				if (!image.CacheWriteFailed)
+				{
+					image.FilePath = cachePath;
+				}
+
+				image.Image.Format = data.Format;
+				image.Image.Width = data.Width;
+				image.Image.Height = data.Height;
+				image.Image.MipLevels = (UINT)data.Levels.size();
+				image.Image.ArraySize = 1;
+				image.Image.Subresources.resize(data.Levels.size());
+
+				UINT levelWidth = data.Width;
+				UINT levelHeight = data.Height;
+				for (size_t level = 0; level < data.Levels.size(); level++)
+				{
+					D3D11_SUBRESOURCE_DATA& subresource = image.Image.Subresources[level];
+					GetSurfaceSize(data.Format, levelWidth, levelHeight, &subresource.SysMemPitch);
+					subresource.pSysMem = data.Levels[level].data();
+					subresource.SysMemSlicePitch = (UINT)data.Levels[level].size();
+
+					levelWidth = std::max(1u, levelWidth / 2);
+					levelHeight = std::max(1u, levelHeight / 2);
+				}
+
+				image.Source = ImageSource::Decoded;
+			});
+
+			double loadTime = Milliseconds(Clock::now() - loadStart).count();
+			double summedDecodeTime = 0.0;
+			double summedMipTime = 0.0;
+			double summedEncodeTime = 0.0;
+			double encodedPixels = 0.0;
+			size_t uncompressedSize = 0;
+			size_t compressedSize = 0;
+			size_t mappedCount = 0;
+			size_t cachedCount = 0;
+
+			auto createTexture = [&](size_t i) {
+				const TextureImage& image = images[i].Image;
+
+				D3D11_TEXTURE2D_DESC textureDesc;
+				ZERO_MEMORY(textureDesc);
+				textureDesc.Width = image.Width;
+				textureDesc.Height = image.Height;
+				textureDesc.MipLevels = image.MipLevels;
+				textureDesc.ArraySize = image.ArraySize;
+				textureDesc.Format = image.Format;
+				textureDesc.SampleDesc.Count = 1;
+				textureDesc.Usage = D3D11_USAGE_IMMUTABLE;
+				textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+				textureDesc.MiscFlags = image.Cube ? D3D11_RESOURCE_MISC_TEXTURECUBE : 0;
+
+				// Streamed textures start with only their low mips, the rest is read
+				// from the file again when the renderer asks for it
+				bool streamed = m_textureStreaming && !images[i].FilePath.empty() && image.ArraySize == 1;
+				UINT residentMip = 0;
+				if (streamed)
+				{
+					residentMip = TextureStreamer::GetInitialMip(image.Format, image.Width, image.Height, image.MipLevels);
+					textureDesc.Width = std::max(1u, image.Width >> residentMip);
+					textureDesc.Height = std::max(1u, image.Height >> residentMip);
+					textureDesc.MipLevels = image.MipLevels - residentMip;
+				}
+
+				// Block compressed textures store the bytes per 4x4 block as their stride.
+				// The subresources point straight into the mapped file or encoder output.
+				UINT texelStride = GetBlockSize(image.Format) ? GetBlockSize(image.Format) : GetTexelSize(image.Format);
+				ID textureID = CreateTexture2D(textureDesc, texelStride, image.Subresources.data() + residentMip);
+				m_texturePaths[decodePaths[i]] = textureID;
+
+				if (streamed)
+				{
+					TextureStreamer::Register(textureID, images[i].FilePath, image, residentMip);
+				}
+
+				// The device has its own copy now
+				images[i].File.Close();
+				images[i].Data = TextureData();
+			};
+
+			// Material maps sharing a format, size and mip count become slices of one
+			// array, in the order their groups are first seen
+			using ArrayKey = std::tuple<DXGI_FORMAT, UINT, UINT, UINT>;
+			std::map<ArrayKey, size_t> arrayGroupIndices;
+			std::vector<std::vector<size_t>> arrayGroups;
+
+			// Create the GPU textures in the requested order
+			for (size_t i = 0; i < decodePaths.size(); i++)
+			{
+				LoadedImage& loaded = images[i];
+				const TextureImage& image = loaded.Image;
+				summedDecodeTime += loaded.DecodeTime;
+				summedMipTime += loaded.MipTime;
+				summedEncodeTime += loaded.EncodeTime;
+
+				if (loaded.Source == ImageSource::Missing)
+				{
+					std::cerr << "\t" << decodePaths[i] << ": failed to load" << std::endl;
+					continue;
+				}
+
+				if (loaded.CacheWriteFailed)
+				{
+					std::cerr << "\t" << decodePaths[i] << ": failed to write the texture cache" << std::endl;
+				}
+
+				size_t textureUncompressedSize = 0;
+				size_t textureCompressedSize = 0;
+				double texturePixels = 0.0;
+
+				UINT levelWidth = image.Width;
+				UINT levelHeight = image.Height;
+				for (UINT level = 0; level < image.MipLevels; level++)
+				{
+					textureUncompressedSize += (size_t)levelWidth * levelHeight * 4 * image.ArraySize;
+					texturePixels += (double)levelWidth * levelHeight * image.ArraySize;
+
+					levelWidth = std::max(1u, levelWidth / 2);
+					levelHeight = std::max(1u, levelHeight / 2);
+				}
+				for (const D3D11_SUBRESOURCE_DATA& subresource : image.Subresources)
+				{
+					textureCompressedSize += subresource.SysMemSlicePitch;
+				}
+
+				if (arraySlices && image.ArraySize == 1 && !image.Cube)
+				{
+					ArrayKey key(image.Format, image.Width, image.Height, image.MipLevels);
+					if (arrayGroupIndices.count(key) == 0)
+					{
+						arrayGroupIndices[key] = arrayGroups.size();
+						arrayGroups.emplace_back();
+					}
+					arrayGroups[arrayGroupIndices[key]].push_back(i);
+				}
+				else
+				{
+					createTexture(i);
+				}
+
+				uncompressedSize += textureUncompressedSize;
+				compressedSize += textureCompressedSize;
+
+				double ratio = (double)textureUncompressedSize / (double)textureCompressedSize;
+
+				std::cout << "\t" << decodePaths[i] << ": " << GetFormatName(image.Format) << ", "
+					<< image.MipLevels << " mips, " << ratio << ":1, ";
+
+				if (loaded.Source == ImageSource::Mapped)
+				{
+					mappedCount++;
+					std::cout << "mapped " << loaded.DecodeTime << " ms" << std::endl;
+				}
+				else if (loaded.Source == ImageSource::Cached)
+				{
+					cachedCount++;
+					std::cout << "cached " << loaded.DecodeTime << " ms" << std::endl;
+				}
+				else if (loaded.EncodeTime > 0.0)
+				{
+					encodedPixels += texturePixels;
+					std::cout << "decode " << loaded.DecodeTime << " ms, mips " << loaded.MipTime << " ms, encode "
+						<< loaded.EncodeTime << " ms (" << texturePixels / (loaded.EncodeTime * 1000.0) << " MPix/s), PSNR "
+						<< loaded.PSNR << " dB" << std::endl;
+				}
+				else
+				{
+					std::cout << "decode " << loaded.DecodeTime << " ms, mips " << loaded.MipTime << " ms, uncompressed" << std::endl;
+				}
+			}
+
+			// The arrays are immutable, groups that do not fit in the remaining slots
+			// are created as separate textures instead
+			size_t packedCount = 0;
+			size_t arrayCount = 0;
+			for (const std::vector<size_t>& group : arrayGroups)
+			{
+				if (m_materialTextureArrays.size() >= MAX_MATERIAL_TEXTURE_ARRAYS)
+				{
+					for (size_t i : group)
+					{
+						createTexture(i);
+					}
+					continue;
+				}
+
+				const TextureImage& first = images[group.front()].Image;
+
+				std::vector<D3D11_SUBRESOURCE_DATA> subresources;
+				subresources.reserve(group.size() * first.MipLevels);
+				for (size_t i : group)
+				{
+					const std::vector<D3D11_SUBRESOURCE_DATA>& slice = images[i].Image.Subresources;
+					subresources.insert(subresources.end(), slice.begin(), slice.end());
+				}
+
+				D3D11_TEXTURE2D_DESC textureDesc;
+				ZERO_MEMORY(textureDesc);
+				textureDesc.Width = first.Width;
+				textureDesc.Height = first.Height;
+				textureDesc.MipLevels = first.MipLevels;
+				textureDesc.ArraySize = (UINT)group.size();
+				textureDesc.Format = first.Format;
+				textureDesc.SampleDesc.Count = 1;
+				textureDesc.Usage = D3D11_USAGE_IMMUTABLE;
+				textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+				UINT texelStride = GetBlockSize(first.Format) ? GetBlockSize(first.Format) : GetTexelSize(first.Format);
+				ID arrayID = CreateTexture2DArray(textureDesc, texelStride, subresources.data());
+
+				int arraySlot = (int)m_materialTextureArrays.size();
+				m_materialTextureArrays.push_back(arrayID);
+
+				for (size_t slice = 0; slice < group.size(); slice++)
+				{
+					size_t i = group[slice];
+					m_textureArraySlices[decodePaths[i]] = { arraySlot, (int)slice };
+
+					images[i].File.Close();
+					images[i].Data = TextureData();
+				}
+
+				std::cout << "\tArray " << arraySlot << ": " << GetFormatName(first.Format) << " " << first.Width << "x"
+					<< first.Height << ", " << group.size() << " slices" << std::endl;
+
+				packedCount += group.size();
+				arrayCount++;
+			}
+
+			if (arrayCount)
+			{
+				std::cout << "Packed " << packedCount << " textures into " << arrayCount << " texture arrays ("
+					<< m_materialTextureArrays.size() << "/" << MAX_MATERIAL_TEXTURE_ARRAYS << " slots used)" << std::endl;
+			}
+
+			std::cout << "Loaded " << decodePaths.size() << " textures (" << mappedCount << " mapped, " << cachedCount
+				<< " cached) in " << loadTime << " ms (decode " << summedDecodeTime << " ms, mips " << summedMipTime
+				<< " ms, encode " << summedEncodeTime << " ms summed, " << Platform::JobSystem::WorkerCount() + 1
+				<< " threads)" << std::endl;
+
+			if (compressedSize)
+			{
+				std::cout << "Texture memory " << compressedSize / (1024.0 * 1024.0) << " MB, "
+					<< uncompressedSize / (1024.0 * 1024.0) << " MB uncompressed ("
+					<< (double)uncompressedSize / (double)compressedSize << ":1)";
+				if (summedEncodeTime > 0.0)
+				{
+					std::cout << ", encode " << encodedPixels / (summedEncodeTime * 1000.0) << " MPix/s";
+				}
+				std::cout << std::endl;
+			}
+		}
+
+		std::vector<ID> textureIDs;
+		textureIDs.reserve(filePaths.size());
+		for (size_t i = 0; i < filePaths.size(); i++)
+		{
+			auto texture = m_texturePaths.find(filePaths[i]);
+			textureIDs.push_back(texture != m_texturePaths.end() ? texture->second : 0);
+
+			if (arraySlices)
+			{
+				auto slice = m_textureArraySlices.find(filePaths[i]);
+				(*arraySlices)[i] = (slice != m_textureArraySlices.end()) ? slice->second : TextureArraySlice();
+			}
+		}
+
+		return textureIDs;
 	}
 
 	ID ResourceManager::CreateAppWindowInternal(UINT width, UINT height, const std::string& title, WindowProcedureFunction windowProc)
@@ -651,13 +1510,6 @@ namespace Resource
 
 	ID ResourceManager::CreateTexture2DInternal(UINT width, UINT height, DXGI_FORMAT format, UINT texelStride, const void* initData)
 	{
-		Resource::Texture2D texture;
-		
-		texture.Width = width;
-		texture.Height = height;
-		texture.Format = format;
-		texture.TexelStride = texelStride;
-
 		D3D11_TEXTURE2D_DESC textureDesc;
 		ZERO_MEMORY(textureDesc);
 		textureDesc.Width = width;
@@ -677,23 +1529,76 @@ namespace Resource
 			ZERO_MEMORY(data);
 			data.pSysMem = initData;
 			data.SysMemPitch = texelStride * width;
-			ASSERT_HR(Platform::GPU::Device()->CreateTexture2D(&textureDesc, &data, texture.Texture.GetAddressOf()));
-		}
-		else
-		{
-			ASSERT_HR(Platform::GPU::Device()->CreateTexture2D(&textureDesc, NULL, texture.Texture.GetAddressOf()));
+			return CreateTexture2DInternal(textureDesc, texelStride, &data);
 		}
 
-		ASSERT_HR(Platform::GPU::Device()->CreateRenderTargetView(texture.Texture.Get(), NULL, texture.RTV.GetAddressOf()));
-		ASSERT_HR(Platform::GPU::Device()->CreateShaderResourceView(texture.Texture.Get(), NULL, texture.SRV.GetAddressOf()));
-		ASSERT_HR(Platform::GPU::Device()->CreateUnorderedAccessView(texture.Texture.Get(), NULL, texture.UAV.GetAddressOf()));
+		return CreateTexture2DInternal(textureDesc, texelStride, nullptr);
+	}
 
+	ID ResourceManager::CreateTexture2DInternal(const D3D11_TEXTURE2D_DESC& description, UINT texelStride, const D3D11_SUBRESOURCE_DATA* initData)
+	{
 		ID textureID = m_IDCounter++;
-		m_textures[textureID] = std::make_shared<Texture2D>(texture);
+		m_textures[textureID] = BuildTexture2D(description, texelStride, initData);
 
 		return textureID;
 	}
 
+	ID ResourceManager::CreateTexture2DArrayInternal(const D3D11_TEXTURE2D_DESC& description, UINT texelStride, const D3D11_SUBRESOURCE_DATA* initData)
+	{
+		ID textureID = m_IDCounter++;
+		m_textures[textureID] = BuildTexture2D(description, texelStride, initData, true);
+
+		return textureID;
+	}
+
+	void ResourceManager::ReplaceTexture2DInternal(ID textureID, const D3D11_TEXTURE2D_DESC& description, UINT texelStride, const D3D11_SUBRESOURCE_DATA* initData)
+	{
+		assert(m_textures.count(textureID) && "Only existing textures can be replaced");
+		m_textures[textureID] = BuildTexture2D(description, texelStride, initData);
+	}
+
+	std::shared_ptr<Texture2D> ResourceManager::BuildTexture2D(const D3D11_TEXTURE2D_DESC& description, UINT texelStride, const D3D11_SUBRESOURCE_DATA* initData, bool arrayView)
+	{
+		auto texture = std::make_shared<Texture2D>();
+
+		texture->Width = description.Width;
+		texture->Height = description.Height;
+		texture->Format = description.Format;
+		texture->TexelStride = texelStride;
+		texture->MipLevels = description.MipLevels;
+		texture->ArraySize = description.ArraySize;
+
+		ASSERT_HR(Platform::GPU::Device()->CreateTexture2D(&description, initData, texture->Texture.GetAddressOf()));
+
+		if (description.BindFlags & D3D11_BIND_RENDER_TARGET)
+		{
+			ASSERT_HR(Platform::GPU::Device()->CreateRenderTargetView(texture->Texture.Get(), NULL, texture->RTV.GetAddressOf()));
+		}
+		if ((description.BindFlags & D3D11_BIND_SHADER_RESOURCE) && arrayView)
+		{
+			// The default view of a single slice texture is not an array
+			D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
+			ZERO_MEMORY(srvDesc);
+			srvDesc.Format = description.Format;
+			srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+			srvDesc.Texture2DArray.MostDetailedMip = 0;
+			srvDesc.Texture2DArray.MipLevels = description.MipLevels;
+			srvDesc.Texture2DArray.FirstArraySlice = 0;
+			srvDesc.Texture2DArray.ArraySize = description.ArraySize;
+			ASSERT_HR(Platform::GPU::Device()->CreateShaderResourceView(texture->Texture.Get(), &srvDesc, texture->SRV.GetAddressOf()));
+		}
+		else if (description.BindFlags & D3D11_BIND_SHADER_RESOURCE)
+		{
+			ASSERT_HR(Platform::GPU::Device()->CreateShaderResourceView(texture->Texture.Get(), NULL, texture->SRV.GetAddressOf()));
+		}
+		if (description.BindFlags & D3D11_BIND_UNORDERED_ACCESS)
+		{
+			ASSERT_HR(Platform::GPU::Device()->CreateUnorderedAccessView(texture->Texture.Get(), NULL, texture->UAV.GetAddressOf()));
+		}
+
+		return texture;
+	}
+
 	ID ResourceManager::CreateDepthTextureInternal(UINT width, UINT height, const void* initData)
 	{
 		Resource::DepthTexture texture;
@@ -763,58 +1668,222 @@ namespace Resource
 		return samplerID;
 	}
 
+	ID ResourceManager::CreateDepthStencilStateInternal(const D3D11_DEPTH_STENCIL_DESC& description)
+	{
+		Resource::DepthStencilState state;
+
+		ASSERT_HR(Platform::GPU::Device()->CreateDepthStencilState(&description, state.State.GetAddressOf()));
+
+		ID stateID = m_IDCounter++;
+		m_depthStencilStates[stateID] = std::make_shared<DepthStencilState>(state);
+
+		return stateID;
+	}
+
 	ID ResourceManager::CreateShaderProgramInternal(const std::string& filePath)
 	{
+		return CreateShaderProgramsInternal(filePath, { ShaderDefines() }).front();
+	}
+
+	std::vector<ID> ResourceManager::CreateShaderProgramsInternal(const std::string& filePath, const std::vector<ShaderDefines>& permutations)
+	{
+		std::vector<std::shared_ptr<ShaderProgram>> programs = CompileShaderProgramsInternal(filePath, permutations, true);
+
+		std::vector<ID> programIDs;
+		for (size_t p = 0; p < programs.size(); p++)
+		{
+			if (!programs[p])
+			{
+				programIDs.push_back(0);
+				continue;
+			}
+
+			ID programID = m_IDCounter++;
+			m_shaderPrograms[programID] = programs[p];
+			programIDs.push_back(programID);
+
+			if (m_shaderHotReload)
+			{
+				ShaderReloader::Register(programID, filePath, permutations[p]);
+			}
+		}
+
+		return programIDs;
+	}
+
+	std::shared_ptr<ShaderProgram> ResourceManager::CompileShaderProgramInternal(const std::string& filePath, const ShaderDefines& defines)
+	{
+		return CompileShaderProgramsInternal(filePath, { defines }, false).front();
+	}
+
+	void ResourceManager::ReplaceShaderProgramInternal(ID programID, const std::shared_ptr<ShaderProgram>& program)
+	{
+		if (m_shaderPrograms.count(programID) && program)
+		{
+			m_shaderPrograms[programID] = program;
+		}
+	}
+
+	std::vector<std::shared_ptr<ShaderProgram>> ResourceManager::CompileShaderProgramsInternal(const std::string& filePath, const std::vector<ShaderDefines>& permutations, bool parallel)
+	{
+		using Clock = std::chrono::high_resolution_clock;
+
 		std::ifstream file(filePath);
 
 		if (!file.is_open())
 		{
-			return 0;
+			return std::vector<std::shared_ptr<ShaderProgram>>(permutations.size());
 		}
 
 		std::string shaderContent( (std::istreambuf_iterator<char>(file)), (std::istreambuf_iterator<char>()) );
 
-		std::string entryPoint;
-		ShaderProgram program;
-		
 		/**
-		* Compile vertex shader if found
+		* Find the stages of the program, every permutation has the same ones
 		*/
 
-		entryPoint = FindEntryPoint(shaderContent, "ENTRY_VERTEX");
-		if (entryPoint.size())
+		struct Stage
+		{
+			UINT Flag;
+			std::string EntryPoint;
+			const char* ShaderModel;
+		};
+
+		std::vector<Stage> stages;
+		const Stage candidates[] = {
+			{ SHADER_STAGE_VERTEX, FindEntryPoint(shaderContent, "ENTRY_VERTEX"), "vs_5_0" },
+			{ SHADER_STAGE_PIXEL, FindEntryPoint(shaderContent, "ENTRY_PIXEL"), "ps_5_0" },
+			{ SHADER_STAGE_COMPUTE, FindEntryPoint(shaderContent, "ENTRY_COMPUTE"), "cs_5_0" }
+		};
+		for (const Stage& stage : candidates)
 		{
-			program.Stages = program.Stages | SHADER_STAGE_VERTEX;
+			if (stage.EntryPoint.size())
+			{
+				stages.push_back(stage);
+			}
+		}
 
-			ComPtr<ID3DBlob> blob = CompileShader(shaderContent, entryPoint, "vs_5_0", filePath);
-			ASSERT_HR(Platform::GPU::Device()->CreateVertexShader(blob->GetBufferPointer(), blob->GetBufferSize(), NULL, program.Vertex.GetAddressOf()));
-		
-			D3D11_INPUT_ELEMENT_DESC inputElements[] = {
-				{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-				{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-				{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }
-			};
-			const int elementCount = sizeof(inputElements) / sizeof(inputElements[0]);
-			ASSERT_HR(Platform::GPU::Device()->CreateInputLayout(inputElements, elementCount, blob->GetBufferPointer(), blob->GetBufferSize(), program.InputLayout.GetAddressOf()));
+		// Also what a reload sees of a file an editor has emptied but not written yet
+		if (stages.empty())
+		{
+			std::cerr << filePath << ": no //#define ENTRY_* marker" << std::endl;
+			return std::vector<std::shared_ptr<ShaderProgram>>(permutations.size());
 		}
 
 		/**
-		* Compile pixel shader if found
+		* Compile every stage of every permutation on its own, D3DCompile and the
+		* shader cache files do not share anything between them
 		*/
 
-		entryPoint = FindEntryPoint(shaderContent, "ENTRY_PIXEL");
-		if (entryPoint.size())
+		std::vector<std::vector<D3D_SHADER_MACRO>> macros(permutations.size());
+		for (size_t p = 0; p < permutations.size(); p++)
 		{
-			program.Stages = program.Stages | SHADER_STAGE_PIXEL;
+			for (const ShaderDefine& define : permutations[p])
+			{
+				macros[p].push_back({ define.Name.c_str(), define.Value.c_str() });
+			}
+			macros[p].push_back({ NULL, NULL });
+		}
+
+		Clock::time_point start = Clock::now();
+
+		std::vector<ComPtr<ID3DBlob>> blobs(permutations.size() * stages.size());
+		auto compile = [&](size_t i) {
+			const size_t p = i / stages.size();
+			const Stage& stage = stages[i % stages.size()];
+			blobs[i] = CompileShader(shaderContent, stage.EntryPoint, stage.ShaderModel, filePath, macros[p].data());
+		};
+
+		if (parallel)
+		{
+			Platform::JobSystem::ParallelFor(blobs.size(), compile);
+		}
+		else
+		{
+			for (size_t i = 0; i < blobs.size(); i++)
+			{
+				compile(i);
+			}
+		}
 
-			ComPtr<ID3DBlob> blob = CompileShader(shaderContent, entryPoint, "ps_5_0", filePath);
-			ASSERT_HR(Platform::GPU::Device()->CreatePixelShader(blob->GetBufferPointer(), blob->GetBufferSize(), NULL, program.Pixel.GetAddressOf()));
+		{
+			std::lock_guard<std::mutex> lock(m_shaderCacheMutex);
+			m_shaderCacheStatistics.Milliseconds += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
 		}
 
-		ID programID = m_IDCounter++;
-		m_shaderPrograms[programID] = std::make_shared<ShaderProgram>(program);
+		/**
+		* Create the shaders, a permutation with a stage that failed to compile or
+		* be created is left empty
+		*/
+
+		std::vector<std::shared_ptr<ShaderProgram>> programs;
+		for (size_t p = 0; p < permutations.size(); p++)
+		{
+			ShaderProgram program;
+			bool compiled = true;
+
+			for (size_t s = 0; s < stages.size(); s++)
+			{
+				ID3DBlob* blob = blobs[p * stages.size() + s].Get();
+				if (!blob)
+				{
+					compiled = false;
+					break;
+				}
+
+				program.Stages = program.Stages | stages[s].Flag;
+
+				ComPtr<ID3D11ShaderReflection> reflection;
+				HRESULT hr = D3DReflect(blob->GetBufferPointer(), blob->GetBufferSize(), IID_PPV_ARGS(reflection.GetAddressOf()));
+				if (FAILED(hr))
+				{
+					std::cerr << filePath << " (" << stages[s].EntryPoint << "): reflecting the shader failed, error 0x" << std::hex << (UINT)hr << std::dec << std::endl;
+					compiled = false;
+					break;
+				}
+				ReflectBindings(reflection.Get(), stages[s].Flag, program.Bindings);
+
+				if (stages[s].Flag == SHADER_STAGE_VERTEX)
+				{
+					hr = Platform::GPU::Device()->CreateVertexShader(blob->GetBufferPointer(), blob->GetBufferSize(), NULL, program.Vertex.GetAddressOf());
+
+					// Only what the shader reads, depth only shaders read the mesh position stream
+					std::vector<D3D11_INPUT_ELEMENT_DESC> inputElements = ReflectInputLayout(reflection.Get());
+					if (SUCCEEDED(hr) && inputElements.size())
+					{
+						hr = Platform::GPU::Device()->CreateInputLayout(inputElements.data(), (UINT)inputElements.size(), blob->GetBufferPointer(), blob->GetBufferSize(), program.InputLayout.GetAddressOf());
+					}
+				}
+				else if (stages[s].Flag == SHADER_STAGE_PIXEL)
+				{
+					hr = Platform::GPU::Device()->CreatePixelShader(blob->GetBufferPointer(), blob->GetBufferSize(), NULL, program.Pixel.GetAddressOf());
+				}
+				else
+				{
+					hr = Platform::GPU::Device()->CreateComputeShader(blob->GetBufferPointer(), blob->GetBufferSize(), NULL, program.Compute.GetAddressOf());
+				}
+
+				if (FAILED(hr))
+				{
+					std::cerr << filePath << " (" << stages[s].EntryPoint << "): creating the shader failed, error 0x" << std::hex << (UINT)hr << std::dec << std::endl;
+					compiled = false;
+					break;
+				}
+			}
+
+			if (!compiled)
+			{
+				programs.push_back(std::shared_ptr<ShaderProgram>());
+				continue;
+			}
+
+			std::sort(program.Bindings.begin(), program.Bindings.end(), [](const ShaderBinding& a, const ShaderBinding& b) {
+				return (a.Type != b.Type) ? a.Type < b.Type : a.Slot < b.Slot;
+			});
 
-		return programID;
+			programs.push_back(std::make_shared<ShaderProgram>(program));
+		}
+
+		return programs;
 	}
 
 	std::shared_ptr<Window> ResourceManager::GetWindowInternal(ID windowID)
@@ -890,6 +1959,15 @@ namespace Resource
 		return m_samplers[samplerID];
 	}
 
+	std::shared_ptr<const DepthStencilState> ResourceManager::GetDepthStencilStateInternal(ID stateID)
+	{
+		if (m_depthStencilStates.count(stateID) == 0)
+		{
+			return std::shared_ptr<const DepthStencilState>();
+		}
+		return m_depthStencilStates[stateID];
+	}
+
 	std::shared_ptr<const ShaderProgram> ResourceManager::GetShaderProgramInternal(ID programID)
 	{
 		if (m_shaderPrograms.count(programID) == 0)
@@ -919,16 +1997,54 @@ namespace Resource
 		return entryName;
 	}
 
-	ComPtr<ID3DBlob> ResourceManager::CompileShader(const std::string& src, const std::string& entryPoint, const std::string& shaderModel, const std::string& sourceFile)
+	ComPtr<ID3DBlob> ResourceManager::CompileShader(const std::string& src, const std::string& entryPoint, const std::string& shaderModel, const std::string& sourceFile, const D3D_SHADER_MACRO* defines)
 	{
+		std::string cachePath;
 		ComPtr<ID3DBlob> blob;
-		ComPtr<ID3DBlob> errorBlob;
-		HRESULT hr = D3DCompile(src.c_str(), src.size(), sourceFile.c_str(), NULL, D3D_COMPILE_STANDARD_FILE_INCLUDE, entryPoint.c_str(), shaderModel.c_str(), NULL, NULL, blob.GetAddressOf(), errorBlob.GetAddressOf());
-		if (FAILED(hr))
+		if (m_shaderCache)
 		{
-			OutputDebugStringA((char*)errorBlob->GetBufferPointer());
-			ASSERT_HR(hr);
-			return ComPtr<ID3DBlob>();
+			cachePath = GetShaderCachePath(src, sourceFile, entryPoint, shaderModel, defines);
+			if (!cachePath.empty())
+			{
+				blob = ReadShaderCache(cachePath);
+			}
+		}
+
+		if (blob)
+		{
+			std::lock_guard<std::mutex> lock(m_shaderCacheMutex);
+			m_shaderCacheStatistics.Hits++;
+		}
+		else
+		{
+			ComPtr<ID3DBlob> errorBlob;
+			HRESULT hr = D3DCompile(src.c_str(), src.size(), sourceFile.c_str(), defines, D3D_COMPILE_STANDARD_FILE_INCLUDE, entryPoint.c_str(), shaderModel.c_str(), NULL, NULL, blob.GetAddressOf(), errorBlob.GetAddressOf());
+			if (FAILED(hr))
+			{
+				// No error text if the compiler could not read the source at all
+				std::stringstream error;
+				if (errorBlob)
+				{
+					error << (const char*)errorBlob->GetBufferPointer();
+				}
+				else
+				{
+					error << "error 0x" << std::hex << (UINT)hr;
+				}
+				OutputDebugStringA(error.str().c_str());
+				std::cerr << sourceFile << " (" << entryPoint << "): " << error.str() << std::endl;
+				ASSERT_HR(hr);
+				return ComPtr<ID3DBlob>();
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(m_shaderCacheMutex);
+				m_shaderCacheStatistics.Misses++;
+			}
+			if (!cachePath.empty() && !WriteShaderCache(cachePath, blob.Get()))
+			{
+				std::cerr << sourceFile << ": failed to write the shader cache" << std::endl;
+			}
 		}
 
 		return blob;
@@ -6,6 +6,13 @@ namespace Resource
 {
 	void ShaderProgram::Bind()
 	{
+		// Compute programs leave the graphics pipeline alone
+		if (Stages & SHADER_STAGE_COMPUTE)
+		{
+			Platform::GPU::Context()->CSSetShader(Compute.Get(), NULL, NULL);
+			return;
+		}
+
 		Platform::GPU::Context()->IASetInputLayout(InputLayout.Get());
 		Platform::GPU::Context()->VSSetShader(Vertex.Get(), NULL, NULL);
 		Platform::GPU::Context()->PSSetShader(Pixel.Get(), NULL, NULL);
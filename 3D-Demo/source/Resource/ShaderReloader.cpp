@@ -0,0 +1,234 @@
+#include "pch.h"
+#include "Resource/ShaderReloader.h"
+#include "Resource/ResourceManager.h"
+
+namespace
+{
+	// The file and everything it includes with #include "...", relative to
+	// the including file like the compiler does
+	void FindDependencies(const std::string& filePath, std::vector<std::string>& dependencies)
+	{
+		if (std::find(dependencies.begin(), dependencies.end(), filePath) != dependencies.end())
+		{
+			return;
+		}
+		dependencies.push_back(filePath);
+
+		std::ifstream file(filePath);
+		std::filesystem::path directory = std::filesystem::path(filePath).parent_path();
+
+		std::string line;
+		while (std::getline(file, line))
+		{
+			size_t start = line.find_first_not_of(" \t");
+			if (start == std::string::npos || line.compare(start, 8, "#include") != 0)
+			{
+				continue;
+			}
+
+			size_t open = line.find('"', start + 8);
+			size_t close = (open != std::string::npos) ? line.find('"', open + 1) : std::string::npos;
+			if (close == std::string::npos)
+			{
+				continue;
+			}
+
+			std::string include = line.substr(open + 1, close - open - 1);
+			FindDependencies((directory / include).lexically_normal().string(), dependencies);
+		}
+	}
+}
+
+namespace Resource
+{
+	std::unique_ptr<ShaderReloader> ShaderReloader::s_instance;
+
+	void ShaderReloader::Initialize()
+	{
+		if (!s_instance)
+		{
+			s_instance = std::make_unique<ShaderReloader>();
+		}
+	}
+
+	void ShaderReloader::Finalize()
+	{
+		s_instance.reset();
+	}
+
+	ShaderReloader::ShaderReloader() :
+		m_reloads(0),
+		m_failures(0),
+		m_running(true)
+	{
+		m_thread = std::thread(&ShaderReloader::ReloadThreadMain, this);
+	}
+
+	ShaderReloader::~ShaderReloader()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_running = false;
+		}
+		m_condition.notify_all();
+		m_thread.join();
+	}
+
+	void ShaderReloader::RegisterInternal(ID programID, const std::string& filePath, const ShaderDefines& defines)
+	{
+		WatchedProgram program;
+		program.FilePath = std::filesystem::path(filePath).lexically_normal().string();
+		program.Defines = defines;
+		WatchDependencies(program);
+
+		m_programs[programID] = program;
+	}
+
+	void ShaderReloader::UpdateInternal()
+	{
+		// Swap in what the reload thread has compiled
+		{
+			std::vector<ReloadResult> results;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				results.swap(m_results);
+			}
+
+			for (ReloadResult& result : results)
+			{
+				auto it = m_programs.find(result.ProgramID);
+				if (it == m_programs.end())
+				{
+					continue;
+				}
+
+				WatchedProgram& program = it->second;
+				program.Pending = false;
+
+				// With other stages than the program it replaces it would bind the wrong shaders
+				auto current = Manager::GetShaderProgram(result.ProgramID);
+				if (result.Program && current && result.Program->Stages == current->Stages)
+				{
+					Manager::ReplaceShaderProgram(result.ProgramID, result.Program);
+					m_reloads++;
+					std::cout << "Reloaded " << program.FilePath << std::endl;
+				}
+				else if (result.Program)
+				{
+					m_failures++;
+					std::cerr << "Shader reload: " << program.FilePath << " has different stages now, keeping the previous program" << std::endl;
+				}
+				else
+				{
+					m_failures++;
+					std::cerr << "Shader reload: " << program.FilePath << " failed to compile, keeping the previous program" << std::endl;
+				}
+
+				// Includes may have been added or removed, also when it failed
+				WatchDependencies(program);
+
+				if (program.Dirty)
+				{
+					Queue(result.ProgramID, program);
+				}
+			}
+		}
+
+		// Queue the programs using a changed file
+		std::vector<std::string> changed = m_watcher.GetChangedFiles();
+		if (changed.empty())
+		{
+			return;
+		}
+
+		for (auto& entry : m_programs)
+		{
+			WatchedProgram& program = entry.second;
+			for (const std::string& filePath : changed)
+			{
+				if (std::find(program.Dependencies.begin(), program.Dependencies.end(), filePath) != program.Dependencies.end())
+				{
+					Queue(entry.first, program);
+					break;
+				}
+			}
+		}
+	}
+
+	ShaderReloadStatistics ShaderReloader::GetStatisticsInternal() const
+	{
+		ShaderReloadStatistics statistics;
+		statistics.Programs = (UINT)m_programs.size();
+		statistics.Reloads = m_reloads;
+		statistics.Failures = m_failures;
+
+		for (const auto& entry : m_programs)
+		{
+			if (entry.second.Pending)
+			{
+				statistics.PendingRequests++;
+			}
+		}
+
+		return statistics;
+	}
+
+	void ShaderReloader::WatchDependencies(WatchedProgram& program)
+	{
+		program.Dependencies.clear();
+		FindDependencies(program.FilePath, program.Dependencies);
+
+		for (const std::string& dependency : program.Dependencies)
+		{
+			m_watcher.Watch(dependency);
+		}
+	}
+
+	void ShaderReloader::Queue(ID programID, WatchedProgram& program)
+	{
+		// One compile at a time per program, the latest change is picked up after it
+		if (program.Pending)
+		{
+			program.Dirty = true;
+			return;
+		}
+
+		program.Pending = true;
+		program.Dirty = false;
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_requests.push_back({ programID, program.FilePath, program.Defines });
+		}
+		m_condition.notify_one();
+	}
+
+	void ShaderReloader::ReloadThreadMain()
+	{
+		while (true)
+		{
+			ReloadRequest request;
+
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_condition.wait(lock, [this]() { return !m_running || !m_requests.empty(); });
+
+				if (!m_running)
+				{
+					return;
+				}
+
+				request = m_requests.front();
+				m_requests.pop_front();
+			}
+
+			// The device is free threaded, the shaders are created here as well
+			ReloadResult result;
+			result.ProgramID = request.ProgramID;
+			result.Program = Manager::CompileShaderProgram(request.FilePath, request.Defines);
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_results.push_back(std::move(result));
+		}
+	}
+}
@@ -0,0 +1,411 @@
+#include "pch.h"
+#include "Resource/TextureStreamer.h"
+#include "Resource/ResourceManager.h"
+#include "Resource/BlockCompression.h"
+#include "Resource/DDS.h"
+#include "Resource/KTX2.h"
+#include "Platform/GPU.h"
+#include "Platform/FrameArena.h"
+
+#include <cmath>
+
+namespace
+{
+	// Largest dimension of the mip a streamed texture starts at
+	const UINT INITIAL_MIP_SIZE = 64;
+
+	const size_t DEFAULT_BUDGET = 128 * 1024 * 1024;
+
+	// Block compressed textures need their most detailed mip in whole blocks
+	bool IsValidTopMip(DXGI_FORMAT format, UINT width, UINT height, UINT mip)
+	{
+		if (!Resource::GetBlockSize(format))
+		{
+			return true;
+		}
+		return (width >> mip) % 4 == 0 && (height >> mip) % 4 == 0 && (width >> mip) > 0 && (height >> mip) > 0;
+	}
+
+	UINT GetTexelStride(DXGI_FORMAT format)
+	{
+		UINT blockSize = Resource::GetBlockSize(format);
+		return blockSize ? blockSize : Resource::GetTexelSize(format);
+	}
+}
+
+namespace Resource
+{
+	std::unique_ptr<TextureStreamer> TextureStreamer::s_instance;
+
+	void TextureStreamer::Initialize()
+	{
+		if (!s_instance)
+		{
+			s_instance = std::make_unique<TextureStreamer>();
+		}
+	}
+
+	void TextureStreamer::Finalize()
+	{
+		s_instance.reset();
+	}
+
+	UINT TextureStreamer::GetInitialMip(DXGI_FORMAT format, UINT width, UINT height, UINT mipLevels)
+	{
+		UINT mip = 0;
+		while (mip + 1 < mipLevels && std::max(width >> mip, height >> mip) > INITIAL_MIP_SIZE)
+		{
+			mip++;
+		}
+
+		while (mip > 0 && !IsValidTopMip(format, width, height, mip))
+		{
+			mip--;
+		}
+
+		return mip;
+	}
+
+	TextureStreamer::TextureStreamer() :
+		m_budget(DEFAULT_BUDGET),
+		m_residentBytes(0),
+		m_pendingBytes(0),
+		m_frame(1),
+		m_uploads(0),
+		m_evictions(0),
+		m_running(true)
+	{
+		m_thread = std::thread(&TextureStreamer::StreamingThreadMain, this);
+	}
+
+	TextureStreamer::~TextureStreamer()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_running = false;
+		}
+		m_condition.notify_all();
+		m_thread.join();
+	}
+
+	void TextureStreamer::RegisterInternal(ID textureID, const std::string& filePath, const TextureImage& image, UINT residentMip)
+	{
+		StreamedTexture texture;
+		texture.FilePath = filePath;
+		texture.Format = image.Format;
+		texture.Width = image.Width;
+		texture.Height = image.Height;
+		texture.MipLevels = image.MipLevels;
+
+		for (UINT level = 0; level < image.MipLevels; level++)
+		{
+			texture.MipSizes.push_back(GetSurfaceSize(image.Format, std::max(1u, image.Width >> level), std::max(1u, image.Height >> level)));
+		}
+
+		texture.InitialMip = residentMip;
+		texture.ResidentMip = residentMip;
+		texture.WantedMip = residentMip;
+
+		m_residentBytes += GetResidentSize(texture, residentMip);
+		m_textures[textureID] = texture;
+	}
+
+	void TextureStreamer::RequestInternal(ID textureID, float texcoordsPerPixel)
+	{
+		auto it = m_textures.find(textureID);
+		if (it == m_textures.end())
+		{
+			return;
+		}
+
+		StreamedTexture& texture = it->second;
+
+		// One texel per pixel is enough, the initial mips are always resident
+		float texelsPerPixel = texcoordsPerPixel * std::max(texture.Width, texture.Height);
+		UINT mip = (texelsPerPixel > 1.0f) ? (UINT)std::log2(texelsPerPixel) : 0;
+		mip = std::min(mip, texture.InitialMip);
+
+		while (mip > 0 && !IsValidTopMip(texture.Format, texture.Width, texture.Height, mip))
+		{
+			mip--;
+		}
+
+		if (texture.LastUsedFrame != m_frame)
+		{
+			texture.LastUsedFrame = m_frame;
+			texture.WantedMip = mip;
+		}
+		else
+		{
+			texture.WantedMip = std::min(texture.WantedMip, mip);
+		}
+	}
+
+	void TextureStreamer::UpdateInternal()
+	{
+		// Upload what the streaming thread has read
+		{
+			std::vector<LoadResult> results;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				results.swap(m_results);
+			}
+
+			for (LoadResult& result : results)
+			{
+				auto it = m_textures.find(result.TextureID);
+				if (it == m_textures.end())
+				{
+					continue;
+				}
+
+				StreamedTexture& texture = it->second;
+				texture.Pending = false;
+				m_pendingBytes -= texture.PendingBytes;
+				texture.PendingBytes = 0;
+
+				const TextureImage& image = result.Image;
+				bool matches = result.Succeeded &&
+					image.Format == texture.Format &&
+					image.Width == texture.Width &&
+					image.Height == texture.Height &&
+					image.MipLevels == texture.MipLevels &&
+					image.ArraySize == 1;
+
+				if (!matches)
+				{
+					texture.Failed = true;
+					std::cerr << "Texture streaming: failed to read " << texture.FilePath << std::endl;
+					continue;
+				}
+
+				if (result.TargetMip < texture.ResidentMip)
+				{
+					Upload(result.TextureID, texture, image, result.TargetMip);
+				}
+			}
+		}
+
+		// Over budget, least recently used textures go back to their initial
+		// mip and textures still in use drop the mips they no longer need
+		if (m_residentBytes + m_pendingBytes > m_budget)
+		{
+			Platform::FrameVector<std::pair<ID, StreamedTexture*>> candidates;
+			for (auto& entry : m_textures)
+			{
+				StreamedTexture& texture = entry.second;
+				bool usedThisFrame = texture.LastUsedFrame == m_frame;
+				if (texture.ResidentMip < texture.InitialMip && (!usedThisFrame || texture.WantedMip > texture.ResidentMip))
+				{
+					candidates.emplace_back(entry.first, &texture);
+				}
+			}
+
+			std::sort(candidates.begin(), candidates.end(), [this](const auto& a, const auto& b) {
+				if (a.second->LastUsedFrame != b.second->LastUsedFrame)
+				{
+					return a.second->LastUsedFrame < b.second->LastUsedFrame;
+				}
+				return GetResidentSize(*a.second, a.second->ResidentMip) > GetResidentSize(*b.second, b.second->ResidentMip);
+			});
+
+			for (auto& candidate : candidates)
+			{
+				if (m_residentBytes + m_pendingBytes <= m_budget)
+				{
+					break;
+				}
+
+				StreamedTexture& texture = *candidate.second;
+				UINT targetMip = (texture.LastUsedFrame == m_frame) ? texture.WantedMip : texture.InitialMip;
+				Evict(candidate.first, texture, targetMip);
+			}
+		}
+
+		// Queue loads for textures sampled finer than they are resident, the
+		// largest shortfall first, as long as they fit the budget
+		{
+			Platform::FrameVector<std::pair<ID, StreamedTexture*>> candidates;
+			for (auto& entry : m_textures)
+			{
+				StreamedTexture& texture = entry.second;
+				if (!texture.Pending && !texture.Failed && texture.LastUsedFrame == m_frame && texture.WantedMip < texture.ResidentMip)
+				{
+					candidates.emplace_back(entry.first, &texture);
+				}
+			}
+
+			std::sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) {
+				return a.second->ResidentMip - a.second->WantedMip > b.second->ResidentMip - b.second->WantedMip;
+			});
+
+			bool queued = false;
+			for (auto& candidate : candidates)
+			{
+				StreamedTexture& texture = *candidate.second;
+				size_t cost = GetResidentSize(texture, texture.WantedMip) - GetResidentSize(texture, texture.ResidentMip);
+				if (m_residentBytes + m_pendingBytes + cost > m_budget)
+				{
+					continue;
+				}
+
+				texture.Pending = true;
+				texture.PendingBytes = cost;
+				m_pendingBytes += cost;
+
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_requests.push_back({ candidate.first, texture.FilePath, texture.WantedMip });
+				queued = true;
+			}
+
+			if (queued)
+			{
+				m_condition.notify_one();
+			}
+		}
+
+		m_frame++;
+	}
+
+	TextureStreamingStatistics TextureStreamer::GetStatisticsInternal() const
+	{
+		TextureStreamingStatistics statistics;
+		statistics.ResidentBytes = m_residentBytes;
+		statistics.BudgetBytes = m_budget;
+		statistics.StreamedTextures = (UINT)m_textures.size();
+		statistics.Uploads = m_uploads;
+		statistics.Evictions = m_evictions;
+
+		for (const auto& entry : m_textures)
+		{
+			if (entry.second.Pending)
+			{
+				statistics.PendingRequests++;
+			}
+		}
+
+		return statistics;
+	}
+
+	size_t TextureStreamer::GetResidentSize(const StreamedTexture& texture, UINT mostDetailedMip) const
+	{
+		size_t size = 0;
+		for (UINT level = mostDetailedMip; level < texture.MipLevels; level++)
+		{
+			size += texture.MipSizes[level];
+		}
+		return size;
+	}
+
+	void TextureStreamer::Upload(ID textureID, StreamedTexture& texture, const TextureImage& image, UINT targetMip)
+	{
+		D3D11_TEXTURE2D_DESC textureDesc;
+		ZERO_MEMORY(textureDesc);
+		textureDesc.Width = std::max(1u, texture.Width >> targetMip);
+		textureDesc.Height = std::max(1u, texture.Height >> targetMip);
+		textureDesc.MipLevels = texture.MipLevels - targetMip;
+		textureDesc.ArraySize = 1;
+		textureDesc.Format = texture.Format;
+		textureDesc.SampleDesc.Count = 1;
+		textureDesc.Usage = D3D11_USAGE_IMMUTABLE;
+		textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+		// Straight from the mapped file, including the mips already resident
+		ResourceManager::ReplaceTexture2D(textureID, textureDesc, GetTexelStride(texture.Format), image.Subresources.data() + targetMip);
+
+		m_residentBytes += GetResidentSize(texture, targetMip) - GetResidentSize(texture, texture.ResidentMip);
+		texture.ResidentMip = targetMip;
+		m_uploads++;
+	}
+
+	void TextureStreamer::Evict(ID textureID, StreamedTexture& texture, UINT targetMip)
+	{
+		if (targetMip <= texture.ResidentMip)
+		{
+			return;
+		}
+
+		// Keep the current texture alive to copy the remaining mips from
+		std::shared_ptr<const Texture2D> previous = ResourceManager::GetTexture2D(textureID);
+
+		D3D11_TEXTURE2D_DESC textureDesc;
+		ZERO_MEMORY(textureDesc);
+		textureDesc.Width = std::max(1u, texture.Width >> targetMip);
+		textureDesc.Height = std::max(1u, texture.Height >> targetMip);
+		textureDesc.MipLevels = texture.MipLevels - targetMip;
+		textureDesc.ArraySize = 1;
+		textureDesc.Format = texture.Format;
+		textureDesc.SampleDesc.Count = 1;
+		textureDesc.Usage = D3D11_USAGE_DEFAULT;
+		textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+		ResourceManager::ReplaceTexture2D(textureID, textureDesc, GetTexelStride(texture.Format));
+		std::shared_ptr<const Texture2D> current = ResourceManager::GetTexture2D(textureID);
+
+		UINT skippedLevels = targetMip - texture.ResidentMip;
+		for (UINT level = 0; level < textureDesc.MipLevels; level++)
+		{
+			Platform::GPU::Context()->CopySubresourceRegion(current->Texture.Get(), level, 0, 0, 0, previous->Texture.Get(), level + skippedLevels, nullptr);
+		}
+
+		m_residentBytes -= GetResidentSize(texture, texture.ResidentMip) - GetResidentSize(texture, targetMip);
+		texture.ResidentMip = targetMip;
+		m_evictions++;
+	}
+
+	void TextureStreamer::StreamingThreadMain()
+	{
+		while (true)
+		{
+			LoadRequest request;
+
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_condition.wait(lock, [this]() { return !m_running || !m_requests.empty(); });
+
+				if (!m_running)
+				{
+					return;
+				}
+
+				request = m_requests.front();
+				m_requests.pop_front();
+			}
+
+			LoadResult result;
+			result.TextureID = request.TextureID;
+			result.TargetMip = request.TargetMip;
+
+			if (result.File.Open(request.FilePath))
+			{
+				std::string extension = std::filesystem::path(request.FilePath).extension().string();
+				std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return (char)tolower(c); });
+				bool ktx2 = extension == ".ktx2";
+				result.Succeeded = ktx2
+					? ParseKTX2(result.File.Data(), result.File.Size(), result.Image)
+					: ParseDDS(result.File.Data(), result.File.Size(), result.Image);
+			}
+
+			// Fault the requested mips in here so the upload on the main thread
+			// does not wait for the disk
+			if (result.Succeeded)
+			{
+				unsigned int checksum = 0;
+				for (size_t i = request.TargetMip; i < result.Image.Subresources.size(); i++)
+				{
+					const D3D11_SUBRESOURCE_DATA& subresource = result.Image.Subresources[i];
+					const unsigned char* data = (const unsigned char*)subresource.pSysMem;
+					for (size_t offset = 0; offset < subresource.SysMemSlicePitch; offset += 4096)
+					{
+						checksum += data[offset];
+					}
+				}
+				volatile unsigned int touched = checksum;
+				(void)touched;
+			}
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_results.push_back(std::move(result));
+		}
+	}
+}
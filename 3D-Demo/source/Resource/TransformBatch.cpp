@@ -0,0 +1,269 @@
+#include "pch.h"
+#include "Resource/TransformBatch.h"
+
+#include <intrin.h>
+#include <immintrin.h>
+
+namespace
+{
+	/** --- LANE OPERATIONS --- */
+
+	struct ScalarLanes
+	{
+		using Vector = float;
+		static const size_t Width = 1;
+
+		static inline Vector Load(const float* source) { return *source; }
+		static inline Vector Set(float value) { return value; }
+		static inline Vector Add(Vector a, Vector b) { return a + b; }
+		static inline Vector Subtract(Vector a, Vector b) { return a - b; }
+		static inline Vector Multiply(Vector a, Vector b) { return a * b; }
+	};
+
+	struct SSELanes
+	{
+		using Vector = __m128;
+		static const size_t Width = 4;
+
+		static inline Vector Load(const float* source) { return _mm_loadu_ps(source); }
+		static inline Vector Set(float value) { return _mm_set1_ps(value); }
+		static inline Vector Add(Vector a, Vector b) { return _mm_add_ps(a, b); }
+		static inline Vector Subtract(Vector a, Vector b) { return _mm_sub_ps(a, b); }
+		static inline Vector Multiply(Vector a, Vector b) { return _mm_mul_ps(a, b); }
+	};
+
+	struct AVXLanes
+	{
+		using Vector = __m256;
+		static const size_t Width = 8;
+
+		static inline Vector Load(const float* source) { return _mm256_loadu_ps(source); }
+		static inline Vector Set(float value) { return _mm256_set1_ps(value); }
+		static inline Vector Add(Vector a, Vector b) { return _mm256_add_ps(a, b); }
+		static inline Vector Subtract(Vector a, Vector b) { return _mm256_sub_ps(a, b); }
+		static inline Vector Multiply(Vector a, Vector b) { return _mm256_mul_ps(a, b); }
+	};
+
+	/** --- MATRIX COMPOSITION --- */
+
+	// The first three rows of the transposed matrices of Lanes::Width transforms,
+	// rows[r][c] holds element (r, c) of every transform. The last row is always 0 0 0 1.
+	template<typename Lanes>
+	inline void ComposeRows(const Resource::TransformBatch& transforms, size_t index, typename Lanes::Vector rows[3][4])
+	{
+		using Vector = typename Lanes::Vector;
+
+		Vector x = Lanes::Load(transforms.RotationX.data() + index);
+		Vector y = Lanes::Load(transforms.RotationY.data() + index);
+		Vector z = Lanes::Load(transforms.RotationZ.data() + index);
+		Vector w = Lanes::Load(transforms.RotationW.data() + index);
+
+		Vector x2 = Lanes::Add(x, x);
+		Vector y2 = Lanes::Add(y, y);
+		Vector z2 = Lanes::Add(z, z);
+
+		Vector xx = Lanes::Multiply(x, x2);
+		Vector yy = Lanes::Multiply(y, y2);
+		Vector zz = Lanes::Multiply(z, z2);
+		Vector xy = Lanes::Multiply(x, y2);
+		Vector xz = Lanes::Multiply(x, z2);
+		Vector yz = Lanes::Multiply(y, z2);
+		Vector xw = Lanes::Multiply(w, x2);
+		Vector yw = Lanes::Multiply(w, y2);
+		Vector zw = Lanes::Multiply(w, z2);
+
+		Vector one = Lanes::Set(1.f);
+
+		// Rotation rows as in XMMatrixRotationQuaternion
+		Vector r00 = Lanes::Subtract(one, Lanes::Add(yy, zz));
+		Vector r01 = Lanes::Add(xy, zw);
+		Vector r02 = Lanes::Subtract(xz, yw);
+		Vector r10 = Lanes::Subtract(xy, zw);
+		Vector r11 = Lanes::Subtract(one, Lanes::Add(xx, zz));
+		Vector r12 = Lanes::Add(yz, xw);
+		Vector r20 = Lanes::Add(xz, yw);
+		Vector r21 = Lanes::Subtract(yz, xw);
+		Vector r22 = Lanes::Subtract(one, Lanes::Add(xx, yy));
+
+		// Scale scales the rotation rows, translation becomes the last column once transposed
+		Vector scaleX = Lanes::Load(transforms.ScaleX.data() + index);
+		Vector scaleY = Lanes::Load(transforms.ScaleY.data() + index);
+		Vector scaleZ = Lanes::Load(transforms.ScaleZ.data() + index);
+
+		rows[0][0] = Lanes::Multiply(r00, scaleX);
+		rows[0][1] = Lanes::Multiply(r10, scaleY);
+		rows[0][2] = Lanes::Multiply(r20, scaleZ);
+		rows[0][3] = Lanes::Load(transforms.PositionX.data() + index);
+
+		rows[1][0] = Lanes::Multiply(r01, scaleX);
+		rows[1][1] = Lanes::Multiply(r11, scaleY);
+		rows[1][2] = Lanes::Multiply(r21, scaleZ);
+		rows[1][3] = Lanes::Load(transforms.PositionY.data() + index);
+
+		rows[2][0] = Lanes::Multiply(r02, scaleX);
+		rows[2][1] = Lanes::Multiply(r12, scaleY);
+		rows[2][2] = Lanes::Multiply(r22, scaleZ);
+		rows[2][3] = Lanes::Load(transforms.PositionZ.data() + index);
+	}
+
+	void ComposeScalar(const Resource::TransformBatch& transforms, size_t begin, size_t end, DirectX::XMFLOAT4X4* output)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			float rows[3][4];
+			ComposeRows<ScalarLanes>(transforms, i, rows);
+
+			DirectX::XMFLOAT4X4& matrix = output[i - begin];
+			for (int r = 0; r < 3; r++)
+			{
+				for (int c = 0; c < 4; c++)
+				{
+					matrix.m[r][c] = rows[r][c];
+				}
+			}
+			matrix._41 = 0.f;
+			matrix._42 = 0.f;
+			matrix._43 = 0.f;
+			matrix._44 = 1.f;
+		}
+	}
+
+	// Lanes hold one element of 4 transforms, a 4x4 transpose turns them into one matrix row each
+	size_t ComposeSSE(const Resource::TransformBatch& transforms, size_t begin, size_t end, DirectX::XMFLOAT4X4* output)
+	{
+		const __m128 lastRow = _mm_setr_ps(0.f, 0.f, 0.f, 1.f);
+
+		size_t i = begin;
+		for (; i + SSELanes::Width <= end; i += SSELanes::Width)
+		{
+			__m128 rows[3][4];
+			ComposeRows<SSELanes>(transforms, i, rows);
+
+			for (int r = 0; r < 3; r++)
+			{
+				_MM_TRANSPOSE4_PS(rows[r][0], rows[r][1], rows[r][2], rows[r][3]);
+				for (int lane = 0; lane < 4; lane++)
+				{
+					_mm_storeu_ps(output[i - begin + lane].m[r], rows[r][lane]);
+				}
+			}
+			for (int lane = 0; lane < 4; lane++)
+			{
+				_mm_storeu_ps(output[i - begin + lane].m[3], lastRow);
+			}
+		}
+
+		return i;
+	}
+
+	// Same as ComposeSSE, both 128-bit halves are transposed at once
+	size_t ComposeAVX(const Resource::TransformBatch& transforms, size_t begin, size_t end, DirectX::XMFLOAT4X4* output)
+	{
+		const __m128 lastRow = _mm_setr_ps(0.f, 0.f, 0.f, 1.f);
+
+		size_t i = begin;
+		for (; i + AVXLanes::Width <= end; i += AVXLanes::Width)
+		{
+			__m256 rows[3][4];
+			ComposeRows<AVXLanes>(transforms, i, rows);
+
+			for (int r = 0; r < 3; r++)
+			{
+				__m256 t0 = _mm256_unpacklo_ps(rows[r][0], rows[r][1]);
+				__m256 t1 = _mm256_unpackhi_ps(rows[r][0], rows[r][1]);
+				__m256 t2 = _mm256_unpacklo_ps(rows[r][2], rows[r][3]);
+				__m256 t3 = _mm256_unpackhi_ps(rows[r][2], rows[r][3]);
+
+				// Lane n holds the row of transform n in its low half and of transform n + 4 in its high half
+				__m256 lanes[4] = {
+					_mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0)),
+					_mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2)),
+					_mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0)),
+					_mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2)),
+				};
+
+				for (int lane = 0; lane < 4; lane++)
+				{
+					_mm_storeu_ps(output[i - begin + lane].m[r], _mm256_castps256_ps128(lanes[lane]));
+					_mm_storeu_ps(output[i - begin + lane + 4].m[r], _mm256_extractf128_ps(lanes[lane], 1));
+				}
+			}
+			for (int lane = 0; lane < 8; lane++)
+			{
+				_mm_storeu_ps(output[i - begin + lane].m[3], lastRow);
+			}
+		}
+
+		return i;
+	}
+
+	// The kernel only uses AVX float instructions, AVX2 is not needed
+	bool SupportsAVX()
+	{
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 1)
+		{
+			return false;
+		}
+
+		// The OS has to save the upper halves of the registers
+		__cpuid(info, 1);
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+		return osxsave && avx && (_xgetbv(0) & 0x6) == 0x6;
+	}
+}
+
+namespace Resource
+{
+	void TransformBatch::Resize(size_t count)
+	{
+		for (std::vector<float>* component : { &PositionX, &PositionY, &PositionZ, &RotationX, &RotationY, &RotationZ, &ScaleX, &ScaleY, &ScaleZ })
+		{
+			component->resize(count, 0.f);
+		}
+		RotationW.resize(count, 1.f);
+	}
+
+	void TransformBatch::Set(size_t index, const Transform& transform)
+	{
+		PositionX[index] = transform.Position.x;
+		PositionY[index] = transform.Position.y;
+		PositionZ[index] = transform.Position.z;
+		RotationX[index] = transform.Rotation.x;
+		RotationY[index] = transform.Rotation.y;
+		RotationZ[index] = transform.Rotation.z;
+		RotationW[index] = transform.Rotation.w;
+		ScaleX[index] = transform.Scale.x;
+		ScaleY[index] = transform.Scale.y;
+		ScaleZ[index] = transform.Scale.z;
+	}
+
+	SimdLevel GetSimdLevel()
+	{
+		static const SimdLevel level = SupportsAVX() ? SimdLevel::AVX : SimdLevel::SSE;
+		return level;
+	}
+
+	void ComposeMatricesTransposed(const TransformBatch& transforms, size_t begin, size_t end, DirectX::XMFLOAT4X4* output)
+	{
+		ComposeMatricesTransposed(transforms, begin, end, output, GetSimdLevel());
+	}
+
+	void ComposeMatricesTransposed(const TransformBatch& transforms, size_t begin, size_t end, DirectX::XMFLOAT4X4* output, SimdLevel level)
+	{
+		assert(end <= transforms.Size());
+
+		// The wide paths stop at the last full batch, the scalar path finishes the rest
+		size_t tail = begin;
+		switch (level)
+		{
+		case SimdLevel::AVX:	tail = ComposeAVX(transforms, begin, end, output); break;
+		case SimdLevel::SSE:	tail = ComposeSSE(transforms, begin, end, output); break;
+		default:				break;
+		}
+
+		ComposeScalar(transforms, tail, end, output + (tail - begin));
+	}
+}
@@ -58,7 +58,7 @@ namespace Resource
 			if (windowInstanceData)
 			{
 				auto window = Manager::GetWindow(windowInstanceData->WindowID);
-				window->State = Resource::WindowState::Destroyed;
+				window->State = state;
 			}
 		}		
 	}
@@ -0,0 +1,1085 @@
+#include "pch.h"
+#include "Scene/Benchmarks.h"
+#include "Scene/Components.h"
+#include "Scene/TransformSystem.h"
+#include "Resource/TransformBatch.h"
+#include "Graphics/DepthSort.h"
+#include "Graphics/InstanceBuckets.h"
+#include "Graphics/LightClusters.h"
+#include "Graphics/RenderGraph.h"
+#include "Graphics/ShadowCascades.h"
+#include "Platform/JobSystem.h"
+
+#include <numeric>
+#include <random>
+
+namespace
+{
+	using Clock = std::chrono::high_resolution_clock;
+	using Milliseconds = std::chrono::duration<double, std::milli>;
+
+	// Keeps the optimizer from dropping the measured work
+	volatile float s_sink = 0.f;
+
+	void ConsumeMatrices(const std::vector<DirectX::XMFLOAT4X4>& matrices)
+	{
+		float sum = 0.f;
+		for (size_t i = 0; i < matrices.size(); i += 64)
+		{
+			sum += matrices[i]._14;
+		}
+		s_sink = s_sink + sum;
+	}
+
+	// parentOf(i) returns the index of the parent of entity i, or i for a root
+	std::vector<entt::entity> CreateEntities(entt::registry& registry, size_t entityCount, const std::function<size_t(size_t)>& parentOf = nullptr)
+	{
+		std::vector<entt::entity> created;
+		created.reserve(entityCount);
+
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> position(-500.f, 500.f);
+		std::uniform_real_distribution<float> angle(-DirectX::XM_PI, DirectX::XM_PI);
+		std::uniform_real_distribution<float> scale(0.5f, 2.f);
+
+		for (size_t i = 0; i < entityCount; i++)
+		{
+			Component::TransformComponent transform;
+			transform.Position = { position(random), position(random), position(random) };
+			transform.SetEulerRotation({ angle(random), angle(random), angle(random) });
+			transform.Scale = { scale(random), scale(random), scale(random) };
+
+			if (parentOf && parentOf(i) != i)
+			{
+				// Children stay close to their parent so deep chains do not drift off
+				transform.Position = { 1.f, 0.f, 0.f };
+				transform.Scale = { 1.f, 1.f, 1.f };
+				transform.ParentEntity = created[parentOf(i)];
+			}
+
+			entt::entity entity = registry.create();
+			registry.emplace<Component::MeshComponent>(entity, Component::MeshComponent{ 1 });
+			registry.emplace<Component::TransformComponent>(entity, transform);
+			created.push_back(entity);
+		}
+
+		return created;
+	}
+
+	// A deferred frame with SSAO, bloom and FXAA, plus a debug view nothing reads
+	void BuildDeferredGraph(Graphics::RenderGraph& graph, UINT width, UINT height)
+	{
+		using namespace Graphics;
+		using Usage = RenderResourceUsage;
+
+		RenderResource backBuffer = graph.Import("Back buffer", 1, RenderResourceDesc::Texture(width, height, DXGI_FORMAT_R8G8B8A8_UNORM, 4));
+		RenderResource color, normal, emissive, roughness, depth;
+		graph.AddPass("G-buffer", [&](RenderGraphBuilder& builder) {
+			color = builder.Write(builder.Create("Color", RenderResourceDesc::Texture(width, height, DXGI_FORMAT_R8G8B8A8_UNORM, 4)));
+			normal = builder.Write(builder.Create("Normal", RenderResourceDesc::Texture(width, height, DXGI_FORMAT_R10G10B10A2_UNORM, 4)));
+			emissive = builder.Write(builder.Create("Emissive", RenderResourceDesc::Texture(width, height, DXGI_FORMAT_R8G8B8A8_UNORM, 4)));
+			roughness = builder.Write(builder.Create("Roughness", RenderResourceDesc::Texture(width, height, DXGI_FORMAT_R8_UNORM, 1)));
+			depth = builder.Write(builder.Create("Depth", RenderResourceDesc::Depth(width, height)), Usage::DepthStencil);
+		}, nullptr);
+
+		RenderResource occlusion;
+		graph.AddPass("SSAO", [&](RenderGraphBuilder& builder) {
+			builder.Read(normal);
+			builder.Read(depth);
+			occlusion = builder.Write(builder.Create("Occlusion", RenderResourceDesc::Texture(width / 2, height / 2, DXGI_FORMAT_R8_UNORM, 1)));
+		}, nullptr);
+		for (const char* name : { "SSAO blur X", "SSAO blur Y" })
+		{
+			graph.AddPass(name, [&](RenderGraphBuilder& builder) {
+				builder.Read(occlusion);
+				occlusion = builder.Write(builder.Create("Blurred occlusion", RenderResourceDesc::Texture(width / 2, height / 2, DXGI_FORMAT_R8_UNORM, 1)));
+			}, nullptr);
+		}
+
+		RenderResource hdr;
+		graph.AddPass("Lighting", [&](RenderGraphBuilder& builder) {
+			for (RenderResource input : { color, normal, emissive, roughness, depth, occlusion })
+			{
+				builder.Read(input);
+			}
+			hdr = builder.Write(builder.Create("HDR", RenderResourceDesc::Texture(width, height, DXGI_FORMAT_R16G16B16A16_FLOAT, 8)), Usage::UnorderedAccess);
+		}, nullptr);
+
+		graph.AddPass("Debug view", [&](RenderGraphBuilder& builder) {
+			builder.Read(normal);
+			builder.Write(builder.Create("Debug", RenderResourceDesc::Texture(width, height, DXGI_FORMAT_R8G8B8A8_UNORM, 4)));
+		}, nullptr);
+
+		// Bloom, down to a 32th and back up
+		const UINT BLOOM_LEVELS = 5;
+		RenderResource bloom[BLOOM_LEVELS + 1];
+		bloom[0] = hdr;
+		for (UINT level = 1; level <= BLOOM_LEVELS; level++)
+		{
+			graph.AddPass("Bloom down", [&](RenderGraphBuilder& builder) {
+				builder.Read(bloom[level - 1]);
+				bloom[level] = builder.Write(builder.Create("Bloom", RenderResourceDesc::Texture(width >> level, height >> level, DXGI_FORMAT_R16G16B16A16_FLOAT, 8)));
+			}, nullptr);
+		}
+		RenderResource upsampled = bloom[BLOOM_LEVELS];
+		for (UINT level = BLOOM_LEVELS - 1; level >= 1; level--)
+		{
+			graph.AddPass("Bloom up", [&](RenderGraphBuilder& builder) {
+				builder.Read(upsampled);
+				builder.Read(bloom[level]);
+				upsampled = builder.Write(builder.Create("Bloom", RenderResourceDesc::Texture(width >> level, height >> level, DXGI_FORMAT_R16G16B16A16_FLOAT, 8)));
+			}, nullptr);
+		}
+
+		RenderResource ldr;
+		graph.AddPass("Tone mapping", [&](RenderGraphBuilder& builder) {
+			builder.Read(hdr);
+			builder.Read(upsampled);
+			ldr = builder.Write(builder.Create("LDR", RenderResourceDesc::Texture(width, height, DXGI_FORMAT_R8G8B8A8_UNORM, 4)));
+		}, nullptr);
+
+		graph.AddPass("FXAA", [&](RenderGraphBuilder& builder) {
+			builder.Read(ldr);
+			builder.Write(backBuffer);
+		}, nullptr);
+	}
+
+	// Full screen effects one after another, each reading the last one's result
+	void BuildPostChainGraph(Graphics::RenderGraph& graph, UINT width, UINT height, UINT passCount)
+	{
+		using namespace Graphics;
+
+		RenderResource backBuffer = graph.Import("Back buffer", 1, RenderResourceDesc::Texture(width, height, DXGI_FORMAT_R8G8B8A8_UNORM, 4));
+		RenderResource previous;
+		for (UINT i = 0; i < passCount; i++)
+		{
+			graph.AddPass("Effect", [&](RenderGraphBuilder& builder) {
+				if (previous.IsValid())
+				{
+					builder.Read(previous);
+				}
+				previous = builder.Write(builder.Create("Effect", RenderResourceDesc::Texture(width, height, DXGI_FORMAT_R16G16B16A16_FLOAT, 8)));
+			}, nullptr);
+		}
+
+		graph.AddPass("Present", [&](RenderGraphBuilder& builder) {
+			builder.Read(previous);
+			builder.Write(backBuffer);
+		}, nullptr);
+	}
+
+	// Depth buffer rasterizing triangles on the CPU, counts the fragments that
+	// pass the depth test, which is how often an early-z GPU runs the pixel shader
+	class SoftwareDepthBuffer
+	{
+	public:
+
+		SoftwareDepthBuffer(UINT width, UINT height) : m_width(width), m_height(height), m_depth(width * height, 1.f) {}
+
+		void Clear() { std::fill(m_depth.begin(), m_depth.end(), 1.f); }
+
+		// Triangle in clip space, clockwise on screen when facing the camera.
+		// Returns the fragments passing, equal only passes the stored depth and writes nothing.
+		size_t Draw(const DirectX::XMFLOAT4 (&clip)[3], bool equal)
+		{
+			float x[3], y[3], z[3];
+			for (int i = 0; i < 3; i++)
+			{
+				if (clip[i].w <= 0.f)
+				{
+					return 0;
+				}
+				x[i] = (clip[i].x / clip[i].w * 0.5f + 0.5f) * m_width;
+				y[i] = (0.5f - clip[i].y / clip[i].w * 0.5f) * m_height;
+				z[i] = clip[i].z / clip[i].w;
+			}
+
+			float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+			if (area <= 0.f)
+			{
+				return 0; // Back facing
+			}
+
+			int minX = std::max(0, (int)std::floor(std::min(x[0], std::min(x[1], x[2]))));
+			int maxX = std::min((int)m_width - 1, (int)std::ceil(std::max(x[0], std::max(x[1], x[2]))));
+			int minY = std::max(0, (int)std::floor(std::min(y[0], std::min(y[1], y[2]))));
+			int maxY = std::min((int)m_height - 1, (int)std::ceil(std::max(y[0], std::max(y[1], y[2]))));
+
+			size_t passed = 0;
+			for (int py = minY; py <= maxY; py++)
+			{
+				for (int px = minX; px <= maxX; px++)
+				{
+					float cx = px + 0.5f;
+					float cy = py + 0.5f;
+					float w0 = (x[2] - x[1]) * (cy - y[1]) - (y[2] - y[1]) * (cx - x[1]);
+					float w1 = (x[0] - x[2]) * (cy - y[2]) - (y[0] - y[2]) * (cx - x[2]);
+					float w2 = (x[1] - x[0]) * (cy - y[0]) - (y[1] - y[0]) * (cx - x[0]);
+					if (w0 < 0.f || w1 < 0.f || w2 < 0.f)
+					{
+						continue;
+					}
+
+					float depth = (w0 * z[0] + w1 * z[1] + w2 * z[2]) / area;
+					float& stored = m_depth[py * m_width + px];
+					if (equal ? depth == stored : depth < stored)
+					{
+						stored = equal ? stored : depth;
+						passed++;
+					}
+				}
+			}
+			return passed;
+		}
+
+		size_t CoveredPixels() const { return (size_t)std::count_if(m_depth.begin(), m_depth.end(), [](float depth) { return depth < 1.f; }); }
+		bool operator==(const SoftwareDepthBuffer& other) const { return m_depth == other.m_depth; }
+
+	private:
+
+		UINT m_width;
+		UINT m_height;
+		std::vector<float> m_depth;
+	};
+
+	// movedIndex is the entity moved, with its subtree, for the incremental update
+	void MeasureHierarchy(const char* name, size_t entityCount, size_t frameCount, const std::function<size_t(size_t)>& parentOf, size_t movedIndex)
+	{
+		std::cout << "\t" << name << ":" << std::endl;
+
+		for (bool parallel : { false, true })
+		{
+			entt::registry registry;
+			TransformSystem transformSystem(registry);
+			if (!parallel)
+			{
+				transformSystem.SetParallelThreshold(0);
+			}
+
+			std::vector<entt::entity> entities = CreateEntities(registry, entityCount, parentOf);
+
+			Clock::time_point start = Clock::now();
+			transformSystem.Update();
+			double rebuildTime = Milliseconds(Clock::now() - start).count();
+
+			std::vector<entt::entity> roots;
+			registry.view<Component::TransformComponent>().each([&](entt::entity entity, const auto& transform) {
+				if (transform.ParentEntity == entt::null)
+				{
+					roots.push_back(entity);
+				}
+			});
+
+			// Moving every root dirties the whole hierarchy
+			size_t fullCount = 0;
+			start = Clock::now();
+			for (size_t frame = 0; frame < frameCount; frame++)
+			{
+				for (entt::entity root : roots)
+				{
+					registry.patch<Component::TransformComponent>(root, [](auto& transform) { transform.Rotate(DirectX::XMVectorSet(0.f, 1.f, 0.f, 0.f), 0.01f); });
+				}
+				fullCount = transformSystem.Update();
+			}
+			double fullTime = Milliseconds(Clock::now() - start).count() / frameCount;
+
+			// A single node inside the hierarchy moves with its subtree
+			size_t subtreeCount = 0;
+			entt::entity moved = entities[std::min(movedIndex, entities.size() - 1)];
+			start = Clock::now();
+			for (size_t frame = 0; frame < frameCount; frame++)
+			{
+				registry.patch<Component::TransformComponent>(moved, [](auto& transform) { transform.RotateLocal(DirectX::XMVectorSet(1.f, 0.f, 0.f, 0.f), 0.01f); });
+				subtreeCount = transformSystem.Update();
+			}
+			double subtreeTime = Milliseconds(Clock::now() - start).count() / frameCount;
+
+			std::cout << "\t\t" << (parallel ? "Parallel" : "Serial") << ": rebuild " << rebuildTime << " ms, full update "
+				<< fullTime << " ms (" << fullCount << " matrices), subtree update " << subtreeTime << " ms ("
+				<< subtreeCount << " matrices)" << std::endl;
+		}
+	}
+}
+
+namespace Benchmarks
+{
+	void TransformCache(size_t entityCount, size_t frameCount, float movingFraction)
+	{
+		entt::registry registry;
+		TransformSystem transformSystem(registry);
+
+		CreateEntities(registry, entityCount);
+		transformSystem.Update();
+
+		std::vector<entt::entity> entities;
+		entities.reserve(entityCount);
+		registry.view<Component::TransformComponent>().each([&](entt::entity entity, auto&) {
+			entities.push_back(entity);
+		});
+
+		std::vector<DirectX::XMFLOAT4X4> submitted;
+		submitted.reserve(entityCount);
+
+		// Every matrix rebuilt from position, rotation and scale when submitted
+		Clock::time_point start = Clock::now();
+		for (size_t frame = 0; frame < frameCount; frame++)
+		{
+			submitted.clear();
+			registry.view<Component::MeshComponent, Component::TransformComponent>().each([&](auto entity, const auto& mesh, const auto& transform) {
+				submitted.push_back(transform.GetMatrixTransposed());
+			});
+			ConsumeMatrices(submitted);
+		}
+		double recomputeTime = Milliseconds(Clock::now() - start).count() / frameCount;
+
+		// A different slice of the entities moves every frame, the rest is static
+		size_t movingCount = std::min(entityCount, (size_t)(entityCount * movingFraction));
+		size_t updated = 0;
+		double updateTime = 0.0;
+		double gatherTime = 0.0;
+		for (size_t frame = 0; frame < frameCount; frame++)
+		{
+			start = Clock::now();
+			for (size_t i = 0; i < movingCount; i++)
+			{
+				entt::entity entity = entities[(frame * movingCount + i) % entities.size()];
+				registry.patch<Component::TransformComponent>(entity, [](auto& transform) {
+					transform.Position.y += 0.1f;
+					transform.Rotate(DirectX::XMVectorSet(0.f, 1.f, 0.f, 0.f), 0.01f);
+				});
+			}
+			updated += transformSystem.Update();
+			Clock::time_point gatherStart = Clock::now();
+			updateTime += Milliseconds(gatherStart - start).count();
+
+			submitted.clear();
+			registry.view<Component::MeshComponent, Component::WorldMatrixComponent>().each([&](auto entity, const auto& mesh, const auto& world) {
+				submitted.push_back(world.WorldTransposed);
+			});
+			ConsumeMatrices(submitted);
+			gatherTime += Milliseconds(Clock::now() - gatherStart).count();
+		}
+		updateTime /= frameCount;
+		gatherTime /= frameCount;
+
+		std::cout << "Transform cache, " << entityCount << " entities, " << movingCount << " moving per frame, "
+			<< frameCount << " frames" << std::endl;
+		std::cout << "\tRecompute on submit: " << recomputeTime << " ms/frame" << std::endl;
+		std::cout << "\tCached: " << updateTime + gatherTime << " ms/frame (update " << updateTime << " ms, "
+			<< updated / frameCount << " matrices, gather " << gatherTime << " ms)" << std::endl;
+		std::cout << "\tSpeedup: " << recomputeTime / (updateTime + gatherTime) << "x" << std::endl;
+	}
+
+	void TransformHierarchy(size_t entityCount, size_t frameCount)
+	{
+		const size_t CHAIN_LENGTH = 1000;
+		const size_t ROOT_COUNT = 4;
+		const size_t BRANCH_COUNT = std::max((size_t)1, entityCount / 100);
+
+		std::cout << "Transform hierarchy, " << entityCount << " entities, " << frameCount << " frames, "
+			<< Platform::JobSystem::WorkerCount() + 1 << " threads" << std::endl;
+
+		// The middle of the first chain moves
+		MeasureHierarchy("Deep (chains of 1000)", entityCount, frameCount, [&](size_t i) {
+			return (i % CHAIN_LENGTH == 0) ? i : i - 1;
+		}, CHAIN_LENGTH / 2);
+
+		// Roots, then branches spread over the roots, then leaves spread over the
+		// branches. The first branch moves.
+		MeasureHierarchy("Wide (4 roots, 1% branches)", entityCount, frameCount, [&](size_t i) {
+			if (i < ROOT_COUNT) return i;
+			if (i < ROOT_COUNT + BRANCH_COUNT) return i % ROOT_COUNT;
+			return ROOT_COUNT + i % BRANCH_COUNT;
+		}, ROOT_COUNT);
+
+		// The wide hierarchy stays put and a camera, a root of its own, moves
+		MeasureHierarchy("Static, moving camera", entityCount, frameCount, [&](size_t i) {
+			if (i <= ROOT_COUNT) return i;
+			if (i - 1 < ROOT_COUNT + BRANCH_COUNT) return 1 + (i - 1) % ROOT_COUNT;
+			return 1 + ROOT_COUNT + (i - 1) % BRANCH_COUNT;
+		}, 0);
+	}
+
+	bool TransformKernel(size_t transformCount, size_t iterationCount)
+	{
+		// Tolerance for a matrix element, the kernel and DirectXMath round differently
+		const float MAX_ERROR = 1e-4f;
+
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> position(-500.f, 500.f);
+		std::uniform_real_distribution<float> angle(-DirectX::XM_PI, DirectX::XM_PI);
+		std::uniform_real_distribution<float> scale(0.5f, 2.f);
+
+		std::vector<Resource::Transform> transforms(transformCount);
+		Resource::TransformBatch batch;
+		batch.Resize(transformCount);
+		for (size_t i = 0; i < transformCount; i++)
+		{
+			transforms[i].Position = { position(random), position(random), position(random) };
+			transforms[i].SetEulerRotation({ angle(random), angle(random), angle(random) });
+			transforms[i].Scale = { scale(random), scale(random), scale(random) };
+			batch.Set(i, transforms[i]);
+		}
+
+		std::vector<DirectX::XMFLOAT4X4> expected(transformCount);
+		Clock::time_point start = Clock::now();
+		for (size_t iteration = 0; iteration < iterationCount; iteration++)
+		{
+			for (size_t i = 0; i < transformCount; i++)
+			{
+				expected[i] = transforms[i].GetMatrixTransposed();
+			}
+			ConsumeMatrices(expected);
+		}
+		double referenceTime = Milliseconds(Clock::now() - start).count() / iterationCount;
+
+		std::cout << "Transform kernel, " << transformCount << " transforms, " << iterationCount << " iterations" << std::endl;
+		std::cout << "	GetMatrixTransposed: " << referenceTime << " ms (" << transformCount / referenceTime / 1000.0 << " M matrices/s)" << std::endl;
+
+		const std::pair<Resource::SimdLevel, const char*> levels[] = {
+			{ Resource::SimdLevel::Scalar, "Scalar" },
+			{ Resource::SimdLevel::SSE, "SSE" },
+			{ Resource::SimdLevel::AVX, "AVX" },
+		};
+
+		bool passed = true;
+		std::vector<DirectX::XMFLOAT4X4> output(transformCount);
+		for (const auto& level : levels)
+		{
+			if (level.first > Resource::GetSimdLevel())
+			{
+				std::cout << "	" << level.second << ": not supported" << std::endl;
+				continue;
+			}
+
+			// Odd ranges exercise the scalar tail behind the wide batches
+			float maxError = 0.f;
+			for (size_t offset : { (size_t)0, (size_t)3 })
+			{
+				size_t begin = std::min(offset, transformCount);
+				size_t end = std::max(begin, transformCount - std::min(transformCount, (size_t)5));
+				std::fill(output.begin(), output.end(), DirectX::XMFLOAT4X4());
+				Resource::ComposeMatricesTransposed(batch, begin, end, output.data(), level.first);
+				for (size_t i = begin; i < end; i++)
+				{
+					for (int element = 0; element < 16; element++)
+					{
+						float error = std::abs(output[i - begin].m[element / 4][element % 4] - expected[i].m[element / 4][element % 4]);
+						maxError = std::max(maxError, error);
+					}
+				}
+			}
+
+			start = Clock::now();
+			for (size_t iteration = 0; iteration < iterationCount; iteration++)
+			{
+				Resource::ComposeMatricesTransposed(batch, 0, transformCount, output.data(), level.first);
+				ConsumeMatrices(output);
+			}
+			double time = Milliseconds(Clock::now() - start).count() / iterationCount;
+
+			bool correct = maxError <= MAX_ERROR;
+			passed = passed && correct;
+			std::cout << "	" << level.second << ": " << time << " ms (" << transformCount / time / 1000.0 << " M matrices/s, "
+				<< referenceTime / time << "x), max error " << maxError << (correct ? "" : " FAILED") << std::endl;
+		}
+
+		return passed;
+	}
+
+	void Jobs(size_t jobCount, size_t frameCount)
+	{
+		using Nanoseconds = std::chrono::duration<double, std::nano>;
+
+		std::cout << "Jobs, " << jobCount << " jobs, " << Platform::JobSystem::WorkerCount() << " workers" << std::endl;
+
+		std::atomic<size_t> executed = 0;
+		auto job = [&executed]() { executed++; };
+
+		// Spawned into the shared deque, every job run by a worker is stolen
+		{
+			Platform::JobCounter counter;
+			Clock::time_point start = Clock::now();
+			for (size_t i = 0; i < jobCount; i++)
+			{
+				Platform::JobSystem::Run(job, &counter);
+			}
+			Platform::JobSystem::Wait(counter);
+			double time = Nanoseconds(Clock::now() - start).count();
+			std::cout << "\tSpawn from main thread: " << time / jobCount << " ns/job" << std::endl;
+		}
+
+		// Spawned by a job into its worker's deque, idle workers steal from it
+		{
+			Platform::JobCounter rootCounter;
+			Platform::JobCounter counter;
+			Clock::time_point start = Clock::now();
+			Platform::JobSystem::Run([&]() {
+				for (size_t i = 0; i < jobCount; i++)
+				{
+					Platform::JobSystem::Run(job, &counter);
+				}
+				Platform::JobSystem::Wait(counter);
+			}, &rootCounter);
+			Platform::JobSystem::Wait(rootCounter);
+			double time = Nanoseconds(Clock::now() - start).count();
+			std::cout << "\tSpawn from a job: " << time / jobCount << " ns/job" << std::endl;
+		}
+
+		// A fence, the second group only starts when the first is done
+		{
+			Platform::JobCounter first;
+			Platform::JobCounter second;
+			std::atomic<size_t> firstDone = 0;
+			std::atomic<bool> ordered = true;
+			for (size_t i = 0; i < 64; i++)
+			{
+				Platform::JobSystem::Run([&firstDone]() { firstDone++; }, &first);
+			}
+			for (size_t i = 0; i < 64; i++)
+			{
+				Platform::JobSystem::Run([&]() { ordered = ordered && firstDone.load() == 64; }, &second, &first);
+			}
+			Platform::JobSystem::Wait(second);
+			std::cout << "\tDependencies: " << (ordered ? "ordered" : "NOT ORDERED") << std::endl;
+		}
+
+		if (executed != 2 * jobCount)
+		{
+			std::cout << "\tLost jobs: " << 2 * jobCount - executed << std::endl;
+		}
+
+		// Full update of a wide hierarchy, every level is split into jobs
+		const size_t ENTITY_COUNT = 100000;
+		const size_t ROOT_COUNT = 4;
+		const size_t BRANCH_COUNT = ENTITY_COUNT / 100;
+
+		std::cout << "\tTransform update scaling, " << ENTITY_COUNT << " entities:" << std::endl;
+
+		UINT hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+		double singleThreadTime = 0.0;
+		for (UINT threadCount = 1; threadCount <= hardwareThreads; threadCount *= 2)
+		{
+			Platform::JobSystem::Finalize();
+			Platform::JobSystem::Initialize(std::max(1u, threadCount - 1));
+
+			entt::registry registry;
+			TransformSystem transformSystem(registry);
+			if (threadCount == 1)
+			{
+				transformSystem.SetParallelThreshold(0);
+			}
+
+			CreateEntities(registry, ENTITY_COUNT, [&](size_t i) {
+				if (i < ROOT_COUNT) return i;
+				if (i < ROOT_COUNT + BRANCH_COUNT) return i % ROOT_COUNT;
+				return ROOT_COUNT + i % BRANCH_COUNT;
+			});
+			transformSystem.Update();
+
+			std::vector<entt::entity> roots;
+			registry.view<Component::TransformComponent>().each([&](entt::entity entity, const auto& transform) {
+				if (transform.ParentEntity == entt::null)
+				{
+					roots.push_back(entity);
+				}
+			});
+
+			Clock::time_point start = Clock::now();
+			for (size_t frame = 0; frame < frameCount; frame++)
+			{
+				for (entt::entity root : roots)
+				{
+					registry.patch<Component::TransformComponent>(root, [](auto& transform) { transform.Position.y += 0.1f; });
+				}
+				transformSystem.Update();
+			}
+			double time = Milliseconds(Clock::now() - start).count() / frameCount;
+			if (threadCount == 1)
+			{
+				singleThreadTime = time;
+			}
+
+			std::cout << "\t\t" << threadCount << " threads: " << time << " ms (" << singleThreadTime / time << "x)" << std::endl;
+		}
+
+		Platform::JobSystem::Finalize();
+		Platform::JobSystem::Initialize();
+	}
+
+	void Instances(size_t instanceCount, size_t frameCount)
+	{
+		const ID MESH_COUNT = 64;
+
+		// Meshes in random order, the worst case for the last mesh shortcut
+		std::mt19937 random(1234);
+		std::uniform_int_distribution<ID> mesh(1, MESH_COUNT);
+		std::vector<Graphics::InstanceSubmission> submissions(instanceCount);
+		for (size_t i = 0; i < instanceCount; i++)
+		{
+			submissions[i].MeshID = mesh(random);
+			DirectX::XMStoreFloat4x4(&submissions[i].WorldTransposed, DirectX::XMMatrixTranslation((float)i, 0.f, 0.f));
+		}
+
+		std::cout << "Instance submission, " << instanceCount << " instances, " << MESH_COUNT << " meshes, "
+			<< frameCount << " frames, " << Platform::JobSystem::WorkerCount() + 1 << " threads" << std::endl;
+
+		auto consume = [](const std::vector<Resource::ObjectBufferData>& instances) {
+			if (!instances.empty())
+			{
+				s_sink = s_sink + instances.back().World._41;
+			}
+		};
+
+		// The map is cleared every frame, freeing the vectors
+		double mapTime;
+		{
+			std::map<ID, std::vector<Resource::ObjectBufferData>> instances;
+			Clock::time_point start = Clock::now();
+			for (size_t frame = 0; frame < frameCount; frame++)
+			{
+				for (const auto& submission : submissions)
+				{
+					Resource::ObjectBufferData data;
+					data.World = submission.WorldTransposed;
+					instances[submission.MeshID].push_back(data);
+				}
+				for (const auto& bucket : instances)
+				{
+					consume(bucket.second);
+				}
+				instances.clear();
+			}
+			mapTime = Milliseconds(Clock::now() - start).count() / frameCount;
+		}
+		std::cout << "\tstd::map push_back: " << mapTime << " ms/frame" << std::endl;
+
+		auto measure = [&](const char* name, size_t parallelThreshold, bool bulk) {
+			Graphics::InstanceBuckets buckets;
+			buckets.SetParallelThreshold(parallelThreshold);
+
+			Clock::time_point start = Clock::now();
+			for (size_t frame = 0; frame < frameCount; frame++)
+			{
+				if (bulk)
+				{
+					buckets.Add(submissions.data(), submissions.size());
+				}
+				else
+				{
+					for (const auto& submission : submissions)
+					{
+						buckets.Add(submission.MeshID, submission.WorldTransposed);
+					}
+				}
+				for (const auto& bucket : buckets.GetBuckets())
+				{
+					consume(bucket.Instances);
+				}
+				if (frame + 1 < frameCount)
+				{
+					buckets.Clear();
+				}
+			}
+			double time = Milliseconds(Clock::now() - start).count() / frameCount;
+
+			// Every instance lands in its mesh's bucket, in submission order
+			size_t mismatches = 0;
+			std::vector<size_t> next(MESH_COUNT + 1, 0);
+			std::vector<const Graphics::InstanceBuckets::Bucket*> byMesh(MESH_COUNT + 1, nullptr);
+			for (const auto& bucket : buckets.GetBuckets())
+			{
+				byMesh[bucket.MeshID] = &bucket;
+			}
+			for (const auto& submission : submissions)
+			{
+				const auto* bucket = byMesh[submission.MeshID];
+				size_t index = next[submission.MeshID]++;
+				if (!bucket || index >= bucket->Instances.size() || bucket->Instances[index].World._41 != submission.WorldTransposed._41)
+				{
+					mismatches++;
+				}
+			}
+
+			std::cout << "\t" << name << ": " << time << " ms/frame (" << mapTime / time << "x)"
+				<< (mismatches ? ", MISMATCHES: " + std::to_string(mismatches) : "") << std::endl;
+		};
+
+		measure("InstanceBuckets one at a time", 0, false);
+		measure("InstanceBuckets bulk, serial", 0, true);
+		measure("InstanceBuckets bulk, parallel", 1, true);
+	}
+
+	bool LightBinning(size_t lightCount, size_t frameCount)
+	{
+		using namespace DirectX;
+		using Graphics::LightClusters;
+
+		// Camera as in the demo, lights spread through the frustum
+		Graphics::ClusterView view;
+		XMStoreFloat4x4(&view.View, XMMatrixLookToLH(XMVectorSet(0.f, 0.f, 0.f, 1.f), XMVectorSet(0.f, 0.f, 1.f, 0.f), XMVectorSet(0.f, 1.f, 0.f, 0.f)));
+		view.FOV = XM_PI / 2.f;
+		view.AspectRatio = 16.f / 9.f;
+		view.NearPlane = 0.1f;
+		view.FarPlane = 1000.f;
+
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> side(-1.f, 1.f);
+		std::uniform_real_distribution<float> depth(1.f, 800.f);
+		std::uniform_real_distribution<float> radius(1.f, 15.f);
+		std::vector<Resource::PointLight> lights(lightCount);
+		for (auto& light : lights)
+		{
+			float z = depth(random);
+			light.Position = { side(random) * z * 1.2f, side(random) * z * 0.8f, z };
+			light.Radius = radius(random);
+			light.Color = { 1.f, 1.f, 1.f };
+			light.Padding = 0.f;
+		}
+
+		std::cout << "Light binning, " << lightCount << " lights, " << LightClusters::GRID_X << "x" << LightClusters::GRID_Y << "x"
+			<< LightClusters::GRID_Z << " clusters, " << frameCount << " frames, " << Platform::JobSystem::WorkerCount() + 1 << " threads" << std::endl;
+
+		LightClusters clusters;
+		auto measure = [&](const char* name, bool parallel) {
+			Clock::time_point start = Clock::now();
+			for (size_t frame = 0; frame < frameCount; frame++)
+			{
+				clusters.Build(view, lights.data(), lights.size(), parallel);
+				s_sink = s_sink + (float)clusters.GetLightIndices().size();
+			}
+			double time = Milliseconds(Clock::now() - start).count() / frameCount;
+			std::cout << "\t" << name << ": " << time << " ms/frame" << std::endl;
+		};
+		measure("Serial", false);
+		measure("Parallel", true);
+
+		// Every cluster against every light, with the same sphere against box test
+		size_t mismatches = 0;
+		size_t binned = 0;
+		const auto& result = clusters.GetClusters();
+		const auto& indices = clusters.GetLightIndices();
+		std::vector<UINT> expected;
+		for (UINT cluster = 0; cluster < LightClusters::CLUSTER_COUNT; cluster++)
+		{
+			XMFLOAT3 minimum, maximum;
+			clusters.GetClusterBounds(cluster, minimum, maximum);
+
+			expected.clear();
+			for (UINT i = 0; i < (UINT)lights.size(); i++)
+			{
+				const XMFLOAT3& center = lights[i].Position;
+				float dx = std::max(0.f, std::max(minimum.x - center.x, center.x - maximum.x));
+				float dy = std::max(0.f, std::max(minimum.y - center.y, center.y - maximum.y));
+				float dz = std::max(0.f, std::max(minimum.z - center.z, center.z - maximum.z));
+				if (dx * dx + dy * dy + dz * dz <= lights[i].Radius * lights[i].Radius)
+				{
+					expected.push_back(i);
+				}
+			}
+			if (expected.size() > LightClusters::MAX_LIGHTS_PER_CLUSTER)
+			{
+				expected.resize(LightClusters::MAX_LIGHTS_PER_CLUSTER);
+			}
+
+			std::vector<UINT> actual(indices.begin() + result[cluster].Offset, indices.begin() + result[cluster].Offset + result[cluster].Count);
+			std::sort(actual.begin(), actual.end());
+			mismatches += (actual != expected);
+			binned += actual.size();
+		}
+
+		std::cout << "\t" << (double)binned / LightClusters::CLUSTER_COUNT << " lights per cluster on average, "
+			<< (mismatches ? std::to_string(mismatches) + " MISMATCHED CLUSTERS" : "all clusters match") << std::endl;
+		return mismatches == 0;
+	}
+
+	bool RenderGraphAliasing(size_t frameCount)
+	{
+		const UINT WIDTH = 1920;
+		const UINT HEIGHT = 1080;
+
+		std::cout << "Render graph, " << WIDTH << "x" << HEIGHT << ", " << frameCount << " frames" << std::endl;
+
+		auto toMB = [](size_t bytes) { return (double)bytes / (1024 * 1024); };
+
+		bool valid = true;
+		auto measure = [&](const char* name, const std::function<void(Graphics::RenderGraph&)>& build) {
+			Graphics::RenderGraph graph;
+
+			// Declaring and compiling, as every frame
+			Clock::time_point start = Clock::now();
+			for (size_t frame = 0; frame < frameCount; frame++)
+			{
+				graph.Reset();
+				build(graph);
+				graph.Compile();
+			}
+			double time = Milliseconds(Clock::now() - start).count() * 1000.0 / frameCount;
+			Graphics::RenderGraphStatistics aliased = graph.GetStatistics();
+			valid &= graph.ValidateAliasing();
+
+			graph.Compile(false);
+			Graphics::RenderGraphStatistics separate = graph.GetStatistics();
+			valid &= aliased.AliasedBytes <= separate.AliasedBytes && aliased.AliasedBytes >= aliased.PeakLiveBytes;
+
+			std::cout << "\t" << name << ": " << aliased.Passes << " passes, " << aliased.CulledPasses << " culled, "
+				<< aliased.Barriers << " barriers, " << time << " us to declare and compile" << std::endl;
+			std::cout << "\t\t" << aliased.TransientResources << " transient resources in " << separate.PhysicalResources
+				<< " physical ones without aliasing, " << aliased.PhysicalResources << " with" << std::endl;
+			std::cout << "\t\tPeak transient memory: " << toMB(separate.AliasedBytes) << " MB without aliasing, "
+				<< toMB(aliased.AliasedBytes) << " MB with, " << toMB(aliased.PeakLiveBytes) << " MB alive at once" << std::endl;
+		};
+
+		measure("Deferred with post processing", [&](Graphics::RenderGraph& graph) { BuildDeferredGraph(graph, WIDTH, HEIGHT); });
+		measure("Post processing chain of 16", [&](Graphics::RenderGraph& graph) { BuildPostChainGraph(graph, WIDTH, HEIGHT, 16); });
+
+		std::cout << "\t" << (valid ? "No aliased resources overlap" : "OVERLAPPING ALIASED RESOURCES") << std::endl;
+		return valid;
+	}
+
+	bool ShadowCascades(size_t casterCount, size_t frameCount)
+	{
+		using namespace DirectX;
+		using Graphics::ShadowCascades;
+		using Graphics::ShadowCaster;
+
+		Graphics::ClusterView view;
+		view.FOV = XM_PI / 2.f;
+		view.AspectRatio = 16.f / 9.f;
+		view.NearPlane = 0.1f;
+		view.FarPlane = 1000.f;
+
+		const float SHADOW_DISTANCE = 400.f;
+		const float CASTER_DISTANCE = 500.f;
+		const XMFLOAT3 direction = { -0.4f, -1.f, 0.3f };
+
+		// Casters spread over the floor of the demo scene
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> side(-1000.f, 1000.f);
+		std::uniform_real_distribution<float> height(0.f, 50.f);
+		std::uniform_real_distribution<float> radius(0.5f, 10.f);
+		std::vector<ShadowCaster> casters(casterCount);
+		for (ShadowCaster& caster : casters)
+		{
+			caster.Center = { side(random), height(random), side(random) };
+			caster.Radius = radius(random);
+		}
+
+		std::cout << "Shadow cascades, " << casterCount << " casters, " << ShadowCascades::CASCADE_COUNT << " cascades of "
+			<< ShadowCascades::RESOLUTION << "x" << ShadowCascades::RESOLUTION << ", " << frameCount << " frames" << std::endl;
+
+		// The camera walks and turns a little every frame
+		auto setCamera = [&](size_t frame) {
+			float yaw = frame * 0.01f;
+			XMVECTOR position = XMVectorSet(frame * 0.37f - 100.f, 10.f + frame * 0.05f, frame * 0.21f, 1.f);
+			XMVECTOR forward = XMVectorSet(std::sin(yaw), -0.2f, std::cos(yaw), 0.f);
+			XMStoreFloat4x4(&view.View, XMMatrixLookToLH(position, forward, XMVectorSet(0.f, 1.f, 0.f, 0.f)));
+		};
+
+		ShadowCascades cascades;
+		std::vector<UINT> visible[ShadowCascades::CASCADE_COUNT];
+		double updateTime = 0.0;
+		double cullTime = 0.0;
+		size_t drawn = 0;
+
+		size_t cullMismatches = 0;
+		size_t cornersOutside = 0;
+		size_t unstableCascades = 0;
+		float radii[ShadowCascades::CASCADE_COUNT] = {};
+
+		for (size_t frame = 0; frame < frameCount; frame++)
+		{
+			setCamera(frame);
+
+			Clock::time_point start = Clock::now();
+			cascades.Update(view, direction, SHADOW_DISTANCE, CASTER_DISTANCE);
+			Clock::time_point updated = Clock::now();
+			cascades.Cull(casters.data(), casters.size(), visible);
+			Clock::time_point culled = Clock::now();
+
+			updateTime += Milliseconds(updated - start).count();
+			cullTime += Milliseconds(culled - updated).count();
+
+			XMMATRIX inverseView = XMMatrixInverse(nullptr, XMLoadFloat4x4(&view.View));
+			for (UINT c = 0; c < ShadowCascades::CASCADE_COUNT; c++)
+			{
+				const ShadowCascades::Cascade& cascade = cascades.GetCascade(c);
+				drawn += visible[c].size();
+
+				// The SIMD cull against one caster at a time
+				std::vector<UINT> expected;
+				for (UINT i = 0; i < (UINT)casters.size(); i++)
+				{
+					if (cascades.IsVisible(c, casters[i]))
+					{
+						expected.push_back(i);
+					}
+				}
+				cullMismatches += (expected != visible[c]);
+
+				// The whole slice has to land inside the shadow map
+				XMFLOAT3 corners[8];
+				cascades.GetSliceCorners(c, corners);
+				XMMATRIX viewProjection = XMLoadFloat4x4(&cascade.ViewProjection);
+				for (const XMFLOAT3& corner : corners)
+				{
+					XMFLOAT3 clip;
+					XMStoreFloat3(&clip, XMVector3TransformCoord(XMVector3TransformCoord(XMLoadFloat3(&corner), inverseView), viewProjection));
+					const float EPSILON = 1e-3f;
+					cornersOutside += std::abs(clip.x) > 1.f + EPSILON || std::abs(clip.y) > 1.f + EPSILON || clip.z < -EPSILON || clip.z > 1.f + EPSILON;
+				}
+
+				// Same size every frame and on whole texels, or the edges would shimmer
+				if (frame == 0)
+				{
+					radii[c] = cascade.Radius;
+				}
+				float x = cascade.Center.x / cascade.TexelSize;
+				float y = cascade.Center.y / cascade.TexelSize;
+				unstableCascades += cascade.Radius != radii[c]
+					|| std::abs(x - std::round(x)) > 1e-2f || std::abs(y - std::round(y)) > 1e-2f;
+			}
+		}
+
+		std::cout << "\tUpdate: " << updateTime * 1000.0 / frameCount << " us/frame" << std::endl;
+		std::cout << "\tCull: " << cullTime / frameCount << " ms/frame, "
+			<< (double)drawn / frameCount << " caster draws per frame in all cascades" << std::endl;
+		for (UINT c = 0; c < ShadowCascades::CASCADE_COUNT; c++)
+		{
+			const ShadowCascades::Cascade& cascade = cascades.GetCascade(c);
+			std::cout << "\t\tCascade " << c << ": " << cascade.NearDepth << " to " << cascade.FarDepth << " units, "
+				<< cascade.TexelSize << " units per texel" << std::endl;
+		}
+
+		bool valid = cullMismatches == 0 && cornersOutside == 0 && unstableCascades == 0;
+		std::cout << "\t" << (cullMismatches ? std::to_string(cullMismatches) + " MISMATCHED CULLS, " : "culling matches, ")
+			<< (cornersOutside ? std::to_string(cornersOutside) + " SLICE CORNERS OUTSIDE, " : "slices covered, ")
+			<< (unstableCascades ? std::to_string(unstableCascades) + " UNSTABLE CASCADES" : "cascades stable") << std::endl;
+		return valid;
+	}
+
+	bool Overdraw(size_t boxCount)
+	{
+		using namespace DirectX;
+
+		const UINT WIDTH = 480;
+		const UINT HEIGHT = 270;
+		const float NEAR_PLANE = 0.1f;
+		const float FAR_PLANE = 1000.f;
+
+		XMMATRIX viewProjection = XMMatrixMultiply(
+			XMMatrixLookToLH(XMVectorZero(), XMVectorSet(0.f, 0.f, 1.f, 0.f), XMVectorSet(0.f, 1.f, 0.f, 0.f)),
+			XMMatrixPerspectiveFovLH(XM_PI / 2.f, (float)WIDTH / HEIGHT, NEAR_PLANE, FAR_PLANE));
+
+		// Boxes through the frustum, about as large on screen near as far
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> side(-1.f, 1.f);
+		std::uniform_real_distribution<float> depth(5.f, 300.f);
+		std::uniform_real_distribution<float> size(0.02f, 0.12f);
+		std::uniform_real_distribution<float> angle(-XM_PI, XM_PI);
+
+		struct Box
+		{
+			XMFLOAT4 Triangles[12][3]; // Clip space
+		};
+		std::vector<Box> boxes(boxCount);
+		std::vector<float> nearDepths(boxCount);
+		for (size_t b = 0; b < boxCount; b++)
+		{
+			float z = depth(random);
+			XMVECTOR center = XMVectorSet(side(random) * z * 1.6f, side(random) * z * 0.9f, z, 1.f);
+			XMVECTOR extent = XMVectorScale(XMVectorSet(size(random), size(random), size(random), 0.f), z);
+			XMMATRIX world = XMMatrixScalingFromVector(extent) * XMMatrixRotationRollPitchYaw(angle(random), angle(random), 0.f) * XMMatrixTranslationFromVector(center);
+			nearDepths[b] = z - XMVectorGetX(XMVector3Length(extent));
+
+			XMVECTOR corners[8];
+			for (int c = 0; c < 8; c++)
+			{
+				corners[c] = XMVector3TransformCoord(XMVectorSet((c & 1) ? 1.f : -1.f, (c & 2) ? 1.f : -1.f, (c & 4) ? 1.f : -1.f, 1.f), world);
+			}
+
+			// Two triangles per face, wound clockwise seen from outside
+			const int faces[6][4] = { { 0, 1, 3, 2 }, { 4, 5, 7, 6 }, { 0, 1, 5, 4 }, { 2, 3, 7, 6 }, { 0, 2, 6, 4 }, { 1, 3, 7, 5 } };
+			for (int f = 0; f < 6; f++)
+			{
+				for (int half = 0; half < 2; half++)
+				{
+					XMVECTOR v[3] = { corners[faces[f][0]], corners[faces[f][1 + half]], corners[faces[f][2 + half]] };
+					XMVECTOR normal = XMVector3Cross(XMVectorSubtract(v[1], v[0]), XMVectorSubtract(v[2], v[0]));
+					if (XMVectorGetX(XMVector3Dot(normal, XMVectorSubtract(v[0], center))) < 0.f)
+					{
+						std::swap(v[1], v[2]);
+					}
+					for (int i = 0; i < 3; i++)
+					{
+						XMStoreFloat4(&boxes[b].Triangles[f * 2 + half][i], XMVector4Transform(XMVectorSetW(v[i], 1.f), viewProjection));
+					}
+				}
+			}
+		}
+
+		std::cout << "Overdraw, " << boxCount << " boxes, " << WIDTH << "x" << HEIGHT << " software depth buffer" << std::endl;
+
+		// Front to back by the nearest point of each box, as the renderer sorts instances
+		Graphics::DepthSort depthSort;
+		depthSort.SetRange(NEAR_PLANE, FAR_PLANE);
+		std::vector<UINT> frontToBack;
+		const size_t SORT_ITERATIONS = 100;
+		Clock::time_point start = Clock::now();
+		for (size_t i = 0; i < SORT_ITERATIONS; i++)
+		{
+			depthSort.Sort(nearDepths.data(), nearDepths.size(), frontToBack);
+		}
+		double sortTime = Milliseconds(Clock::now() - start).count() * 1000.0 / SORT_ITERATIONS;
+
+		std::vector<UINT> submitted(boxCount);
+		std::iota(submitted.begin(), submitted.end(), 0);
+		std::vector<UINT> backToFront(frontToBack.rbegin(), frontToBack.rend());
+
+		bool sorted = true;
+		for (size_t i = 1; i < frontToBack.size(); i++)
+		{
+			sorted &= depthSort.GetBucket(nearDepths[frontToBack[i - 1]]) <= depthSort.GetBucket(nearDepths[frontToBack[i]]);
+		}
+
+		auto draw = [&](SoftwareDepthBuffer& buffer, const std::vector<UINT>& order, bool equal) {
+			size_t passed = 0;
+			for (UINT b : order)
+			{
+				for (const auto& triangle : boxes[b].Triangles)
+				{
+					passed += buffer.Draw(triangle, equal);
+				}
+			}
+			return passed;
+		};
+
+		SoftwareDepthBuffer submittedBuffer(WIDTH, HEIGHT);
+		SoftwareDepthBuffer sortedBuffer(WIDTH, HEIGHT);
+		SoftwareDepthBuffer reversedBuffer(WIDTH, HEIGHT);
+		size_t submittedShaded = draw(submittedBuffer, submitted, false);
+		size_t sortedShaded = draw(sortedBuffer, frontToBack, false);
+		size_t reversedShaded = draw(reversedBuffer, backToFront, false);
+
+		// With the prepass: the sorted depth pass, then shading only what equals the depth
+		size_t prepassShaded = draw(sortedBuffer, frontToBack, true);
+		size_t covered = sortedBuffer.CoveredPixels();
+
+		auto report = [&](const char* name, size_t shaded) {
+			std::cout << "\t" << name << ": " << shaded << " pixels shaded, overdraw " << (covered ? (double)shaded / covered : 0.0) << std::endl;
+		};
+		std::cout << "\t" << covered << " of " << WIDTH * HEIGHT << " pixels covered, front to back sort of " << boxCount << " draws in " << sortTime << " us" << std::endl;
+		report("Back to front", reversedShaded);
+		report("Submission order", submittedShaded);
+		report("Front to back", sortedShaded);
+		report("Depth prepass, then depth equal", prepassShaded);
+		std::cout << "\t\tThe prepass itself tests " << sortedShaded << " depth only pixels" << std::endl;
+
+		// Every order has to end with the same depth, the prepass shades each covered pixel
+		// about once, more only where two triangles of a box share an edge
+		bool valid = sorted && submittedBuffer == sortedBuffer && reversedBuffer == sortedBuffer
+			&& sortedShaded <= submittedShaded && prepassShaded >= covered && prepassShaded <= sortedShaded;
+		std::cout << "\t" << (valid ? "Depth matches in every order" : "MISMATCHED DEPTH OR ORDER") << std::endl;
+		return valid;
+	}
+}
\ No newline at end of file
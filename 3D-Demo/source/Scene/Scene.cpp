@@ -4,10 +4,20 @@
 #include "Scene/Scene.h"
 #include "Scene/Components.h"
 #include "Graphics/Renderer.h"
+#include "Platform/FrameArena.h"
+#include "Platform/JobSystem.h"
+#include "Platform/Profiler.h"
+
+namespace
+{
+	// Interpolated entities per job when gathering submissions
+	const size_t SUBMISSIONS_PER_JOB = 512;
+}
 
 Scene::Scene()
 {
 	m_registry = std::make_shared<entt::registry>();
+	m_transformSystem = std::make_unique<TransformSystem>(*m_registry);
 }
 
 Scene::~Scene()
@@ -45,12 +55,13 @@ void Scene::Setup()
 		Component::TransformComponent cameraTransform;
 		//cameraTransform.Position = { 0.f, 50.f, 1.0f };
 		cameraTransform.Position = { 0.f, 0.f, 10.0f };
-		cameraTransform.Rotation = { 0.f, 3.1415f, 0.0 };
+		cameraTransform.SetEulerRotation({ 0.f, 3.1415f, 0.0 });
 
 		m_mainCamera = m_registry->create();
 		m_registry->emplace<Component::CameraComponent>(m_mainCamera, cameraSettings);
 		m_registry->emplace<Component::CameraControllerFPS>(m_mainCamera, cameraController);
 		m_registry->emplace<Component::TransformComponent>(m_mainCamera, cameraTransform);
+		m_registry->emplace<Component::PreviousTransformComponent>(m_mainCamera, Component::PreviousTransformComponent{ cameraTransform });
 	}
 
 	{
@@ -98,10 +109,44 @@ void Scene::Setup()
 
 		std::cout << m_registry->size<Component::MeshComponent>() << " objects initialized." << std::endl;
 	}
+
+	{
+		// Setup lights: one large white light over the scene and rows of small
+		// coloured ones along the floor
+
+		auto addLight = [&](const DirectX::XMFLOAT3& position, float radius, const DirectX::XMFLOAT3& color) {
+			Component::TransformComponent lightTransform;
+			lightTransform.Position = position;
+
+			entt::entity light = m_registry->create();
+			m_registry->emplace<Component::TransformComponent>(light, lightTransform);
+			m_registry->emplace<Component::PointLightComponent>(light, Component::PointLightComponent{ radius, color });
+		};
+
+		addLight({ -50.f, 20.f, 20.f }, 2000.f, { 1.f, 1.f, 1.f });
+
+		const DirectX::XMFLOAT3 colors[] = { { 1.f, 0.4f, 0.2f }, { 0.2f, 0.6f, 1.f }, { 0.4f, 1.f, 0.3f }, { 1.f, 0.9f, 0.5f } };
+		UINT colorIndex = 0;
+		for (float x = -600.f; x <= 600.f; x += 100.f)
+		{
+			for (float z = -200.f; z <= 200.f; z += 100.f)
+			{
+				addLight({ x, 20.f, z }, 80.f, colors[colorIndex++ % std::size(colors)]);
+			}
+		}
+
+		// Low evening sun, the only light with shadows
+		entt::entity sun = m_registry->create();
+		m_registry->emplace<Component::DirectionalLightComponent>(sun, Component::DirectionalLightComponent{ { -0.5f, -0.6f, 0.4f }, { 0.5f, 0.45f, 0.4f } });
+
+		std::cout << m_registry->size<Component::PointLightComponent>() << " lights initialized." << std::endl;
+	}
 }
 
 void Scene::Update(float delta)
 {
+	PROFILE_SCOPE("Scene::Update");
+
 	elapsed += delta * 0.5f;
 
 	{
@@ -110,25 +155,22 @@ void Scene::Update(float delta)
 		window->Process();
 	}
 
+	m_registry->view<Component::PreviousTransformComponent, Component::TransformComponent>().each([](auto& previous, const auto& transform) {
+		previous.Transform = transform;
+	});
+
 
 	{
 		auto view = m_registry->view<Component::CameraComponent, Component::CameraControllerFPS, Component::TransformComponent>();
-		view.each([](auto entity, const Component::CameraComponent& camera, const Component::CameraControllerFPS& controller, Component::TransformComponent& transform) {
+		view.each([&](auto entity, const Component::CameraComponent& camera, const Component::CameraControllerFPS& controller, Component::TransformComponent& transform) {
 
 			using namespace DirectX;
 
 			XMVECTOR position = XMLoadFloat3(&transform.Position);
 
-			XMVECTOR forward;
-			XMVECTOR right;
-			XMVECTOR up;
-			{
-				XMFLOAT4X4 worldMatrixFloat = transform.GetMatrix();
-
-				forward = XMVector3Normalize({ worldMatrixFloat._31, worldMatrixFloat._32, worldMatrixFloat._33, 0.f });
-				right = XMVector3Normalize({ worldMatrixFloat._11, worldMatrixFloat._12, worldMatrixFloat._13, 0.f });
-				up = XMVector3Normalize({ worldMatrixFloat._21, worldMatrixFloat._22, worldMatrixFloat._23, 0.f });
-			}
+			XMVECTOR forward = transform.GetForward();
+			XMVECTOR right = transform.GetRight();
+			XMVECTOR up = transform.GetUp();
 
 			XMVECTOR movement = { 0, 0, 0, 0 };
 
@@ -154,7 +196,6 @@ void Scene::Update(float delta)
 
 			XMStoreFloat3(&transform.Position, position);
 
-			float roll = 0;
 			float pitch = 0;
 			float yaw = 0;
 
@@ -167,32 +208,105 @@ void Scene::Update(float delta)
 			if (GetAsyncKeyState(VK_DOWN))
 				pitch += controller.TurnSpeedVertical;
 
-			transform.Rotation.x += pitch;
-			transform.Rotation.y += yaw;
-			transform.Rotation.z += roll;
+			// Yaw around the world up axis and pitch around the camera's own right
+			// axis, so the horizon never rolls. Pitch stops short of straight up or
+			// down, where yaw and pitch would turn around the same axis.
+			const float MAX_PITCH_SINE = 0.99f;
+
+			float pitchSine = -XMVectorGetY(forward);
+			if ((pitch > 0.f && pitchSine + pitch > MAX_PITCH_SINE) || (pitch < 0.f && pitchSine + pitch < -MAX_PITCH_SINE))
+			{
+				pitch = 0.f;
+			}
+
+			if (pitch != 0.f)
+				transform.RotateLocal(XMVectorSet(1.f, 0.f, 0.f, 0.f), pitch);
+			if (yaw != 0.f)
+				transform.Rotate(XMVectorSet(0.f, 1.f, 0.f, 0.f), yaw);
+
+			m_registry->patch<Component::TransformComponent>(entity);
 			});
 	}
+
+	{
+		PROFILE_SCOPE("TransformSystem::Update");
+		m_transformSystem->Update();
+	}
 }
 
-void Scene::Draw()
-{	
+void Scene::Draw(float alpha)
+{
+	PROFILE_SCOPE("Scene::Draw");
+
 	{
-		Component::TransformComponent& transformComp = m_registry->get<Component::TransformComponent>(m_mainCamera);
+		const auto& transformComp = m_registry->get<Component::TransformComponent>(m_mainCamera);
+		const auto& previousComp = m_registry->get<Component::PreviousTransformComponent>(m_mainCamera);
 		Component::CameraComponent& camera = m_registry->get<Component::CameraComponent>(m_mainCamera);
-		Graphics::Renderer::BeginFrame(camera, transformComp);
+		Graphics::Renderer::BeginFrame(camera, Resource::Transform::Interpolate(previousComp.Transform, transformComp, alpha));
 	}
 
-	auto view = m_registry->view<Component::MeshComponent, Component::TransformComponent>();
+	auto view = m_registry->view<Component::MeshComponent, Component::WorldMatrixComponent>(entt::exclude<Component::PreviousTransformComponent>);
+	auto interpolatedView = m_registry->view<Component::MeshComponent, Component::TransformComponent, Component::PreviousTransformComponent>();
 
-	view.each([&](auto entity, const auto& meshComp, const auto& transformComp) {
-		Graphics::Renderer::Submit(meshComp.MeshID, transformComp);
-	});
+	{
+		PROFILE_SCOPE("Scene::Submit");
+
+		Platform::FrameVector<Graphics::InstanceSubmission> submissions;
+		submissions.reserve(view.size_hint() + interpolatedView.size_hint());
+		view.each([&](auto entity, const auto& meshComp, const auto& worldComp) {
+			submissions.push_back({ meshComp.MeshID, worldComp.WorldTransposed });
+		});
+
+		// Moving entities compose a matrix each, spread over the job system. The
+		// view only knows an upper bound of its size.
+		const size_t staticCount = submissions.size();
+		submissions.resize(staticCount + interpolatedView.size_hint());
+		size_t interpolatedCount = Platform::JobSystem::ParallelForEach(interpolatedView, SUBMISSIONS_PER_JOB, [&](size_t i, entt::entity entity) {
+			const auto& meshComp = interpolatedView.get<Component::MeshComponent>(entity);
+			const auto& transformComp = interpolatedView.get<Component::TransformComponent>(entity);
+			const auto& previousComp = interpolatedView.get<Component::PreviousTransformComponent>(entity);
+			submissions[staticCount + i] = { meshComp.MeshID, Resource::Transform::Interpolate(previousComp.Transform, transformComp, alpha).GetMatrixTransposed() };
+		});
+		submissions.resize(staticCount + interpolatedCount);
+		Graphics::Renderer::Submit(submissions.data(), submissions.size());
+	}
+
+	{
+		PROFILE_SCOPE("Scene::SubmitLights");
+
+		auto lightView = m_registry->view<Component::PointLightComponent, Component::WorldMatrixComponent>();
+
+		Platform::FrameVector<Resource::PointLight> lights;
+		lights.reserve(lightView.size_hint());
+		lightView.each([&](const auto& lightComp, const auto& worldComp) {
+			// Translation is in the last column of the transposed matrix
+			const DirectX::XMFLOAT4X4& world = worldComp.WorldTransposed;
+			lights.push_back({ { world._14, world._24, world._34 }, lightComp.Radius, lightComp.Color, 0.f });
+		});
+		Graphics::Renderer::SubmitLights(lights.data(), lights.size());
+
+		auto sunView = m_registry->view<Component::DirectionalLightComponent>();
+		if (!sunView.empty())
+		{
+			const auto& sunComp = sunView.get<Component::DirectionalLightComponent>(sunView.front());
+			Graphics::Renderer::SubmitDirectionalLight({ sunComp.Direction, sunComp.Color });
+		}
+	}
 
 	Graphics::Renderer::EndFrame();
 
 	{
 		auto& windowComp = m_registry->get<Component::WindowComponent>(m_mainWindow);
 		auto window = Resource::Manager::GetWindow(windowComp.WindowID);
+
+		PROFILE_SCOPE("Window::Present");
 		window->Present();
 	}
 }
+
+bool Scene::IsRunning() const
+{
+	auto& windowComp = m_registry->get<Component::WindowComponent>(m_mainWindow);
+	auto window = Resource::Manager::GetWindow(windowComp.WindowID);
+	return window && window->State != Resource::WindowState::Destroyed;
+}
@@ -0,0 +1,325 @@
+#include "pch.h"
+#include "Scene/TransformSystem.h"
+#include "Scene/Components.h"
+#include "Platform/JobSystem.h"
+
+namespace
+{
+	// Nodes per parallel task, small enough to balance wide levels
+	const size_t NODES_PER_TASK = 1024;
+}
+
+TransformSystem::TransformSystem(entt::registry& registry) :
+	m_registry(registry),
+	m_changedTransforms(registry, entt::collector.group<Component::TransformComponent>().update<Component::TransformComponent>()),
+	m_hierarchyChanged(true),
+	m_parallelThreshold(4 * NODES_PER_TASK)
+{
+	m_registry.on_destroy<Component::TransformComponent>().connect<&TransformSystem::OnTransformDestroyed>(*this);
+}
+
+TransformSystem::~TransformSystem()
+{
+	m_registry.on_destroy<Component::TransformComponent>().disconnect<&TransformSystem::OnTransformDestroyed>(*this);
+	m_changedTransforms.disconnect();
+}
+
+void TransformSystem::OnTransformDestroyed(entt::registry& registry, entt::entity entity)
+{
+	m_hierarchyChanged = true;
+}
+
+size_t TransformSystem::Update()
+{
+	// New local matrices for changed transforms, a new entity or parent means
+	// the node order has to be rebuilt
+	m_changedNodes.clear();
+
+	if (!m_hierarchyChanged)
+	{
+		m_changedTransforms.each([&](entt::entity entity) {
+			auto node = m_nodeIndices.find(entity);
+			if (node == m_nodeIndices.end())
+			{
+				m_hierarchyChanged = true;
+				return;
+			}
+
+			uint32_t i = node->second;
+			const auto& transform = m_registry.get<Component::TransformComponent>(entity);
+			entt::entity parent = (m_parents[i] != NO_PARENT) ? m_entities[m_parents[i]] : entt::null;
+			if (transform.ParentEntity != parent)
+			{
+				m_hierarchyChanged = true;
+				return;
+			}
+
+			m_changedNodes.push_back(i);
+		});
+	}
+
+	if (m_hierarchyChanged)
+	{
+		m_changedTransforms.clear();
+		Rebuild();
+
+		// Every root, and below them everything
+		m_changedNodes.clear();
+		for (uint32_t i = 0; i < (uint32_t)m_entities.size() && m_parents[i] == NO_PARENT; i++)
+		{
+			m_changedNodes.push_back(i);
+		}
+	}
+	else if (!m_changedNodes.empty())
+	{
+		// Composed 4 or 8 at a time, then scattered back to their nodes
+		m_changedBatch.Resize(m_changedNodes.size());
+		m_changedMatrices.resize(m_changedNodes.size());
+		for (size_t k = 0; k < m_changedNodes.size(); k++)
+		{
+			m_changedBatch.Set(k, m_registry.get<Component::TransformComponent>(m_entities[m_changedNodes[k]]));
+		}
+
+		Resource::ComposeMatricesTransposed(m_changedBatch, 0, m_changedNodes.size(), m_changedMatrices.data());
+
+		for (size_t k = 0; k < m_changedNodes.size(); k++)
+		{
+			m_localMatrices[m_changedNodes[k]] = m_changedMatrices[k];
+		}
+
+		std::sort(m_changedNodes.begin(), m_changedNodes.end());
+	}
+
+	if (m_changedNodes.empty())
+	{
+		return 0;
+	}
+
+	// Levels above the first change are up to date. Below it the dirty nodes
+	// of a level are the changed ones plus the children of the dirty ranges of
+	// the level above, merged into ranges again.
+	size_t level = std::upper_bound(m_levels.begin(), m_levels.end(), m_changedNodes.front()) - m_levels.begin() - 1;
+	size_t changed = 0;
+	size_t updateCount = 0;
+	m_dirtyRanges.clear();
+
+	for (; level + 1 < m_levels.size(); level++)
+	{
+		const uint32_t levelEnd = (uint32_t)m_levels[level + 1];
+
+		m_levelRanges.clear();
+		size_t dirty = 0;
+		while (dirty < m_dirtyRanges.size() || (changed < m_changedNodes.size() && m_changedNodes[changed] < levelEnd))
+		{
+			NodeRange range;
+			bool takeChanged = changed < m_changedNodes.size() && m_changedNodes[changed] < levelEnd &&
+				(dirty == m_dirtyRanges.size() || m_changedNodes[changed] < m_dirtyRanges[dirty].Begin);
+			if (takeChanged)
+			{
+				range = { m_changedNodes[changed], m_changedNodes[changed] + 1 };
+				changed++;
+			}
+			else
+			{
+				range = m_dirtyRanges[dirty++];
+			}
+
+			if (!m_levelRanges.empty() && range.Begin <= m_levelRanges.back().End)
+			{
+				m_levelRanges.back().End = std::max(m_levelRanges.back().End, range.End);
+			}
+			else
+			{
+				m_levelRanges.push_back(range);
+			}
+		}
+
+		m_dirtyRanges.clear();
+		for (const NodeRange& range : m_levelRanges)
+		{
+			size_t count = range.End - range.Begin;
+			if (m_parallelThreshold == 0 || count < m_parallelThreshold)
+			{
+				UpdateNodes(range.Begin, range.End);
+			}
+			else
+			{
+				Platform::JobSystem::ParallelForRange(count, NODES_PER_TASK, [&](size_t taskBegin, size_t taskEnd) {
+					UpdateNodes(range.Begin + taskBegin, range.Begin + taskEnd);
+				});
+			}
+			updateCount += count;
+
+			NodeRange children = { m_childBegin[range.Begin], m_childEnd[range.End - 1] };
+			if (children.Begin < children.End)
+			{
+				m_dirtyRanges.push_back(children);
+			}
+		}
+
+		if (m_dirtyRanges.empty() && changed == m_changedNodes.size())
+		{
+			break;
+		}
+	}
+
+	return updateCount;
+}
+
+void TransformSystem::UpdateNodes(size_t begin, size_t end)
+{
+	using namespace DirectX;
+
+	// Only reads the component storage, safe to call from several threads
+	auto worlds = m_registry.view<Component::WorldMatrixComponent>();
+
+	for (size_t i = begin; i < end; i++)
+	{
+		// world = local * parent world, the transposed matrices multiply the other way around
+		uint32_t parent = m_parents[i];
+		if (parent != NO_PARENT)
+		{
+			XMMATRIX world = XMMatrixMultiply(XMLoadFloat4x4(&m_worldMatrices[parent]), XMLoadFloat4x4(&m_localMatrices[i]));
+			XMStoreFloat4x4(&m_worldMatrices[i], world);
+		}
+		else
+		{
+			m_worldMatrices[i] = m_localMatrices[i];
+		}
+
+		worlds.get<Component::WorldMatrixComponent>(m_entities[i]).WorldTransposed = m_worldMatrices[i];
+	}
+}
+
+void TransformSystem::Rebuild()
+{
+	m_hierarchyChanged = false;
+
+	std::vector<entt::entity> entities;
+	std::unordered_map<entt::entity, uint32_t> indices;
+	m_registry.view<Component::TransformComponent>().each([&](entt::entity entity, const auto& transform) {
+		indices[entity] = (uint32_t)entities.size();
+		entities.push_back(entity);
+	});
+
+	// Parents without a transform are ignored, the child becomes a root
+	std::vector<uint32_t> parents(entities.size(), NO_PARENT);
+	for (size_t i = 0; i < entities.size(); i++)
+	{
+		auto parent = indices.find(m_registry.get<Component::TransformComponent>(entities[i]).ParentEntity);
+		if (parent != indices.end() && parent->second != i)
+		{
+			parents[i] = parent->second;
+		}
+	}
+
+	// Walk up from every node to the first one known to reach a root. A cycle
+	// is broken by turning the node that closes it into a root.
+	const int UNKNOWN = 0;
+	const int VISITING = 1;
+	const int REACHES_ROOT = 2;
+	std::vector<int> states(entities.size(), UNKNOWN);
+	std::vector<uint32_t> chain;
+	for (uint32_t i = 0; i < (uint32_t)entities.size(); i++)
+	{
+		chain.clear();
+		uint32_t node = i;
+		while (node != NO_PARENT && states[node] != REACHES_ROOT)
+		{
+			if (states[node] == VISITING)
+			{
+				std::cerr << "Transform hierarchy cycle at entity " << entt::to_integral(entities[chain.back()]) << std::endl;
+				parents[chain.back()] = NO_PARENT;
+				break;
+			}
+
+			states[node] = VISITING;
+			chain.push_back(node);
+			node = parents[node];
+		}
+
+		for (uint32_t visited : chain)
+		{
+			states[visited] = REACHES_ROOT;
+		}
+	}
+
+	// Children of every node in view order
+	std::vector<uint32_t> childOffsets(entities.size() + 1, 0);
+	for (uint32_t parent : parents)
+	{
+		if (parent != NO_PARENT)
+		{
+			childOffsets[parent + 1]++;
+		}
+	}
+	for (size_t i = 1; i < childOffsets.size(); i++)
+	{
+		childOffsets[i] += childOffsets[i - 1];
+	}
+
+	std::vector<uint32_t> children(childOffsets.back());
+	std::vector<uint32_t> next(childOffsets.begin(), childOffsets.end() - 1);
+	for (uint32_t i = 0; i < (uint32_t)entities.size(); i++)
+	{
+		if (parents[i] != NO_PARENT)
+		{
+			children[next[parents[i]]++] = i;
+		}
+	}
+
+	// Breadth first from the roots, a node reached at the start of a level
+	// begins the next one
+	std::vector<uint32_t> nodes;
+	nodes.reserve(entities.size());
+	for (uint32_t i = 0; i < (uint32_t)entities.size(); i++)
+	{
+		if (parents[i] == NO_PARENT)
+		{
+			nodes.push_back(i);
+		}
+	}
+
+	m_childBegin.resize(entities.size());
+	m_childEnd.resize(entities.size());
+	m_levels.assign(1, 0);
+	for (size_t node = 0; node < nodes.size(); node++)
+	{
+		if (node == m_levels.back())
+		{
+			m_levels.push_back(nodes.size());
+		}
+
+		m_childBegin[node] = (uint32_t)nodes.size();
+		nodes.insert(nodes.end(), children.begin() + childOffsets[nodes[node]], children.begin() + childOffsets[nodes[node] + 1]);
+		m_childEnd[node] = (uint32_t)nodes.size();
+	}
+
+	std::vector<uint32_t> order(entities.size());
+	for (uint32_t node = 0; node < (uint32_t)nodes.size(); node++)
+	{
+		order[nodes[node]] = node;
+	}
+
+	m_entities.resize(entities.size());
+	m_parents.resize(entities.size());
+	m_localMatrices.resize(entities.size());
+	m_worldMatrices.resize(entities.size());
+	m_nodeIndices.clear();
+
+	Resource::TransformBatch batch;
+	batch.Resize(entities.size());
+
+	for (uint32_t i = 0; i < (uint32_t)entities.size(); i++)
+	{
+		uint32_t node = order[i];
+		m_entities[node] = entities[i];
+		m_parents[node] = (parents[i] != NO_PARENT) ? order[parents[i]] : NO_PARENT;
+		batch.Set(node, m_registry.get<Component::TransformComponent>(entities[i]));
+		m_nodeIndices[entities[i]] = node;
+
+		m_registry.get_or_emplace<Component::WorldMatrixComponent>(entities[i]);
+	}
+
+	Resource::ComposeMatricesTransposed(batch, 0, entities.size(), m_localMatrices.data());
+}